@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "adversarial.h"
+
+// 周期的なキーワードの長さ
+#define ADVERSARIAL_PERIODIC_LENGTH 32
+// 共通の接尾辞・接頭辞を持つキーワードの本数と、共通部分の長さ
+#define ADVERSARIAL_N_SHARED_KEYWORDS 16
+#define ADVERSARIAL_SHARED_LENGTH 24
+// short-keyword で混ぜる長いキーワードの本数と長さ
+#define ADVERSARIAL_N_LONG_KEYWORDS 15
+#define ADVERSARIAL_LONG_LENGTH 16
+
+// テキストが text_size バイト以上になるまで unit を繰り返して追記する
+static void
+adversarial_repeat(GString *text, const gchar *unit, gsize text_size)
+{
+    gsize unit_size = strlen(unit);
+    while (text->len < text_size) {
+        g_string_append_len(text, unit, unit_size);
+    }
+}
+
+// c を length 個並べた文字列を返す
+static gchar *
+adversarial_run(gchar c, gsize length)
+{
+    gchar *run = (gchar *) g_malloc(length + 1);
+    memset(run, c, length);
+    run[length] = '\0';
+    return run;
+}
+
+// 照合位置ごとに末尾から 31 文字一致してから先頭で失敗し、次の文字 'a' によるシフトは 1 になる
+static void
+adversarial_periodic_miss(gsize text_size, GString *text, GPtrArray *keywords)
+{
+    gchar *run = adversarial_run('a', ADVERSARIAL_PERIODIC_LENGTH - 1);
+    adversarial_repeat(text, run, text_size);
+    g_ptr_array_add(keywords, g_strconcat("b", run, NULL));
+    g_free(run);
+}
+
+// 周期 2 のキーワードが 2 バイトおきに一致し、一致のたびにキーワード全体を比較し直す
+static void
+adversarial_periodic_match(gsize text_size, GString *text, GPtrArray *keywords)
+{
+    adversarial_repeat(text, "ab", text_size);
+    GString *keyword = g_string_new(NULL);
+    adversarial_repeat(keyword, "ab", ADVERSARIAL_PERIODIC_LENGTH);
+    g_ptr_array_add(keywords, g_string_free(keyword, FALSE));
+}
+
+// すべてのキーワードが長い接尾辞 a...a を共有し、トライを深く辿ってから失敗する
+// 接尾辞の中では shift1 と shift2 が 1 に潰れる
+static void
+adversarial_shared_suffix(gsize text_size, GString *text, GPtrArray *keywords)
+{
+    gchar *run = adversarial_run('a', ADVERSARIAL_SHARED_LENGTH);
+    adversarial_repeat(text, run, text_size);
+    for (gint i = 0; i < ADVERSARIAL_N_SHARED_KEYWORDS; ++i) {
+        gchar head[2] = {(gchar) ('b' + i), '\0'};
+        g_ptr_array_add(keywords, g_strconcat(head, run, NULL));
+    }
+    g_free(run);
+}
+
+// 1 文字のキーワードが1つあるだけで、最短のキーワード長で抑えられるシフト量が 1 になる
+static void
+adversarial_short_keyword(gsize text_size, GString *text, GPtrArray *keywords)
+{
+    // テキストとキーワードは 'z' を含まない英小文字のランダムな並び
+    static const gchar alphabet[] = "abcdefghijklmnopqrstuvwxy";
+    while (text->len < text_size) {
+        g_string_append_c(text, alphabet[rand() % (sizeof(alphabet) - 1)]);
+    }
+    for (gint i = 0; i < ADVERSARIAL_N_LONG_KEYWORDS; ++i) {
+        gchar *keyword = (gchar *) g_malloc(ADVERSARIAL_LONG_LENGTH + 1);
+        for (gint j = 0; j < ADVERSARIAL_LONG_LENGTH; ++j) {
+            keyword[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+        keyword[ADVERSARIAL_LONG_LENGTH] = '\0';
+        g_ptr_array_add(keywords, keyword);
+    }
+    g_ptr_array_add(keywords, g_strdup("z"));
+}
+
+// a...ab の途中で 'c' が来るたびに、深さ 31 から根まで fail_state を辿る
+static void
+adversarial_deep_fail_chain(gsize text_size, GString *text, GPtrArray *keywords)
+{
+    gchar *run = adversarial_run('a', ADVERSARIAL_PERIODIC_LENGTH - 1);
+    gchar *unit = g_strconcat(run, "c", NULL);
+    adversarial_repeat(text, unit, text_size);
+    g_ptr_array_add(keywords, g_strconcat(run, "b", NULL));
+    g_free(unit);
+    g_free(run);
+}
+
+// a, aa, aaa, ... が入れ子になり、テキストの各位置で最大 32 本のキーワードが同時に一致する
+static void
+adversarial_nested_prefix(gsize text_size, GString *text, GPtrArray *keywords)
+{
+    gchar *run = adversarial_run('a', ADVERSARIAL_PERIODIC_LENGTH);
+    adversarial_repeat(text, run, text_size);
+    for (gsize length = 1; length <= ADVERSARIAL_PERIODIC_LENGTH; ++length) {
+        g_ptr_array_add(keywords, g_strndup(run, length));
+    }
+    g_free(run);
+}
+
+// 長い接頭辞 abab...ab を共有するキーワードが、接頭辞の直後の1文字で必ず失敗する
+static void
+adversarial_repeated_prefix(gsize text_size, GString *text, GPtrArray *keywords)
+{
+    GString *prefix = g_string_new(NULL);
+    adversarial_repeat(prefix, "ab", ADVERSARIAL_SHARED_LENGTH);
+    gchar *unit = g_strconcat(prefix->str, "z", NULL);
+    adversarial_repeat(text, unit, text_size);
+    for (gint i = 0; i < ADVERSARIAL_N_SHARED_KEYWORDS; ++i) {
+        gchar tail[2] = {(gchar) ('c' + i), '\0'};
+        g_ptr_array_add(keywords, g_strconcat(prefix->str, tail, NULL));
+    }
+    g_free(unit);
+    g_string_free(prefix, TRUE);
+}
+
+static const AdversarialScenario adversarial_scenarios[] = {
+    {"periodic-miss", "Sunday, Horspool", "b a^31 in a^n", adversarial_periodic_miss},
+    {"periodic-match", "Boyer-Moore", "(ab)^16 in (ab)^n", adversarial_periodic_match},
+    {"shared-suffix", "Commentz-Walter", "16 keywords x a^24 in a^n", adversarial_shared_suffix},
+    {"short-keyword", "Commentz-Walter", "one 1-char keyword among 16-char keywords", adversarial_short_keyword},
+    {"deep-fail-chain", "Aho-Corasick", "a^31 b in (a^31 c)^n", adversarial_deep_fail_chain},
+    {"nested-prefix", "Aho-Corasick, single-pattern engines", "a, aa, ..., a^32 in a^n", adversarial_nested_prefix},
+    {"repeated-prefix", "naive, Aho-Corasick", "16 keywords (ab)^12 x in ((ab)^12 z)^n", adversarial_repeated_prefix},
+};
+
+const AdversarialScenario *
+Adversarial_getScenarios(gsize *n_scenarios)
+{
+    *n_scenarios = G_N_ELEMENTS(adversarial_scenarios);
+    return adversarial_scenarios;
+}
+
+/**
+ * 名前が name のシナリオを返し、見つからなければ NULL を返す
+ */
+const AdversarialScenario *
+Adversarial_findScenario(const gchar *name)
+{
+    for (gsize i = 0; i < G_N_ELEMENTS(adversarial_scenarios); ++i) {
+        if (0 == strcmp(adversarial_scenarios[i].name, name)) {
+            return &adversarial_scenarios[i];
+        }
+    }
+    return NULL;
+}
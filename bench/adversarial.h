@@ -0,0 +1,33 @@
+// ベンチマーク用の最悪ケースの入力
+// 各エンジンのシフトやスキップが効かなくなるテキストとキーワードの組を名前付きで作る
+// ランダムな入力での平均的なスループットと並べて、最悪ケースのスループットを追跡するために使う
+
+#ifndef __ADVERSARIAL_H__
+#define __ADVERSARIAL_H__
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * text_size バイト程度のテキストを text に追記し、キーワード (g_free で解放する文字列) を keywords に追加する
+ */
+typedef void (*AdversarialGenerateFunc)(gsize text_size, GString *text, GPtrArray *keywords);
+
+typedef struct AdversarialScenario {
+    const gchar *name;                 /* --scenario で指定する名前 */
+    const gchar *target;               /* 苦手とするエンジン */
+    const gchar *description;
+    AdversarialGenerateFunc generate;
+} AdversarialScenario;
+
+extern const AdversarialScenario *Adversarial_getScenarios(gsize *n_scenarios);
+extern const AdversarialScenario *Adversarial_findScenario(const gchar *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __ADVERSARIAL_H__
@@ -1,16 +1,26 @@
+#include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
 #include <glib.h>
 
 #include "../src/ahocorasickunicode.h"
+#include "../src/approximateunicode.h"
 #include "../src/boyermoore.h"
 #include "../src/boyermooreunicode.h"
 #include "../src/commentzwalter.h"
 #include "../src/commentzwalterunicode.h"
+#include "../src/matcher.h"
+#include "../src/matchercostprofile.h"
 #include "../src/naiveunicode.h"
+#include "../src/simddispatch.h"
 #include "../src/sunday.h"
+#include "../src/twoway.h"
+#include "../src/twowayunicode.h"
+#include "adversarial.h"
+#include "harness.h"
+#include "perfcounters.h"
 
 // 大文字小文字は区別しない、正規化しない
 // サンプルデータは UTF-8 である必要がある
@@ -20,48 +30,154 @@
 #define KEYWORD_SIZE (64)
 #define KEYWORD_ALLOC_SIZE (KEYWORD_SIZE + 6)
 
-typedef void (*bench_impl_func)(const char *, const char *, size_t, size_t, double *, long *);
+// --calibrate で計測する文書の大きさと、1つの格子点で前処理と走査のそれぞれを繰り返す最短時間
+#define CALIBRATION_DOCUMENT_SIZE (256 * 1024)
+#define CALIBRATION_MIN_NS (10 * 1000 * 1000)
+
+// --corpus の既定値
+#define CORPUS_DEFAULT_KEYWORDS 100
+#define CORPUS_DEFAULT_HIT_RATIO 0.5
+#define CORPUS_DEFAULT_MIN_LENGTH 2
+#define CORPUS_DEFAULT_MAX_LENGTH 8
+// テキストに現れないキーワードを作るときに試す回数の上限
+#define CORPUS_MAX_RETRIES 1000
+
+// --adversarial で作るテキストの大きさ
+#define ADVERSARIAL_TEXT_SIZE (256 * 1024)
+
+// --threads で指定できるスレッド数の上限
+#define THREADS_MAX 1024
+
+// --batch で Matcher_scanBatch に一度に渡す行数
+#define BATCH_N_LINES 1024
+
+// 計測の既定値: 捨てる反復の回数、--corpus で計測する反復の回数、--compare で性能劣化とみなす遅れ (%)
+#define BENCH_DEFAULT_WARMUP 2
+#define BENCH_DEFAULT_ITERATIONS 10
+#define BENCH_DEFAULT_THRESHOLD 5.0
+
+// 計測区間にかかった時間 (ns) とハードウェアカウンタの値
+// 前処理の区間では、前処理の結果が使うメモリのバイト数も記録する
+typedef struct bench_phase_t {
+    gint64 ns;
+    PerfCounterValues counters;
+    gsize memory_bytes;
+} bench_phase_t;
+
+#define BENCH_PHASE_INIT {0, PERFCOUNTERVALUES_INIT, 0}
+
+typedef void (*bench_impl_func)(const char *, const char *, size_t, size_t, bench_phase_t *, long *);
 
 struct bench_entry_t {
     const char *label;
     bench_impl_func bench_impl;
 };
 
-static void bench_ac_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits);
-static void bench_cw(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits);
-static void bench_cw_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits);
-static void bench_bm(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits);
-static void bench_bm_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits);
-static void bench_sunday(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits);
-static void bench_naive_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits);
-static void bench_naive_unicode_with_simd(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits);
+static void bench_ac_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+static void bench_cw(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+static void bench_cw_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+static void bench_bm(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+static void bench_bm_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+static void bench_sunday(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+#ifdef __SSE2__
+static void bench_sunday_with_simd(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+#endif // __SSE2__
+static void bench_twoway(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+static void bench_twoway_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+static void bench_naive_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+#ifdef __SSE2__
+static void bench_naive_unicode_with_simd(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+#endif // __SSE2__
+static void bench_approximate_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+static void bench_matcher(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits);
+
+// コマンドラインで指定する計測の設定
+static struct {
+    gint warmup;
+    gint iterations;
+    HarnessReport *report;
+    PerfCounters *counters; // --perf でカウンタを開けなければ NULL
+    gboolean verbose_memory; // --memory でメモリの内訳を出力する
+    gint max_threads; // --threads で指定したスレッド数。0 なら複数スレッドでは計測しない
+    gint pin_cpu; // --pin で指定した CPU。複数スレッドでは i 番目のスレッドを pin_cpu + i 番の CPU に固定する
+    gboolean batch; // --batch で1行ずつの走査とまとめた走査を比べる
+    gboolean interleave; // --interleave で Aho-Corasick の逐次の走査と交互の走査を比べる
+    gboolean lines; // --lines で見つかった位置の行番号を後から数える場合と、走査しながら数える場合を比べる
+    gint approximate; // --approximate で指定した誤りの数の上限。0 なら近似照合は計測しない
+} bench_options = {BENCH_DEFAULT_WARMUP, BENCH_DEFAULT_ITERATIONS, NULL, NULL, FALSE, 0, -1, FALSE, FALSE, FALSE, 0};
 
 static struct bench_entry_t bench_entries[] = {
         {"Aho-Corasick   ", bench_ac_unicode},
         {"Commentz-Walter", bench_cw_unicode},
         {"Boyer-Moore    ", bench_bm},
+        {"BM-Unicode     ", bench_bm_unicode},
         {"Sunday         ", bench_sunday},
+#ifdef __SSE2__
+        {"Sunday-SIMD    ", bench_sunday_with_simd},
+#endif // __SSE2__
+        {"Two-Way        ", bench_twoway},
+        {"Two-Way-Unicode", bench_twoway_unicode},
         {"naive          ", bench_naive_unicode},
+#ifdef __SSE2__
+        {"naive-SIMD     ", bench_naive_unicode_with_simd},
+#endif // __SSE2__
+        {"Approximate-k1 ", bench_approximate_unicode},
+        {"Auto           ", bench_matcher},
         {NULL, NULL},
 };
 
+// 現在の時刻と、--perf で開いたカウンタの値を読む
+static void
+bench_phase_begin(bench_phase_t *begin)
+{
+    if (NULL != bench_options.counters) {
+        PerfCounters_read(bench_options.counters, &begin->counters);
+    } else {
+        begin->counters = (PerfCounterValues) PERFCOUNTERVALUES_INIT;
+    }
+    begin->ns = Harness_getTimeNs();
+}
+
+// bench_phase_begin からの時間とカウンタの増分を phase に足し込む。phase が NULL なら何もしない
+static void
+bench_phase_end(bench_phase_t *phase, const bench_phase_t *begin)
+{
+    if (NULL == phase) {
+        return;
+    }
+    phase->ns += Harness_getTimeNs() - begin->ns;
+    if (NULL != bench_options.counters) {
+        PerfCounterValues end;
+        PerfCounters_read(bench_options.counters, &end);
+        PerfCounterValues_addDelta(&phase->counters, &begin->counters, &end);
+    }
+}
+
+// 前処理の結果が使うメモリを phase に足し込む。phase が NULL なら何もしない
+static void
+bench_phase_addMemory(bench_phase_t *phase, const MemoryUsage *usage)
+{
+    if (NULL != phase) {
+        phase->memory_bytes += MemoryUsage_getTotal(usage);
+    }
+}
+
 static void
-bench_ac_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits)
+bench_ac_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
 {
     UnicodeAhoCorasickMatcher *matcher = UnicodeAhoCorasickMatcher_new(MAX_KEYWORD_LENGTH);
     const char *keyword = keywords;
     const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
-    struct timeval tv_before;
-    g_assert(0 == gettimeofday(&tv_before, NULL));
+    bench_phase_t build_begin;
+    bench_phase_begin(&build_begin);
     for (; keyword_end != keyword; keyword += KEYWORD_ALLOC_SIZE) {
         g_assert(UnicodeAhoCorasickMatcher_addKeywordAsUTF8(matcher, keyword, -1L, NULL));
     }
-    struct timeval tv_after;
-    g_assert(0 == gettimeofday(&tv_after, NULL));
-    if (NULL != build_time) {
-        *build_time += tv_after.tv_sec - tv_before.tv_sec;
-        *build_time += (tv_after.tv_usec -tv_before.tv_usec) * 0.000001;
-    }
+    UnicodeAhoCorasickMatcher_compile(matcher);
+    bench_phase_end(build, &build_begin);
+    MemoryUsage usage = MEMORYUSAGE_INIT;
+    UnicodeAhoCorasickMatcher_memoryUsage(matcher, &usage);
+    bench_phase_addMemory(build, &usage);
     for (int j=0; j<n_scanning; ++j) {
         UnicodeAhoCorasickPatternsIter *iter = NULL;
         g_assert(UnicodeAhoCorasickMatcher_scanUTF8String(matcher, document, -1L, &iter, NULL));
@@ -74,23 +190,21 @@ bench_ac_unicode(const char *document, const char *keywords, size_t n_keywords,
 }
 
 static void
-bench_cw(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits)
+bench_cw(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
 {
     CommentzWalterMatcher *matcher = CommentzWalterMatcher_new(MAX_KEYWORD_LENGTH);
     const char *keyword = keywords;
     const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
-    struct timeval tv_before;
-    g_assert(0 == gettimeofday(&tv_before, NULL));
+    bench_phase_t build_begin;
+    bench_phase_begin(&build_begin);
     for (; keyword_end != keyword; keyword += KEYWORD_ALLOC_SIZE) {
         CommentzWalterMatcher_addKeyword(matcher, keyword, -1L);
     }
     CommentzWalterMatcher_compile(matcher);
-    struct timeval tv_after;
-    g_assert(0 == gettimeofday(&tv_after, NULL));
-    if (NULL != build_time) {
-        *build_time += tv_after.tv_sec - tv_before.tv_sec;
-        *build_time += (tv_after.tv_usec -tv_before.tv_usec) * 0.000001;
-    }
+    bench_phase_end(build, &build_begin);
+    MemoryUsage usage = MEMORYUSAGE_INIT;
+    CommentzWalterMatcher_memoryUsage(matcher, &usage);
+    bench_phase_addMemory(build, &usage);
     for (int j=0; j<n_scanning; ++j) {
         gconstpointer output = NULL;
         CommentzWalterMatcher_scan(matcher, document, -1L, &output);
@@ -102,23 +216,21 @@ bench_cw(const char *document, const char *keywords, size_t n_keywords, size_t n
 }
 
 static void
-bench_cw_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits)
+bench_cw_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
 {
     UnicodeCommentzWalterMatcher *matcher = UnicodeCommentzWalterMatcher_new(MAX_KEYWORD_LENGTH);
     const char *keyword = keywords;
     const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
-    struct timeval tv_before;
-    g_assert(0 == gettimeofday(&tv_before, NULL));
+    bench_phase_t build_begin;
+    bench_phase_begin(&build_begin);
     for (; keyword_end != keyword; keyword += KEYWORD_ALLOC_SIZE) {
         g_assert(UnicodeCommentzWalterMatcher_addKeywordAsUTF8(matcher, keyword, -1L, NULL));
     }
     UnicodeCommentzWalterMatcher_compile(matcher);
-    struct timeval tv_after;
-    g_assert(0 == gettimeofday(&tv_after, NULL));
-    if (NULL != build_time) {
-        *build_time += tv_after.tv_sec - tv_before.tv_sec;
-        *build_time += (tv_after.tv_usec -tv_before.tv_usec) * 0.000001;
-    }
+    bench_phase_end(build, &build_begin);
+    MemoryUsage usage = MEMORYUSAGE_INIT;
+    UnicodeCommentzWalterMatcher_memoryUsage(matcher, &usage);
+    bench_phase_addMemory(build, &usage);
     for (int j=0; j<n_scanning; ++j) {
         gconstpointer output = NULL;
         g_assert(UnicodeCommentzWalterMatcher_scanUTF8String(matcher, document, -1L, &output, NULL));
@@ -130,21 +242,19 @@ bench_cw_unicode(const char *document, const char *keywords, size_t n_keywords,
 }
 
 static void
-bench_bm(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits)
+bench_bm(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
 {
-    struct timeval tv_before;
-    struct timeval tv_after;
     const char *keyword = keywords;
     const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
     BoyerMooreMatcher *matcher = BoyerMooreMatcher_new("dummy");
     for (; keyword_end != keyword; keyword += KEYWORD_ALLOC_SIZE ) {
-        g_assert(0 == gettimeofday(&tv_before, NULL));
+        bench_phase_t build_begin;
+        bench_phase_begin(&build_begin);
         BoyerMooreMatcher_updatePattern(matcher, keyword);
-        g_assert(0 == gettimeofday(&tv_after, NULL));
-        if (NULL != build_time) {
-            *build_time += tv_after.tv_sec - tv_before.tv_sec;
-            *build_time += (tv_after.tv_usec -tv_before.tv_usec) * 0.000001;
-        }
+        bench_phase_end(build, &build_begin);
+        MemoryUsage usage = MEMORYUSAGE_INIT;
+        BoyerMooreMatcher_memoryUsage(matcher, &usage);
+        bench_phase_addMemory(build, &usage);
         for (int j=0; j<n_scanning; ++j) {
             if (BoyerMooreMatcher_scan(matcher, document, FALSE)) {
                 if (NULL != n_hits) {
@@ -157,23 +267,21 @@ bench_bm(const char *document, const char *keywords, size_t n_keywords, size_t n
 }
 
 static void
-bench_bm_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits)
+bench_bm_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
 {
-    struct timeval tv_before;
-    struct timeval tv_after;
     const char *keyword = keywords;
     const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
     for (; keyword_end != keyword; keyword += KEYWORD_ALLOC_SIZE) {
-        g_assert(0 == gettimeofday(&tv_before, NULL));
+        bench_phase_t build_begin;
+        bench_phase_begin(&build_begin);
         glong length_as_u16 = 0L;
         gunichar2 *keyword_as_u16 = g_utf8_to_utf16(keyword, -1L, NULL, &length_as_u16, NULL);
         g_assert(NULL != keyword_as_u16);
         UnicodeBoyerMooreMatcher *matcher = UnicodeBoyerMooreMatcher_new(keyword_as_u16, length_as_u16);
-        g_assert(0 == gettimeofday(&tv_after, NULL));
-        if (NULL != build_time) {
-            *build_time += tv_after.tv_sec - tv_before.tv_sec;
-            *build_time += (tv_after.tv_usec -tv_before.tv_usec) * 0.000001;
-        }
+        bench_phase_end(build, &build_begin);
+        MemoryUsage usage = MEMORYUSAGE_INIT;
+        UnicodeBoyerMooreMatcher_memoryUsage(matcher, &usage);
+        bench_phase_addMemory(build, &usage);
         for (size_t j=0; j<n_scanning; ++j) {
             gboolean matched;
             g_assert(UnicodeBoyerMooreMatcher_scanUTF8String(matcher, document, -1L, &matched, NULL));
@@ -187,22 +295,20 @@ bench_bm_unicode(const char *document, const char *keywords, size_t n_keywords,
 }
 
 static void
-bench_sunday(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits)
+bench_sunday(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
 {
-    struct timeval tv_before;
-    struct timeval tv_after;
     gsize documentlen = strlen(document);
     const char *keyword = keywords;
     const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
     SundayMatcher *matcher = SundayMatcher_new("dummy", -1L);
     for (; keyword_end != keyword; keyword += KEYWORD_ALLOC_SIZE ) {
-        g_assert(0 == gettimeofday(&tv_before, NULL));
+        bench_phase_t build_begin;
+        bench_phase_begin(&build_begin);
         SundayMatcher_reinit(matcher, keyword, -1L);
-        g_assert(0 == gettimeofday(&tv_after, NULL));
-        if (NULL != build_time) {
-            *build_time += tv_after.tv_sec - tv_before.tv_sec;
-            *build_time += (tv_after.tv_usec -tv_before.tv_usec) * 0.000001;
-        }
+        bench_phase_end(build, &build_begin);
+        MemoryUsage usage = MEMORYUSAGE_INIT;
+        SundayMatcher_memoryUsage(matcher, &usage);
+        bench_phase_addMemory(build, &usage);
         for (int j=0; j<n_scanning; ++j) {
             if (SundayMatcher_scan(matcher, document, documentlen)) {
                 if (NULL != n_hits) {
@@ -214,8 +320,96 @@ bench_sunday(const char *document, const char *keywords, size_t n_keywords, size
     SundayMatcher_free(matcher);
 }
 
+#ifdef __SSE2__
+
+static void
+bench_sunday_with_simd(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
+{
+    gsize documentlen = strlen(document);
+    const char *keyword = keywords;
+    const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
+    SundayMatcher *matcher = SundayMatcher_new("dummy", -1L);
+    for (; keyword_end != keyword; keyword += KEYWORD_ALLOC_SIZE ) {
+        bench_phase_t build_begin;
+        bench_phase_begin(&build_begin);
+        SundayMatcher_reinit(matcher, keyword, -1L);
+        bench_phase_end(build, &build_begin);
+        MemoryUsage usage = MEMORYUSAGE_INIT;
+        SundayMatcher_memoryUsage(matcher, &usage);
+        bench_phase_addMemory(build, &usage);
+        for (int j=0; j<n_scanning; ++j) {
+            if (SundayMatcher_scanWithSIMD(matcher, document, documentlen)) {
+                if (NULL != n_hits) {
+                    ++(*n_hits);
+                }
+            }
+        }
+    }
+    SundayMatcher_free(matcher);
+}
+
+#endif // __SSE2__
+
+static void
+bench_twoway(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
+{
+    gsize documentlen = strlen(document);
+    const char *keyword = keywords;
+    const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
+    TwoWayMatcher *matcher = TwoWayMatcher_new("dummy", -1L);
+    for (; keyword_end != keyword; keyword += KEYWORD_ALLOC_SIZE ) {
+        bench_phase_t build_begin;
+        bench_phase_begin(&build_begin);
+        TwoWayMatcher_reinit(matcher, keyword, -1L);
+        bench_phase_end(build, &build_begin);
+        MemoryUsage usage = MEMORYUSAGE_INIT;
+        TwoWayMatcher_memoryUsage(matcher, &usage);
+        bench_phase_addMemory(build, &usage);
+        for (int j=0; j<n_scanning; ++j) {
+            if (TwoWayMatcher_scan(matcher, document, documentlen)) {
+                if (NULL != n_hits) {
+                    ++(*n_hits);
+                }
+            }
+        }
+    }
+    TwoWayMatcher_free(matcher);
+}
+
+static void
+bench_twoway_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
+{
+    glong document_length_as_u16 = 0L;
+    gunichar2 *document_as_u16 = g_utf8_to_utf16(document, -1L, NULL, &document_length_as_u16, NULL);
+    g_assert(NULL != document_as_u16);
+    const char *keyword = keywords;
+    const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
+    for (; keyword_end != keyword; keyword += KEYWORD_ALLOC_SIZE) {
+        bench_phase_t build_begin;
+        bench_phase_begin(&build_begin);
+        glong length_as_u16 = 0L;
+        gunichar2 *keyword_as_u16 = g_utf8_to_utf16(keyword, -1L, NULL, &length_as_u16, NULL);
+        g_assert(NULL != keyword_as_u16);
+        UnicodeTwoWayMatcher *matcher = UnicodeTwoWayMatcher_new(keyword_as_u16, length_as_u16);
+        bench_phase_end(build, &build_begin);
+        MemoryUsage usage = MEMORYUSAGE_INIT;
+        UnicodeTwoWayMatcher_memoryUsage(matcher, &usage);
+        bench_phase_addMemory(build, &usage);
+        for (size_t j=0; j<n_scanning; ++j) {
+            if (UnicodeTwoWayMatcher_scan(matcher, document_as_u16, document_length_as_u16)) {
+                if (NULL != n_hits) {
+                    ++(*n_hits);
+                }
+            }
+        }
+        UnicodeTwoWayMatcher_free(matcher);
+        g_free(keyword_as_u16);
+    }
+    g_free(document_as_u16);
+}
+
 static void
-bench_naive_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits)
+bench_naive_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
 {
     const char *keyword = keywords;
     const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
@@ -230,8 +424,10 @@ bench_naive_unicode(const char *document, const char *keywords, size_t n_keyword
     }
 }
 
+#ifdef __SSE2__
+
 static void
-bench_naive_unicode_with_simd(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, double *build_time, long *n_hits)
+bench_naive_unicode_with_simd(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
 {
     const char *keyword = keywords;
     const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
@@ -246,6 +442,82 @@ bench_naive_unicode_with_simd(const char *document, const char *keywords, size_t
     }
 }
 
+#endif // __SSE2__
+
+static gboolean
+bench_approximate_found(gsize end_offset, guint distance, gpointer user_data)
+{
+    *(gboolean *) user_data = TRUE;
+    return FALSE;
+}
+
+// 編集距離が1以下の出現を探す。ほかのエンジンと違って誤りを許すので、見つかるキーワードの数は多くなる
+static void
+bench_approximate_unicode(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
+{
+    glong document_length_as_u16 = 0L;
+    gunichar2 *document_as_u16 = g_utf8_to_utf16(document, -1L, NULL, &document_length_as_u16, NULL);
+    g_assert(NULL != document_as_u16);
+    const char *keyword = keywords;
+    const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
+    for (; keyword_end != keyword; keyword += KEYWORD_ALLOC_SIZE) {
+        bench_phase_t build_begin;
+        bench_phase_begin(&build_begin);
+        glong length_as_u16 = 0L;
+        gunichar2 *keyword_as_u16 = g_utf8_to_utf16(keyword, -1L, NULL, &length_as_u16, NULL);
+        g_assert(NULL != keyword_as_u16);
+        UnicodeApproximateMatcher *matcher = UnicodeApproximateMatcher_new(keyword_as_u16, length_as_u16,
+                                                                           UNICODE_APPROXIMATE_EDIT_DISTANCE,
+                                                                           MIN(1, length_as_u16 - 1));
+        bench_phase_end(build, &build_begin);
+        MemoryUsage usage = MEMORYUSAGE_INIT;
+        UnicodeApproximateMatcher_memoryUsage(matcher, &usage);
+        bench_phase_addMemory(build, &usage);
+        for (size_t j=0; j<n_scanning; ++j) {
+            gboolean found = FALSE;
+            UnicodeApproximateMatcher_scanUTF16String(matcher, document_as_u16, document_length_as_u16,
+                                                      bench_approximate_found, &found);
+            if (found && NULL != n_hits) {
+                ++(*n_hits);
+            }
+        }
+        UnicodeApproximateMatcher_free(matcher);
+        g_free(keyword_as_u16);
+    }
+    g_free(document_as_u16);
+}
+
+static void
+bench_matcher(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_phase_t *build, long *n_hits)
+{
+    static gboolean engine_reported = FALSE;
+    Matcher *matcher = Matcher_new();
+    const char *keyword = keywords;
+    const char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
+    bench_phase_t build_begin;
+    bench_phase_begin(&build_begin);
+    for (; keyword_end != keyword; keyword += KEYWORD_ALLOC_SIZE) {
+        g_assert(Matcher_addKeyword(matcher, keyword, -1L, NULL));
+    }
+    g_assert(Matcher_compile(matcher, MATCHER_ENGINE_AUTO, NULL));
+    bench_phase_end(build, &build_begin);
+    MemoryUsage usage = MEMORYUSAGE_INIT;
+    Matcher_memoryUsage(matcher, &usage);
+    bench_phase_addMemory(build, &usage);
+    if (!engine_reported) {
+        g_printerr("Auto engine: %s\n", Matcher_getEngineName(matcher));
+        engine_reported = TRUE;
+    }
+    for (int j=0; j<n_scanning; ++j) {
+        const gchar *found = NULL;
+        g_assert(Matcher_scan(matcher, document, -1L, &found, NULL, NULL));
+        if (NULL != found && NULL != n_hits) {
+            ++(*n_hits);
+        }
+    }
+    Matcher_free(matcher);
+}
+
 static size_t
 rand_utf8_text(size_t size, char *outbuf)
 {
@@ -263,61 +535,1168 @@ rand_utf8_text(size_t size, char *outbuf)
     return real_size;
 }
 
+// キーワード数と長さ (文字数) の格子で各エンジンを計測する
+static const guint calibration_keyword_counts[] = {1, 4, 16, 64, 256};
+static const guint calibration_keyword_lengths[] = {2, 4, 8, 16, 32};
+
+// 英文らしい頻度で英小文字と空白を並べる
+static const char calibration_ascii_chars[] =
+    "           eeeeeeeeeeeetttttttttaaaaaaaaoooooooiiiiiiinnnnnnnsssssshhhhhhrrrrrrddddlllluuucccmmwwffggyyppbbvkjxqz";
+
+// alphabet の文字を n_chars 文字並べる
+// CJK はひらがなと漢字をおよそ 7:3 で混ぜる
+static size_t
+rand_calibration_text(MatcherAlphabet alphabet, size_t n_chars, char *outbuf)
+{
+    size_t real_size = 0;
+    for (size_t i=0; i<n_chars; ++i) {
+        if (MATCHER_ALPHABET_ASCII == alphabet) {
+            outbuf[real_size++] = calibration_ascii_chars[rand() % (sizeof(calibration_ascii_chars) - 1)];
+        } else {
+            gunichar rand_char = (rand() % 10 < 7) ? 0x3041 + rand() % 83 : 0x4E00 + rand() % 2000;
+            real_size += g_unichar_to_utf8(rand_char, outbuf + real_size);
+        }
+    }
+    outbuf[real_size] = '\0';
+    return real_size;
+}
+
+static gboolean
+count_match(const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    ++(*(long *) user_data);
+    return TRUE;
+}
+
+// 1回の前処理にかかる時間 (ns) を返す
+static double
+time_build(Matcher *matcher, MatcherEngine engine, gint64 min_ns)
+{
+    long n_repeats = 0;
+    gint64 elapsed = 0;
+    gint64 begin = Harness_getTimeNs();
+    do {
+        g_assert(Matcher_compile(matcher, engine, NULL));
+        ++n_repeats;
+        elapsed = Harness_getTimeNs() - begin;
+    } while (elapsed < min_ns);
+    return (double) elapsed / n_repeats;
+}
+
+// document を1回走査してすべての出現を数えるのにかかる時間 (ns) を返す
+static double
+time_scan(Matcher *matcher, const char *document, size_t document_size, gint64 min_ns, long *n_hits)
+{
+    long n_repeats = 0;
+    gint64 elapsed = 0;
+    gint64 begin = Harness_getTimeNs();
+    do {
+        *n_hits = 0;
+        g_assert(Matcher_scanAll(matcher, document, document_size, count_match, n_hits, NULL));
+        ++n_repeats;
+        elapsed = Harness_getTimeNs() - begin;
+    } while (elapsed < min_ns);
+    return (double) elapsed / n_repeats;
+}
+
+// キーワード数、長さ、文字種を変えながら各エンジンの前処理と走査の時間を計測し、コストプロファイルとして保存する
+static int
+calibrate(const char *filename)
+{
+    MatcherCostProfile *profile = MatcherCostProfile_new(
+        calibration_keyword_counts, G_N_ELEMENTS(calibration_keyword_counts),
+        calibration_keyword_lengths, G_N_ELEMENTS(calibration_keyword_lengths));
+    char *document = (char *) malloc(sizeof(char) * (CALIBRATION_DOCUMENT_SIZE * 3 + 1));
+    char *keyword = (char *) malloc(sizeof(char) * (MAX_KEYWORD_LENGTH * 3 + 1));
+    printf("alphabet\tkeywords\tlength\tengine\tbuild_ns_per_byte\tscan_ns_per_byte\thits\n");
+    for (guint alphabet=0; alphabet<MATCHER_N_ALPHABETS; ++alphabet) {
+        // 文書の大きさは文字数で揃える
+        size_t document_size = rand_calibration_text((MatcherAlphabet) alphabet, CALIBRATION_DOCUMENT_SIZE, document);
+        for (gsize ci=0; ci<G_N_ELEMENTS(calibration_keyword_counts); ++ci) {
+            for (gsize li=0; li<G_N_ELEMENTS(calibration_keyword_lengths); ++li) {
+                // 重複したキーワードは Matcher に除かれるので、異なるキーワードを指定した本数だけ作る
+                Matcher *matcher = Matcher_new();
+                GHashTable *keyword_set = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+                size_t keyword_bytes = 0;
+                while (g_hash_table_size(keyword_set) < calibration_keyword_counts[ci]) {
+                    size_t keyword_size = rand_calibration_text((MatcherAlphabet) alphabet, calibration_keyword_lengths[li], keyword);
+                    if (!g_hash_table_contains(keyword_set, keyword)) {
+                        g_hash_table_add(keyword_set, g_strdup(keyword));
+                        g_assert(Matcher_addKeyword(matcher, keyword, -1L, NULL));
+                        keyword_bytes += keyword_size;
+                    }
+                }
+                g_hash_table_destroy(keyword_set);
+                for (guint engine=MATCHER_ENGINE_AUTO+1; engine<MATCHER_N_ENGINES; ++engine) {
+                    const gchar *engine_name = MatcherEngine_getName((MatcherEngine) engine);
+                    if (NULL == engine_name) {
+                        continue;
+                    }
+                    double build_ns = time_build(matcher, (MatcherEngine) engine, CALIBRATION_MIN_NS);
+                    long n_hits = 0;
+                    double scan_ns = time_scan(matcher, document, document_size, CALIBRATION_MIN_NS, &n_hits);
+                    double build_ns_per_byte = build_ns / keyword_bytes;
+                    double scan_ns_per_byte = scan_ns / document_size;
+                    MatcherCostProfile_setCost(profile, (MatcherEngine) engine, (MatcherAlphabet) alphabet, ci, li,
+                                               MAX(build_ns_per_byte, 0.001), MAX(scan_ns_per_byte, 0.001));
+                    printf("%s\t%u\t%u\t%s\t%lf\t%lf\t%ld\n",
+                           MatcherCostProfile_getAlphabetName((MatcherAlphabet) alphabet),
+                           calibration_keyword_counts[ci], calibration_keyword_lengths[li], engine_name,
+                           build_ns_per_byte, scan_ns_per_byte, n_hits);
+                    fflush(stdout);
+                }
+                Matcher_free(matcher);
+            }
+        }
+    }
+    free(keyword);
+    free(document);
+    GError *error = NULL;
+    if (!MatcherCostProfile_save(profile, filename, &error)) {
+        g_printerr("failed to save %s: %s\n", filename, error->message);
+        g_error_free(error);
+        MatcherCostProfile_free(profile);
+        return 1;
+    }
+    MatcherCostProfile_free(profile);
+    g_printerr("cost profile is saved to %s\n", filename);
+    return 0;
+}
+
+// text の文字境界から n_chars 文字を取り出して outbuf に書き込み、そのバイト数を返す
+// 取り出した範囲が改行を含むかテキストの末尾を越える場合は 0 を返す
+static size_t
+corpus_pick_substring(const char *text, size_t text_size, size_t n_chars, char *outbuf)
+{
+    const char *begin = text + (size_t) rand() % text_size;
+    while (text < begin && 0x80 == (*(const guchar *) begin & 0xC0)) {
+        --begin;
+    }
+    const char *end = begin;
+    const char *const text_end = text + text_size;
+    for (size_t i=0; i<n_chars; ++i) {
+        if (text_end <= end || '\r' == *end || '\n' == *end) {
+            return 0;
+        }
+        end = g_utf8_next_char(end);
+    }
+    if (text_end < end) {
+        return 0;
+    }
+    memcpy(outbuf, begin, end - begin);
+    outbuf[end - begin] = '\0';
+    return end - begin;
+}
+
+// text から取り出した n_chars 文字の1文字を text 中の別の文字に置き換え、text に現れないキーワードを作る
+// 文字の出現頻度はテキストに近いまま、必ず照合に失敗するキーワードになる
+static size_t
+corpus_make_miss_keyword(const char *text, size_t text_size, size_t n_chars, char *outbuf)
+{
+    char replacement[8];
+    char *work = (char *) g_malloc(n_chars * 6 + 8);
+    for (int retry=0; retry<CORPUS_MAX_RETRIES; ++retry) {
+        size_t keyword_size = corpus_pick_substring(text, text_size, n_chars, outbuf);
+        if (0 == keyword_size || 0 == corpus_pick_substring(text, text_size, 1, replacement)) {
+            continue;
+        }
+        const char *target = g_utf8_offset_to_pointer(outbuf, rand() % n_chars);
+        const char *target_end = g_utf8_next_char(target);
+        size_t head_size = target - outbuf;
+        size_t replacement_size = strlen(replacement);
+        memcpy(work, outbuf, head_size);
+        memcpy(work + head_size, replacement, replacement_size);
+        strcpy(work + head_size + replacement_size, target_end);
+        if (NULL == g_strstr_len(text, text_size, work)) {
+            strcpy(outbuf, work);
+            g_free(work);
+            return strlen(outbuf);
+        }
+    }
+    g_free(work);
+    return 0;
+}
+
+// text から n_keywords 本の異なるキーワードを作って matcher に登録し、text に現れるキーワードの本数を返す
+// キーワードの長さは min_length 以上 max_length 以下の一様分布で、およそ hit_ratio の割合が text に現れる
+// 登録したキーワードの合計バイト数を keyword_bytes に代入する。keywords が NULL でなければキーワードの複製を追加する
+static size_t
+corpus_add_keywords(Matcher *matcher, const char *text, size_t text_size, size_t n_keywords, double hit_ratio,
+                    size_t min_length, size_t max_length, size_t *keyword_bytes, GPtrArray *keywords)
+{
+    size_t n_hit_keywords = (size_t) (n_keywords * hit_ratio + 0.5);
+    char *keyword = (char *) malloc(sizeof(char) * (max_length * 6 + 1));
+    GHashTable *keyword_set = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    size_t n_actual_hits = 0;
+    int n_failures = 0;
+    while (g_hash_table_size(keyword_set) < n_keywords && n_failures < CORPUS_MAX_RETRIES) {
+        gboolean hit = g_hash_table_size(keyword_set) < n_hit_keywords;
+        size_t length = min_length + (size_t) rand() % (max_length - min_length + 1);
+        size_t keyword_size = hit
+            ? corpus_pick_substring(text, text_size, length, keyword)
+            : corpus_make_miss_keyword(text, text_size, length, keyword);
+        if (0 == keyword_size || g_hash_table_contains(keyword_set, keyword)) {
+            ++n_failures;
+            continue;
+        }
+        g_hash_table_add(keyword_set, g_strdup(keyword));
+        g_assert(Matcher_addKeyword(matcher, keyword, keyword_size, NULL));
+        if (NULL != keywords) {
+            g_ptr_array_add(keywords, g_strdup(keyword));
+        }
+        *keyword_bytes += keyword_size;
+        if (hit) {
+            ++n_actual_hits;
+        }
+    }
+    if (g_hash_table_size(keyword_set) < n_keywords) {
+        g_printerr("only %u distinct keywords could be made\n", g_hash_table_size(keyword_set));
+    }
+    g_hash_table_destroy(keyword_set);
+    free(keyword);
+    return n_actual_hits;
+}
+
+// 1つのエンジンで前処理と走査を交互に繰り返し、ウォームアップの後の反復をそれぞれ計測して出力する
+// 見つかったキーワードの数を返す
+static long
+corpus_measure_engine(Matcher *matcher, MatcherEngine engine, const char *suite, const char *case_name, const char *text,
+                      size_t text_size, size_t keyword_bytes)
+{
+    HarnessSamples build_samples = HARNESS_SAMPLES_INIT;
+    HarnessSamples scan_samples = HARNESS_SAMPLES_INIT;
+    PerfCounterValues build_counters = PERFCOUNTERVALUES_INIT;
+    PerfCounterValues scan_counters = PERFCOUNTERVALUES_INIT;
+    long n_matches = 0;
+    for (int i=0; i<bench_options.warmup + bench_options.iterations; ++i) {
+        bench_phase_t build = BENCH_PHASE_INIT;
+        bench_phase_t scan = BENCH_PHASE_INIT;
+        bench_phase_t begin;
+        if (NULL != bench_options.counters) {
+            PerfCounters_start(bench_options.counters);
+        }
+        bench_phase_begin(&begin);
+        g_assert(Matcher_compile(matcher, engine, NULL));
+        bench_phase_end(&build, &begin);
+        n_matches = 0;
+        bench_phase_begin(&begin);
+        g_assert(Matcher_scanAll(matcher, text, text_size, count_match, &n_matches, NULL));
+        bench_phase_end(&scan, &begin);
+        if (NULL != bench_options.counters) {
+            PerfCounters_stop(bench_options.counters);
+        }
+        if (bench_options.warmup <= i) {
+            HarnessSamples_add(&build_samples, build.ns);
+            HarnessSamples_add(&scan_samples, scan.ns);
+            PerfCounterValues_add(&build_counters, &build.counters);
+            PerfCounterValues_add(&scan_counters, &scan.counters);
+        }
+    }
+    gchar *label = (MATCHER_ENGINE_AUTO == engine)
+        ? g_strdup_printf("Auto (%s)", Matcher_getEngineName(matcher))
+        : g_strdup(Matcher_getEngineName(matcher));
+    // STRING_MATCHING_STATS を定義してビルドしていれば、最後の走査の統計を出力する
+    ScanStats stats;
+    if (Matcher_getStats(matcher, &stats)) {
+        g_printerr("scan stats: %s\n", label);
+        ScanStats_pprint(&stats, stderr);
+    }
+    MemoryUsage usage = MEMORYUSAGE_INIT;
+    Matcher_memoryUsage(matcher, &usage);
+    if (bench_options.verbose_memory) {
+        g_printerr("memory usage: %s\n", label);
+        MemoryUsage_pprint(&usage, stderr);
+    }
+    HarnessMemory memory = {MemoryUsage_getTotal(&usage), Matcher_getKeywordCount(matcher)};
+    HarnessReport_add(bench_options.report, suite, case_name, label, "build", keyword_bytes, -1, &memory,
+                      &build_samples, &build_counters);
+    HarnessReport_add(bench_options.report, suite, case_name, label, "scan", text_size, n_matches, NULL,
+                      &scan_samples, &scan_counters);
+    g_free(label);
+    HarnessSamples_clear(&scan_samples);
+    HarnessSamples_clear(&build_samples);
+    return n_matches;
+}
+
+// 利用できるすべてのエンジンと自動選択のそれぞれで corpus_measure_engine を実行する
 static void
-measure(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, const char *label, bench_impl_func bench_impl, double *build_time, double *total_time, long *n_hits)
+corpus_measure_engines(Matcher *matcher, const char *suite, const char *case_name, const char *text, size_t text_size,
+                       size_t keyword_bytes)
 {
-    struct timeval tv_before;
-    g_assert(0 == gettimeofday(&tv_before, NULL));
-    bench_impl(document, keywords, n_keywords, n_scanning, build_time, n_hits);
-    struct timeval tv_after;
-    g_assert(0 == gettimeofday(&tv_after, NULL));
-    if (NULL != total_time) {
-        *total_time += tv_after.tv_sec - tv_before.tv_sec;
-        *total_time += (tv_after.tv_usec -tv_before.tv_usec) * 0.000001;
+    long expected_matches = -1;
+    for (guint engine=MATCHER_ENGINE_AUTO; engine<MATCHER_N_ENGINES; ++engine) {
+        if (MATCHER_ENGINE_AUTO != engine && NULL == MatcherEngine_getName((MatcherEngine) engine)) {
+            continue;
+        }
+        long n_matches = corpus_measure_engine(matcher, (MatcherEngine) engine, suite, case_name, text, text_size,
+                                               keyword_bytes);
+        // すべてのエンジンが同じ数だけ見つけるはずなので、食い違えば知らせる
+        if (0 > expected_matches) {
+            expected_matches = n_matches;
+        } else if (expected_matches != n_matches) {
+            g_printerr("warning: %s found %ld matches, expected %ld\n",
+                       Matcher_getEngineName(matcher), n_matches, expected_matches);
+        }
     }
-    //printf("[%s]:\ttime=%lf,\tn_hits=%ld\n", label, elapsed_sec, n_hits);
 }
 
-int
-main(int argc, char *argv[])
+// 複数スレッドでの計測で、メインスレッドとワーカーが共有する状態
+// ワーカーは round が進むたびに自分の文書を1回走査し、n_running を減らす
+typedef struct threads_shared_t {
+    GMutex mutex;
+    GCond start_cond;
+    GCond done_cond;
+    gint round;
+    gint n_running;
+    gboolean quit;
+    Matcher *matcher; // 走査は読み取りだけなので、すべてのワーカーで共有する
+    const char *text;
+    size_t text_size;
+} threads_shared_t;
+
+typedef struct threads_worker_t {
+    threads_shared_t *shared;
+    GThread *thread;
+    gint index;
+    long n_matches; // 最後の走査で見つかったキーワードの数
+} threads_worker_t;
+
+// 現在の走査が終わったことを知らせる。mutex を持って呼ぶ
+static void
+threads_finish(threads_shared_t *shared)
+{
+    if (0 == --shared->n_running) {
+        g_cond_signal(&shared->done_cond);
+    }
+}
+
+static gpointer
+threads_worker(gpointer data)
+{
+    threads_worker_t *self = (threads_worker_t *) data;
+    threads_shared_t *shared = self->shared;
+    if (0 <= bench_options.pin_cpu) {
+        GError *error = NULL;
+        if (!Harness_pinCPU(bench_options.pin_cpu + self->index, &error)) {
+            g_printerr("warning: %s\n", error->message);
+            g_error_free(error);
+        }
+    }
+    // 文書は各スレッドが自分で複製し、そのスレッドに近いメモリに置く
+    char *text = (char *) g_malloc(shared->text_size);
+    memcpy(text, shared->text, shared->text_size);
+    g_mutex_lock(&shared->mutex);
+    gint round = shared->round;
+    threads_finish(shared);
+    while (TRUE) {
+        while (round == shared->round && !shared->quit) {
+            g_cond_wait(&shared->start_cond, &shared->mutex);
+        }
+        if (shared->quit) {
+            break;
+        }
+        round = shared->round;
+        g_mutex_unlock(&shared->mutex);
+        self->n_matches = 0;
+        g_assert(Matcher_scanAll(shared->matcher, text, shared->text_size, count_match, &self->n_matches, NULL));
+        g_mutex_lock(&shared->mutex);
+        threads_finish(shared);
+    }
+    g_mutex_unlock(&shared->mutex);
+    g_free(text);
+    return NULL;
+}
+
+// すべてのワーカーが走査を終えるまで待つ。mutex を持って呼ぶ
+static void
+threads_wait(threads_shared_t *shared)
+{
+    while (0 < shared->n_running) {
+        g_cond_wait(&shared->done_cond, &shared->mutex);
+    }
+}
+
+// n_threads 個のスレッドがそれぞれ自分の文書を同時に走査する時間を反復ごとに計測し、
+// 見つかったキーワードの数をすべてのスレッドで合計して返す
+static long
+threads_measure(threads_shared_t *shared, gint n_threads, HarnessSamples *samples)
+{
+    threads_worker_t *workers = g_new0(threads_worker_t, n_threads);
+    shared->round = 0;
+    shared->quit = FALSE;
+    shared->n_running = n_threads;
+    for (gint i=0; i<n_threads; ++i) {
+        workers[i].shared = shared;
+        workers[i].index = i;
+        workers[i].thread = g_thread_new("bench-worker", threads_worker, &workers[i]);
+    }
+    g_mutex_lock(&shared->mutex);
+    threads_wait(shared);
+    for (int i=0; i<bench_options.warmup + bench_options.iterations; ++i) {
+        gint64 begin_ns = Harness_getTimeNs();
+        shared->n_running = n_threads;
+        ++shared->round;
+        g_cond_broadcast(&shared->start_cond);
+        threads_wait(shared);
+        if (bench_options.warmup <= i) {
+            HarnessSamples_add(samples, Harness_getTimeNs() - begin_ns);
+        }
+    }
+    shared->quit = TRUE;
+    g_cond_broadcast(&shared->start_cond);
+    g_mutex_unlock(&shared->mutex);
+    long n_matches = 0;
+    for (gint i=0; i<n_threads; ++i) {
+        g_thread_join(workers[i].thread);
+        n_matches += workers[i].n_matches;
+    }
+    g_free(workers);
+    return n_matches;
+}
+
+// 1 から --threads で指定した数まで倍々にスレッドを増やし、同じ Matcher を共有して走査する
+// 全体のスループットと、1スレッドのスループットをスレッド数倍したものに対する割合 (効率) を求める
+static void
+threads_measure_engine(Matcher *matcher, MatcherEngine engine, const char *suite, const char *case_name,
+                       const char *text, size_t text_size)
+{
+    g_assert(Matcher_compile(matcher, engine, NULL));
+    gchar *label = (MATCHER_ENGINE_AUTO == engine)
+        ? g_strdup_printf("Auto (%s)", Matcher_getEngineName(matcher))
+        : g_strdup(Matcher_getEngineName(matcher));
+    threads_shared_t shared;
+    g_mutex_init(&shared.mutex);
+    g_cond_init(&shared.start_cond);
+    g_cond_init(&shared.done_cond);
+    shared.matcher = matcher;
+    shared.text = text;
+    shared.text_size = text_size;
+    gdouble single_mb_per_s = 0.0;
+    for (gint n_threads=1; n_threads<=bench_options.max_threads; n_threads=MIN(n_threads * 2, bench_options.max_threads)) {
+        HarnessSamples samples = HARNESS_SAMPLES_INIT;
+        long n_matches = threads_measure(&shared, n_threads, &samples);
+        HarnessStats stats;
+        HarnessSamples_summarize(&samples, &stats);
+        gdouble mb_per_s = (0.0 < stats.median)
+            ? (gdouble) text_size * n_threads / (stats.median / 1e9) / (1024.0 * 1024.0) : 0.0;
+        if (1 == n_threads) {
+            single_mb_per_s = mb_per_s;
+        }
+        g_printerr("scaling: %s threads=%d %.2lf MB/s, efficiency %.1lf%%\n", label, n_threads, mb_per_s,
+                   (0.0 < single_mb_per_s) ? 100.0 * mb_per_s / (single_mb_per_s * n_threads) : 0.0);
+        gchar *threads_case_name = g_strdup_printf("%s t=%d", case_name, n_threads);
+        // カウンタは呼び出したスレッドの分しか数えられないので、複数スレッドの計測では出力しない
+        HarnessReport_add(bench_options.report, suite, threads_case_name, label, "scan", text_size * n_threads,
+                          n_matches, NULL, &samples, NULL);
+        g_free(threads_case_name);
+        HarnessSamples_clear(&samples);
+        if (bench_options.max_threads == n_threads) {
+            break;
+        }
+    }
+    g_cond_clear(&shared.done_cond);
+    g_cond_clear(&shared.start_cond);
+    g_mutex_clear(&shared.mutex);
+    g_free(label);
+}
+
+// 利用できるすべてのエンジンと自動選択のそれぞれで threads_measure_engine を実行する
+static void
+threads_measure_engines(Matcher *matcher, const char *suite, const char *case_name, const char *text,
+                        size_t text_size)
+{
+    ScanStats stats;
+    if (Matcher_getStats(matcher, &stats)) {
+        g_printerr("warning: scan stats are shared by all threads and will be inaccurate\n");
+    }
+    for (guint engine=MATCHER_ENGINE_AUTO; engine<MATCHER_N_ENGINES; ++engine) {
+        if (MATCHER_ENGINE_AUTO != engine && NULL == MatcherEngine_getName((MatcherEngine) engine)) {
+            continue;
+        }
+        threads_measure_engine(matcher, (MatcherEngine) engine, suite, case_name, text, text_size);
+    }
+}
+
+// 1行ずつ Matcher_scanAll を呼んで、見つかったキーワードの数を返す
+static long
+batch_scanEach(Matcher *matcher, const MatcherString *lines, gsize n_lines)
+{
+    long n_matches = 0;
+    for (gsize i=0; i<n_lines; ++i) {
+        g_assert(Matcher_scanAll(matcher, lines[i].text, lines[i].length, count_match, &n_matches, NULL));
+    }
+    return n_matches;
+}
+
+// BATCH_N_LINES 行ずつ Matcher_scanBatch で走査して、見つかったキーワードの数を返す
+static long
+batch_scanBatches(Matcher *matcher, const MatcherString *lines, gsize n_lines, MatcherBatch *batch)
+{
+    long n_matches = 0;
+    for (gsize i=0; i<n_lines; i+=BATCH_N_LINES) {
+        gsize n_batch_lines = MIN(BATCH_N_LINES, n_lines - i);
+        g_assert(Matcher_scanBatch(matcher, lines + i, n_batch_lines, TRUE, batch, NULL));
+        for (gsize j=0; j<n_batch_lines; ++j) {
+            gsize n_line_matches = 0;
+            (void) MatcherBatch_getMatches(batch, j, &n_line_matches);
+            n_matches += n_line_matches;
+        }
+    }
+    return n_matches;
+}
+
+// テキストを行に分け、1行ずつ走査する場合とまとめて走査する場合のスループットをエンジンごとに比べる
+static void
+batch_measure_engines(Matcher *matcher, const char *suite, const char *case_name, const char *text, size_t text_size)
+{
+    GArray *lines = g_array_new(FALSE, FALSE, sizeof(MatcherString));
+    for (const char *line = text; line < text + text_size; ) {
+        const char *newline = (const char *) memchr(line, '\n', text + text_size - line);
+        const char *line_end = (NULL == newline) ? text + text_size : newline;
+        MatcherString string = {line, line_end - line};
+        g_array_append_val(lines, string);
+        line = line_end + 1;
+    }
+    const MatcherString *strings = (const MatcherString *) lines->data;
+    MatcherBatch *batch = MatcherBatch_new();
+    for (guint engine=MATCHER_ENGINE_AUTO; engine<MATCHER_N_ENGINES; ++engine) {
+        if (MATCHER_ENGINE_AUTO != engine && NULL == MatcherEngine_getName((MatcherEngine) engine)) {
+            continue;
+        }
+        g_assert(Matcher_compile(matcher, (MatcherEngine) engine, NULL));
+        HarnessSamples each_samples = HARNESS_SAMPLES_INIT;
+        HarnessSamples batch_samples = HARNESS_SAMPLES_INIT;
+        long each_matches = 0;
+        long batch_matches = 0;
+        for (int i=0; i<bench_options.warmup + bench_options.iterations; ++i) {
+            gint64 begin_ns = Harness_getTimeNs();
+            each_matches = batch_scanEach(matcher, strings, lines->len);
+            gint64 each_ns = Harness_getTimeNs() - begin_ns;
+            begin_ns = Harness_getTimeNs();
+            batch_matches = batch_scanBatches(matcher, strings, lines->len, batch);
+            gint64 batch_ns = Harness_getTimeNs() - begin_ns;
+            if (bench_options.warmup <= i) {
+                HarnessSamples_add(&each_samples, each_ns);
+                HarnessSamples_add(&batch_samples, batch_ns);
+            }
+        }
+        if (each_matches != batch_matches) {
+            g_printerr("warning: %s found %ld matches in batches, expected %ld\n",
+                       Matcher_getEngineName(matcher), batch_matches, each_matches);
+        }
+        gchar *label = (MATCHER_ENGINE_AUTO == engine)
+            ? g_strdup_printf("Auto (%s)", Matcher_getEngineName(matcher))
+            : g_strdup(Matcher_getEngineName(matcher));
+        gchar *each_label = g_strdup_printf("%s per-line", label);
+        gchar *batch_label = g_strdup_printf("%s batch", label);
+        HarnessStats each_stats;
+        HarnessStats batch_stats;
+        HarnessSamples_summarize(&each_samples, &each_stats);
+        HarnessSamples_summarize(&batch_samples, &batch_stats);
+        g_printerr("batch: %s %u lines, speedup %.2lfx\n", label, lines->len,
+                   (0.0 < batch_stats.median) ? each_stats.median / batch_stats.median : 0.0);
+        HarnessReport_add(bench_options.report, suite, case_name, each_label, "scan", text_size, each_matches, NULL,
+                          &each_samples, NULL);
+        HarnessReport_add(bench_options.report, suite, case_name, batch_label, "scan", text_size, batch_matches, NULL,
+                          &batch_samples, NULL);
+        g_free(batch_label);
+        g_free(each_label);
+        g_free(label);
+        HarnessSamples_clear(&batch_samples);
+        HarnessSamples_clear(&each_samples);
+    }
+    MatcherBatch_free(batch);
+    g_array_free(lines, TRUE);
+}
+
+static gboolean
+lines_collect(const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    g_array_append_val((GArray *) user_data, offset);
+    return TRUE;
+}
+
+static int
+lines_compareOffsets(const void *a, const void *b)
+{
+    gsize x = *(const gsize *) a;
+    gsize y = *(const gsize *) b;
+    return (x < y) ? -1 : (x > y);
+}
+
+// Matcher_scanAll で見つかった位置を集め、位置の順に並べてから memchr で改行を数えて行番号を求める
+// 行番号の合計を返す
+static gsize
+lines_scanThenCount(Matcher *matcher, const char *text, size_t text_size, GArray *offsets)
+{
+    g_array_set_size(offsets, 0);
+    g_assert(Matcher_scanAll(matcher, text, text_size, lines_collect, offsets, NULL));
+    qsort(offsets->data, offsets->len, sizeof(gsize), lines_compareOffsets);
+    gsize line = 1;
+    gsize line_sum = 0;
+    const char *cursor = text;
+    for (guint i=0; i<offsets->len; ++i) {
+        const char *match = text + g_array_index(offsets, gsize, i);
+        while (cursor < match && NULL != (cursor = (const char *) memchr(cursor, '\n', match - cursor))) {
+            ++line;
+            ++cursor;
+        }
+        cursor = match;
+        line_sum += line;
+    }
+    return line_sum;
+}
+
+static gboolean
+lines_sumLine(const MatcherLine *line, const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    *(gsize *) user_data += line->number;
+    return TRUE;
+}
+
+// --lines で比べる走査の方法
+typedef enum {
+    LINES_SCAN_THEN_COUNT, // Matcher_scanAll の後で改行を数える
+    LINES_SCAN_LINES,      // Matcher_scanLines ですべての出現を報告する
+    LINES_FIRST_PER_LINE,  // Matcher_scanLines で1行に1つだけ報告する
+    LINES_N_MODES,
+} lines_mode_t;
+
+static const char *lines_mode_names[LINES_N_MODES] = {"scan+count", "scan-lines", "first-per-line"};
+
+// 見つかった位置の行番号を求める方法ごとのスループットをエンジンごとに比べる
+// すべての出現を報告する2つの方法では、行番号の合計が一致することを確かめる
+static void
+lines_measure_engines(Matcher *matcher, const char *suite, const char *case_name, const char *text, size_t text_size)
+{
+    GArray *offsets = g_array_new(FALSE, FALSE, sizeof(gsize));
+    for (guint engine=MATCHER_ENGINE_AUTO; engine<MATCHER_N_ENGINES; ++engine) {
+        if (MATCHER_ENGINE_AUTO != engine && NULL == MatcherEngine_getName((MatcherEngine) engine)) {
+            continue;
+        }
+        g_assert(Matcher_compile(matcher, (MatcherEngine) engine, NULL));
+        gchar *label = (MATCHER_ENGINE_AUTO == engine)
+            ? g_strdup_printf("Auto (%s)", Matcher_getEngineName(matcher))
+            : g_strdup(Matcher_getEngineName(matcher));
+        double base_median = 0.0;
+        gsize base_line_sum = 0;
+        for (int mode=0; mode<LINES_N_MODES; ++mode) {
+            HarnessSamples samples = HARNESS_SAMPLES_INIT;
+            gsize line_sum = 0;
+            for (int i=0; i<bench_options.warmup + bench_options.iterations; ++i) {
+                line_sum = 0;
+                gint64 begin_ns = Harness_getTimeNs();
+                if (LINES_SCAN_THEN_COUNT == mode) {
+                    line_sum = lines_scanThenCount(matcher, text, text_size, offsets);
+                } else {
+                    g_assert(Matcher_scanLines(matcher, text, text_size, LINES_FIRST_PER_LINE == mode, lines_sumLine,
+                                               &line_sum, NULL));
+                }
+                gint64 elapsed_ns = Harness_getTimeNs() - begin_ns;
+                if (bench_options.warmup <= i) {
+                    HarnessSamples_add(&samples, elapsed_ns);
+                }
+            }
+            HarnessStats stats;
+            HarnessSamples_summarize(&samples, &stats);
+            if (LINES_SCAN_THEN_COUNT == mode) {
+                base_median = stats.median;
+                base_line_sum = line_sum;
+            } else {
+                if (LINES_SCAN_LINES == mode && base_line_sum != line_sum) {
+                    g_printerr("warning: %s summed line numbers to %lu, expected %lu\n", label,
+                               (unsigned long) line_sum, (unsigned long) base_line_sum);
+                }
+                g_printerr("lines: %s %s, speedup %.2lfx\n", label, lines_mode_names[mode],
+                           (0.0 < stats.median) ? base_median / stats.median : 0.0);
+            }
+            gchar *mode_label = g_strdup_printf("%s %s", label, lines_mode_names[mode]);
+            HarnessReport_add(bench_options.report, suite, case_name, mode_label, "scan", text_size, (long) line_sum,
+                              NULL, &samples, NULL);
+            g_free(mode_label);
+            HarnessSamples_clear(&samples);
+        }
+        g_free(label);
+    }
+    g_array_free(offsets, TRUE);
+}
+
+// --interleave で、1つのテキストを分けて交互に読み進める範囲の数
+static const guint interleave_slice_counts[] = {2, 4, 8, 16};
+
+static gboolean
+interleave_count_match(guint stream, gconstpointer output, gsize end_offset, gpointer user_data)
 {
-    g_assert(4 == argc);
-    size_t n_tests = (size_t) atoi(argv[1]);
-    size_t n_keywords = (size_t) atoi(argv[2]);
-    size_t n_scanning = (size_t) atoi(argv[3]);
-    srand(time(NULL));
-    double build_times[G_N_ELEMENTS(bench_entries)];
-    double total_times[G_N_ELEMENTS(bench_entries)];
+    ++(*(long *) user_data);
+    return TRUE;
+}
+
+// Aho-Corasick の逐次のイテレータで走査して、見つかったキーワードの数を返す
+static long
+interleave_scanSequentially(UnicodeAhoCorasickMatcher *matcher, const gunichar2 *text, gsize textlen)
+{
+    long n_matches = 0;
+    UnicodeAhoCorasickPatternsIter *iter = NULL;
+    UnicodeAhoCorasickMatcher_scanUTF16String(matcher, text, textlen, &iter);
+    while (NULL != UnicodeAhoCorasickPatternsIter_next(iter)) {
+        ++n_matches;
+    }
+    UnicodeAhoCorasickPatternsIter_free(iter);
+    return n_matches;
+}
+
+// テキストを UTF-16 に変換しておき、Aho-Corasick の逐次のイテレータと、
+// テキストを分けた範囲を交互に読み進めて遷移表を先読みする走査のスループットを比べる
+// 遷移表がキャッシュに収まらないほどキーワードが多いときに差が出る
+static void
+interleave_measure(const GPtrArray *keywords, const char *suite, const char *case_name, const char *text,
+                   size_t text_size)
+{
+    GPtrArray *u16keywords = g_ptr_array_new_with_free_func(g_free);
+    GArray *u16keyword_lens = g_array_new(FALSE, FALSE, sizeof(glong));
+    glong max_u16len = 1;
+    for (guint i=0; i<keywords->len; ++i) {
+        glong u16len = 0;
+        gunichar2 *u16keyword = g_utf8_to_utf16((const gchar *) g_ptr_array_index(keywords, i), -1L, NULL, &u16len, NULL);
+        g_assert(NULL != u16keyword);
+        g_ptr_array_add(u16keywords, u16keyword);
+        g_array_append_val(u16keyword_lens, u16len);
+        max_u16len = MAX(max_u16len, u16len);
+    }
+    UnicodeAhoCorasickMatcher *matcher = UnicodeAhoCorasickMatcher_new(max_u16len);
+    for (guint i=0; i<u16keywords->len; ++i) {
+        g_assert(UnicodeAhoCorasickMatcher_addKeywordAsUTF16(matcher, (const gunichar2 *) g_ptr_array_index(u16keywords, i),
+                                                            g_array_index(u16keyword_lens, glong, i), NULL));
+    }
+    UnicodeAhoCorasickMatcher_compile(matcher);
+    glong u16textlen = 0;
+    gunichar2 *u16text = g_utf8_to_utf16(text, text_size, NULL, &u16textlen, NULL);
+    g_assert(NULL != u16text);
+
+    guint n_configs = 1 + G_N_ELEMENTS(interleave_slice_counts);
+    HarnessSamples *samples = g_new0(HarnessSamples, n_configs);
+    long *n_matches = g_new0(long, n_configs);
+    for (int i=0; i<bench_options.warmup + bench_options.iterations; ++i) {
+        for (guint j=0; j<n_configs; ++j) {
+            gint64 begin_ns = Harness_getTimeNs();
+            if (0 == j) {
+                n_matches[j] = interleave_scanSequentially(matcher, u16text, u16textlen);
+            } else {
+                n_matches[j] = 0;
+                g_assert(UnicodeAhoCorasickMatcher_scanUTF16Sliced(matcher, u16text, u16textlen,
+                                                                   interleave_slice_counts[j - 1],
+                                                                   interleave_count_match, &n_matches[j]));
+            }
+            gint64 elapsed_ns = Harness_getTimeNs() - begin_ns;
+            if (bench_options.warmup <= i) {
+                HarnessSamples_add(&samples[j], elapsed_ns);
+            }
+        }
+    }
+    HarnessStats sequential_stats;
+    HarnessSamples_summarize(&samples[0], &sequential_stats);
+    HarnessReport_add(bench_options.report, suite, case_name, "Aho-Corasick sequential", "scan", text_size,
+                      n_matches[0], NULL, &samples[0], NULL);
+    for (guint j=1; j<n_configs; ++j) {
+        if (n_matches[0] != n_matches[j]) {
+            g_printerr("warning: %u interleaved streams found %ld matches, expected %ld\n",
+                       interleave_slice_counts[j - 1], n_matches[j], n_matches[0]);
+        }
+        HarnessStats stats;
+        HarnessSamples_summarize(&samples[j], &stats);
+        g_printerr("interleave: %u streams, speedup %.2lfx\n", interleave_slice_counts[j - 1],
+                   (0.0 < stats.median) ? sequential_stats.median / stats.median : 0.0);
+        gchar *label = g_strdup_printf("Aho-Corasick interleaved x%u", interleave_slice_counts[j - 1]);
+        HarnessReport_add(bench_options.report, suite, case_name, label, "scan", text_size, n_matches[j], NULL,
+                          &samples[j], NULL);
+        g_free(label);
+    }
+    for (guint j=0; j<n_configs; ++j) {
+        HarnessSamples_clear(&samples[j]);
+    }
+    g_free(n_matches);
+    g_free(samples);
+    g_free(u16text);
+    UnicodeAhoCorasickMatcher_free(matcher);
+    g_array_free(u16keyword_lens, TRUE);
+    g_ptr_array_free(u16keywords, TRUE);
+}
+
+static gboolean
+approximate_count_match(gsize end_offset, guint distance, gpointer user_data)
+{
+    ++(*(long *) user_data);
+    return TRUE;
+}
+
+// キーワードごとに近似照合のマッチャーを作り、誤りの数え方と上限ごとにテキスト全体を走査するスループットを計測する
+// 誤りの上限は 0 から --approximate で指定した数までで、UTF-16 の長さがそれ以下のキーワードでは長さ - 1 に抑える
+static void
+approximate_measure(const GPtrArray *keywords, const char *suite, const char *case_name, const char *text,
+                    size_t text_size)
+{
+    static const UnicodeApproximateMode modes[] = {UNICODE_APPROXIMATE_MISMATCHES, UNICODE_APPROXIMATE_EDIT_DISTANCE};
+    static const char *mode_names[] = {"mismatch", "edit"};
+    UTF16Buffer buffer = UTF16BUFFER_INIT;
+    for (gsize m=0; m<G_N_ELEMENTS(modes); ++m) {
+        for (gint max_distance=0; max_distance<=bench_options.approximate; ++max_distance) {
+            GPtrArray *matchers = g_ptr_array_new_with_free_func((GDestroyNotify) UnicodeApproximateMatcher_free);
+            for (guint i=0; i<keywords->len; ++i) {
+                glong u16len = 0;
+                gunichar2 *u16keyword = g_utf8_to_utf16((const gchar *) g_ptr_array_index(keywords, i), -1L, NULL, &u16len, NULL);
+                g_assert(NULL != u16keyword);
+                g_ptr_array_add(matchers, UnicodeApproximateMatcher_new(u16keyword, u16len, modes[m],
+                                                                        MIN(max_distance, u16len - 1)));
+                g_free(u16keyword);
+            }
+            HarnessSamples samples = HARNESS_SAMPLES_INIT;
+            long n_matches = 0;
+            for (int i=0; i<bench_options.warmup + bench_options.iterations; ++i) {
+                n_matches = 0;
+                gint64 begin_ns = Harness_getTimeNs();
+                for (guint j=0; j<matchers->len; ++j) {
+                    g_assert(UnicodeApproximateMatcher_scanUTF8StringWithBuffer(
+                        (const UnicodeApproximateMatcher *) g_ptr_array_index(matchers, j), text, text_size, &buffer,
+                        approximate_count_match, &n_matches, NULL));
+                }
+                gint64 elapsed_ns = Harness_getTimeNs() - begin_ns;
+                if (bench_options.warmup <= i) {
+                    HarnessSamples_add(&samples, elapsed_ns);
+                }
+            }
+            gchar *label = g_strdup_printf("Approximate %s k=%d", mode_names[m], max_distance);
+            HarnessReport_add(bench_options.report, suite, case_name, label, "scan", text_size * matchers->len, n_matches,
+                              NULL, &samples, NULL);
+            g_free(label);
+            HarnessSamples_clear(&samples);
+            g_ptr_array_free(matchers, TRUE);
+        }
+    }
+    UTF16Buffer_clear(&buffer);
+}
+
+// 実際のテキストからキーワードを作り、各エンジンの前処理時間と走査のスループットを計測する
+static int
+corpus_bench(const char *filename, size_t n_keywords, double hit_ratio, size_t min_length, size_t max_length)
+{
+    gchar *text = NULL;
+    gsize text_size = 0;
+    GError *error = NULL;
+    if (!g_file_get_contents(filename, &text, &text_size, &error)) {
+        g_printerr("failed to read %s: %s\n", filename, error->message);
+        g_error_free(error);
+        return 1;
+    }
+    if (!g_utf8_validate(text, text_size, NULL)) {
+        g_printerr("%s is not valid UTF-8\n", filename);
+        g_free(text);
+        return 1;
+    }
+    Matcher *matcher = Matcher_new();
+    GPtrArray *keywords = (bench_options.interleave || 0 < bench_options.approximate)
+        ? g_ptr_array_new_with_free_func(g_free) : NULL;
+    size_t keyword_bytes = 0;
+    size_t n_hit_keywords = corpus_add_keywords(matcher, text, text_size, n_keywords, hit_ratio, min_length, max_length,
+                                                &keyword_bytes, keywords);
+    Matcher_setExpectedScanBytes(matcher, text_size);
+    gchar *basename = g_path_get_basename(filename);
+    gchar *case_name = g_strdup_printf("%s k=%lu hit=%.2f len=%lu-%lu", basename, (unsigned long) n_keywords,
+                                       hit_ratio, (unsigned long) min_length, (unsigned long) max_length);
+    g_printerr("corpus: %s (%lu bytes), keywords: %lu (hit: %lu), length: %lu-%lu chars\n",
+               basename, (unsigned long) text_size, (unsigned long) n_keywords, (unsigned long) n_hit_keywords,
+               (unsigned long) min_length, (unsigned long) max_length);
+    g_free(basename);
+    // --interleave では遷移表がキャッシュに収まらないほどキーワードを増やすので、単一パターンのエンジンでは終わらない
+    if (!bench_options.interleave) {
+        corpus_measure_engines(matcher, "corpus", case_name, text, text_size, keyword_bytes);
+    }
+    if (0 < bench_options.max_threads) {
+        threads_measure_engines(matcher, "threads", case_name, text, text_size);
+    }
+    if (bench_options.batch) {
+        batch_measure_engines(matcher, "batch", case_name, text, text_size);
+    }
+    if (bench_options.lines) {
+        lines_measure_engines(matcher, "lines", case_name, text, text_size);
+    }
+    if (0 < bench_options.approximate) {
+        approximate_measure(keywords, "approximate", case_name, text, text_size);
+    }
+    if (bench_options.interleave) {
+        interleave_measure(keywords, "interleave", case_name, text, text_size);
+    }
+    if (NULL != keywords) {
+        g_ptr_array_free(keywords, TRUE);
+    }
+    g_free(case_name);
+    Matcher_free(matcher);
+    g_free(text);
+    return 0;
+}
+
+// 名前付きの最悪ケースの入力で各エンジンを計測する。names が NULL ならすべてのシナリオを計測する
+static int
+adversarial_bench(gchar **names)
+{
+    gsize n_scenarios = 0;
+    const AdversarialScenario *scenarios = Adversarial_getScenarios(&n_scenarios);
+    GPtrArray *selected = g_ptr_array_new();
+    if (NULL == names) {
+        for (gsize i=0; i<n_scenarios; ++i) {
+            g_ptr_array_add(selected, (gpointer) &scenarios[i]);
+        }
+    } else {
+        for (gchar **name = names; NULL != *name; ++name) {
+            const AdversarialScenario *scenario = Adversarial_findScenario(*name);
+            if (NULL == scenario) {
+                g_printerr("unknown scenario: %s\n", *name);
+                g_ptr_array_free(selected, TRUE);
+                return 1;
+            }
+            g_ptr_array_add(selected, (gpointer) scenario);
+        }
+    }
+    for (guint i=0; i<selected->len; ++i) {
+        const AdversarialScenario *scenario = (const AdversarialScenario *) g_ptr_array_index(selected, i);
+        GString *text = g_string_new(NULL);
+        GPtrArray *keywords = g_ptr_array_new_with_free_func(g_free);
+        scenario->generate(ADVERSARIAL_TEXT_SIZE, text, keywords);
+        Matcher *matcher = Matcher_new();
+        size_t keyword_bytes = 0;
+        for (guint j=0; j<keywords->len; ++j) {
+            const gchar *keyword = (const gchar *) g_ptr_array_index(keywords, j);
+            g_assert(Matcher_addKeyword(matcher, keyword, -1L, NULL));
+            keyword_bytes += strlen(keyword);
+        }
+        Matcher_setExpectedScanBytes(matcher, text->len);
+        g_printerr("scenario: %s (%s), target: %s, %lu bytes, keywords: %u\n", scenario->name,
+                   scenario->description, scenario->target, (unsigned long) text->len, keywords->len);
+        corpus_measure_engines(matcher, "adversarial", scenario->name, text->str, text->len, keyword_bytes);
+        if (0 < bench_options.max_threads) {
+            threads_measure_engines(matcher, "threads", scenario->name, text->str, text->len);
+        }
+        Matcher_free(matcher);
+        g_ptr_array_free(keywords, TRUE);
+        g_string_free(text, TRUE);
+    }
+    g_ptr_array_free(selected, TRUE);
+    return 0;
+}
+
+// bench_impl を1回実行し、前処理と全体のそれぞれにかかった時間とカウンタの値を返す
+static void
+measure(const char *document, const char *keywords, size_t n_keywords, size_t n_scanning, bench_impl_func bench_impl, bench_phase_t *build, bench_phase_t *total, long *n_hits)
+{
+    *build = (bench_phase_t) BENCH_PHASE_INIT;
+    *total = (bench_phase_t) BENCH_PHASE_INIT;
+    if (NULL != bench_options.counters) {
+        PerfCounters_start(bench_options.counters);
+    }
+    bench_phase_t begin;
+    bench_phase_begin(&begin);
+    bench_impl(document, keywords, n_keywords, n_scanning, build, n_hits);
+    bench_phase_end(total, &begin);
+    if (NULL != bench_options.counters) {
+        PerfCounters_stop(bench_options.counters);
+    }
+}
+
+// ランダムな文書とキーワードを毎回作り直し、各エンジンの前処理と走査を計測する
+static int
+random_bench(size_t n_tests, size_t n_keywords, size_t n_scanning)
+{
+    HarnessSamples build_samples[G_N_ELEMENTS(bench_entries)];
+    HarnessSamples scan_samples[G_N_ELEMENTS(bench_entries)];
+    PerfCounterValues build_counters[G_N_ELEMENTS(bench_entries)];
+    PerfCounterValues scan_counters[G_N_ELEMENTS(bench_entries)];
+    long n_hits[G_N_ELEMENTS(bench_entries)];
+    HarnessMemory memory[G_N_ELEMENTS(bench_entries)];
     for (int i=0; i<G_N_ELEMENTS(bench_entries); ++i) {
-        build_times[i] = 0.0;
-        total_times[i] = 0.0;
+        build_samples[i] = (HarnessSamples) HARNESS_SAMPLES_INIT;
+        scan_samples[i] = (HarnessSamples) HARNESS_SAMPLES_INIT;
+        build_counters[i] = (PerfCounterValues) PERFCOUNTERVALUES_INIT;
+        scan_counters[i] = (PerfCounterValues) PERFCOUNTERVALUES_INIT;
     }
     char *document = (char *) malloc(sizeof(char) * (DOCUMENT_SIZE + 6));
     char *keywords = (char *) malloc(sizeof(char) * KEYWORD_ALLOC_SIZE * n_keywords);
-    for (int i=0; i<n_tests; ++i) {
-        rand_utf8_text(DOCUMENT_SIZE, document);
+    size_t document_size = 0;
+    size_t keyword_bytes = 0;
+    for (int i=0; i<bench_options.warmup + n_tests; ++i) {
+        document_size = rand_utf8_text(DOCUMENT_SIZE, document);
+        keyword_bytes = 0;
         char *keyword = keywords;
         char *keyword_end = keywords + KEYWORD_ALLOC_SIZE * n_keywords;
         for (; keyword < keyword_end; keyword += KEYWORD_ALLOC_SIZE) {
-            rand_utf8_text(KEYWORD_SIZE, keyword);
+            keyword_bytes += rand_utf8_text(KEYWORD_SIZE, keyword);
         }
-        struct bench_entry_t *bench_entry = bench_entries;
-        double *build_time = build_times;
-        double *total_time = total_times;
-        for (; bench_entry->label != NULL; ++bench_entry, ++build_time, ++total_time) {
-            measure(document, keywords, n_keywords, n_scanning, bench_entry->label, bench_entry->bench_impl, build_time, total_time, NULL);
+        for (int j=0; bench_entries[j].label != NULL; ++j) {
+            bench_phase_t build;
+            bench_phase_t total;
+            n_hits[j] = 0;
+            measure(document, keywords, n_keywords, n_scanning, bench_entries[j].bench_impl, &build, &total, &n_hits[j]);
+            // 前処理の結果は反復によらずほぼ同じ大きさなので、最後の反復のものを出力する
+            memory[j] = (HarnessMemory) {build.memory_bytes, n_keywords};
+            if (bench_options.warmup <= i) {
+                HarnessSamples_add(&build_samples[j], build.ns);
+                HarnessSamples_add(&scan_samples[j], total.ns - build.ns);
+                // 走査のカウンタは全体から前処理の分を引いたもの
+                PerfCounterValues_add(&build_counters[j], &build.counters);
+                PerfCounterValues_addDelta(&scan_counters[j], &build.counters, &total.counters);
+            }
         }
     }
     free(keywords);
     free(document);
-    struct bench_entry_t *bench_entry = bench_entries;
-    double *build_time = build_times;
-    double *total_time = total_times;
-    for (; bench_entry->label != NULL; ++bench_entry, ++build_time, ++total_time) {
-        double build_time_average = *build_time / (double) n_tests;
-        double total_time_average = *total_time / (double) n_tests;
-        double search_time_average = total_time_average - build_time_average;
-        printf("[%s]:\t%lf,\t%lf,\t%lf\n", bench_entry->label, build_time_average, search_time_average, total_time_average);
+    gchar *case_name = g_strdup_printf("k=%lu scans=%lu", (unsigned long) n_keywords, (unsigned long) n_scanning);
+    for (int j=0; bench_entries[j].label != NULL; ++j) {
+        gchar *label = g_strchomp(g_strdup(bench_entries[j].label));
+        HarnessReport_add(bench_options.report, "random", case_name, label, "build", keyword_bytes, -1,
+                          &memory[j], &build_samples[j], &build_counters[j]);
+        HarnessReport_add(bench_options.report, "random", case_name, label, "scan", document_size * n_scanning, n_hits[j],
+                          NULL, &scan_samples[j], &scan_counters[j]);
+        g_free(label);
+        HarnessSamples_clear(&scan_samples[j]);
+        HarnessSamples_clear(&build_samples[j]);
     }
+    g_free(case_name);
     return 0;
 }
+
+int
+main(int argc, char *argv[])
+{
+    gchar *calibration_filename = NULL;
+    gchar **corpus_filenames = NULL;
+    gboolean adversarial = FALSE;
+    gchar **scenario_names = NULL;
+    gint n_keywords = CORPUS_DEFAULT_KEYWORDS;
+    gdouble hit_ratio = CORPUS_DEFAULT_HIT_RATIO;
+    gint min_length = CORPUS_DEFAULT_MIN_LENGTH;
+    gint max_length = CORPUS_DEFAULT_MAX_LENGTH;
+    gint seed = -1;
+    gchar *format_name = NULL;
+    gchar *output_filename = NULL;
+    gboolean compare = FALSE;
+    gboolean perf = FALSE;
+    gdouble threshold = BENCH_DEFAULT_THRESHOLD;
+    GOptionEntry entries[] = {
+        {"calibrate", 0, 0, G_OPTION_ARG_FILENAME, &calibration_filename, "measure engine costs and save a cost profile", "FILE"},
+        {"corpus", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &corpus_filenames, "UTF-8 text to scan (repeatable)", "FILE"},
+        {"adversarial", 0, 0, G_OPTION_ARG_NONE, &adversarial, "measure named worst-case inputs for each engine", NULL},
+        {"scenario", 0, 0, G_OPTION_ARG_STRING_ARRAY, &scenario_names, "worst-case input to measure (repeatable)", "NAME"},
+        {"keywords", 0, 0, G_OPTION_ARG_INT, &n_keywords, "number of keywords extracted from the corpus", "N"},
+        {"hit-ratio", 0, 0, G_OPTION_ARG_DOUBLE, &hit_ratio, "ratio of keywords that occur in the corpus", "RATIO"},
+        {"min-length", 0, 0, G_OPTION_ARG_INT, &min_length, "minimum keyword length in characters", "N"},
+        {"max-length", 0, 0, G_OPTION_ARG_INT, &max_length, "maximum keyword length in characters", "N"},
+        {"warmup", 0, 0, G_OPTION_ARG_INT, &bench_options.warmup, "iterations run before measuring", "N"},
+        {"iterations", 0, 0, G_OPTION_ARG_INT, &bench_options.iterations, "measured iterations per engine in corpus and adversarial modes", "N"},
+        {"memory", 0, 0, G_OPTION_ARG_NONE, &bench_options.verbose_memory, "print the memory breakdown of each engine in corpus and adversarial modes", NULL},
+        {"perf", 0, 0, G_OPTION_ARG_NONE, &perf, "count cycles, instructions, cache and branch misses per byte", NULL},
+        {"pin", 0, 0, G_OPTION_ARG_INT, &bench_options.pin_cpu, "pin the benchmark to a CPU", "CPU"},
+        {"batch", 0, 0, G_OPTION_ARG_NONE, &bench_options.batch, "in corpus mode, compare scanning line by line with scanning batches of lines", NULL},
+        {"lines", 0, 0, G_OPTION_ARG_NONE, &bench_options.lines, "in corpus mode, compare counting lines after scanning with line-oriented scanning", NULL},
+        {"approximate", 0, 0, G_OPTION_ARG_INT, &bench_options.approximate, "in corpus mode, also measure approximate matching of each keyword with up to N mismatches or edits", "N"},
+        {"interleave", 0, 0, G_OPTION_ARG_NONE, &bench_options.interleave, "in corpus mode, compare sequential Aho-Corasick scanning with interleaved streams instead of measuring every engine", NULL},
+        {"threads", 0, 0, G_OPTION_ARG_INT, &bench_options.max_threads, "also scan with 1, 2, 4, ... N threads sharing one matcher in corpus and adversarial modes", "N"},
+        {"seed", 0, 0, G_OPTION_ARG_INT, &seed, "random seed, to compare runs on the same inputs", "SEED"},
+        {"format", 0, 0, G_OPTION_ARG_STRING, &format_name, "output format: text, csv or json", "FORMAT"},
+        {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output_filename, "write results to FILE instead of stdout", "FILE"},
+        {"compare", 0, 0, G_OPTION_ARG_NONE, &compare, "compare two CSV result files: --compare BASE NEW", NULL},
+        {"threshold", 0, 0, G_OPTION_ARG_DOUBLE, &threshold, "slowdown in percent reported as a regression", "PERCENT"},
+        G_OPTION_ENTRY_NULL,
+    };
+    GOptionContext *context = g_option_context_new("[N_TESTS N_KEYWORDS N_SCANNING]");
+    g_option_context_add_main_entries(context, entries, NULL);
+    GError *error = NULL;
+    gboolean parsed = g_option_context_parse(context, &argc, &argv, &error);
+    g_option_context_free(context);
+    HarnessFormat format = HARNESS_FORMAT_TEXT;
+    if (!parsed || (NULL != format_name && !HarnessFormat_parse(format_name, &format, &error))) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    if (compare) {
+        if (3 != argc) {
+            g_printerr("usage: %s --compare BASE.csv NEW.csv\n", g_get_prgname());
+            return 1;
+        }
+        gboolean regressed = FALSE;
+        if (!Harness_compare(argv[1], argv[2], threshold, stdout, &regressed, &error)) {
+            g_printerr("%s\n", error->message);
+            g_error_free(error);
+            return 1;
+        }
+        return regressed ? 2 : 0;
+    }
+
+    if (0 <= bench_options.pin_cpu && !Harness_pinCPU(bench_options.pin_cpu, &error)) {
+        g_printerr("warning: %s\n", error->message);
+        g_clear_error(&error);
+    }
+    if (0 > seed) {
+        seed = (gint) (time(NULL) & G_MAXINT);
+    }
+    srand(seed);
+    g_printerr("seed: %d\n", seed);
+    if (NULL != calibration_filename) {
+        return calibrate(calibration_filename);
+    }
+    adversarial |= NULL != scenario_names;
+    if (NULL == corpus_filenames && !adversarial && 4 != argc) {
+        g_printerr("usage: %s [OPTION...] N_TESTS N_KEYWORDS N_SCANNING\n"
+                   "       %s [OPTION...] --corpus FILE [--corpus FILE...]\n"
+                   "       %s [OPTION...] --adversarial [--scenario NAME...]\n",
+                   g_get_prgname(), g_get_prgname(), g_get_prgname());
+        return 1;
+    }
+    if (NULL != corpus_filenames &&
+        (0 >= n_keywords || 0.0 > hit_ratio || 1.0 < hit_ratio || 0 >= min_length || min_length > max_length ||
+         MAX_KEYWORD_LENGTH < max_length)) {
+        g_printerr("invalid corpus options\n");
+        return 1;
+    }
+    if (0 > bench_options.warmup || 0 >= bench_options.iterations) {
+        g_printerr("invalid number of iterations\n");
+        return 1;
+    }
+    if (0 > bench_options.approximate) {
+        g_printerr("invalid maximum distance\n");
+        return 1;
+    }
+    if (0 > bench_options.max_threads || THREADS_MAX < bench_options.max_threads) {
+        g_printerr("invalid number of threads\n");
+        return 1;
+    }
+    FILE *ostream = stdout;
+    if (NULL != output_filename && NULL == (ostream = fopen(output_filename, "w"))) {
+        g_printerr("failed to open %s: %s\n", output_filename, g_strerror(errno));
+        return 1;
+    }
+    if (perf && NULL == (bench_options.counters = PerfCounters_open(&error))) {
+        g_printerr("warning: hardware counters are not available, measuring time only: %s\n", error->message);
+        g_clear_error(&error);
+    }
+    bench_options.report = HarnessReport_new(format, ostream, NULL != bench_options.counters);
+    g_printerr("SIMD level: %s\n", SIMDDispatch_getLevelName(SIMDDispatch_getLevel()));
+    int status = 0;
+    if (NULL != corpus_filenames || adversarial) {
+        for (gchar **filename = corpus_filenames; NULL != filename && NULL != *filename; ++filename) {
+            status |= corpus_bench(*filename, n_keywords, hit_ratio, min_length, max_length);
+        }
+        if (adversarial) {
+            status |= adversarial_bench(scenario_names);
+        }
+    } else {
+        status = random_bench((size_t) atoi(argv[1]), (size_t) atoi(argv[2]), (size_t) atoi(argv[3]));
+    }
+    HarnessReport_free(bench_options.report);
+    PerfCounters_close(bench_options.counters);
+    if (stdout != ostream) {
+        fclose(ostream);
+    }
+    g_strfreev(scenario_names);
+    g_strfreev(corpus_filenames);
+    return status;
+}
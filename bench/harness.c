@@ -0,0 +1,500 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+
+#include "harness.h"
+
+/* CSV の列。Harness_compare はこの名前で列を探す */
+#define HARNESS_CSV_HEADER \
+    "suite,case,engine,phase,bytes,matches,iterations,min_ns,mean_ns,stddev_ns,median_ns,p95_ns,p99_ns,mb_per_s,memory_bytes,bytes_per_keyword"
+
+struct HarnessReport {
+    HarnessFormat format;
+    FILE *ostream;
+    gboolean with_counters;
+    gsize n_rows;
+};
+
+/**
+ * CLOCK_MONOTONIC_RAW による現在時刻 (ns) を返す
+ * NTP による周波数の補正を受けないので、短い区間の計測値が揺れにくい
+ */
+gint64
+Harness_getTimeNs(void)
+{
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC_RAW
+    g_assert(0 == clock_gettime(CLOCK_MONOTONIC_RAW, &ts));
+#else
+    g_assert(0 == clock_gettime(CLOCK_MONOTONIC, &ts));
+#endif
+    return (gint64) ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+/**
+ * 呼び出したスレッドを cpu 番の CPU だけで動くようにする
+ * 計測の途中で別の CPU に移されてキャッシュが冷えるのを防ぐ
+ */
+gboolean
+Harness_pinCPU(gint cpu, GError **error)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (0 != sched_setaffinity(0, sizeof(set), &set)) {
+        g_set_error(error, HARNESS_ERROR, HARNESS_ERROR_PIN, "failed to pin to CPU %d: %s", cpu, g_strerror(errno));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void
+HarnessSamples_add(HarnessSamples *self, gdouble value)
+{
+    if (self->len == self->capacity) {
+        self->capacity = MAX(self->capacity * 2, 16);
+        self->values = (gdouble *) g_realloc_n(self->values, self->capacity, sizeof(gdouble));
+    }
+    self->values[self->len++] = value;
+}
+
+void
+HarnessSamples_clear(HarnessSamples *self)
+{
+    g_free(self->values);
+    self->values = NULL;
+    self->len = 0;
+    self->capacity = 0;
+}
+
+static int
+Harness_compareDouble(const void *lhs, const void *rhs)
+{
+    gdouble l = *(const gdouble *) lhs;
+    gdouble r = *(const gdouble *) rhs;
+    return (l > r) - (l < r);
+}
+
+/**
+ * 昇順に並んだ n 個の値の q 分位点を線形補間で求める
+ */
+static gdouble
+Harness_quantile(const gdouble *sorted, gsize n, gdouble q)
+{
+    gdouble position = q * (n - 1);
+    gsize lower = (gsize) position;
+    if (lower + 1 >= n) {
+        return sorted[n - 1];
+    }
+    return sorted[lower] + (sorted[lower + 1] - sorted[lower]) * (position - lower);
+}
+
+void
+HarnessSamples_summarize(const HarnessSamples *self, HarnessStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->n = self->len;
+    if (0 == self->len) {
+        return;
+    }
+    gdouble *sorted = g_new(gdouble, self->len);
+    memcpy(sorted, self->values, sizeof(gdouble) * self->len);
+    qsort(sorted, self->len, sizeof(gdouble), Harness_compareDouble);
+    gdouble sum = 0.0;
+    for (gsize i = 0; i < self->len; ++i) {
+        sum += sorted[i];
+    }
+    stats->mean = sum / self->len;
+    gdouble squared_sum = 0.0;
+    for (gsize i = 0; i < self->len; ++i) {
+        squared_sum += (sorted[i] - stats->mean) * (sorted[i] - stats->mean);
+    }
+    stats->stddev = (1 < self->len) ? sqrt(squared_sum / (self->len - 1)) : 0.0;
+    stats->min = sorted[0];
+    stats->median = Harness_quantile(sorted, self->len, 0.5);
+    stats->p95 = Harness_quantile(sorted, self->len, 0.95);
+    stats->p99 = Harness_quantile(sorted, self->len, 0.99);
+    g_free(sorted);
+}
+
+gboolean
+HarnessFormat_parse(const gchar *name, HarnessFormat *format, GError **error)
+{
+    if (0 == strcmp("text", name)) {
+        *format = HARNESS_FORMAT_TEXT;
+    } else if (0 == strcmp("csv", name)) {
+        *format = HARNESS_FORMAT_CSV;
+    } else if (0 == strcmp("json", name)) {
+        *format = HARNESS_FORMAT_JSON;
+    } else {
+        g_set_error(error, HARNESS_ERROR, HARNESS_ERROR_INVALID_FORMAT, "unknown format: %s", name);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+HarnessReport *
+HarnessReport_new(HarnessFormat format, FILE *ostream, gboolean with_counters)
+{
+    HarnessReport *self = (HarnessReport *) g_malloc0(sizeof(HarnessReport));
+    self->format = format;
+    self->ostream = ostream;
+    self->with_counters = with_counters;
+    return self;
+}
+
+/**
+ * JSON の配列を閉じてから解放する。ostream は閉じない
+ */
+void
+HarnessReport_free(HarnessReport *self)
+{
+    if (NULL != self) {
+        if (HARNESS_FORMAT_JSON == self->format) {
+            fprintf(self->ostream, (0 == self->n_rows) ? "[]\n" : "\n]\n");
+        }
+        fflush(self->ostream);
+        g_free(self);
+    }
+}
+
+/**
+ * CSV の区切りや JSON の文字列を壊さないように、名前に含まれる ',' '"' '\\' と制御文字を '_' に置き換える
+ */
+static gchar *
+HarnessReport_sanitize(const gchar *name)
+{
+    gchar *sanitized = g_strdup(name);
+    for (gchar *p = sanitized; '\0' != *p; ++p) {
+        if (',' == *p || '"' == *p || '\\' == *p || (0x20 > (guchar) *p)) {
+            *p = '_';
+        }
+    }
+    return sanitized;
+}
+
+/**
+ * 1回の反復で処理した1バイトあたりのカウンタの値を求める。数えていなければ FALSE を返す
+ */
+static gboolean
+HarnessReport_perByte(const PerfCounterValues *counters, PerfCounter counter, gsize bytes, gsize n, gdouble *value)
+{
+    if (NULL == counters || !PerfCounterValues_has(counters, counter) || 0 == bytes || 0 == n) {
+        return FALSE;
+    }
+    *value = (gdouble) counters->values[counter] / ((gdouble) bytes * n);
+    return TRUE;
+}
+
+static gboolean
+HarnessReport_ipc(const PerfCounterValues *counters, gdouble *value)
+{
+    if (NULL == counters || !PerfCounterValues_has(counters, PERF_COUNTER_CYCLES) ||
+        !PerfCounterValues_has(counters, PERF_COUNTER_INSTRUCTIONS) || 0 == counters->values[PERF_COUNTER_CYCLES]) {
+        return FALSE;
+    }
+    *value = (gdouble) counters->values[PERF_COUNTER_INSTRUCTIONS] / counters->values[PERF_COUNTER_CYCLES];
+    return TRUE;
+}
+
+/**
+ * カウンタの列を出力する
+ * テキストでは1バイトあたりの値を、CSV と JSON では列名に _per_byte を付けて出力し、最後に IPC を加える
+ * 数えていない値はテキストでは '-'、CSV では空欄、JSON では null にする
+ */
+static void
+HarnessReport_addCounters(HarnessReport *self, gsize bytes, gsize n, const PerfCounterValues *counters)
+{
+    gdouble value = 0.0;
+    for (gsize i = 0; i < PERF_N_COUNTERS; ++i) {
+        gboolean has_value = HarnessReport_perByte(counters, (PerfCounter) i, bytes, n, &value);
+        switch (self->format) {
+        case HARNESS_FORMAT_TEXT:
+            if (has_value) {
+                fprintf(self->ostream, " %15.4lf", value);
+            } else {
+                fprintf(self->ostream, " %15s", "-");
+            }
+            break;
+        case HARNESS_FORMAT_CSV:
+            if (has_value) {
+                fprintf(self->ostream, ",%.6lf", value);
+            } else {
+                fprintf(self->ostream, ",");
+            }
+            break;
+        case HARNESS_FORMAT_JSON:
+            if (has_value) {
+                fprintf(self->ostream, ", \"%s_per_byte\": %.6lf", PerfCounter_getName((PerfCounter) i), value);
+            } else {
+                fprintf(self->ostream, ", \"%s_per_byte\": null", PerfCounter_getName((PerfCounter) i));
+            }
+            break;
+        }
+    }
+    gboolean has_ipc = HarnessReport_ipc(counters, &value);
+    switch (self->format) {
+    case HARNESS_FORMAT_TEXT:
+        if (has_ipc) {
+            fprintf(self->ostream, " %6.2lf", value);
+        } else {
+            fprintf(self->ostream, " %6s", "-");
+        }
+        break;
+    case HARNESS_FORMAT_CSV:
+        if (has_ipc) {
+            fprintf(self->ostream, ",%.3lf", value);
+        } else {
+            fprintf(self->ostream, ",");
+        }
+        break;
+    case HARNESS_FORMAT_JSON:
+        if (has_ipc) {
+            fprintf(self->ostream, ", \"ipc\": %.3lf", value);
+        } else {
+            fprintf(self->ostream, ", \"ipc\": null");
+        }
+        break;
+    }
+}
+
+static void
+HarnessReport_addCounterHeader(HarnessReport *self)
+{
+    for (gsize i = 0; i < PERF_N_COUNTERS; ++i) {
+        const gchar *name = PerfCounter_getName((PerfCounter) i);
+        if (HARNESS_FORMAT_TEXT == self->format) {
+            gchar *label = g_strdup_printf("%s/B", name);
+            fprintf(self->ostream, " %15s", label);
+            g_free(label);
+        } else {
+            fprintf(self->ostream, ",%s_per_byte", name);
+        }
+    }
+    fprintf(self->ostream, (HARNESS_FORMAT_TEXT == self->format) ? " %6s" : ",%s", "ipc");
+}
+
+/**
+ * 1つの計測結果を出力する
+ * bytes は1回の反復で処理したバイト数で、中央値から求めたスループットの計算に使う
+ * matches は見つかったキーワードの数で、数えていなければ負の値を渡す
+ * memory は前処理の結果が使うメモリで、前処理の行でなければ NULL を渡す
+ * counters は計測した反復すべてのカウンタの合計で、カウンタ付きの出力で bytes と反復の回数で割って出力する
+ * カウンタを数えていなければ NULL を渡す
+ */
+void
+HarnessReport_add(HarnessReport *self, const gchar *suite, const gchar *case_name,
+                  const gchar *engine, const gchar *phase, gsize bytes, glong matches,
+                  const HarnessMemory *memory, const HarnessSamples *samples,
+                  const PerfCounterValues *counters)
+{
+    HarnessStats stats;
+    HarnessSamples_summarize(samples, &stats);
+    gdouble mb_per_s = (0.0 < stats.median) ? bytes / (stats.median / 1e9) / (1024.0 * 1024.0) : 0.0;
+    gdouble bytes_per_keyword = (NULL != memory && 0 < memory->n_keywords)
+        ? (gdouble) memory->bytes / memory->n_keywords : 0.0;
+    gchar *suite_s = HarnessReport_sanitize(suite);
+    gchar *case_s = HarnessReport_sanitize(case_name);
+    gchar *engine_s = HarnessReport_sanitize(engine);
+    switch (self->format) {
+    case HARNESS_FORMAT_TEXT:
+        if (0 == self->n_rows) {
+            fprintf(self->ostream, "%-11s %-36s %-28s %-5s %5s %11s %11s %11s %7s %10s %10s %10s %10s",
+                    "suite", "case", "engine", "phase", "n", "median_ms", "p95_ms", "p99_ms", "cv", "MB/s", "matches",
+                    "mem_KiB", "B/keyword");
+            if (self->with_counters) {
+                HarnessReport_addCounterHeader(self);
+            }
+            fprintf(self->ostream, "\n");
+        }
+        fprintf(self->ostream, "%-11s %-36s %-28s %-5s %5lu %11.3lf %11.3lf %11.3lf %6.1lf%% %10.2lf %10ld",
+                suite_s, case_s, engine_s, phase, (unsigned long) stats.n, stats.median / 1e6, stats.p95 / 1e6,
+                stats.p99 / 1e6, (0.0 < stats.mean) ? 100.0 * stats.stddev / stats.mean : 0.0, mb_per_s, matches);
+        if (NULL != memory) {
+            fprintf(self->ostream, " %10.1lf %10.1lf", memory->bytes / 1024.0, bytes_per_keyword);
+        } else {
+            fprintf(self->ostream, " %10s %10s", "-", "-");
+        }
+        break;
+    case HARNESS_FORMAT_CSV:
+        if (0 == self->n_rows) {
+            fprintf(self->ostream, "%s", HARNESS_CSV_HEADER);
+            if (self->with_counters) {
+                HarnessReport_addCounterHeader(self);
+            }
+            fprintf(self->ostream, "\n");
+        }
+        fprintf(self->ostream, "%s,%s,%s,%s,%lu,%ld,%lu,%.0lf,%.0lf,%.0lf,%.0lf,%.0lf,%.0lf,%.3lf",
+                suite_s, case_s, engine_s, phase, (unsigned long) bytes, matches, (unsigned long) stats.n,
+                stats.min, stats.mean, stats.stddev, stats.median, stats.p95, stats.p99, mb_per_s);
+        if (NULL != memory) {
+            fprintf(self->ostream, ",%lu,%.1lf", (unsigned long) memory->bytes, bytes_per_keyword);
+        } else {
+            fprintf(self->ostream, ",,");
+        }
+        break;
+    case HARNESS_FORMAT_JSON:
+        fprintf(self->ostream, "%s\n  {\"suite\": \"%s\", \"case\": \"%s\", \"engine\": \"%s\", \"phase\": \"%s\", "
+                "\"bytes\": %lu, \"matches\": %ld, \"iterations\": %lu, \"min_ns\": %.0lf, \"mean_ns\": %.0lf, "
+                "\"stddev_ns\": %.0lf, \"median_ns\": %.0lf, \"p95_ns\": %.0lf, \"p99_ns\": %.0lf, \"mb_per_s\": %.3lf",
+                (0 == self->n_rows) ? "[" : ",", suite_s, case_s, engine_s, phase, (unsigned long) bytes, matches,
+                (unsigned long) stats.n, stats.min, stats.mean, stats.stddev, stats.median, stats.p95, stats.p99, mb_per_s);
+        if (NULL != memory) {
+            fprintf(self->ostream, ", \"memory_bytes\": %lu, \"bytes_per_keyword\": %.1lf",
+                    (unsigned long) memory->bytes, bytes_per_keyword);
+        } else {
+            fprintf(self->ostream, ", \"memory_bytes\": null, \"bytes_per_keyword\": null");
+        }
+        break;
+    }
+    if (self->with_counters) {
+        HarnessReport_addCounters(self, bytes, stats.n, counters);
+    }
+    fprintf(self->ostream, (HARNESS_FORMAT_JSON == self->format) ? "}" : "\n");
+    ++self->n_rows;
+    fflush(self->ostream);
+    g_free(engine_s);
+    g_free(case_s);
+    g_free(suite_s);
+}
+
+/**
+ * Harness_compare が比較に使う1行分の値
+ */
+typedef struct HarnessResult {
+    gchar *key; // suite, case, engine, phase をタブでつないだもの
+    gdouble median;
+    gdouble p95;
+} HarnessResult;
+
+static void
+HarnessResult_free(gpointer data)
+{
+    HarnessResult *self = (HarnessResult *) data;
+    g_free(self->key);
+    g_free(self);
+}
+
+static gint
+Harness_findColumn(gchar **columns, const gchar *name)
+{
+    for (gint i = 0; NULL != columns[i]; ++i) {
+        if (0 == strcmp(name, g_strstrip(columns[i]))) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * HarnessReport が出力した CSV を読み込み、HarnessResult をファイル中の順に並べた配列を返す
+ */
+static GPtrArray *
+Harness_loadCSV(const gchar *filename, GError **error)
+{
+    gchar *contents = NULL;
+    if (!g_file_get_contents(filename, &contents, NULL, error)) {
+        return NULL;
+    }
+    GPtrArray *results = g_ptr_array_new_with_free_func(HarnessResult_free);
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+    gchar **header = (NULL != lines[0]) ? g_strsplit(lines[0], ",", -1) : g_strsplit("", ",", -1);
+    const gchar *names[] = {"suite", "case", "engine", "phase", "median_ns", "p95_ns"};
+    gint indices[G_N_ELEMENTS(names)];
+    gint max_index = 0;
+    for (gsize i = 0; i < G_N_ELEMENTS(names); ++i) {
+        indices[i] = Harness_findColumn(header, names[i]);
+        if (0 > indices[i]) {
+            g_set_error(error, HARNESS_ERROR, HARNESS_ERROR_INVALID_RESULT, "%s: missing column %s", filename, names[i]);
+            goto escape;
+        }
+        max_index = MAX(max_index, indices[i]);
+    }
+    for (gsize line = 1; NULL != lines[line]; ++line) {
+        if ('\0' == *g_strstrip(lines[line])) {
+            continue;
+        }
+        gchar **fields = g_strsplit(lines[line], ",", -1);
+        if (g_strv_length(fields) <= (guint) max_index) {
+            g_set_error(error, HARNESS_ERROR, HARNESS_ERROR_INVALID_RESULT, "%s:%lu: too few fields",
+                        filename, (unsigned long) line + 1);
+            g_strfreev(fields);
+            goto escape;
+        }
+        HarnessResult *result = (HarnessResult *) g_malloc0(sizeof(HarnessResult));
+        result->key = g_strjoin("\t", fields[indices[0]], fields[indices[1]], fields[indices[2]], fields[indices[3]], NULL);
+        result->median = g_ascii_strtod(fields[indices[4]], NULL);
+        result->p95 = g_ascii_strtod(fields[indices[5]], NULL);
+        g_ptr_array_add(results, result);
+        g_strfreev(fields);
+    }
+    g_strfreev(header);
+    g_strfreev(lines);
+    return results;
+
+ escape:
+    g_strfreev(header);
+    g_strfreev(lines);
+    g_ptr_array_free(results, TRUE);
+    return NULL;
+}
+
+/**
+ * 2つの CSV の中央値を比べて ostream に出力する
+ * 中央値が threshold (%) より大きく遅くなり、かつ基準の p95 も上回った行を性能劣化とみなして regressed を TRUE にする
+ * 揺れの範囲に収まる差は劣化として扱わない
+ */
+gboolean
+Harness_compare(const gchar *base_filename, const gchar *new_filename, gdouble threshold,
+                FILE *ostream, gboolean *regressed, GError **error)
+{
+    GPtrArray *base_results = Harness_loadCSV(base_filename, error);
+    if (NULL == base_results) {
+        return FALSE;
+    }
+    GPtrArray *new_results = Harness_loadCSV(new_filename, error);
+    if (NULL == new_results) {
+        g_ptr_array_free(base_results, TRUE);
+        return FALSE;
+    }
+    GHashTable *base_table = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < base_results->len; ++i) {
+        HarnessResult *result = (HarnessResult *) g_ptr_array_index(base_results, i);
+        g_hash_table_insert(base_table, result->key, result);
+    }
+    *regressed = FALSE;
+    fprintf(ostream, "%-11s %-36s %-28s %-5s %12s %12s %9s\n",
+            "suite", "case", "engine", "phase", "base_ms", "new_ms", "delta");
+    for (guint i = 0; i < new_results->len; ++i) {
+        const HarnessResult *new_result = (const HarnessResult *) g_ptr_array_index(new_results, i);
+        const HarnessResult *base_result = (const HarnessResult *) g_hash_table_lookup(base_table, new_result->key);
+        gchar **names = g_strsplit(new_result->key, "\t", 4);
+        if (NULL == base_result) {
+            fprintf(ostream, "%-11s %-36s %-28s %-5s %12s %12.3lf %9s\n",
+                    names[0], names[1], names[2], names[3], "-", new_result->median / 1e6, "new");
+        } else {
+            gdouble delta = (0.0 < base_result->median) ? 100.0 * (new_result->median / base_result->median - 1.0) : 0.0;
+            const gchar *verdict = "";
+            if (threshold < delta && base_result->p95 < new_result->median) {
+                verdict = "  REGRESSION";
+                *regressed = TRUE;
+            } else if (-threshold > delta && new_result->p95 < base_result->median) {
+                verdict = "  improved";
+            }
+            fprintf(ostream, "%-11s %-36s %-28s %-5s %12.3lf %12.3lf %+8.1lf%%%s\n",
+                    names[0], names[1], names[2], names[3], base_result->median / 1e6, new_result->median / 1e6,
+                    delta, verdict);
+        }
+        g_strfreev(names);
+    }
+    g_hash_table_destroy(base_table);
+    g_ptr_array_free(new_results, TRUE);
+    g_ptr_array_free(base_results, TRUE);
+    return TRUE;
+}
@@ -0,0 +1,91 @@
+// ベンチマークの計測を支える道具
+// 単調増加で NTP の補正を受けない時計、CPU の固定、反復ごとの計測値の集計、
+// テキスト・CSV・JSON での出力と、2つの CSV の比較を提供する
+// 出力にはハードウェアカウンタの1バイトあたりの値を含められる
+
+#ifndef __HARNESS_H__
+#define __HARNESS_H__
+
+#include <stdio.h>
+#include <glib.h>
+
+#include "perfcounters.h"
+
+struct HarnessReport;
+typedef struct HarnessReport HarnessReport;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HARNESS_ERROR (g_quark_from_static_string("harness-error-quark"))
+
+typedef enum {
+    HARNESS_ERROR_PIN,
+    HARNESS_ERROR_INVALID_FORMAT,
+    HARNESS_ERROR_INVALID_RESULT,
+} HarnessError;
+
+typedef enum {
+    HARNESS_FORMAT_TEXT,
+    HARNESS_FORMAT_CSV,
+    HARNESS_FORMAT_JSON,
+} HarnessFormat;
+
+/**
+ * 反復ごとの計測値 (ns) を溜める可変長の配列
+ * HARNESS_SAMPLES_INIT で初期化し、不要になったら HarnessSamples_clear で解放する
+ */
+typedef struct HarnessSamples {
+    gdouble *values;
+    gsize len;
+    gsize capacity;
+} HarnessSamples;
+
+#define HARNESS_SAMPLES_INIT {NULL, 0, 0}
+
+/**
+ * 計測値の要約。パーセンタイルは昇順に並べた計測値を線形補間して求める
+ */
+typedef struct HarnessStats {
+    gsize n;
+    gdouble min;
+    gdouble mean;
+    gdouble stddev;
+    gdouble median;
+    gdouble p95;
+    gdouble p99;
+} HarnessStats;
+
+/**
+ * 前処理の結果が使うメモリのバイト数と、その前処理に登録したキーワードの本数
+ */
+typedef struct HarnessMemory {
+    gsize bytes;
+    gsize n_keywords;
+} HarnessMemory;
+
+extern gint64 Harness_getTimeNs(void);
+extern gboolean Harness_pinCPU(gint cpu, GError **error);
+
+extern void HarnessSamples_add(HarnessSamples *self, gdouble value);
+extern void HarnessSamples_clear(HarnessSamples *self);
+extern void HarnessSamples_summarize(const HarnessSamples *self, HarnessStats *stats);
+
+extern gboolean HarnessFormat_parse(const gchar *name, HarnessFormat *format, GError **error);
+
+extern HarnessReport *HarnessReport_new(HarnessFormat format, FILE *ostream, gboolean with_counters);
+extern void HarnessReport_free(HarnessReport *self);
+extern void HarnessReport_add(HarnessReport *self, const gchar *suite, const gchar *case_name,
+                              const gchar *engine, const gchar *phase, gsize bytes, glong matches,
+                              const HarnessMemory *memory, const HarnessSamples *samples,
+                              const PerfCounterValues *counters);
+
+extern gboolean Harness_compare(const gchar *base_filename, const gchar *new_filename, gdouble threshold,
+                                FILE *ostream, gboolean *regressed, GError **error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HARNESS_H__
@@ -0,0 +1,217 @@
+#include <errno.h>
+#include <string.h>
+#include <glib.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
+#include "perfcounters.h"
+
+static const gchar *const perf_counter_names[PERF_N_COUNTERS] = {
+    "cycles",
+    "instructions",
+    "l1d_misses",
+    "llc_misses",
+    "branch_misses",
+};
+
+struct PerfCounters {
+    gint fds[PERF_N_COUNTERS]; // 開けなかったカウンタは -1
+    gint leader_fd;
+    guint available;
+    gsize n_opened;
+};
+
+const gchar *
+PerfCounter_getName(PerfCounter counter)
+{
+    return perf_counter_names[counter];
+}
+
+void
+PerfCounterValues_add(PerfCounterValues *self, const PerfCounterValues *other)
+{
+    for (gsize i = 0; i < PERF_N_COUNTERS; ++i) {
+        self->values[i] += other->values[i];
+    }
+    self->available |= other->available;
+}
+
+/**
+ * 同じ計測の中で読んだ2つの値の差 end - begin を足し込む
+ */
+void
+PerfCounterValues_addDelta(PerfCounterValues *self, const PerfCounterValues *begin, const PerfCounterValues *end)
+{
+    for (gsize i = 0; i < PERF_N_COUNTERS; ++i) {
+        self->values[i] += (end->values[i] > begin->values[i]) ? end->values[i] - begin->values[i] : 0;
+    }
+    self->available |= end->available;
+}
+
+gboolean
+PerfCounterValues_has(const PerfCounterValues *self, PerfCounter counter)
+{
+    return 0 != (self->available & (1u << counter));
+}
+
+#ifdef __linux__
+
+/**
+ * 各カウンタの perf_event_attr の type と config
+ */
+static const struct {
+    guint32 type;
+    guint64 config;
+} perf_counter_events[PERF_N_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+                         | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                         | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+static gint
+PerfCounters_openEvent(PerfCounter counter, gint group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = perf_counter_events[counter].type;
+    attr.config = perf_counter_events[counter].config;
+    attr.disabled = (0 > group_fd) ? 1 : 0;
+    // カーネルを除けば perf_event_paranoid が 2 でも開ける
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (gint) syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/**
+ * 呼び出したスレッドのカウンタを開く
+ * サイクル数を開けなければエラーを返す。そのほかのカウンタは開けたものだけを数える
+ */
+PerfCounters *
+PerfCounters_open(GError **error)
+{
+    PerfCounters *self = (PerfCounters *) g_malloc0(sizeof(PerfCounters));
+    for (gsize i = 0; i < PERF_N_COUNTERS; ++i) {
+        self->fds[i] = -1;
+    }
+    self->leader_fd = PerfCounters_openEvent(PERF_COUNTER_CYCLES, -1);
+    if (0 > self->leader_fd) {
+        g_set_error(error, PERFCOUNTERS_ERROR, PERFCOUNTERS_ERROR_UNAVAILABLE,
+                    "perf_event_open failed: %s", g_strerror(errno));
+        g_free(self);
+        return NULL;
+    }
+    self->fds[PERF_COUNTER_CYCLES] = self->leader_fd;
+    self->available = 1u << PERF_COUNTER_CYCLES;
+    self->n_opened = 1;
+    for (gsize i = 0; i < PERF_N_COUNTERS; ++i) {
+        if (PERF_COUNTER_CYCLES == i) {
+            continue;
+        }
+        self->fds[i] = PerfCounters_openEvent((PerfCounter) i, self->leader_fd);
+        if (0 <= self->fds[i]) {
+            self->available |= 1u << i;
+            ++self->n_opened;
+        }
+    }
+    return self;
+}
+
+void
+PerfCounters_close(PerfCounters *self)
+{
+    if (NULL != self) {
+        for (gsize i = 0; i < PERF_N_COUNTERS; ++i) {
+            if (0 <= self->fds[i]) {
+                close(self->fds[i]);
+            }
+        }
+        g_free(self);
+    }
+}
+
+/**
+ * 0 から数え始める
+ */
+void
+PerfCounters_start(PerfCounters *self)
+{
+    ioctl(self->leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(self->leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+/**
+ * PerfCounters_start からの値を values に書き込む。数えている最中でも読める
+ * カウンタが多重化されて一部の時間しか数えられなかった場合は、動いていた時間の割合で補正する
+ */
+void
+PerfCounters_read(PerfCounters *self, PerfCounterValues *values)
+{
+    // nr, time_enabled, time_running に続いて {value, id} が開いた順に並ぶ
+    guint64 buffer[3 + 2 * PERF_N_COUNTERS];
+    memset(values, 0, sizeof(PerfCounterValues));
+    ssize_t size = read(self->leader_fd, buffer, sizeof(buffer));
+    if (size < (ssize_t) (sizeof(guint64) * (3 + 2 * self->n_opened))) {
+        return;
+    }
+    guint64 time_enabled = buffer[1];
+    guint64 time_running = buffer[2];
+    gdouble scale = (0 < time_running) ? (gdouble) time_enabled / time_running : 1.0;
+    gsize position = 3;
+    for (gsize i = 0; i < PERF_N_COUNTERS; ++i) {
+        if (0 <= self->fds[i]) {
+            values->values[i] = (guint64) (buffer[position] * scale);
+            position += 2;
+        }
+    }
+    values->available = self->available;
+}
+
+void
+PerfCounters_stop(PerfCounters *self)
+{
+    ioctl(self->leader_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+}
+
+#else // __linux__
+
+PerfCounters *
+PerfCounters_open(GError **error)
+{
+    g_set_error_literal(error, PERFCOUNTERS_ERROR, PERFCOUNTERS_ERROR_UNAVAILABLE,
+                        "hardware counters are supported only on Linux");
+    return NULL;
+}
+
+void
+PerfCounters_close(PerfCounters *self)
+{
+}
+
+void
+PerfCounters_start(PerfCounters *self)
+{
+}
+
+void
+PerfCounters_read(PerfCounters *self, PerfCounterValues *values)
+{
+    memset(values, 0, sizeof(PerfCounterValues));
+}
+
+void
+PerfCounters_stop(PerfCounters *self)
+{
+}
+
+#endif // __linux__
@@ -0,0 +1,60 @@
+// perf_event_open によるハードウェアカウンタの計測
+// サイクル数、命令数、L1 データキャッシュと LLC のミス、分岐予測ミスを1つのグループとして同時に数える
+// コンテナ内などでカウンタが使えない場合は PerfCounters_open がエラーを返すので、時間の計測だけで続ければよい
+
+#ifndef __PERFCOUNTERS_H__
+#define __PERFCOUNTERS_H__
+
+#include <glib.h>
+
+struct PerfCounters;
+typedef struct PerfCounters PerfCounters;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PERFCOUNTERS_ERROR (g_quark_from_static_string("perfcounters-error-quark"))
+
+typedef enum {
+    PERFCOUNTERS_ERROR_UNAVAILABLE,
+} PerfCountersError;
+
+typedef enum {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_L1D_MISSES,
+    PERF_COUNTER_LLC_MISSES,
+    PERF_COUNTER_BRANCH_MISSES,
+    PERF_N_COUNTERS,
+} PerfCounter;
+
+/**
+ * カウンタの値。PERFCOUNTERVALUES_INIT で初期化する
+ * available は開けたカウンタのビット集合で、開けなかったカウンタの値は 0 のままになる
+ */
+typedef struct PerfCounterValues {
+    guint64 values[PERF_N_COUNTERS];
+    guint available;
+} PerfCounterValues;
+
+#define PERFCOUNTERVALUES_INIT {{0}, 0}
+
+extern const gchar *PerfCounter_getName(PerfCounter counter);
+
+extern void PerfCounterValues_add(PerfCounterValues *self, const PerfCounterValues *other);
+extern void PerfCounterValues_addDelta(PerfCounterValues *self, const PerfCounterValues *begin,
+                                       const PerfCounterValues *end);
+extern gboolean PerfCounterValues_has(const PerfCounterValues *self, PerfCounter counter);
+
+extern PerfCounters *PerfCounters_open(GError **error);
+extern void PerfCounters_close(PerfCounters *self);
+extern void PerfCounters_start(PerfCounters *self);
+extern void PerfCounters_read(PerfCounters *self, PerfCounterValues *values);
+extern void PerfCounters_stop(PerfCounters *self);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __PERFCOUNTERS_H__
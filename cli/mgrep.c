@@ -0,0 +1,533 @@
+// 複数のキーワードを UTF-8 のテキストから探す grep 風のコマンド
+// キーワードはファイルから1行に1つずつ読み、Matcher にエンジンを選ばせる
+// ファイルはメモリにマップして複数のスレッドで並行に走査し、結果は指定した順に出力する
+// ファイルを指定しないか - を指定すると、標準入力を行単位で読みながら走査する
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "../src/linecounter.h"
+#include "../src/matcher.h"
+
+// 標準入力から一度に読む大きさ
+#define MGREP_READ_SIZE (1024 * 1024)
+#define MGREP_STDIN_NAME "(standard input)"
+
+// 終了コード: 見つかった、見つからなかった、エラーがあった
+#define MGREP_EXIT_MATCHED 0
+#define MGREP_EXIT_NOT_MATCHED 1
+#define MGREP_EXIT_ERROR 2
+
+static struct {
+    gboolean count;         // --count で件数だけを出力する
+    gboolean with_filename; // 出力の先頭にファイル名を付ける
+    gboolean first_per_line; // --first-per-line で1行につき最初の1つだけを出力する
+} mgrep_options = {FALSE, FALSE, FALSE};
+
+// 見つかったキーワードの開始位置 (テキストの先頭からのバイトオフセット) と、その位置を含む行の番号 (1 始まり)
+typedef struct mgrep_match_t {
+    gsize offset;
+    gsize line;
+    const gchar *keyword;
+    gsize keywordlen;
+} mgrep_match_t;
+
+// 走査する1つのファイル。出力とエラーは、前のファイルの出力が終わるまで溜めておく
+typedef struct mgrep_file_t {
+    gchar *path;
+    GString *output;
+    gchar *error_message; // エラーがなければ NULL
+    gboolean failed;      // UTF-8 でないために飛ばしたのではなく、読めなかった
+    gsize n_matches;
+    gboolean done;
+} mgrep_file_t;
+
+// ワーカーが共有する状態
+// ワーカーは next_file を1つずつ進めてファイルを取り、走査が終わったら next_output から順に出力する
+typedef struct mgrep_shared_t {
+    Matcher *matcher;
+    GPtrArray *files; // 要素は mgrep_file_t
+    gint next_file;
+    GMutex mutex;
+    guint next_output;
+} mgrep_shared_t;
+
+static mgrep_file_t *
+mgrep_file_new(const gchar *path)
+{
+    mgrep_file_t *self = g_new0(mgrep_file_t, 1);
+    self->path = g_strdup(path);
+    self->output = g_string_new(NULL);
+    return self;
+}
+
+static void
+mgrep_file_free(gpointer data)
+{
+    mgrep_file_t *self = (mgrep_file_t *) data;
+    g_string_free(self->output, TRUE);
+    g_free(self->error_message);
+    g_free(self->path);
+    g_free(self);
+}
+
+static gboolean
+mgrep_collect(const MatcherLine *line, const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    mgrep_match_t match = {offset, line->number, keyword, keywordlen};
+    g_array_append_val((GArray *) user_data, match);
+    return TRUE;
+}
+
+// 開始位置の昇順、同じ位置ならキーワードの辞書順に並べる
+static int
+mgrep_compareMatches(const void *a, const void *b)
+{
+    const mgrep_match_t *x = (const mgrep_match_t *) a;
+    const mgrep_match_t *y = (const mgrep_match_t *) b;
+    if (x->offset != y->offset) {
+        return (x->offset < y->offset) ? -1 : 1;
+    }
+    return strcmp(x->keyword, y->keyword);
+}
+
+// text を走査し、見つかったキーワードを位置の順に output に書き出して n_matches に件数を足す
+// base_offset と *line はテキストの先頭のファイル上のオフセットと行番号 (1 始まり)
+// update_line が TRUE なら *line をテキストの末尾の行番号に進める
+static gboolean
+mgrep_scanText(Matcher *matcher, const gchar *name, const gchar *text, gsize textlen, gsize base_offset,
+               gsize *line, gboolean update_line, GString *output, gsize *n_matches, GError **error)
+{
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(mgrep_match_t));
+    if (!Matcher_scanLines(matcher, text, textlen, mgrep_options.first_per_line, mgrep_collect, matches, error)) {
+        g_array_free(matches, TRUE);
+        return FALSE;
+    }
+    *n_matches += matches->len;
+    if (!mgrep_options.count) {
+        // 単一パターンのエンジンはキーワードごとに報告するので、位置の順に並べ直す
+        qsort(matches->data, matches->len, sizeof(mgrep_match_t), mgrep_compareMatches);
+        for (guint i = 0; i < matches->len; ++i) {
+            const mgrep_match_t *match = &g_array_index(matches, mgrep_match_t, i);
+            if (mgrep_options.with_filename) {
+                g_string_append_printf(output, "%s:", name);
+            }
+            g_string_append_printf(output, "%lu:%lu:", (unsigned long) (*line - 1 + match->line),
+                                   (unsigned long) (base_offset + match->offset));
+            g_string_append_len(output, match->keyword, match->keywordlen);
+            g_string_append_c(output, '\n');
+        }
+    }
+    if (update_line) {
+        *line += LineCounter_countNewlines(text, textlen);
+    }
+    g_array_free(matches, TRUE);
+    return TRUE;
+}
+
+// 件数だけを出力するときの1行を output に書き出す
+static void
+mgrep_appendCount(GString *output, const gchar *name, gsize n_matches)
+{
+    if (mgrep_options.with_filename) {
+        g_string_append_printf(output, "%s:", name);
+    }
+    g_string_append_printf(output, "%lu\n", (unsigned long) n_matches);
+}
+
+// ファイルをメモリにマップして走査する
+static gboolean
+mgrep_scanFile(Matcher *matcher, mgrep_file_t *file, GError **error)
+{
+    GMappedFile *mapped = g_mapped_file_new(file->path, FALSE, error);
+    if (NULL == mapped) {
+        return FALSE;
+    }
+    // 空のファイルは内容が NULL になる
+    const gchar *text = g_mapped_file_get_contents(mapped);
+    gsize textlen = g_mapped_file_get_length(mapped);
+    gboolean scanned = TRUE;
+    if (0 < textlen) {
+        if (!g_utf8_validate(text, textlen, NULL)) {
+            g_set_error(error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE,
+                        "%s: binary file or not valid UTF-8, skipped", file->path);
+            scanned = FALSE;
+        } else {
+            gsize line = 1;
+            scanned = mgrep_scanText(matcher, file->path, text, textlen, 0, &line, FALSE, file->output,
+                                     &file->n_matches, error);
+        }
+    }
+    if (scanned && mgrep_options.count) {
+        mgrep_appendCount(file->output, file->path, file->n_matches);
+    }
+    g_mapped_file_unref(mapped);
+    return scanned;
+}
+
+// 走査の終わったファイルの出力を、指定された順に書き出す。mutex を持って呼ぶ
+static void
+mgrep_flush(mgrep_shared_t *shared)
+{
+    while (shared->next_output < shared->files->len) {
+        mgrep_file_t *file = (mgrep_file_t *) g_ptr_array_index(shared->files, shared->next_output);
+        if (!file->done) {
+            break;
+        }
+        fwrite(file->output->str, 1, file->output->len, stdout);
+        g_string_free(file->output, TRUE);
+        file->output = g_string_new(NULL);
+        if (NULL != file->error_message) {
+            fflush(stdout);
+            g_printerr("%s: %s\n", g_get_prgname(), file->error_message);
+        }
+        ++shared->next_output;
+    }
+}
+
+static gpointer
+mgrep_worker(gpointer data)
+{
+    mgrep_shared_t *shared = (mgrep_shared_t *) data;
+    while (TRUE) {
+        gint index = g_atomic_int_add(&shared->next_file, 1);
+        if ((guint) index >= shared->files->len) {
+            break;
+        }
+        mgrep_file_t *file = (mgrep_file_t *) g_ptr_array_index(shared->files, index);
+        GError *error = NULL;
+        if (!mgrep_scanFile(shared->matcher, file, &error)) {
+            file->error_message = g_strdup(error->message);
+            // grep と同じく、バイナリのファイルを飛ばしただけならエラーにしない
+            file->failed = !g_error_matches(error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE);
+            g_error_free(error);
+        }
+        g_mutex_lock(&shared->mutex);
+        file->done = TRUE;
+        mgrep_flush(shared);
+        g_mutex_unlock(&shared->mutex);
+    }
+    return NULL;
+}
+
+// 指定されたファイルを n_threads 個のスレッドで走査する
+static void
+mgrep_scanFiles(Matcher *matcher, GPtrArray *files, gint n_threads)
+{
+    mgrep_shared_t shared;
+    shared.matcher = matcher;
+    shared.files = files;
+    shared.next_file = 0;
+    shared.next_output = 0;
+    g_mutex_init(&shared.mutex);
+    n_threads = MIN(n_threads, (gint) files->len);
+    if (1 >= n_threads) {
+        mgrep_worker(&shared);
+    } else {
+        GThread **threads = g_new(GThread *, n_threads);
+        for (gint i = 0; i < n_threads; ++i) {
+            threads[i] = g_thread_new("mgrep-worker", mgrep_worker, &shared);
+        }
+        for (gint i = 0; i < n_threads; ++i) {
+            g_thread_join(threads[i]);
+        }
+        g_free(threads);
+    }
+    g_mutex_clear(&shared.mutex);
+}
+
+// fd を読みながら走査する
+// キーワードは改行を含まないので、読んだ中で最後の改行までを走査し、途中の行は次に持ち越す
+// パイプから少しずつ届く入力でも行が揃うたびに出力するよう、read(2) で届いた分だけを読み、出力を書き出す
+static gboolean
+mgrep_scanStream(Matcher *matcher, gint fd, const gchar *name, gsize *n_matches, GError **error)
+{
+    GString *buffer = g_string_sized_new(MGREP_READ_SIZE);
+    GString *output = g_string_new(NULL);
+    gsize offset = 0;
+    gsize line = 1;
+    gboolean scanned = TRUE;
+    gboolean eof = FALSE;
+    while (scanned && !eof) {
+        gsize buffered = buffer->len;
+        g_string_set_size(buffer, buffered + MGREP_READ_SIZE);
+        gssize n_read = read(fd, buffer->str + buffered, MGREP_READ_SIZE);
+        if (0 > n_read) {
+            g_string_set_size(buffer, buffered);
+            if (EINTR == errno) {
+                continue;
+            }
+            g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "%s: %s", name, g_strerror(errno));
+            scanned = FALSE;
+            break;
+        }
+        g_string_set_size(buffer, buffered + n_read);
+        eof = (0 == n_read);
+        gsize scanlen = buffer->len;
+        if (!eof) {
+            // 持ち越した部分には改行がないので、いま読んだ部分から最後の改行を探す
+            while (buffered < scanlen && '\n' != buffer->str[scanlen - 1]) {
+                --scanlen;
+            }
+            if (buffered == scanlen) {
+                continue;
+            }
+        }
+        if (!g_utf8_validate(buffer->str, scanlen, NULL)) {
+            g_set_error(error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE,
+                        "%s: binary input or not valid UTF-8", name);
+            scanned = FALSE;
+            break;
+        }
+        scanned = mgrep_scanText(matcher, name, buffer->str, scanlen, offset, &line, TRUE, output, n_matches, error);
+        if (0 < output->len) {
+            fwrite(output->str, 1, output->len, stdout);
+            fflush(stdout);
+            g_string_truncate(output, 0);
+        }
+        g_string_erase(buffer, 0, scanlen);
+        offset += scanlen;
+    }
+    if (scanned && mgrep_options.count) {
+        mgrep_appendCount(output, name, *n_matches);
+        fwrite(output->str, 1, output->len, stdout);
+    }
+    g_string_free(output, TRUE);
+    g_string_free(buffer, TRUE);
+    return scanned;
+}
+
+// キーワードのファイルを読み、1行を1つのキーワードとして登録する。空の行は無視する
+static gboolean
+mgrep_loadKeywords(Matcher *matcher, const gchar *filename, GError **error)
+{
+    gchar *contents = NULL;
+    gsize length = 0;
+    if (!g_file_get_contents(filename, &contents, &length, error)) {
+        return FALSE;
+    }
+    guint n_keywords = 0;
+    guint line = 0;
+    gchar *iter = contents;
+    gchar *contents_end = contents + length;
+    while (iter < contents_end) {
+        ++line;
+        gchar *line_end = (gchar *) memchr(iter, '\n', contents_end - iter);
+        gchar *next = (NULL == line_end) ? contents_end : line_end + 1;
+        if (NULL == line_end) {
+            line_end = contents_end;
+        }
+        if (iter < line_end && '\r' == line_end[-1]) {
+            --line_end;
+        }
+        if (iter < line_end) {
+            GError *keyword_error = NULL;
+            if (!Matcher_addKeyword(matcher, iter, line_end - iter, &keyword_error)) {
+                g_set_error(error, keyword_error->domain, keyword_error->code, "%s:%u: %s",
+                            filename, line, keyword_error->message);
+                g_error_free(keyword_error);
+                g_free(contents);
+                return FALSE;
+            }
+            ++n_keywords;
+        }
+        iter = next;
+    }
+    g_free(contents);
+    if (0 == n_keywords) {
+        g_set_error(error, MATCHER_ERROR, MATCHER_ERROR_NO_KEYWORD, "%s: no keywords", filename);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static int
+mgrep_comparePaths(const void *a, const void *b)
+{
+    return strcmp(*(const gchar *const *) a, *(const gchar *const *) b);
+}
+
+// path がディレクトリなら中の通常のファイルを名前の順に再帰的に、ファイルならそれ自身を files に加える
+// ディレクトリへのシンボリックリンクは循環を避けるために辿らない
+static gboolean
+mgrep_addPath(GPtrArray *files, const gchar *path, gsize *total_size, GError **error)
+{
+    if (!g_file_test(path, G_FILE_TEST_IS_DIR)) {
+        if (!g_file_test(path, G_FILE_TEST_EXISTS)) {
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "%s: No such file or directory", path);
+            return FALSE;
+        }
+        g_ptr_array_add(files, mgrep_file_new(path));
+        struct stat st;
+        if (0 == stat(path, &st)) {
+            *total_size += st.st_size;
+        }
+        return TRUE;
+    }
+    GDir *dir = g_dir_open(path, 0, error);
+    if (NULL == dir) {
+        return FALSE;
+    }
+    GPtrArray *children = g_ptr_array_new_with_free_func(g_free);
+    const gchar *name = NULL;
+    while (NULL != (name = g_dir_read_name(dir))) {
+        g_ptr_array_add(children, g_build_filename(path, name, NULL));
+    }
+    g_dir_close(dir);
+    qsort(children->pdata, children->len, sizeof(gpointer), mgrep_comparePaths);
+    gboolean added = TRUE;
+    for (guint i = 0; i < children->len; ++i) {
+        const gchar *child = (const gchar *) g_ptr_array_index(children, i);
+        if (g_file_test(child, G_FILE_TEST_IS_SYMLINK) && g_file_test(child, G_FILE_TEST_IS_DIR)) {
+            continue;
+        }
+        if (!g_file_test(child, G_FILE_TEST_IS_DIR) && !g_file_test(child, G_FILE_TEST_IS_REGULAR)) {
+            continue;
+        }
+        GError *child_error = NULL;
+        if (!mgrep_addPath(files, child, total_size, &child_error)) {
+            // 読めないディレクトリがあっても残りは走査する
+            g_printerr("%s: %s\n", g_get_prgname(), child_error->message);
+            g_error_free(child_error);
+            added = FALSE;
+        }
+    }
+    g_ptr_array_free(children, TRUE);
+    return added;
+}
+
+static gboolean
+mgrep_parseEngine(const gchar *name, MatcherEngine *engine)
+{
+    if (NULL == name || 0 == g_ascii_strcasecmp(name, "auto")) {
+        *engine = MATCHER_ENGINE_AUTO;
+        return TRUE;
+    }
+    for (guint i = MATCHER_ENGINE_AUTO + 1; i < MATCHER_N_ENGINES; ++i) {
+        const gchar *engine_name = MatcherEngine_getName((MatcherEngine) i);
+        if (NULL != engine_name && 0 == g_ascii_strcasecmp(name, engine_name)) {
+            *engine = (MatcherEngine) i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+int
+main(int argc, char *argv[])
+{
+    gchar *keywords_filename = NULL;
+    gchar *engine_name = NULL;
+    gint n_threads = (gint) g_get_num_processors();
+    gboolean with_filename = FALSE;
+    gboolean no_filename = FALSE;
+    gboolean verbose = FALSE;
+    GOptionEntry entries[] = {
+        {"file", 'f', 0, G_OPTION_ARG_FILENAME, &keywords_filename, "read keywords from FILE, one per line", "FILE"},
+        {"count", 'c', 0, G_OPTION_ARG_NONE, &mgrep_options.count, "print only the number of matches per input", NULL},
+        {"first-per-line", 0, 0, G_OPTION_ARG_NONE, &mgrep_options.first_per_line,
+         "report only the leftmost match of each line, so --count counts matching lines", NULL},
+        {"with-filename", 'H', 0, G_OPTION_ARG_NONE, &with_filename, "print the file name for each match", NULL},
+        {"no-filename", 0, 0, G_OPTION_ARG_NONE, &no_filename, "never print file names", NULL},
+        {"engine", 0, 0, G_OPTION_ARG_STRING, &engine_name, "engine to use instead of choosing automatically", "NAME"},
+        {"threads", 'j', 0, G_OPTION_ARG_INT, &n_threads, "number of files scanned in parallel", "N"},
+        {"verbose", 0, 0, G_OPTION_ARG_NONE, &verbose, "print the chosen engine", NULL},
+        G_OPTION_ENTRY_NULL,
+    };
+    GOptionContext *context = g_option_context_new("-f KEYWORDS [FILE|DIRECTORY...]");
+    g_option_context_set_summary(context,
+                                 "Print FILE:LINE:OFFSET:KEYWORD for each keyword found in UTF-8 text.\n"
+                                 "OFFSET is the byte offset of the match. With no FILE, or when FILE is -, read standard input.");
+    g_option_context_add_main_entries(context, entries, NULL);
+    GError *error = NULL;
+    gboolean parsed = g_option_context_parse(context, &argc, &argv, &error);
+    g_option_context_free(context);
+    if (!parsed) {
+        g_printerr("%s: %s\n", g_get_prgname(), error->message);
+        g_error_free(error);
+        return MGREP_EXIT_ERROR;
+    }
+    MatcherEngine engine = MATCHER_ENGINE_AUTO;
+    if (NULL == keywords_filename || 0 >= n_threads || !mgrep_parseEngine(engine_name, &engine)) {
+        g_printerr("usage: %s [OPTION...] -f KEYWORDS [FILE|DIRECTORY...]\n", g_get_prgname());
+        return MGREP_EXIT_ERROR;
+    }
+
+    Matcher *matcher = Matcher_new();
+    if (!mgrep_loadKeywords(matcher, keywords_filename, &error)) {
+        g_printerr("%s: %s\n", g_get_prgname(), error->message);
+        g_error_free(error);
+        Matcher_free(matcher);
+        return MGREP_EXIT_ERROR;
+    }
+
+    int status = MGREP_EXIT_NOT_MATCHED;
+    gboolean from_stdin = (1 == argc) || (2 == argc && 0 == strcmp(argv[1], "-"));
+    GPtrArray *files = g_ptr_array_new_with_free_func(mgrep_file_free);
+    gsize total_size = 0;
+    for (int i = 1; !from_stdin && i < argc; ++i) {
+        if (0 == strcmp(argv[i], "-")) {
+            g_printerr("%s: standard input cannot be combined with files\n", g_get_prgname());
+            g_ptr_array_free(files, TRUE);
+            Matcher_free(matcher);
+            return MGREP_EXIT_ERROR;
+        }
+        if (!mgrep_addPath(files, argv[i], &total_size, &error)) {
+            if (NULL != error) {
+                g_printerr("%s: %s\n", g_get_prgname(), error->message);
+                g_clear_error(&error);
+            }
+            status = MGREP_EXIT_ERROR;
+        }
+    }
+    // 複数のファイルを走査するときは grep と同じくファイル名を付ける
+    mgrep_options.with_filename = !no_filename &&
+        (with_filename || 1 < files->len || (2 == argc && g_file_test(argv[1], G_FILE_TEST_IS_DIR)));
+
+    // すべての入力を同じエンジンで走査するので、1つの入力の平均の大きさに合わせて選ぶ
+    Matcher_setExpectedScanBytes(matcher, from_stdin ? MGREP_READ_SIZE : MAX(total_size / MAX(files->len, 1), 1));
+    if (!Matcher_compile(matcher, engine, &error)) {
+        g_printerr("%s: %s\n", g_get_prgname(), error->message);
+        g_error_free(error);
+        g_ptr_array_free(files, TRUE);
+        Matcher_free(matcher);
+        return MGREP_EXIT_ERROR;
+    }
+    if (verbose) {
+        g_printerr("%s: %u keywords, engine: %s\n", g_get_prgname(), Matcher_getKeywordCount(matcher),
+                   Matcher_getEngineName(matcher));
+    }
+
+    gsize n_matches = 0;
+    if (from_stdin) {
+        if (!mgrep_scanStream(matcher, STDIN_FILENO, MGREP_STDIN_NAME, &n_matches, &error)) {
+            fflush(stdout);
+            g_printerr("%s: %s\n", g_get_prgname(), error->message);
+            g_clear_error(&error);
+            status = MGREP_EXIT_ERROR;
+        }
+    } else {
+        mgrep_scanFiles(matcher, files, n_threads);
+        for (guint i = 0; i < files->len; ++i) {
+            const mgrep_file_t *file = (const mgrep_file_t *) g_ptr_array_index(files, i);
+            n_matches += file->n_matches;
+            if (file->failed) {
+                status = MGREP_EXIT_ERROR;
+            }
+        }
+    }
+    fflush(stdout);
+    if (MGREP_EXIT_ERROR != status && 0 < n_matches) {
+        status = MGREP_EXIT_MATCHED;
+    }
+    g_ptr_array_free(files, TRUE);
+    Matcher_free(matcher);
+    g_free(engine_name);
+    g_free(keywords_filename);
+    return status;
+}
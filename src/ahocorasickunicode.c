@@ -3,52 +3,77 @@
 #include <glib.h>
 
 #include "ahocorasickunicode.h"
+#include "memoryusage.h"
+#include "nodearena.h"
+#include "scanstats.h"
+#include "utf8transcoder.h"
 
-// 論文において "goto function" と記されているものを GHashTable の入れ子として表現していて、
-// GHashTable のキー値がステートマシンにおける遷移条件に相当する
+// 論文において "goto function" と記されているものを NodeArenaEdges の入れ子として表現していて、
+// NodeArenaEdges のラベルがステートマシンにおける遷移条件に相当する
+// ステートと遷移表はすべてマッチャーが持つ NodeArena から確保する
 // また、"failure function", "output function" は fail_state, output メンバとして表現している
 
 struct UnicodeAhoCorasickState;
 typedef struct UnicodeAhoCorasickState UnicodeAhoCorasickState;
 
 struct UnicodeAhoCorasickState {
-  GHashTable *next_states; // 要素は UnicodeAhoCorasickState
+  NodeArenaEdges next_states; // 要素は UnicodeAhoCorasickState
   const UnicodeAhoCorasickState *fail_state;
   gconstpointer output;
 };
 
 struct UnicodeAhoCorasickMatcher {
   gsize max_pattern_len;
+  NodeArena *arena;
   UnicodeAhoCorasickState *start_state;
   gboolean need_update;
   gunichar2 *conds_buf;
+#ifdef STRING_MATCHING_STATS
+  ScanStats stats;
+#endif
 };
 
+/**
+ * 並行して走査している1本のテキストの状態
+ * entered は直前に読んだ1単位で state に遷移したことを表し、次の周回で state の output を報告する
+ */
+typedef struct UnicodeAhoCorasickStream {
+  const UnicodeAhoCorasickState *state;
+  const gunichar2 *text_begin;
+  const gunichar2 *text_iter;
+  const gunichar2 *text_end;
+  guint index;
+  gboolean entered;
+} UnicodeAhoCorasickStream;
+
+/**
+ * テキストを分割して並行に走査するときに、分割した範囲ごとの報告を元のテキストの位置に直すための状態
+ * i 番目の範囲は origins[i] から読み始めるが、末尾が bounds[i] 以下のキーワードは前の範囲で報告済みなので捨てる
+ */
+typedef struct UnicodeAhoCorasickSlices {
+  gsize origins[AHOCORASICKUNICODE_MAX_STREAMS];
+  gsize bounds[AHOCORASICKUNICODE_MAX_STREAMS];
+  UnicodeAhoCorasickStreamFunc func;
+  gpointer user_data;
+} UnicodeAhoCorasickSlices;
+
 struct UnicodeAhoCorasickPatternsIter {
   const UnicodeAhoCorasickState *start_state;
   const UnicodeAhoCorasickState *current_state;
   const UnicodeAhoCorasickState *current_fail_state;
+  const gunichar2 *text_begin;
   const gunichar2 *text_iter;
   const gunichar2 *text_end;
   gunichar2 *text_allocated;
+#ifdef STRING_MATCHING_STATS
+  ScanStats *stats; // 走査しているマッチャーの統計
+#endif
 };
 
-static void UnicodeAhoCorasickState_free(gpointer self);
-
 static UnicodeAhoCorasickState *
-UnicodeAhoCorasickState_new()
+UnicodeAhoCorasickState_new(NodeArena *arena)
 {
-  UnicodeAhoCorasickState *self = (UnicodeAhoCorasickState *) g_malloc0(sizeof(UnicodeAhoCorasickState));
-  self->next_states = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, UnicodeAhoCorasickState_free);
-  return self;
-}
-
-static void
-UnicodeAhoCorasickState_free(gpointer data)
-{
-  UnicodeAhoCorasickState *self = (UnicodeAhoCorasickState *) data;
-  g_hash_table_destroy(self->next_states);
-  g_free(self);
+  return (UnicodeAhoCorasickState *) NodeArena_alloc0(arena, sizeof(UnicodeAhoCorasickState));
 }
 
 static UnicodeAhoCorasickState *
@@ -57,7 +82,7 @@ UnicodeAhoCorasickState_transferMany(UnicodeAhoCorasickState *self, const gunich
   if (0 == n_inputs) {
     return self;
   }
-  gpointer next_state = g_hash_table_lookup(self->next_states, GINT_TO_POINTER(*inputs));
+  gpointer next_state = NodeArenaEdges_lookup(&self->next_states, *inputs);
   if (NULL == next_state) {
     // 入力に基づく遷移先がない
     return NULL;
@@ -71,7 +96,8 @@ UnicodeAhoCorasickMatcher_new(gsize max_pattern_len)
 {
   UnicodeAhoCorasickMatcher *self = (UnicodeAhoCorasickMatcher *) g_malloc0(sizeof(UnicodeAhoCorasickMatcher));
   self->max_pattern_len = max_pattern_len;
-  self->start_state = UnicodeAhoCorasickState_new();
+  self->arena = NodeArena_new();
+  self->start_state = UnicodeAhoCorasickState_new(self->arena);
   self->conds_buf = (gunichar2 *) g_malloc0(sizeof(gunichar2) * max_pattern_len);
   self->need_update = FALSE;
   return self;
@@ -80,7 +106,8 @@ UnicodeAhoCorasickMatcher_new(gsize max_pattern_len)
 void
 UnicodeAhoCorasickMatcher_free(UnicodeAhoCorasickMatcher *self)
 {
-  UnicodeAhoCorasickState_free(self->start_state);
+  // ステートと遷移表はすべてアリーナにあるので、オートマトンを辿らずにまとめて解放できる
+  NodeArena_free(self->arena);
   g_free(self->conds_buf);
   g_free(self);
 }
@@ -92,7 +119,7 @@ UnicodeAhoCorasickMatcher_addKeywordImpl(UnicodeAhoCorasickMatcher *self, const
   UnicodeAhoCorasickState *current_state = self->start_state;
   const gunichar2 *pattern_iter = pattern;
   for (; pattern_end != pattern_iter; ++pattern_iter) {
-    gpointer next_state = g_hash_table_lookup(current_state->next_states, GINT_TO_POINTER(*pattern_iter));
+    gpointer next_state = NodeArenaEdges_lookup(&current_state->next_states, *pattern_iter);
     if (NULL == next_state) {
       break;
     }
@@ -100,9 +127,9 @@ UnicodeAhoCorasickMatcher_addKeywordImpl(UnicodeAhoCorasickMatcher *self, const
   }
   // pattern を表現するために必要なノードを追加する
   for (; pattern_end != pattern_iter; ++pattern_iter) {
-    UnicodeAhoCorasickState *new_state = UnicodeAhoCorasickState_new();
+    UnicodeAhoCorasickState *new_state = UnicodeAhoCorasickState_new(self->arena);
     new_state->fail_state = self->start_state;
-    g_assert(g_hash_table_insert(current_state->next_states, GINT_TO_POINTER((gint) *pattern_iter), (gpointer) new_state));
+    NodeArenaEdges_insert(&current_state->next_states, self->arena, *pattern_iter, (gpointer) new_state);
     current_state = new_state;
   }
   // output を設定する
@@ -161,49 +188,89 @@ UnicodeAhoCorasickMatcher_updateFailStateRecursively(UnicodeAhoCorasickMatcher *
     }
   }
   // 再帰的に処理する
-  if (0 < g_hash_table_size(state->next_states)) {
+  if (0 < state->next_states.size) {
     g_assert(n_conditions + 1 <= self->max_pattern_len);
-    GHashTableIter iter;
-    g_hash_table_iter_init(&iter, state->next_states);
-    gpointer condition = NULL;
-    gpointer next_state = NULL;
-    while (g_hash_table_iter_next(&iter, &condition, &next_state)) {
-      self->conds_buf[n_conditions] = GPOINTER_TO_INT(condition);
-      UnicodeAhoCorasickMatcher_updateFailStateRecursively(self, (UnicodeAhoCorasickState *) next_state, n_conditions + 1);
+    for (guint i = 0; i < state->next_states.size; ++i) {
+      self->conds_buf[n_conditions] = state->next_states.labels[i];
+      UnicodeAhoCorasickMatcher_updateFailStateRecursively(self, (UnicodeAhoCorasickState *) state->next_states.nodes[i], n_conditions + 1);
     }
   }
 }
 
-void
-UnicodeAhoCorasickMatcher_scanImpl(UnicodeAhoCorasickMatcher *self, const gunichar2 *text, const gunichar2 *text_end, gunichar2 *text_allocated, UnicodeAhoCorasickPatternsIter **iter)
+static void
+UnicodeAhoCorasickMatcher_updateFailStates(UnicodeAhoCorasickMatcher *self)
 {
-  // fail_state を再計算する
   if (self->need_update) {
     UnicodeAhoCorasickMatcher_updateFailStateRecursively(self, self->start_state, 0);
     memset(self->conds_buf, 0, sizeof(gunichar2) * self->max_pattern_len);
     self->need_update = FALSE;
   }
-  UnicodeAhoCorasickPatternsIter *new_iter = (UnicodeAhoCorasickPatternsIter *) g_malloc0(sizeof(UnicodeAhoCorasickPatternsIter));
-  new_iter->start_state = self->start_state;
-  new_iter->current_state = self->start_state;
-  new_iter->text_iter = text;
-  new_iter->text_end = text_end;
-  new_iter->text_allocated = text_allocated;
+}
+
+/**
+ * 失敗遷移を求めてオートマトンを完成させる
+ * 走査は未完成なら失敗遷移を求めてから始めるが、そのときに作業用の領域と失敗遷移を書き換えるので、
+ * 複数のスレッドから走査するマッチャーはキーワードを追加し終えたらこの関数を呼んでおく
+ */
+void
+UnicodeAhoCorasickMatcher_compile(UnicodeAhoCorasickMatcher *self)
+{
+  UnicodeAhoCorasickMatcher_updateFailStates(self);
+}
+
+static void
+UnicodeAhoCorasickMatcher_initIter(UnicodeAhoCorasickMatcher *self, const gunichar2 *text, const gunichar2 *text_end, gunichar2 *text_allocated, UnicodeAhoCorasickPatternsIter *iter)
+{
+  // fail_state を再計算する
+  UnicodeAhoCorasickMatcher_updateFailStates(self);
+  memset(iter, 0, sizeof(UnicodeAhoCorasickPatternsIter));
+  iter->start_state = self->start_state;
+  iter->current_state = self->start_state;
+  iter->text_begin = text;
+  iter->text_iter = text;
+  iter->text_end = text_end;
+  iter->text_allocated = text_allocated;
+#ifdef STRING_MATCHING_STATS
+  iter->stats = &self->stats;
+#endif
+  SCANSTATS_COUNT(&self->stats, n_scans, 1);
+  SCANSTATS_COUNT(&self->stats, n_units, text_end - text);
+}
+
+void
+UnicodeAhoCorasickMatcher_scanImpl(UnicodeAhoCorasickMatcher *self, const gunichar2 *text, const gunichar2 *text_end, gunichar2 *text_allocated, UnicodeAhoCorasickPatternsIter **iter)
+{
   g_assert(NULL != iter);
-  *iter = new_iter;
+  *iter = (UnicodeAhoCorasickPatternsIter *) g_malloc(sizeof(UnicodeAhoCorasickPatternsIter));
+  UnicodeAhoCorasickMatcher_initIter(self, text, text_end, text_allocated, *iter);
 }
 
 gboolean
 UnicodeAhoCorasickMatcher_scanUTF8String(UnicodeAhoCorasickMatcher *self, const gchar *text, glong textlen, UnicodeAhoCorasickPatternsIter **iter, GError **error)
 {
+  // 変換結果の所有権はイテレータに移す
+  UTF16Buffer buffer = UTF16BUFFER_INIT;
   glong u16textlen = 0L;
-  GError *conv_error = NULL;
-  gunichar2 *u16text = g_utf8_to_utf16(text, textlen, NULL, &u16textlen, &conv_error);
-  if (u16text == NULL) {
-    g_propagate_error(error, conv_error);
+  if (!UTF8Transcoder_toUTF16(text, textlen, &buffer, &u16textlen, error)) {
+    UTF16Buffer_clear(&buffer);
+    return FALSE;
+  }
+  UnicodeAhoCorasickMatcher_scanImpl(self, buffer.data, buffer.data + u16textlen, buffer.data, iter);
+  return TRUE;
+}
+
+/**
+ * UTF-16 への変換結果を buffer に書き込んで検査する
+ * イテレータは buffer を参照するので、イテレータを使い終わるまで buffer を変更してはいけない
+ */
+gboolean
+UnicodeAhoCorasickMatcher_scanUTF8StringWithBuffer(UnicodeAhoCorasickMatcher *self, const gchar *text, glong textlen, UTF16Buffer *buffer, UnicodeAhoCorasickPatternsIter **iter, GError **error)
+{
+  glong u16textlen = 0L;
+  if (!UTF8Transcoder_toUTF16(text, textlen, buffer, &u16textlen, error)) {
     return FALSE;
   }
-  UnicodeAhoCorasickMatcher_scanImpl(self, u16text, u16text + u16textlen, u16text, iter);
+  UnicodeAhoCorasickMatcher_scanImpl(self, buffer->data, buffer->data + u16textlen, NULL, iter);
   return TRUE;
 }
 
@@ -213,6 +280,163 @@ UnicodeAhoCorasickMatcher_scanUTF16String(UnicodeAhoCorasickMatcher *self, const
   UnicodeAhoCorasickMatcher_scanImpl(self, text, text + textlen, NULL, iter);
 }
 
+/**
+ * テキストに現れるすべてのキーワードを、末尾の位置の順に func に通知する
+ * イテレータをスタックに置くので、走査のたびに確保しない
+ */
+void
+UnicodeAhoCorasickMatcher_scanAllUTF16String(UnicodeAhoCorasickMatcher *self, const gunichar2 *text, gsize textlen, UnicodeAhoCorasickMatchFunc func, gpointer user_data)
+{
+  UnicodeAhoCorasickPatternsIter iter;
+  UnicodeAhoCorasickMatcher_initIter(self, text, text + textlen, NULL, &iter);
+  gconstpointer output = NULL;
+  while (NULL != (output = UnicodeAhoCorasickPatternsIter_next(&iter))) {
+    if (!func(output, UnicodeAhoCorasickPatternsIter_getOffset(&iter), user_data)) {
+      break;
+    }
+  }
+}
+
+/**
+ * streams の各テキストを1単位ずつ交互に読み進める
+ * 1本のテキストでは遷移表を引くたびにキャッシュミスを待つことになるが、あるテキストの次のステートと遷移表を先読みしてから
+ * 他のテキストを進めることで、メモリの待ち時間を重ねて隠す
+ * 1周は2段に分かれていて、前段で前の周回に遷移したステートの output を報告して遷移表を先読みし、
+ * 後段で遷移表を引いて次のステートを先読みする。読み終えたテキストは末尾のものと入れ替えて外す
+ */
+static gboolean
+UnicodeAhoCorasickMatcher_scanStreams(UnicodeAhoCorasickMatcher *self, UnicodeAhoCorasickStream *streams, guint n_streams, UnicodeAhoCorasickStreamFunc func, gpointer user_data)
+{
+  const UnicodeAhoCorasickState *start_state = self->start_state;
+  guint n_active = n_streams;
+  while (0 < n_active) {
+    for (guint i = 0; i < n_active; ) {
+      UnicodeAhoCorasickStream *stream = &streams[i];
+      if (stream->entered) {
+        // fail_state も満たしていることになるので、逐次のイテレータと同じ順に output を報告する
+        gsize end_offset = stream->text_iter - stream->text_begin;
+        const UnicodeAhoCorasickState *state = stream->state;
+        if (NULL != state->output && !func(stream->index, state->output, end_offset, user_data)) {
+          return FALSE;
+        }
+        for (state = state->fail_state; NULL != state; state = state->fail_state) {
+          SCANSTATS_COUNT(&self->stats, n_output_steps, 1);
+          if (NULL != state->output && !func(stream->index, state->output, end_offset, user_data)) {
+            return FALSE;
+          }
+        }
+      }
+      if (stream->text_end == stream->text_iter) {
+        *stream = streams[--n_active];
+        continue;
+      }
+      __builtin_prefetch(stream->state->next_states.labels);
+      __builtin_prefetch(stream->state->next_states.nodes);
+      ++i;
+    }
+    for (guint i = 0; i < n_active; ++i) {
+      UnicodeAhoCorasickStream *stream = &streams[i];
+      const UnicodeAhoCorasickState *current_state = stream->state;
+      gunichar2 input = *stream->text_iter++;
+      stream->entered = FALSE;
+      while (TRUE) {
+        SCANSTATS_COUNT(&self->stats, n_compares, 1);
+        gpointer next_state = NodeArenaEdges_lookup(&current_state->next_states, input);
+        if (NULL != next_state) {
+          current_state = (const UnicodeAhoCorasickState *) next_state;
+          stream->entered = TRUE;
+          break;
+        }
+        if (start_state == current_state) {
+          break;
+        }
+        // fail_state に遷移してリトライする
+        SCANSTATS_COUNT(&self->stats, n_fail_transitions, 1);
+        current_state = current_state->fail_state;
+      }
+      stream->state = current_state;
+      __builtin_prefetch(current_state);
+    }
+  }
+  return TRUE;
+}
+
+/**
+ * n_texts 本のテキストを AHOCORASICKUNICODE_MAX_STREAMS 本ずつ交互に読み進めて走査する
+ * 報告の順序は1本のテキストの中では逐次のイテレータと同じだが、テキストの間では入り混じる
+ * func が FALSE を返して打ち切ったときは FALSE を返す
+ */
+gboolean
+UnicodeAhoCorasickMatcher_scanUTF16Interleaved(UnicodeAhoCorasickMatcher *self, const gunichar2 *const *texts, const gsize *textlens, guint n_texts, UnicodeAhoCorasickStreamFunc func, gpointer user_data)
+{
+  UnicodeAhoCorasickMatcher_updateFailStates(self);
+  UnicodeAhoCorasickStream streams[AHOCORASICKUNICODE_MAX_STREAMS];
+  for (guint first = 0; first < n_texts; first += AHOCORASICKUNICODE_MAX_STREAMS) {
+    guint n_streams = MIN(AHOCORASICKUNICODE_MAX_STREAMS, n_texts - first);
+    for (guint i = 0; i < n_streams; ++i) {
+      UnicodeAhoCorasickStream *stream = &streams[i];
+      stream->state = self->start_state;
+      stream->text_begin = texts[first + i];
+      stream->text_iter = texts[first + i];
+      stream->text_end = texts[first + i] + textlens[first + i];
+      stream->index = first + i;
+      stream->entered = FALSE;
+      SCANSTATS_COUNT(&self->stats, n_scans, 1);
+      SCANSTATS_COUNT(&self->stats, n_units, textlens[first + i]);
+    }
+    if (!UnicodeAhoCorasickMatcher_scanStreams(self, streams, n_streams, func, user_data)) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static gboolean
+UnicodeAhoCorasickSlices_report(guint stream, gconstpointer output, gsize end_offset, gpointer user_data)
+{
+  UnicodeAhoCorasickSlices *slices = (UnicodeAhoCorasickSlices *) user_data;
+  gsize end = slices->origins[stream] + end_offset;
+  if (0 < stream && end <= slices->bounds[stream]) {
+    return TRUE;
+  }
+  return slices->func(stream, output, end, slices->user_data);
+}
+
+/**
+ * 1つのテキストを n_slices 個 (1 以上 AHOCORASICKUNICODE_MAX_STREAMS 以下に丸める) の範囲に分けて交互に読み進める
+ * 範囲の境界をまたぐキーワードを見落とさないよう、2つ目以降の範囲は最長のキーワードの長さより 1 短いだけ手前から読み始め、
+ * 重なりで見つけたキーワードのうち前の範囲で報告済みのものは捨てる
+ * func には範囲の番号と、テキスト全体の先頭からのオフセットを渡す。報告の順序は範囲の間で入り混じる
+ */
+gboolean
+UnicodeAhoCorasickMatcher_scanUTF16Sliced(UnicodeAhoCorasickMatcher *self, const gunichar2 *text, gsize textlen, guint n_slices, UnicodeAhoCorasickStreamFunc func, gpointer user_data)
+{
+  n_slices = CLAMP(n_slices, 1, AHOCORASICKUNICODE_MAX_STREAMS);
+  gsize overlap = (0 < self->max_pattern_len) ? self->max_pattern_len - 1 : 0;
+  UnicodeAhoCorasickSlices slices = {{0}, {0}, func, user_data};
+  const gunichar2 *texts[AHOCORASICKUNICODE_MAX_STREAMS];
+  gsize textlens[AHOCORASICKUNICODE_MAX_STREAMS];
+  for (guint i = 0; i < n_slices; ++i) {
+    gsize begin = textlen * i / n_slices;
+    gsize end = textlen * (i + 1) / n_slices;
+    slices.origins[i] = (overlap < begin) ? begin - overlap : 0;
+    slices.bounds[i] = begin;
+    texts[i] = text + slices.origins[i];
+    textlens[i] = end - slices.origins[i];
+  }
+  return UnicodeAhoCorasickMatcher_scanUTF16Interleaved(self, texts, textlens, n_slices, UnicodeAhoCorasickSlices_report, &slices);
+}
+
+static void
+UnicodeAhoCorasickState_memoryUsage(const UnicodeAhoCorasickState *self, MemoryUsage *usage)
+{
+  usage->nodes += sizeof(UnicodeAhoCorasickState);
+  usage->edges += NodeArenaEdges_getAllocatedBytes(&self->next_states);
+  for (guint i = 0; i < self->next_states.size; ++i) {
+    UnicodeAhoCorasickState_memoryUsage((const UnicodeAhoCorasickState *) self->next_states.nodes[i], usage);
+  }
+}
+
 static void
 UnicodeAhoCorasickMatcher_pprintAutomatonImpl(UnicodeAhoCorasickMatcher *self, UnicodeAhoCorasickState *state, gunichar2 condition, int depth, FILE *ostream)
 {
@@ -231,12 +455,8 @@ UnicodeAhoCorasickMatcher_pprintAutomatonImpl(UnicodeAhoCorasickMatcher *self, U
     fprintf(ostream, "output=%p\n", state->output);
   }
 
-  GHashTableIter iter;
-  g_hash_table_iter_init(&iter, state->next_states);
-  gpointer next_condition = NULL;
-  gpointer next_state = NULL;
-  while (g_hash_table_iter_next(&iter, &next_condition, &next_state)) {
-    UnicodeAhoCorasickMatcher_pprintAutomatonImpl(self, (UnicodeAhoCorasickState *) next_state, GPOINTER_TO_INT(next_condition), depth + 1, ostream);
+  for (guint i = 0; i < state->next_states.size; ++i) {
+    UnicodeAhoCorasickMatcher_pprintAutomatonImpl(self, (UnicodeAhoCorasickState *) state->next_states.nodes[i], state->next_states.labels[i], depth + 1, ostream);
   }
 }
 
@@ -244,14 +464,47 @@ void
 UnicodeAhoCorasickMatcher_pprintAutomaton(UnicodeAhoCorasickMatcher *self, FILE *ostream)
 {
   // fail_state を再計算する
-  if (self->need_update) {
-    UnicodeAhoCorasickMatcher_updateFailStateRecursively(self, self->start_state, 0);
-    memset(self->conds_buf, 0, sizeof(gunichar2) * self->max_pattern_len);
-    self->need_update = FALSE;
-  }
+  UnicodeAhoCorasickMatcher_updateFailStates(self);
   UnicodeAhoCorasickMatcher_pprintAutomatonImpl(self, self->start_state, ' ', 0, ostream);
 }
 
+/**
+ * 走査の統計を返す。STRING_MATCHING_STATS を定義せずにビルドしていれば NULL を返す
+ * 遷移はイテレータを進めたときに数えるので、走査の結果を読み終えてから参照する
+ * Aho-Corasick はシフトしないので、照合位置とシフトに関する値は 0 のままになる
+ */
+const ScanStats *
+UnicodeAhoCorasickMatcher_getStats(const UnicodeAhoCorasickMatcher *self)
+{
+#ifdef STRING_MATCHING_STATS
+  return &self->stats;
+#else
+  return NULL;
+#endif
+}
+
+void
+UnicodeAhoCorasickMatcher_resetStats(UnicodeAhoCorasickMatcher *self)
+{
+#ifdef STRING_MATCHING_STATS
+  ScanStats_reset(&self->stats);
+#endif
+}
+
+/**
+ * 確保している領域のバイト数を用途ごとに usage に足し込む
+ * キーワードは複製せずに output として指すだけなので含まない。走査中のイテレータも含まない
+ */
+void
+UnicodeAhoCorasickMatcher_memoryUsage(const UnicodeAhoCorasickMatcher *self, MemoryUsage *usage)
+{
+  MemoryUsage automaton_usage = MEMORYUSAGE_INIT;
+  UnicodeAhoCorasickState_memoryUsage(self->start_state, &automaton_usage);
+  NodeArena_addMemoryUsage(self->arena, &automaton_usage, usage);
+  usage->buffers += sizeof(gunichar2) * self->max_pattern_len;
+  usage->overhead += sizeof(UnicodeAhoCorasickMatcher);
+}
+
 void
 UnicodeAhoCorasickPatternsIter_free(UnicodeAhoCorasickPatternsIter *self)
 {
@@ -272,6 +525,7 @@ UnicodeAhoCorasickPatternsIter_next(UnicodeAhoCorasickPatternsIter *self)
 
   // fail_state を辿っている途中であれば継続する
   while (NULL != current_fail_state) {
+    SCANSTATS_COUNT(self->stats, n_output_steps, 1);
     output = current_fail_state->output;
     current_fail_state = current_fail_state->fail_state;
     if (NULL != output) {
@@ -279,13 +533,15 @@ UnicodeAhoCorasickPatternsIter_next(UnicodeAhoCorasickPatternsIter *self)
     }
   }
   while (text_end != text_iter) {
-    gpointer next_state = g_hash_table_lookup(current_state->next_states, GINT_TO_POINTER(*text_iter));
+    SCANSTATS_COUNT(self->stats, n_compares, 1);
+    gpointer next_state = NodeArenaEdges_lookup(&current_state->next_states, *text_iter);
     if (NULL == next_state) {
       // 遷移先が存在しない
       if (self->start_state == current_state) {
         ++text_iter;
       } else {
         // fail_state に遷移してリトライする
+        SCANSTATS_COUNT(self->stats, n_fail_transitions, 1);
         current_state = current_state->fail_state;
       }
     } else {
@@ -298,6 +554,7 @@ UnicodeAhoCorasickPatternsIter_next(UnicodeAhoCorasickPatternsIter *self)
       }
       // fail_state も満たしていることになるので output の登録を調べる
       while (NULL != current_fail_state) {
+        SCANSTATS_COUNT(self->stats, n_output_steps, 1);
         output = current_fail_state->output;
         current_fail_state = current_fail_state->fail_state;
         if (NULL != output) {
@@ -314,3 +571,13 @@ UnicodeAhoCorasickPatternsIter_next(UnicodeAhoCorasickPatternsIter *self)
   return output;
 }
 
+/**
+ * 直前に UnicodeAhoCorasickPatternsIter_next が返したキーワードの終端位置を返す
+ * 位置はテキスト先頭からの UTF-16 単位のオフセットで、キーワードの末尾の直後を指す
+ */
+gsize
+UnicodeAhoCorasickPatternsIter_getOffset(const UnicodeAhoCorasickPatternsIter *self)
+{
+  return self->text_iter - self->text_begin;
+}
+
@@ -4,6 +4,10 @@
 #include <stdio.h>
 #include <glib.h>
 
+#include "memoryusage.h"
+#include "scanstats.h"
+#include "utf8transcoder.h"
+
 /**
  * 複数パターンを定数時間でスキャン可能な文字列検索アルゴリズム
  */
@@ -23,18 +27,45 @@ typedef enum {
     AHOCORASICKUNICODE_ERROR_TOO_LONG_PATTERN,
 } AhoCorasickUnicodeError;
 
+/**
+ * 同時に進めるテキストの数の上限。これより多いテキストはこの数ずつ順に走査する
+ */
+#define AHOCORASICKUNICODE_MAX_STREAMS 16
+
+/**
+ * キーワードを見つけるたびに呼ばれる関数
+ * end_offset はキーワードの末尾の直後を指す UTF-16 単位のオフセットで、FALSE を返すと走査を打ち切る
+ */
+typedef gboolean (*UnicodeAhoCorasickMatchFunc)(gconstpointer output, gsize end_offset, gpointer user_data);
+
+/**
+ * 複数のテキストを並行して走査するときに、キーワードを見つけるたびに呼ばれる関数
+ * stream は何本目のテキストか、end_offset はキーワードの末尾の直後を指す UTF-16 単位のオフセット
+ * FALSE を返すとすべてのテキストの走査を打ち切る
+ */
+typedef gboolean (*UnicodeAhoCorasickStreamFunc)(guint stream, gconstpointer output, gsize end_offset, gpointer user_data);
+
 extern UnicodeAhoCorasickMatcher *UnicodeAhoCorasickMatcher_new(gsize max_pattern_len);
 extern void UnicodeAhoCorasickMatcher_free(UnicodeAhoCorasickMatcher *self);
 extern gboolean UnicodeAhoCorasickMatcher_addKeywordAsUTF8(UnicodeAhoCorasickMatcher *self, const gchar *pattern, glong pattern_len, GError **error);
 extern gboolean UnicodeAhoCorasickMatcher_addKeywordAsUTF16(UnicodeAhoCorasickMatcher *self, const gunichar2 *pattern, gsize pattern_len, GError **error);
+extern void UnicodeAhoCorasickMatcher_compile(UnicodeAhoCorasickMatcher *self);
 extern gboolean UnicodeAhoCorasickMatcher_scanUTF8String(UnicodeAhoCorasickMatcher *self, const gchar *text, glong textlen, UnicodeAhoCorasickPatternsIter **iter, GError **error);
+extern gboolean UnicodeAhoCorasickMatcher_scanUTF8StringWithBuffer(UnicodeAhoCorasickMatcher *self, const gchar *text, glong textlen, UTF16Buffer *buffer, UnicodeAhoCorasickPatternsIter **iter, GError **error);
 extern void UnicodeAhoCorasickMatcher_scanUTF16String(UnicodeAhoCorasickMatcher *self, const gunichar2 *text, gsize textlen, UnicodeAhoCorasickPatternsIter **iter);
+extern void UnicodeAhoCorasickMatcher_scanAllUTF16String(UnicodeAhoCorasickMatcher *self, const gunichar2 *text, gsize textlen, UnicodeAhoCorasickMatchFunc func, gpointer user_data);
+extern gboolean UnicodeAhoCorasickMatcher_scanUTF16Interleaved(UnicodeAhoCorasickMatcher *self, const gunichar2 *const *texts, const gsize *textlens, guint n_texts, UnicodeAhoCorasickStreamFunc func, gpointer user_data);
+extern gboolean UnicodeAhoCorasickMatcher_scanUTF16Sliced(UnicodeAhoCorasickMatcher *self, const gunichar2 *text, gsize textlen, guint n_slices, UnicodeAhoCorasickStreamFunc func, gpointer user_data);
+extern const ScanStats *UnicodeAhoCorasickMatcher_getStats(const UnicodeAhoCorasickMatcher *self);
+extern void UnicodeAhoCorasickMatcher_resetStats(UnicodeAhoCorasickMatcher *self);
+extern void UnicodeAhoCorasickMatcher_memoryUsage(const UnicodeAhoCorasickMatcher *self, MemoryUsage *usage);
 #ifdef DEBUG
 extern void UnicodeAhoCorasickMatcher_pprintAutomaton(UnicodeAhoCorasickMatcher *self, FILE *ostream);
 #endif
 
 extern void UnicodeAhoCorasickPatternsIter_free(UnicodeAhoCorasickPatternsIter *self);
 extern gconstpointer UnicodeAhoCorasickPatternsIter_next(UnicodeAhoCorasickPatternsIter *self);
+extern gsize UnicodeAhoCorasickPatternsIter_getOffset(const UnicodeAhoCorasickPatternsIter *self);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,359 @@
+#include <string.h>
+#include <glib.h>
+
+#include "approximateunicode.h"
+#include "memoryusage.h"
+#include "utf8transcoder.h"
+
+#define UNICODE_APPROXIMATE_WORD_BITS 64
+#define UNICODE_APPROXIMATE_N_ASCII 128
+#define UNICODE_APPROXIMATE_MIN_TABLE_BITS 3
+
+struct UnicodeApproximateMatcher {
+    UnicodeApproximateMode mode;
+    guint max_distance;
+    gsize patternlen;  /* UTF-16 のコード単位数 */
+    gsize n_words;     /* パターンの1行を表すワード数 */
+    guint64 last_bit;  /* 最後のワードのうち、パターンの末尾に対応するビット */
+    guint32 ascii_rows[UNICODE_APPROXIMATE_N_ASCII]; /* ASCII のコード単位に対応する masks の行 */
+    guint32 *keys;     /* ASCII 以外のコード単位 + 1 を開番地法で並べたハッシュ表。0 は空き */
+    guint32 *key_rows; /* keys と同じ位置に、対応する masks の行を置く */
+    guint table_shift; /* ハッシュ値の上位ビットを表の位置にするためのシフト量 */
+    gsize table_mask;
+    gsize n_rows;
+    guint64 *masks;    /* コード単位ごとに、パターンでそのコード単位が現れる位置のビットを立てた n_words ワードの行 */
+                       /* 行 0 はパターンに現れないコード単位のための、すべて 0 の行 */
+};
+
+static inline gsize
+UnicodeApproximateMatcher_hash(const UnicodeApproximateMatcher *self, gunichar2 unit)
+{
+    return (gsize) (((guint32) unit * 2654435761u) >> self->table_shift);
+}
+
+/**
+ * コード単位に対応する masks の行を返す。パターンに現れないコード単位なら 0 を返す
+ */
+static inline guint32
+UnicodeApproximateMatcher_lookupRow(const UnicodeApproximateMatcher *self, gunichar2 unit)
+{
+    if (UNICODE_APPROXIMATE_N_ASCII > unit) {
+        return self->ascii_rows[unit];
+    }
+    gsize slot = UnicodeApproximateMatcher_hash(self, unit);
+    while (0 != self->keys[slot]) {
+        if ((guint32) unit + 1 == self->keys[slot]) {
+            return self->key_rows[slot];
+        }
+        slot = (slot + 1) & self->table_mask;
+    }
+    return 0;
+}
+
+/**
+ * コード単位の行を返す。まだ行がなければ新しい行を割り当てる
+ */
+static guint32
+UnicodeApproximateMatcher_addRow(UnicodeApproximateMatcher *self, gunichar2 unit)
+{
+    guint32 row = UnicodeApproximateMatcher_lookupRow(self, unit);
+    if (0 != row) {
+        return row;
+    }
+    row = (guint32) self->n_rows++;
+    if (UNICODE_APPROXIMATE_N_ASCII > unit) {
+        self->ascii_rows[unit] = row;
+        return row;
+    }
+    gsize slot = UnicodeApproximateMatcher_hash(self, unit);
+    while (0 != self->keys[slot]) {
+        slot = (slot + 1) & self->table_mask;
+    }
+    self->keys[slot] = (guint32) unit + 1;
+    self->key_rows[slot] = row;
+    return row;
+}
+
+/**
+ * pattern を誤りが max_distance 以下で探すマッチャーを作る
+ * pattern は空でなく、max_distance はパターンのコード単位数より小さくなければならない
+ */
+UnicodeApproximateMatcher *
+UnicodeApproximateMatcher_new(const gunichar2 *pattern, gsize patternlen, UnicodeApproximateMode mode, guint max_distance)
+{
+    g_return_val_if_fail(0 < patternlen && max_distance < patternlen, NULL);
+    UnicodeApproximateMatcher *self = (UnicodeApproximateMatcher *) g_malloc0(sizeof(UnicodeApproximateMatcher));
+    self->mode = mode;
+    self->max_distance = max_distance;
+    self->patternlen = patternlen;
+    self->n_words = (patternlen + UNICODE_APPROXIMATE_WORD_BITS - 1) / UNICODE_APPROXIMATE_WORD_BITS;
+    self->last_bit = G_GUINT64_CONSTANT(1) << ((patternlen - 1) % UNICODE_APPROXIMATE_WORD_BITS);
+
+    /* 表の使用率を半分以下に抑える */
+    guint table_bits = UNICODE_APPROXIMATE_MIN_TABLE_BITS;
+    while (((gsize) 1 << table_bits) < 2 * patternlen) {
+        ++table_bits;
+    }
+    self->table_shift = 32 - table_bits;
+    self->table_mask = ((gsize) 1 << table_bits) - 1;
+    self->keys = g_new0(guint32, self->table_mask + 1);
+    self->key_rows = g_new0(guint32, self->table_mask + 1);
+
+    /* 行の数はパターンの異なるコード単位の数 + 1 を超えない */
+    self->n_rows = 1;
+    self->masks = g_new0(guint64, (patternlen + 1) * self->n_words);
+    for (gsize i = 0; i < patternlen; ++i) {
+        guint32 row = UnicodeApproximateMatcher_addRow(self, pattern[i]);
+        self->masks[row * self->n_words + i / UNICODE_APPROXIMATE_WORD_BITS] |=
+            G_GUINT64_CONSTANT(1) << (i % UNICODE_APPROXIMATE_WORD_BITS);
+    }
+    self->masks = g_renew(guint64, self->masks, self->n_rows * self->n_words);
+    return self;
+}
+
+UnicodeApproximateMatcher *
+UnicodeApproximateMatcher_newFromUTF8(const gchar *pattern, glong length, UnicodeApproximateMode mode, guint max_distance,
+                                      GError **error)
+{
+    UTF16Buffer buffer = UTF16BUFFER_INIT;
+    glong u16len = 0;
+    if (!UTF8Transcoder_toUTF16(pattern, length, &buffer, &u16len, error)) {
+        UTF16Buffer_clear(&buffer);
+        return NULL;
+    }
+    UnicodeApproximateMatcher *self = NULL;
+    if (0 == u16len) {
+        g_set_error_literal(error, UNICODE_APPROXIMATE_ERROR, UNICODE_APPROXIMATE_ERROR_EMPTY_PATTERN,
+                            "Empty pattern");
+    } else if ((gsize) u16len <= max_distance) {
+        g_set_error(error, UNICODE_APPROXIMATE_ERROR, UNICODE_APPROXIMATE_ERROR_INVALID_DISTANCE,
+                    "Maximum distance %u must be smaller than the pattern length %ld", max_distance, u16len);
+    } else {
+        self = UnicodeApproximateMatcher_new(buffer.data, (gsize) u16len, mode, max_distance);
+    }
+    UTF16Buffer_clear(&buffer);
+    return self;
+}
+
+void
+UnicodeApproximateMatcher_free(UnicodeApproximateMatcher *self)
+{
+    g_free(self->masks);
+    g_free(self->key_rows);
+    g_free(self->keys);
+    g_free(self);
+}
+
+gsize
+UnicodeApproximateMatcher_getPatternLength(const UnicodeApproximateMatcher *self)
+{
+    return self->patternlen;
+}
+
+/**
+ * 誤りの数 j ごとのビット列 state[j] は、読んだテキストの末尾とパターンの先頭 i + 1 コード単位が
+ * j 個以下の誤りで一致するとき i 番目のビットが立つ。テキストを読む前の状態を入れる
+ * 編集距離ではパターンの先頭 j コード単位を削除すれば一致するので、下位 j ビットを立てておく
+ */
+static void
+UnicodeApproximateMatcher_initState(const UnicodeApproximateMatcher *self, guint64 *state)
+{
+    memset(state, 0, sizeof(guint64) * (self->max_distance + 1) * self->n_words);
+    if (UNICODE_APPROXIMATE_EDIT_DISTANCE == self->mode) {
+        for (guint j = 1; j <= self->max_distance; ++j) {
+            for (guint i = 0; i < j; ++i) {
+                state[j * self->n_words + i / UNICODE_APPROXIMATE_WORD_BITS] |=
+                    G_GUINT64_CONSTANT(1) << (i % UNICODE_APPROXIMATE_WORD_BITS);
+            }
+        }
+    }
+}
+
+/**
+ * パターンが1ワードに収まる場合の走査
+ * 1コード単位を読むたびに、誤りの少ない行から順に次の式で更新する (R は更新前、R' は更新後の値)
+ *   一致:     ((R[j] << 1) | 1) & mask
+ *   置換:     (R[j-1] << 1) | 1
+ *   挿入:     R[j-1]            (編集距離のみ。テキストのコード単位を読み飛ばす)
+ *   削除:     (R'[j-1] << 1) | 1 (編集距離のみ。パターンのコード単位を読み飛ばす)
+ * 行は誤りの数について単調なので、最後の行の末尾のビットが立っていなければ一致はない
+ */
+static void
+UnicodeApproximateMatcher_scanWord(const UnicodeApproximateMatcher *self, const gunichar2 *text, gsize textlen,
+                                   UnicodeApproximateMatchFunc func, gpointer user_data)
+{
+    const gboolean edit = (UNICODE_APPROXIMATE_EDIT_DISTANCE == self->mode);
+    const guint max_distance = self->max_distance;
+    const guint64 last_bit = self->last_bit;
+    guint64 state[UNICODE_APPROXIMATE_WORD_BITS];
+    UnicodeApproximateMatcher_initState(self, state);
+    for (gsize i = 0; i < textlen; ++i) {
+        const guint64 mask = self->masks[UnicodeApproximateMatcher_lookupRow(self, text[i])];
+        guint64 previous = state[0]; /* 1つ前の行の更新前の値 */
+        state[0] = ((previous << 1) | 1) & mask;
+        for (guint j = 1; j <= max_distance; ++j) {
+            guint64 current = state[j];
+            guint64 next = ((current << 1) | 1) & mask;
+            if (edit) {
+                next |= previous | ((previous | state[j - 1]) << 1) | 1;
+            } else {
+                next |= (previous << 1) | 1;
+            }
+            state[j] = next;
+            previous = current;
+        }
+        if (0 != (state[max_distance] & last_bit)) {
+            guint distance = 0;
+            while (0 == (state[distance] & last_bit)) {
+                ++distance;
+            }
+            if (!func(i + 1, distance, user_data)) {
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * パターンが複数のワードにまたがる場合の走査
+ * UnicodeApproximateMatcher_scanWord と同じ式で、左シフトであふれた最上位ビットを次のワードに繰り上げる
+ */
+static void
+UnicodeApproximateMatcher_scanWords(const UnicodeApproximateMatcher *self, const gunichar2 *text, gsize textlen,
+                                    UnicodeApproximateMatchFunc func, gpointer user_data)
+{
+    const gboolean edit = (UNICODE_APPROXIMATE_EDIT_DISTANCE == self->mode);
+    const guint max_distance = self->max_distance;
+    const gsize n_words = self->n_words;
+    const gsize last_word = n_words - 1;
+    guint64 *state = g_new(guint64, (max_distance + 1) * n_words);
+    guint64 *previous = g_new(guint64, n_words); /* 1つ前の行の更新前の値 */
+    UnicodeApproximateMatcher_initState(self, state);
+    for (gsize i = 0; i < textlen; ++i) {
+        const guint64 *mask = self->masks + UnicodeApproximateMatcher_lookupRow(self, text[i]) * n_words;
+        for (guint j = 0; j <= max_distance; ++j) {
+            guint64 *row = state + j * n_words;
+            const guint64 *above = row - n_words; /* 更新済みの1つ前の行 */
+            guint64 carry = 1;
+            guint64 error_carry = 1;
+            for (gsize w = 0; w < n_words; ++w) {
+                guint64 current = row[w];
+                guint64 next = ((current << 1) | carry) & mask[w];
+                carry = current >> (UNICODE_APPROXIMATE_WORD_BITS - 1);
+                if (0 < j) {
+                    guint64 advanced = edit ? (previous[w] | above[w]) : previous[w];
+                    next |= (advanced << 1) | error_carry;
+                    error_carry = advanced >> (UNICODE_APPROXIMATE_WORD_BITS - 1);
+                    if (edit) {
+                        next |= previous[w];
+                    }
+                }
+                previous[w] = current;
+                row[w] = next;
+            }
+        }
+        if (0 != (state[max_distance * n_words + last_word] & self->last_bit)) {
+            guint distance = 0;
+            while (0 == (state[distance * n_words + last_word] & self->last_bit)) {
+                ++distance;
+            }
+            if (!func(i + 1, distance, user_data)) {
+                break;
+            }
+        }
+    }
+    g_free(previous);
+    g_free(state);
+}
+
+/**
+ * テキストを先頭から走査し、誤りが max_distance 以下で一致した範囲の末尾を順に報告する
+ */
+void
+UnicodeApproximateMatcher_scanUTF16String(const UnicodeApproximateMatcher *self, const gunichar2 *text, gsize textlen,
+                                          UnicodeApproximateMatchFunc func, gpointer user_data)
+{
+    if (1 == self->n_words) {
+        UnicodeApproximateMatcher_scanWord(self, text, textlen, func, user_data);
+    } else {
+        UnicodeApproximateMatcher_scanWords(self, text, textlen, func, user_data);
+    }
+}
+
+typedef struct UnicodeApproximateUTF8Context {
+    const guchar *text;
+    const gunichar2 *u16text;
+    gsize byte_offset; /* u16_offset と同じ位置のバイトオフセット */
+    gsize u16_offset;
+    UnicodeApproximateMatchFunc func;
+    gpointer user_data;
+} UnicodeApproximateUTF8Context;
+
+/**
+ * UTF-16 のオフセットをバイトオフセットに直して報告する
+ * 報告は末尾の順に来るので、前回の位置から先頭バイトで文字の長さを求めて進めるだけで済む
+ */
+static gboolean
+UnicodeApproximateMatcher_reportUTF8Match(gsize end_offset, guint distance, gpointer user_data)
+{
+    UnicodeApproximateUTF8Context *context = (UnicodeApproximateUTF8Context *) user_data;
+    /* サロゲートペアの間で終わる範囲はバイトオフセットで表せないので報告しない */
+    gunichar2 last = context->u16text[end_offset - 1];
+    if (0xD800 <= last && 0xDBFF >= last) {
+        return TRUE;
+    }
+    while (context->u16_offset < end_offset) {
+        guchar lead = context->text[context->byte_offset];
+        if (0x80 > lead) {
+            context->byte_offset += 1;
+            context->u16_offset += 1;
+        } else if (0xE0 > lead) {
+            context->byte_offset += 2;
+            context->u16_offset += 1;
+        } else if (0xF0 > lead) {
+            context->byte_offset += 3;
+            context->u16_offset += 1;
+        } else {
+            context->byte_offset += 4;
+            context->u16_offset += 2;
+        }
+    }
+    return context->func(context->byte_offset, distance, context->user_data);
+}
+
+/**
+ * UTF-8 のテキストを buffer に UTF-16 として変換してから走査し、一致した範囲の末尾をバイトオフセットで報告する
+ * textlen が負の場合は NUL 終端とみなす
+ */
+gboolean
+UnicodeApproximateMatcher_scanUTF8StringWithBuffer(const UnicodeApproximateMatcher *self, const gchar *text, glong textlen,
+                                                   UTF16Buffer *buffer, UnicodeApproximateMatchFunc func, gpointer user_data,
+                                                   GError **error)
+{
+    glong u16len = 0;
+    if (!UTF8Transcoder_toUTF16(text, textlen, buffer, &u16len, error)) {
+        return FALSE;
+    }
+    UnicodeApproximateUTF8Context context = {(const guchar *) text, buffer->data, 0, 0, func, user_data};
+    UnicodeApproximateMatcher_scanUTF16String(self, buffer->data, (gsize) u16len, UnicodeApproximateMatcher_reportUTF8Match,
+                                              &context);
+    return TRUE;
+}
+
+gboolean
+UnicodeApproximateMatcher_scanUTF8String(const UnicodeApproximateMatcher *self, const gchar *text, glong textlen,
+                                         UnicodeApproximateMatchFunc func, gpointer user_data, GError **error)
+{
+    UTF16Buffer buffer = UTF16BUFFER_INIT;
+    gboolean retval = UnicodeApproximateMatcher_scanUTF8StringWithBuffer(self, text, textlen, &buffer, func, user_data,
+                                                                         error);
+    UTF16Buffer_clear(&buffer);
+    return retval;
+}
+
+void
+UnicodeApproximateMatcher_memoryUsage(const UnicodeApproximateMatcher *self, MemoryUsage *usage)
+{
+    usage->shift_tables += sizeof(guint64) * self->n_rows * self->n_words;
+    usage->overhead += sizeof(UnicodeApproximateMatcher) + 2 * sizeof(guint32) * (self->table_mask + 1);
+}
@@ -0,0 +1,65 @@
+// 誤りを k 個まで許して UTF-16 のパターンを探す、ビット並列 (Wu-Manber の Shift-And) の近似照合
+// パターンの各位置を1ビットに対応させ、許した誤りの数ごとのビット列を1コード単位ごとに更新する
+// 64 コード単位までのパターンは1ワードで、それより長いパターンは複数のワードに分けて計算する
+//
+// 誤りの数え方:
+//   UNICODE_APPROXIMATE_MISMATCHES    置換だけを数える (ハミング距離)。一致した範囲の長さはパターンと同じ
+//   UNICODE_APPROXIMATE_EDIT_DISTANCE 置換・挿入・削除を数える (編集距離)
+// サロゲートペアは2つのコード単位として数えるので、BMP 外の文字の置換は2つの誤りになる
+
+#ifndef __APPROXIMATEUNICODE_H__
+#define __APPROXIMATEUNICODE_H__
+
+#include <glib.h>
+
+#include "memoryusage.h"
+#include "utf8transcoder.h"
+
+struct UnicodeApproximateMatcher;
+typedef struct UnicodeApproximateMatcher UnicodeApproximateMatcher;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UNICODE_APPROXIMATE_ERROR (g_quark_from_static_string("unicode-approximate-error-quark"))
+
+typedef enum {
+    UNICODE_APPROXIMATE_ERROR_EMPTY_PATTERN,
+    UNICODE_APPROXIMATE_ERROR_INVALID_DISTANCE,
+} UnicodeApproximateError;
+
+typedef enum {
+    UNICODE_APPROXIMATE_MISMATCHES,
+    UNICODE_APPROXIMATE_EDIT_DISTANCE,
+} UnicodeApproximateMode;
+
+/**
+ * 誤りが max_distance 以下で一致した範囲の末尾ごとに呼ばれる関数
+ * end_offset は一致した範囲の末尾の直後を指すオフセットで、UTF-16 の走査ではコード単位、UTF-8 の走査ではバイトで数える
+ * distance はその位置で終わる範囲の誤りの数の最小値で、FALSE を返すと走査を打ち切る
+ */
+typedef gboolean (*UnicodeApproximateMatchFunc)(gsize end_offset, guint distance, gpointer user_data);
+
+extern UnicodeApproximateMatcher *UnicodeApproximateMatcher_new(const gunichar2 *pattern, gsize patternlen,
+                                                                UnicodeApproximateMode mode, guint max_distance);
+extern UnicodeApproximateMatcher *UnicodeApproximateMatcher_newFromUTF8(const gchar *pattern, glong length,
+                                                                        UnicodeApproximateMode mode, guint max_distance,
+                                                                        GError **error);
+extern void UnicodeApproximateMatcher_free(UnicodeApproximateMatcher *self);
+extern gsize UnicodeApproximateMatcher_getPatternLength(const UnicodeApproximateMatcher *self);
+extern void UnicodeApproximateMatcher_scanUTF16String(const UnicodeApproximateMatcher *self, const gunichar2 *text, gsize textlen,
+                                                      UnicodeApproximateMatchFunc func, gpointer user_data);
+extern gboolean UnicodeApproximateMatcher_scanUTF8String(const UnicodeApproximateMatcher *self, const gchar *text, glong textlen,
+                                                         UnicodeApproximateMatchFunc func, gpointer user_data, GError **error);
+extern gboolean UnicodeApproximateMatcher_scanUTF8StringWithBuffer(const UnicodeApproximateMatcher *self, const gchar *text,
+                                                                   glong textlen, UTF16Buffer *buffer,
+                                                                   UnicodeApproximateMatchFunc func, gpointer user_data,
+                                                                   GError **error);
+extern void UnicodeApproximateMatcher_memoryUsage(const UnicodeApproximateMatcher *self, MemoryUsage *usage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __APPROXIMATEUNICODE_H__
@@ -2,11 +2,17 @@
 #include <string.h>
 #include <glib.h>
 
+#include "memoryusage.h"
+#include "scanstats.h"
+
 typedef struct BoyerMooreMatcher {
     const gchar *pat;
     guint16 patlen;
     guint16 bcshifts[G_MAXUINT8];
     guint16 *gsshifts;
+#ifdef STRING_MATCHING_STATS
+    ScanStats stats;
+#endif
 } BoyerMooreMatcher;
 
 static void
@@ -82,14 +88,18 @@ BoyerMooreMatcher_scan(BoyerMooreMatcher *self, const gchar *string) {
     int totalshift = 0;
     int patlen = self->patlen;
     int stringlen = strlen(string);
+    SCANSTATS_COUNT(&self->stats, n_scans, 1);
+    SCANSTATS_COUNT(&self->stats, n_units, stringlen);
     while (TRUE) {
         if (totalshift + patlen > stringlen) {
             break;
         }
         /* check matching */
+        SCANSTATS_COUNT(&self->stats, n_alignments, 1);
         gboolean match = TRUE;
         int j;
         for (j = patlen - 1; j >= 0; --j) {
+            SCANSTATS_COUNT(&self->stats, n_compares, 1);
             if (string[totalshift + j] != self->pat[j]) {
                 match = FALSE;
                 break;
@@ -101,8 +111,41 @@ BoyerMooreMatcher_scan(BoyerMooreMatcher *self, const gchar *string) {
             gchar key = *(string + totalshift + j);
             int shift = j + 1 - patlen + MAX(self->bcshifts[(guchar) key], self->gsshifts[j]);
             shift = MAX(shift, 1);
+            SCANSTATS_SHIFT(&self->stats,
+                            (self->bcshifts[(guchar) key] >= self->gsshifts[j])
+                                ? SCANSTATS_RULE_BAD_CHARACTER : SCANSTATS_RULE_GOOD_SUFFIX,
+                            shift, patlen - j);
             totalshift += shift;
         }
     }
     return FALSE;
 }
+
+/**
+ * 走査の統計を返す。STRING_MATCHING_STATS を定義せずにビルドしていれば NULL を返す
+ */
+const ScanStats *
+BoyerMooreMatcher_getStats(const BoyerMooreMatcher *self) {
+#ifdef STRING_MATCHING_STATS
+    return &self->stats;
+#else
+    return NULL;
+#endif
+}
+
+void
+BoyerMooreMatcher_resetStats(BoyerMooreMatcher *self) {
+#ifdef STRING_MATCHING_STATS
+    ScanStats_reset(&self->stats);
+#endif
+}
+
+/**
+ * 確保している領域のバイト数を用途ごとに usage に足し込む
+ * パターンは複製せずに指すだけなので含まない
+ */
+void
+BoyerMooreMatcher_memoryUsage(const BoyerMooreMatcher *self, MemoryUsage *usage) {
+    usage->shift_tables += sizeof(self->bcshifts) + sizeof(guint16) * self->patlen;
+    usage->overhead += sizeof(BoyerMooreMatcher) - sizeof(self->bcshifts);
+}
@@ -3,6 +3,9 @@
 
 #include <glib.h>
 
+#include "memoryusage.h"
+#include "scanstats.h"
+
 struct BoyerMooreMatcher;
 typedef struct BoyerMooreMatcher BoyerMooreMatcher;
 
@@ -10,5 +13,8 @@ extern BoyerMooreMatcher * BoyerMooreMatcher_new(const gchar *pat);
 extern void BoyerMooreMatcher_free(BoyerMooreMatcher *self);
 extern void BoyerMooreMatcher_updatePattern(BoyerMooreMatcher *self, const gchar *pat);
 extern gboolean BoyerMooreMatcher_scan(BoyerMooreMatcher *self, const gchar *string, gboolean verbose);
+extern const ScanStats *BoyerMooreMatcher_getStats(const BoyerMooreMatcher *self);
+extern void BoyerMooreMatcher_resetStats(BoyerMooreMatcher *self);
+extern void BoyerMooreMatcher_memoryUsage(const BoyerMooreMatcher *self, MemoryUsage *usage);
 
 #endif // __BOYERMOORE_H__
@@ -3,18 +3,69 @@
 #include <glib.h>
 
 #include "boyermooreunicode.h"
+#include "memoryusage.h"
+#include "scanstats.h"
+#include "utf8transcoder.h"
 
-#define CHANNEL_READ_COUNT (4096)
+#define DEFAULT_CHANNEL_BUFFER_SIZE (256 * 1024)
+
+#define BCTABLE_MIN_BITS (4) /* bctable の最小要素数の log2 */
 
 struct UnicodeBoyerMooreMatcher {
     gunichar2 *pattern;
     gsize patternlen;
-    guint16 bctable[0x10000]; /* bad character ruleに基づくシフト量テーブル */
+    guint32 *bctable;         /* bad character ruleに基づくシフト量テーブル (パターン中の文字だけを持つハッシュ表) */
+    guint bctable_bits;       /* bctable の要素数の log2 */
     guint16 *gstable;         /* good suffix ruleに基づくシフト量テーブル */
+    gchar *u8pattern;         /* UTF-8 テキストをバイト単位で照合するためのパターン文字列 */
+    gsize u8patternlen;
+    gsize u8bctable[0x100];   /* u8pattern の bad character rule (Horspool) に基づくシフト量テーブル */
     gchar *channelbuf;
-    gunichar2 *textque;
+    gsize channelbufsize;
+#ifdef STRING_MATCHING_STATS
+    ScanStats stats;
+#endif
 };
 
+/* bctable は線形探査のハッシュ表で、各要素は上位16ビットが文字、下位16ビットがシフト量+1 を表す
+ * 0 の要素は空きで、そこで探索が終わった文字はパターンに含まれない */
+
+static inline guint
+UnicodeBoyerMooreMatcher_hashBadChar(const UnicodeBoyerMooreMatcher *self, gunichar2 c)
+{
+    return ((guint32) c * 2654435761u) >> (32 - self->bctable_bits);
+}
+
+static void
+UnicodeBoyerMooreMatcher_setBadCharShift(UnicodeBoyerMooreMatcher *self, gunichar2 c, guint16 shift)
+{
+    const guint mask = (1u << self->bctable_bits) - 1;
+    guint i = UnicodeBoyerMooreMatcher_hashBadChar(self, c);
+    /* 同じ文字が既に登録されていれば、より右側の出現位置に基づくシフト量で上書きする */
+    while (0 != self->bctable[i] && c != (self->bctable[i] >> 16)) {
+        i = (i + 1) & mask;
+    }
+    self->bctable[i] = ((guint32) c << 16) | (guint32) (shift + 1);
+}
+
+static inline gint
+UnicodeBoyerMooreMatcher_getBadCharShift(const UnicodeBoyerMooreMatcher *self, gunichar2 c)
+{
+    const guint mask = (1u << self->bctable_bits) - 1;
+    guint i = UnicodeBoyerMooreMatcher_hashBadChar(self, c);
+    while (TRUE) {
+        guint32 entry = self->bctable[i];
+        if (0 == entry) {
+            /* パターンに含まれない文字 */
+            return self->patternlen;
+        }
+        if (c == (entry >> 16)) {
+            return (entry & 0xFFFF) - 1;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
 /**
  * パターン文字列は UTF-16 に変換されていることを想定している
  */
@@ -27,20 +78,23 @@ UnicodeBoyerMooreMatcher_new(const gunichar2 *pattern, gsize patternlen)
     self->pattern = (gunichar2 *) g_malloc(sizeof(gunichar2) * patternlen);
     memcpy(self->pattern, pattern, sizeof(gunichar2) * patternlen);
     self->patternlen = patternlen;
-    memset(self->bctable, 0, sizeof(guint16) * 0x10000);
     self->gstable = (guint16 *) g_malloc(sizeof(guint16) * patternlen);
     memset(self->gstable, 0, sizeof(guint16) * patternlen);
     /* テキストチャネルの検査でしか必要ないバッファなので遅延確保することにする */
     self->channelbuf = NULL;
-    self->textque = (gunichar2 *) g_malloc(sizeof(gunichar2) * patternlen);
+    self->channelbufsize = DEFAULT_CHANNEL_BUFFER_SIZE;
 
-    /* bad character ruleに基づいて、シフト量を計算する */
+    /* bad character ruleに基づいて、シフト量を計算する
+     * 全文字分の表を作るとパターン長に関係なく 128KB の初期化が必要になるので、
+     * パターン中の文字だけを負荷率 1/2 以下のハッシュ表に登録し、それ以外はパターン長とする */
     g_assert(patternlen <= G_MAXUINT16);
-    for (guint i = 0; i < 0x10000; ++i) {
-        self->bctable[i] = patternlen;
+    self->bctable_bits = BCTABLE_MIN_BITS;
+    while (((gsize) 1 << self->bctable_bits) < patternlen * 2) {
+        ++self->bctable_bits;
     }
+    self->bctable = (guint32 *) g_malloc0(sizeof(guint32) << self->bctable_bits);
     for (guint i = 0; i < patternlen; ++i) {
-        self->bctable[pattern[i]] = patternlen - i - 1;
+        UnicodeBoyerMooreMatcher_setBadCharShift(self, pattern[i], patternlen - i - 1);
     }
 
     /* good suffix ruleに基づいて、シフト量を計算する */
@@ -66,6 +120,24 @@ UnicodeBoyerMooreMatcher_new(const gunichar2 *pattern, gsize patternlen)
         }
     }
 
+    /* UTF-8 テキストを文字単位に復号せずに照合できるように、
+     * パターン文字列を UTF-8 に変換して Horspool のシフト量を計算しておく */
+    glong u8patternlen = 0L;
+    self->u8pattern = g_utf16_to_utf8(pattern, patternlen, NULL, &u8patternlen, NULL);
+    if (NULL == self->u8pattern) {
+        /* 対になっていないサロゲートを含むパターンは UTF-8 に変換できず、正しい UTF-8 のテキストにも現れない
+         * 空のパターンとして扱い、UTF-8 の走査では常に不一致とする。UTF-16 の走査はそのまま照合する */
+        self->u8pattern = g_strdup("");
+        u8patternlen = 0L;
+    }
+    self->u8patternlen = u8patternlen;
+    for (guint i = 0; i < G_N_ELEMENTS(self->u8bctable); ++i) {
+        self->u8bctable[i] = self->u8patternlen;
+    }
+    for (gsize i = 0; i + 1 < self->u8patternlen; ++i) {
+        self->u8bctable[(guchar) self->u8pattern[i]] = self->u8patternlen - i - 1;
+    }
+
     return self;
 }
 
@@ -75,9 +147,10 @@ UnicodeBoyerMooreMatcher_free(UnicodeBoyerMooreMatcher *self)
     if (self == NULL) {
         return;
     }
-    g_free(self->textque);
     g_free(self->channelbuf);
+    g_free(self->u8pattern);
     g_free(self->gstable);
+    g_free(self->bctable);
     g_free(self->pattern);
     g_free(self);
 }
@@ -94,57 +167,49 @@ UnicodeBoyerMooreMatcher_getPatternLength(UnicodeBoyerMooreMatcher *self)
     return self->patternlen;
 }
 
-static void
-UnicodeBoyerMooreMatcher_scanUTF8TextImpl(UnicodeBoyerMooreMatcher *self, const gchar *text,
-                                                gsize textlen, gboolean *match)
+/**
+ * UTF-8 テキストをバイト列のまま Horspool 法で照合し、パターンが最初に現れる位置を返す
+ * UTF-8 は自己同期的な符号なので、バイト列として一致した候補に対しては
+ * 末尾が文字境界になっているかだけを確認すればよい
+ */
+static const gchar *
+UnicodeBoyerMooreMatcher_findUTF8TextImpl(UnicodeBoyerMooreMatcher *self, const gchar *text, gsize textlen)
 {
-    g_assert(NULL != match);
-
-    /* テキスト長が0の場合は不一致とする */
-    if (textlen == 0) {
-        *match = FALSE;
-        return;
+    const guchar *p = (const guchar *) self->u8pattern;
+    const gsize plen = self->u8patternlen;
+    SCANSTATS_COUNT(&self->stats, n_scans, 1);
+    SCANSTATS_COUNT(&self->stats, n_units, textlen);
+    /* テキスト長がパターン長に満たない場合は不一致とする */
+    if (textlen < plen || 0 == plen) {
+        return NULL;
     }
-    const gunichar2 *p = self->pattern;
-    const gchar *t = text;
-    while (TRUE) {
-        /* キューの文字列と完全一致するか確認する */
-        gint i = self->patternlen - 1;
-        const gunichar2 *pp = p + i;
-        const gchar *tt = t;
-        for (int i=0; i<self->patternlen - 1; ++i) {
-            tt = g_utf8_next_char(tt);
-        }
-        gunichar2 tchar;
-        for (; pp >= p; --pp) {
-            tchar = g_utf8_get_char(tt);
-            if (*pp != tchar) {
-                break;
-            }
-            tt = g_utf8_prev_char(tt);
-        }
-        if (pp < p) {
-            *match = TRUE;
-            return;
-        }
-
-        /* シフト量を取得する */
-        gint bcshift = self->bctable[tchar];
-        gint gsshift = self->gstable[pp - p];
-        gint shift = (pp - p) - self->patternlen + 1 + MAX(bcshift, gsshift);
-        if (shift <= 0) {
-            shift = 1;
-        }
-
-        /* キューの文字列を入れ替える */
-        for (int i=0; i<shift; ++i) {
-            t = g_utf8_next_char(t);
-            if ('\0' == *t) {
-                *match = FALSE;
-                return;
+    const guchar plast = p[plen - 1];
+    const guchar *t = (const guchar *) text;
+    const guchar *const tend = t + textlen;
+    const guchar *const tlast = tend - plen;
+    while (t <= tlast) {
+        guchar tchar = t[plen - 1];
+        /* memcmp が比較した長さは分からないので、末尾のバイトが一致すればパターン全体を比較したとみなす */
+        SCANSTATS_COUNT(&self->stats, n_alignments, 1);
+        SCANSTATS_COUNT(&self->stats, n_compares, (tchar == plast) ? plen : 1);
+        if (tchar == plast && 0 == memcmp(t, p, plen - 1)) {
+            /* 候補が見つかったときだけ文字境界を確認する */
+            if (t + plen == tend || 0x80 != (t[plen] & 0xC0)) {
+                return (const gchar *) t;
             }
         }
+        SCANSTATS_SHIFT(&self->stats, SCANSTATS_RULE_BAD_CHARACTER, self->u8bctable[tchar], (tchar == plast) ? plen : 1);
+        t += self->u8bctable[tchar];
     }
+    return NULL;
+}
+
+static void
+UnicodeBoyerMooreMatcher_scanUTF8TextImpl(UnicodeBoyerMooreMatcher *self, const gchar *text,
+                                                gsize textlen, gboolean *match)
+{
+    g_assert(NULL != match);
+    *match = (NULL != UnicodeBoyerMooreMatcher_findUTF8TextImpl(self, text, textlen));
 }
 
 /**
@@ -153,13 +218,57 @@ UnicodeBoyerMooreMatcher_scanUTF8TextImpl(UnicodeBoyerMooreMatcher *self, const
  */
 gboolean
 UnicodeBoyerMooreMatcher_scanUTF8String(UnicodeBoyerMooreMatcher *self, const gchar *text,
-                                             gsize textlen, gboolean *match, GError **error)
+                                             glong textlen, gboolean *match, GError **error)
 {
     g_assert(NULL != match);
+    if (0L > textlen) {
+        textlen = strlen(text);
+    }
     UnicodeBoyerMooreMatcher_scanUTF8TextImpl(self, text, textlen, match);
     return TRUE;
 }
 
+/**
+ * パターン文字列が UTF-8 テキストに最初に現れる位置を返し、見つからなければ NULL を返す
+ */
+const gchar *
+UnicodeBoyerMooreMatcher_findUTF8String(UnicodeBoyerMooreMatcher *self, const gchar *text, glong textlen)
+{
+    if (0L > textlen) {
+        textlen = strlen(text);
+    }
+    return UnicodeBoyerMooreMatcher_findUTF8TextImpl(self, text, textlen);
+}
+
+/**
+ * チャネルの読み出しに使うバッファの大きさを設定する
+ * 読み出し回数を減らすため、既定値は DEFAULT_CHANNEL_BUFFER_SIZE としている
+ */
+void
+UnicodeBoyerMooreMatcher_setChannelBufferSize(UnicodeBoyerMooreMatcher *self, gsize size)
+{
+    self->channelbufsize = size;
+    /* 次回のチャネル検査で確保し直す */
+    g_free(self->channelbuf);
+    self->channelbuf = NULL;
+}
+
+static void
+UnicodeBoyerMooreMatcher_prepareChannelBuffer(UnicodeBoyerMooreMatcher *self)
+{
+    if (NULL != self->channelbuf) {
+        return;
+    }
+    /* 読み出し範囲をまたぐ一致を検出するために前回の末尾を持ち越すので、
+     * 持ち越し分に加えて十分な読み出し領域が残る大きさを確保する
+     * UTF-16 の走査は 2 * (patternlen - 1) バイトを持ち越すので、UTF-8 に変換できず u8patternlen が 0 でも足りるようにする */
+    gsize minsize = 4 * (MAX(self->u8patternlen, 2 * self->patternlen) + 4);
+    if (self->channelbufsize < minsize) {
+        self->channelbufsize = minsize;
+    }
+    self->channelbuf = (gchar *) g_malloc(sizeof(gchar) * self->channelbufsize);
+}
+
 /**
  * パターン文字列がチャネル内の UTF-8 テキストに含まれるかを検査する
  * 検査結果を match に代入する
@@ -170,20 +279,22 @@ UnicodeBoyerMooreMatcher_scanUTF8Channel(UnicodeBoyerMooreMatcher *self, GIOChan
 {
     g_assert(NULL != match);
 
-    if (self->channelbuf == NULL) {
-        self->channelbuf = (gchar *) g_malloc(sizeof(gchar) * CHANNEL_READ_COUNT);
+    *match = FALSE;
+    if (0 == self->u8patternlen) {
+        /* 空のパターンは findUTF8TextImpl と同じく不一致とし、持ち越す長さも求められないので読み出さない */
+        return TRUE;
     }
-    memset(self->textque, 0xFF, sizeof(gunichar2) * self->patternlen);
+    UnicodeBoyerMooreMatcher_prepareChannelBuffer(self);
 
     gchar *bufhead = self->channelbuf;
-    gchar *buftail = self->channelbuf + CHANNEL_READ_COUNT;
+    gchar *buftail = self->channelbuf + self->channelbufsize;
     gchar *readtail = bufhead;
 
     while (TRUE) {
         /* チャネル内のテキストをバッファに読み出す */
         gsize bytes_read = 0;
         GError *read_error = NULL;
-        gboolean read_stat =
+        GIOStatus read_stat =
             g_io_channel_read_chars(text, readtail, buftail - readtail, &bytes_read, &read_error);
         if (G_IO_STATUS_ERROR == read_stat) {
             g_propagate_error(error, read_error);
@@ -199,25 +310,28 @@ UnicodeBoyerMooreMatcher_scanUTF8Channel(UnicodeBoyerMooreMatcher *self, GIOChan
         /* bufhead の全バイトが有効なら TRUE を返すが、
          * 中途半端な切れ方をしている可能性があるので、返値は参考にしない */
         const gchar *validtail = bufhead;
-        (void) g_utf8_validate(bufhead, readtail - bufhead, &validtail);
+        (void) UTF8Transcoder_validate(bufhead, readtail - bufhead, &validtail);
         if (bufhead >= validtail) {
             /* 有効な文字が1文字も含まれていない */
             break;
         }
 
-        /* チャネルから取り出した範囲で、検索文字列を照合する
-         * なお、今回取り出した範囲と次回取り出す範囲にまたがる部分を比較するために、
-         * textque はクリアしてはいけない */
+        /* チャネルから取り出した範囲で、検索文字列を照合する */
         UnicodeBoyerMooreMatcher_scanUTF8TextImpl(self, bufhead, validtail - bufhead, match);
         if (*match) {
             break;
         }
 
-        /* バッファの状態とアドレス情報を再設定 */
-        ptrdiff_t leftlen = readtail - validtail;
+        /* 今回取り出した範囲と次回取り出す範囲にまたがる部分を比較するために、
+         * 照合済み範囲の末尾 u8patternlen - 1 バイトを文字境界に揃えて次回に持ち越す */
+        const gchar *carryhead = validtail - MIN((gsize) (validtail - bufhead), self->u8patternlen - 1);
+        while (carryhead < validtail && 0x80 == (*carryhead & 0xC0)) {
+            ++carryhead;
+        }
+        ptrdiff_t leftlen = readtail - carryhead;
         g_assert(leftlen >= 0);
         if (leftlen != 0) {
-            g_memmove(bufhead, validtail, leftlen);
+            g_memmove(bufhead, carryhead, leftlen);
         }
         readtail = bufhead + leftlen;
     }
@@ -225,27 +339,55 @@ UnicodeBoyerMooreMatcher_scanUTF8Channel(UnicodeBoyerMooreMatcher *self, GIOChan
     return TRUE;
 }
 
+/**
+ * パターン文字列が UTF-8 テキストファイルに含まれるかを検査する
+ * ファイルはメモリマップして直接照合するので、読み出しのコピーは発生しない
+ * また、バイト単位で照合するので UTF-8 としての検証は行わない
+ * 検査結果を match に代入する
+ */
+gboolean
+UnicodeBoyerMooreMatcher_scanUTF8File(UnicodeBoyerMooreMatcher *self, const gchar *filename,
+                                           gboolean *match, GError **error)
+{
+    g_assert(NULL != match);
+
+    GError *map_error = NULL;
+    GMappedFile *mapped_file = g_mapped_file_new(filename, FALSE, &map_error);
+    if (NULL == mapped_file) {
+        g_propagate_error(error, map_error);
+        return FALSE;
+    }
+    UnicodeBoyerMooreMatcher_scanUTF8TextImpl(self, g_mapped_file_get_contents(mapped_file),
+                                                    g_mapped_file_get_length(mapped_file), match);
+    g_mapped_file_unref(mapped_file);
+    return TRUE;
+}
+
 static void
 UnicodeBoyerMooreMatcher_scanUTF16StringImpl(UnicodeBoyerMooreMatcher *self, const gunichar2 *text,
                                                    gsize textlen, gboolean *match)
 {
     g_assert(NULL != match);
+    SCANSTATS_COUNT(&self->stats, n_scans, 1);
+    SCANSTATS_COUNT(&self->stats, n_units, textlen);
 
-    /* テキスト長が0の場合は不一致とする */
-    if (textlen == 0) {
+    /* テキスト長がパターン長に満たない場合は不一致とする */
+    if (textlen < self->patternlen) {
         *match = FALSE;
         return;
     }
 
     const gunichar2 *p = self->pattern;
     const gunichar2 *t = text;
-    const gunichar2 *tend = text + textlen;
+    const gunichar2 *tlast = text + textlen - self->patternlen;
     while (TRUE) {
         /* キューの文字列と完全一致するか確認する */
         gint i = self->patternlen - 1;
         const gunichar2 *pp = p + i;
         const gunichar2 *tt = t + i;
+        SCANSTATS_COUNT(&self->stats, n_alignments, 1);
         for (; pp >= p; --pp, --tt) {
+            SCANSTATS_COUNT(&self->stats, n_compares, 1);
             if (*pp != *tt) {
                 break;
             }
@@ -256,16 +398,19 @@ UnicodeBoyerMooreMatcher_scanUTF16StringImpl(UnicodeBoyerMooreMatcher *self, con
         }
 
         /* シフト量を取得する */
-        gint bcshift = self->bctable[*tt];
+        gint bcshift = UnicodeBoyerMooreMatcher_getBadCharShift(self, *tt);
         gint gsshift = self->gstable[pp - p];
         gint shift = (pp - p) - self->patternlen + 1 + MAX(bcshift, gsshift);
         if (shift <= 0) {
             shift = 1;
         }
+        SCANSTATS_SHIFT(&self->stats,
+                        (bcshift >= gsshift) ? SCANSTATS_RULE_BAD_CHARACTER : SCANSTATS_RULE_GOOD_SUFFIX,
+                        shift, self->patternlen - (pp - p));
 
         /* キューの文字列を入れ替える */
         t += shift;
-        if (t >= tend) {
+        if (t > tlast) {
             *match = FALSE;
             return;
         }
@@ -282,7 +427,6 @@ UnicodeBoyerMooreMatcher_scanUTF16String(UnicodeBoyerMooreMatcher *self, const g
 {
     g_assert(NULL != match);
 
-    memset(self->textque, 0xFF, sizeof(gunichar2) * self->patternlen);
     UnicodeBoyerMooreMatcher_scanUTF16StringImpl(self, text, textlen, match);
 }
 
@@ -296,36 +440,86 @@ UnicodeBoyerMooreMatcher_scanUTF16Channel(UnicodeBoyerMooreMatcher *self, GIOCha
 {
     g_assert(NULL != match);
 
-    if (NULL == self->channelbuf) {
-        self->channelbuf = (gchar *) g_malloc(sizeof(gchar) * CHANNEL_READ_COUNT);
-    }
-    memset(self->textque, 0xFF, sizeof(gunichar2) * self->patternlen);
+    *match = FALSE;
+    UnicodeBoyerMooreMatcher_prepareChannelBuffer(self);
+
+    gchar *bufhead = self->channelbuf;
+    gchar *buftail = self->channelbuf + self->channelbufsize;
+    gchar *readtail = bufhead;
 
     while (TRUE) {
         /* チャネル内のテキストをバッファに読み出す */
-        G_STATIC_ASSERT(0 == CHANNEL_READ_COUNT % 2);
-        gsize valid_size = 0;
+        gsize bytes_read = 0;
         GError *read_error = NULL;
-        gboolean read_stat =
-            g_io_channel_read_chars(text, self->channelbuf, CHANNEL_READ_COUNT, &valid_size,
-                                    &read_error);
+        GIOStatus read_stat =
+            g_io_channel_read_chars(text, readtail, buftail - readtail, &bytes_read, &read_error);
         if (G_IO_STATUS_ERROR == read_stat) {
             g_propagate_error(error, read_error);
             return FALSE;
         }
-        if (G_IO_STATUS_NORMAL != read_stat || 0 == valid_size) {
+        if (G_IO_STATUS_NORMAL != read_stat || 0 == bytes_read) {
             break;
         }
+        readtail += bytes_read;
 
         /* チャネルから取り出した範囲で、検索文字列を照合する
-         * なお、今回取り出した範囲と次回取り出す範囲にまたがる部分を比較するために、
-         * textque はクリアしてはいけない */
-        UnicodeBoyerMooreMatcher_scanUTF16StringImpl(self, (const gunichar2 *) self->channelbuf,
-                                                    valid_size / 2, match);
+         * 奇数バイトで読み出しが途切れた場合の最後の1バイトは次回に回す */
+        gsize valid_units = (readtail - bufhead) / sizeof(gunichar2);
+        UnicodeBoyerMooreMatcher_scanUTF16StringImpl(self, (const gunichar2 *) bufhead,
+                                                    valid_units, match);
         if (*match) {
             break;
         }
+
+        /* 今回取り出した範囲と次回取り出す範囲にまたがる部分を比較するために、
+         * 照合済み範囲の末尾 patternlen - 1 文字を次回に持ち越す */
+        const gchar *carryhead =
+            bufhead + sizeof(gunichar2) * (valid_units - MIN(valid_units, self->patternlen - 1));
+        ptrdiff_t leftlen = readtail - carryhead;
+        g_assert(leftlen >= 0);
+        if (leftlen != 0) {
+            g_memmove(bufhead, carryhead, leftlen);
+        }
+        readtail = bufhead + leftlen;
     }
 
     return TRUE;
 }
+
+/**
+ * 走査の統計を返す。STRING_MATCHING_STATS を定義せずにビルドしていれば NULL を返す
+ * UTF-8 テキストの走査はバイト単位、UTF-16 テキストの走査は UTF-16 単位で数える
+ */
+const ScanStats *
+UnicodeBoyerMooreMatcher_getStats(const UnicodeBoyerMooreMatcher *self)
+{
+#ifdef STRING_MATCHING_STATS
+    return &self->stats;
+#else
+    return NULL;
+#endif
+}
+
+void
+UnicodeBoyerMooreMatcher_resetStats(UnicodeBoyerMooreMatcher *self)
+{
+#ifdef STRING_MATCHING_STATS
+    ScanStats_reset(&self->stats);
+#endif
+}
+
+/**
+ * 確保している領域のバイト数を用途ごとに usage に足し込む
+ * channelbuf はチャネルを走査するまで確保しないので、確保済みのときだけ数える
+ */
+void
+UnicodeBoyerMooreMatcher_memoryUsage(const UnicodeBoyerMooreMatcher *self, MemoryUsage *usage)
+{
+    usage->patterns += sizeof(gunichar2) * self->patternlen + sizeof(gchar) * (self->u8patternlen + 1);
+    usage->shift_tables += (sizeof(guint32) << self->bctable_bits) + sizeof(guint16) * self->patternlen +
+                           sizeof(self->u8bctable);
+    if (NULL != self->channelbuf) {
+        usage->buffers += sizeof(gchar) * self->channelbufsize;
+    }
+    usage->overhead += sizeof(UnicodeBoyerMooreMatcher) - sizeof(self->u8bctable);
+}
@@ -3,6 +3,9 @@
 
 #include <glib.h>
 
+#include "memoryusage.h"
+#include "scanstats.h"
+
 typedef struct UnicodeBoyerMooreMatcher UnicodeBoyerMooreMatcher;
 
 extern UnicodeBoyerMooreMatcher *UnicodeBoyerMooreMatcher_new(const gunichar2 *pattern, gsize patternlen);
@@ -10,15 +13,23 @@ extern void UnicodeBoyerMooreMatcher_free(UnicodeBoyerMooreMatcher *self);
 extern const gunichar2 *UnicodeBoyerMooreMatcher_getPattern(UnicodeBoyerMooreMatcher *self);
 extern gsize UnicodeBoyerMooreMatcher_getPatternLength(UnicodeBoyerMooreMatcher *self);
 extern gboolean UnicodeBoyerMooreMatcher_scanUTF8String(UnicodeBoyerMooreMatcher *self,
-                                                              const gchar *text, gsize textlen,
+                                                              const gchar *text, glong textlen,
                                                               gboolean *match, GError **error);
+extern const gchar *UnicodeBoyerMooreMatcher_findUTF8String(UnicodeBoyerMooreMatcher *self,
+                                                                  const gchar *text, glong textlen);
+extern void UnicodeBoyerMooreMatcher_setChannelBufferSize(UnicodeBoyerMooreMatcher *self, gsize size);
 extern gboolean UnicodeBoyerMooreMatcher_scanUTF8Channel(UnicodeBoyerMooreMatcher *self,
                                                                 GIOChannel *text, gboolean *match,
                                                                 GError **error);
+extern gboolean UnicodeBoyerMooreMatcher_scanUTF8File(UnicodeBoyerMooreMatcher *self, const gchar *filename,
+                                                             gboolean *match, GError **error);
 extern void UnicodeBoyerMooreMatcher_scanUTF16String(UnicodeBoyerMooreMatcher *self,
                                                             const gunichar2 *text,
                                                             gsize textlen, gboolean *match);
 extern gboolean UnicodeBoyerMooreMatcher_scanUTF16Channel(UnicodeBoyerMooreMatcher *self, GIOChannel *text,
                                                                  gboolean *match, GError **error);
+extern const ScanStats *UnicodeBoyerMooreMatcher_getStats(const UnicodeBoyerMooreMatcher *self);
+extern void UnicodeBoyerMooreMatcher_resetStats(UnicodeBoyerMooreMatcher *self);
+extern void UnicodeBoyerMooreMatcher_memoryUsage(const UnicodeBoyerMooreMatcher *self, MemoryUsage *usage);
 
 #endif // __BOYERMOOREUNICODE_H__
@@ -3,6 +3,9 @@
 #include <glib.h>
 
 #include "commentzwalter.h"
+#include "memoryusage.h"
+#include "nodearena.h"
+#include "scanstats.h"
 
 typedef struct CommentzWalterTrie CommentzWalterTrie;
 struct CommentzWalterTrie {
@@ -16,40 +19,25 @@ struct CommentzWalterTrie {
 
 struct CommentzWalterMatcher {
   gsize max_keyword_length;
+  NodeArena *arena; // トライのノードと word の確保先
   gchar *wordbuf;
   CommentzWalterTrie *trie;
   gsize wmin;
   guint chars[0x100];
   gboolean compiled;
+#ifdef STRING_MATCHING_STATS
+  ScanStats stats;
+#endif
 };
 
-static void CommentzWalterTrie_free(gpointer self);
-
 static CommentzWalterTrie *
-CommentzWalterTrie_new()
-{
-  CommentzWalterTrie *self = (CommentzWalterTrie *) g_malloc0(sizeof(CommentzWalterTrie));
-  memset(self->childs, 0, sizeof(self->childs));
-  return self;
-}
-
-static void
-CommentzWalterTrie_free(gpointer data)
+CommentzWalterTrie_new(NodeArena *arena)
 {
-  if (NULL != data) {
-      CommentzWalterTrie *self = (CommentzWalterTrie *) data;
-      CommentzWalterTrie **childs_iter = self->childs;
-      CommentzWalterTrie **childs_end = self->childs + G_N_ELEMENTS(self->childs);
-      for (; childs_iter != childs_end; ++childs_iter) {
-        CommentzWalterTrie_free(*childs_iter);
-      }
-      g_free(self->word);
-      g_free(self);
-  }
+  return (CommentzWalterTrie *) NodeArena_alloc0(arena, sizeof(CommentzWalterTrie));
 }
 
 static void
-CommentzWalterTrie_addKeyword(CommentzWalterTrie *self, const gchar *keyword, glong keyword_length, gchar *wordbuf)
+CommentzWalterTrie_addKeyword(CommentzWalterTrie *self, NodeArena *arena, const gchar *keyword, glong keyword_length, gchar *wordbuf)
 {
   // 既に存在するノードをスキップする
   CommentzWalterTrie *current_node = self;
@@ -66,12 +54,12 @@ CommentzWalterTrie_addKeyword(CommentzWalterTrie *self, const gchar *keyword, gl
   }
   // keyword を表現するために必要なノードを追加する
   for (; keyword <= keyword_iter; --keyword_iter) {
-    CommentzWalterTrie *new_node = CommentzWalterTrie_new();
+    CommentzWalterTrie *new_node = CommentzWalterTrie_new(arena);
     current_node->childs[(guchar) *keyword_iter] = new_node;
     *wordbuf_iter = *keyword_iter;
     ++wordbuf_iter;
     new_node->wordlen = wordbuf_iter - wordbuf;
-    new_node->word = g_memdup(wordbuf, sizeof(gchar) * new_node->wordlen);
+    new_node->word = (gchar *) NodeArena_memdup(arena, wordbuf, sizeof(gchar) * new_node->wordlen);
     current_node = new_node;
   }
   // output を設定する
@@ -122,7 +110,7 @@ CommentzWalterTrie_compile(CommentzWalterTrie *self, const CommentzWalterTrie *r
 static void
 CommentzWalterTrie_calcMinDepthForChar(CommentzWalterTrie *self, guint *min_depths, guint limit_depth)
 {
-  if (limit_depth <= self->wordlen + 1) {
+  if (limit_depth < self->wordlen + 1) {
     return;
   }
   CommentzWalterTrie **childs_iter = self->childs;
@@ -139,6 +127,19 @@ CommentzWalterTrie_calcMinDepthForChar(CommentzWalterTrie *self, guint *min_dept
   }
 }
 
+static void
+CommentzWalterTrie_memoryUsage(const CommentzWalterTrie *self, MemoryUsage *usage)
+{
+  usage->nodes += sizeof(CommentzWalterTrie) - sizeof(self->childs);
+  usage->edges += sizeof(self->childs);
+  usage->patterns += sizeof(gchar) * self->wordlen;
+  for (gsize i = 0; i < G_N_ELEMENTS(self->childs); ++i) {
+    if (NULL != self->childs[i]) {
+      CommentzWalterTrie_memoryUsage(self->childs[i], usage);
+    }
+  }
+}
+
 #ifdef DEBUG
 
 static void
@@ -167,7 +168,8 @@ CommentzWalterMatcher_new(gsize max_keyword_length)
   CommentzWalterMatcher *self = (CommentzWalterMatcher *) g_malloc0(sizeof(CommentzWalterMatcher));
   self->max_keyword_length = max_keyword_length;
   self->wordbuf = (gchar *) g_malloc_n(max_keyword_length, sizeof(gchar));
-  self->trie = CommentzWalterTrie_new();
+  self->arena = NodeArena_new();
+  self->trie = CommentzWalterTrie_new(self->arena);
   self->wmin = max_keyword_length;
   self->compiled = FALSE;
   return self;
@@ -176,7 +178,8 @@ CommentzWalterMatcher_new(gsize max_keyword_length)
 void
 CommentzWalterMatcher_free(CommentzWalterMatcher *self)
 {
-  CommentzWalterTrie_free(self->trie);
+  // ノードはすべてアリーナにあるので、トライを辿らずにまとめて解放できる
+  NodeArena_free(self->arena);
   g_free(self->wordbuf);
   g_free(self);
 }
@@ -187,7 +190,7 @@ CommentzWalterMatcher_addKeyword(CommentzWalterMatcher *self, const gchar *keywo
   if (0L > length) {
       length = strlen(keyword);
   }
-  CommentzWalterTrie_addKeyword(self->trie, keyword, length, self->wordbuf);
+  CommentzWalterTrie_addKeyword(self->trie, self->arena, keyword, length, self->wordbuf);
   self->compiled = FALSE;
   if (self->wmin > length) {
     self->wmin = length;
@@ -217,6 +220,8 @@ CommentzWalterMatcher_scan(CommentzWalterMatcher *self, const gchar *document, g
   if (0L > length) {
       length = strlen(document);
   }
+  SCANSTATS_COUNT(&self->stats, n_scans, 1);
+  SCANSTATS_COUNT(&self->stats, n_units, length);
   const gchar *document_start_iter = document + self->wmin - 1;
   const gchar *const document_end = document + length;
   g_assert(NULL != output);
@@ -224,8 +229,10 @@ CommentzWalterMatcher_scan(CommentzWalterMatcher *self, const gchar *document, g
     const CommentzWalterTrie *current_node = self->trie;
     const gchar *document_iter = document_start_iter;
     guchar label = 0;
+    SCANSTATS_COUNT(&self->stats, n_alignments, 1);
     while (TRUE) {
       label = (guchar) *document_iter;
+      SCANSTATS_COUNT(&self->stats, n_compares, 1);
       const CommentzWalterTrie *next_node = current_node->childs[label];
       if (NULL == next_node) {
         break;
@@ -241,8 +248,12 @@ CommentzWalterMatcher_scan(CommentzWalterMatcher *self, const gchar *document, g
       }
       --document_iter;
     }
-    gint shift = MAX(current_node->shift1, self->chars[label] - (document_start_iter - document_iter) - 1);
-    document_start_iter += MIN(shift, current_node->shift2);
+    glong chars_shift = self->chars[label] - (document_start_iter - document_iter) - 1;
+    gint shift = MIN(MAX(current_node->shift1, chars_shift), current_node->shift2);
+    SCANSTATS_SHIFT(&self->stats,
+                    ScanStats_selectCommentzWalterRule(current_node->shift1, current_node->shift2, chars_shift),
+                    shift, document_start_iter - document_iter + 1);
+    document_start_iter += shift;
     if (document_end <= document_start_iter) {
       *output = NULL;
       return;
@@ -250,6 +261,98 @@ CommentzWalterMatcher_scan(CommentzWalterMatcher *self, const gchar *document, g
   }
 }
 
+/**
+ * 文書に現れるすべてのキーワードを func に通知する
+ * 各照合位置でトライを文書の先頭方向へ辿りきり、途中で見つかったキーワードをすべて報告する
+ * func が FALSE を返すと走査を打ち切る
+ */
+void
+CommentzWalterMatcher_scanAll(CommentzWalterMatcher *self, const gchar *document, glong length,
+                              CommentzWalterMatchFunc func, gpointer user_data)
+{
+  CommentzWalterMatcher_compile(self);
+
+  if (0L > length) {
+      length = strlen(document);
+  }
+  SCANSTATS_COUNT(&self->stats, n_scans, 1);
+  SCANSTATS_COUNT(&self->stats, n_units, length);
+  if ((gsize) length < self->wmin) {
+    return;
+  }
+  const gchar *document_start_iter = document + self->wmin - 1;
+  const gchar *const document_end = document + length;
+  while (TRUE) {
+    const CommentzWalterTrie *current_node = self->trie;
+    const gchar *document_iter = document_start_iter;
+    guchar label = 0;
+    SCANSTATS_COUNT(&self->stats, n_alignments, 1);
+    while (TRUE) {
+      label = (guchar) *document_iter;
+      SCANSTATS_COUNT(&self->stats, n_compares, 1);
+      const CommentzWalterTrie *next_node = current_node->childs[label];
+      if (NULL == next_node) {
+        break;
+      }
+      current_node = next_node;
+      if (NULL != current_node->output &&
+          !func(current_node->output, document_start_iter - document + 1, user_data)) {
+        return;
+      }
+      if (document == document_iter) {
+        break;
+      }
+      --document_iter;
+    }
+    glong chars_shift = self->chars[label] - (document_start_iter - document_iter) - 1;
+    gint shift = MIN(MAX(current_node->shift1, chars_shift), current_node->shift2);
+    SCANSTATS_SHIFT(&self->stats,
+                    ScanStats_selectCommentzWalterRule(current_node->shift1, current_node->shift2, chars_shift),
+                    shift, document_start_iter - document_iter + 1);
+    document_start_iter += shift;
+    if (document_end <= document_start_iter) {
+      return;
+    }
+  }
+}
+
+/**
+ * 走査の統計を返す。STRING_MATCHING_STATS を定義せずにビルドしていれば NULL を返す
+ */
+const ScanStats *
+CommentzWalterMatcher_getStats(const CommentzWalterMatcher *self)
+{
+#ifdef STRING_MATCHING_STATS
+  return &self->stats;
+#else
+  return NULL;
+#endif
+}
+
+void
+CommentzWalterMatcher_resetStats(CommentzWalterMatcher *self)
+{
+#ifdef STRING_MATCHING_STATS
+  ScanStats_reset(&self->stats);
+#endif
+}
+
+/**
+ * 確保している領域のバイト数を用途ごとに usage に足し込む
+ * ノードごとに 256 要素の子ノードの表を持つので、ノード数に比例して大きくなる
+ * キーワードは複製せずに output として指すだけなので含まない
+ */
+void
+CommentzWalterMatcher_memoryUsage(const CommentzWalterMatcher *self, MemoryUsage *usage)
+{
+  MemoryUsage trie_usage = MEMORYUSAGE_INIT;
+  CommentzWalterTrie_memoryUsage(self->trie, &trie_usage);
+  NodeArena_addMemoryUsage(self->arena, &trie_usage, usage);
+  usage->shift_tables += sizeof(self->chars);
+  usage->buffers += sizeof(gchar) * self->max_keyword_length;
+  usage->overhead += sizeof(CommentzWalterMatcher) - sizeof(self->chars);
+}
+
 #ifdef DEBUG
 
 void
@@ -6,9 +6,18 @@
 #include <stdio.h>
 #include <glib.h>
 
+#include "memoryusage.h"
+#include "scanstats.h"
+
 struct CommentzWalterMatcher;
 typedef struct CommentzWalterMatcher CommentzWalterMatcher;
 
+/**
+ * キーワードを見つけるたびに呼ばれる関数
+ * end_offset はキーワード末尾の直後を指すバイトオフセットで、FALSE を返すと走査を打ち切る
+ */
+typedef gboolean (*CommentzWalterMatchFunc)(gconstpointer output, gsize end_offset, gpointer user_data);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -18,6 +27,10 @@ extern void CommentzWalterMatcher_free(CommentzWalterMatcher *self);
 extern void CommentzWalterMatcher_addKeyword(CommentzWalterMatcher *self, const gchar *keyword, glong length);
 extern void CommentzWalterMatcher_compile(CommentzWalterMatcher *self);
 extern void CommentzWalterMatcher_scan(CommentzWalterMatcher *self, const gchar *document, glong length, gconstpointer *output);
+extern void CommentzWalterMatcher_scanAll(CommentzWalterMatcher *self, const gchar *document, glong length, CommentzWalterMatchFunc func, gpointer user_data);
+extern const ScanStats *CommentzWalterMatcher_getStats(const CommentzWalterMatcher *self);
+extern void CommentzWalterMatcher_resetStats(CommentzWalterMatcher *self);
+extern void CommentzWalterMatcher_memoryUsage(const CommentzWalterMatcher *self, MemoryUsage *usage);
 
 #ifdef DEBUG
 extern void CommentzWalterMatcher_pprintTrie(CommentzWalterMatcher *self, FILE *ostream);
@@ -3,9 +3,13 @@
 #include <glib.h>
 
 #include "commentzwalterunicode.h"
+#include "memoryusage.h"
+#include "nodearena.h"
+#include "scanstats.h"
+#include "utf8transcoder.h"
 
 typedef struct UnicodeCommentzWalterTrie {
-  GHashTable *childs; // 要素は UnicodeCommentzWalterTrie
+  NodeArenaEdges childs; // 要素は UnicodeCommentzWalterTrie
   gint shift1;
   gint shift2;
   gunichar2 *word;
@@ -15,41 +19,32 @@ typedef struct UnicodeCommentzWalterTrie {
 
 struct UnicodeCommentzWalterMatcher {
   gsize max_keyword_length;
+  NodeArena *arena; // トライのノード、子ノードの表と word の確保先
   gunichar2 *wordbuf;
   UnicodeCommentzWalterTrie *trie;
   gsize wmin;
   guint chars[0x10000];
   gboolean compiled;
+#ifdef STRING_MATCHING_STATS
+  ScanStats stats;
+#endif
 };
 
-static void UnicodeCommentzWalterTrie_free(gpointer self);
-
 static UnicodeCommentzWalterTrie *
-UnicodeCommentzWalterTrie_new()
-{
-  UnicodeCommentzWalterTrie *self = (UnicodeCommentzWalterTrie *) g_malloc0(sizeof(UnicodeCommentzWalterTrie));
-  self->childs = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, UnicodeCommentzWalterTrie_free);
-  return self;
-}
-
-static void
-UnicodeCommentzWalterTrie_free(gpointer data)
+UnicodeCommentzWalterTrie_new(NodeArena *arena)
 {
-  UnicodeCommentzWalterTrie *self = (UnicodeCommentzWalterTrie *) data;
-  g_hash_table_destroy(self->childs);
-  g_free(self->word);
-  g_free(self);
+  return (UnicodeCommentzWalterTrie *) NodeArena_alloc0(arena, sizeof(UnicodeCommentzWalterTrie));
 }
 
 static void
-UnicodeCommentzWalterTrie_addKeyword(UnicodeCommentzWalterTrie *self, const gunichar2 *keyword, glong keyword_length, gconstpointer output, gunichar2 *wordbuf)
+UnicodeCommentzWalterTrie_addKeyword(UnicodeCommentzWalterTrie *self, NodeArena *arena, const gunichar2 *keyword, glong keyword_length, gconstpointer output, gunichar2 *wordbuf)
 {
   // 既に存在するノードをスキップする
   UnicodeCommentzWalterTrie *current_node = self;
   const gunichar2 *keyword_iter = keyword + keyword_length - 1;
   gunichar2 *wordbuf_iter = wordbuf;
   for (; keyword <= keyword_iter; --keyword_iter) {
-    gpointer child_node = g_hash_table_lookup(current_node->childs, GINT_TO_POINTER(*keyword_iter));
+    gpointer child_node = NodeArenaEdges_lookup(&current_node->childs, *keyword_iter);
     if (NULL == child_node) {
       break;
     }
@@ -59,12 +54,12 @@ UnicodeCommentzWalterTrie_addKeyword(UnicodeCommentzWalterTrie *self, const guni
   }
   // keyword を表現するために必要なノードを追加する
   for (; keyword <= keyword_iter; --keyword_iter) {
-    UnicodeCommentzWalterTrie *new_node = UnicodeCommentzWalterTrie_new();
-    g_assert(g_hash_table_insert(current_node->childs, GINT_TO_POINTER(*keyword_iter), new_node));
+    UnicodeCommentzWalterTrie *new_node = UnicodeCommentzWalterTrie_new(arena);
+    NodeArenaEdges_insert(&current_node->childs, arena, *keyword_iter, new_node);
     *wordbuf_iter = *keyword_iter;
     ++wordbuf_iter;
     new_node->wordlen = wordbuf_iter - wordbuf;
-    new_node->word = g_memdup(wordbuf, sizeof(gunichar2) * new_node->wordlen);
+    new_node->word = (gunichar2 *) NodeArena_memdup(arena, wordbuf, sizeof(gunichar2) * new_node->wordlen);
     current_node = new_node;
   }
   // output を設定する
@@ -81,12 +76,9 @@ UnicodeCommentzWalterTrie_updateShifts(UnicodeCommentzWalterTrie *self, const Un
       self->shift2 = MIN(self->shift2, rel_depth);
     }
   }
-    GHashTableIter childs_iter;
-    g_hash_table_iter_init(&childs_iter, another->childs);
-    gpointer child_node = NULL;
-    while (g_hash_table_iter_next(&childs_iter, NULL, &child_node)) {
-      UnicodeCommentzWalterTrie_updateShifts(self, child_node, rel_depth + 1);
-    }
+  for (guint i = 0; i < another->childs.size; ++i) {
+    UnicodeCommentzWalterTrie_updateShifts(self, another->childs.nodes[i], rel_depth + 1);
+  }
 }
 
 static void
@@ -100,30 +92,34 @@ UnicodeCommentzWalterTrie_compile(UnicodeCommentzWalterTrie *self, const Unicode
     self->shift2 = father_shift2;
     UnicodeCommentzWalterTrie_updateShifts(self, root_node, -(self->wordlen));
   }
-  GHashTableIter childs_iter;
-  g_hash_table_iter_init(&childs_iter, self->childs);
-  gpointer child_node;
-  while (g_hash_table_iter_next(&childs_iter, NULL, &child_node)) {
-    UnicodeCommentzWalterTrie_compile((UnicodeCommentzWalterTrie *) child_node, root_node, wmin, self->shift2);
+  for (guint i = 0; i < self->childs.size; ++i) {
+    UnicodeCommentzWalterTrie_compile((UnicodeCommentzWalterTrie *) self->childs.nodes[i], root_node, wmin, self->shift2);
   }
 }
 
 static void
 UnicodeCommentzWalterTrie_calcMinDepthForChar(UnicodeCommentzWalterTrie *self, guint *min_depths, guint limit_depth)
 {
-  if (limit_depth <= self->wordlen + 1) {
+  if (limit_depth < self->wordlen + 1) {
     return;
   }
-  GHashTableIter childs_iter;
-  g_hash_table_iter_init(&childs_iter, self->childs);
-  gpointer child_label;
-  gpointer child_node;
-  while (g_hash_table_iter_next(&childs_iter, &child_label, &child_node)) {
-    guint *min_depth = min_depths + GPOINTER_TO_INT(child_label);
+  for (guint i = 0; i < self->childs.size; ++i) {
+    guint *min_depth = min_depths + self->childs.labels[i];
     if (*min_depth > self->wordlen + 1) {
       *min_depth = self->wordlen + 1;
     }
-    UnicodeCommentzWalterTrie_calcMinDepthForChar((UnicodeCommentzWalterTrie *) child_node, min_depths, limit_depth);
+    UnicodeCommentzWalterTrie_calcMinDepthForChar((UnicodeCommentzWalterTrie *) self->childs.nodes[i], min_depths, limit_depth);
+  }
+}
+
+static void
+UnicodeCommentzWalterTrie_memoryUsage(const UnicodeCommentzWalterTrie *self, MemoryUsage *usage)
+{
+  usage->nodes += sizeof(UnicodeCommentzWalterTrie);
+  usage->edges += NodeArenaEdges_getAllocatedBytes(&self->childs);
+  usage->patterns += sizeof(gunichar2) * self->wordlen;
+  for (guint i = 0; i < self->childs.size; ++i) {
+    UnicodeCommentzWalterTrie_memoryUsage((const UnicodeCommentzWalterTrie *) self->childs.nodes[i], usage);
   }
 }
 
@@ -147,12 +143,8 @@ UnicodeCommentzWalterTrie_pprint(UnicodeCommentzWalterTrie *self, gunichar2 labe
   fprintf(ostream, "\"%.*s\": <%p> shift1=%d, shift2=%d, word=%s, wordlen=%ld, output=%p\n", length, label_as_utf8, self, self->shift1, self->shift2, word_as_u8, (long) self->wordlen, self->output);
   g_free(word_as_u8);
 
-  GHashTableIter childs_iter;
-  g_hash_table_iter_init(&childs_iter, self->childs);
-  gpointer child_label = NULL;
-  gpointer child_node = NULL;
-  while (g_hash_table_iter_next(&childs_iter, &child_label, &child_node)) {
-    UnicodeCommentzWalterTrie_pprint((UnicodeCommentzWalterTrie *) child_node, GPOINTER_TO_INT(child_label), depth + 1, ostream);
+  for (guint i = 0; i < self->childs.size; ++i) {
+    UnicodeCommentzWalterTrie_pprint((UnicodeCommentzWalterTrie *) self->childs.nodes[i], self->childs.labels[i], depth + 1, ostream);
   }
 }
 
@@ -164,7 +156,8 @@ UnicodeCommentzWalterMatcher_new(gsize max_keyword_length)
   UnicodeCommentzWalterMatcher *self = (UnicodeCommentzWalterMatcher *) g_malloc0(sizeof(UnicodeCommentzWalterMatcher));
   self->max_keyword_length = max_keyword_length;
   self->wordbuf = (gunichar2 *) g_malloc_n(max_keyword_length, sizeof(gunichar2));
-  self->trie = UnicodeCommentzWalterTrie_new();
+  self->arena = NodeArena_new();
+  self->trie = UnicodeCommentzWalterTrie_new(self->arena);
   self->wmin = max_keyword_length;
   self->compiled = FALSE;
   return self;
@@ -173,7 +166,8 @@ UnicodeCommentzWalterMatcher_new(gsize max_keyword_length)
 void
 UnicodeCommentzWalterMatcher_free(UnicodeCommentzWalterMatcher *self)
 {
-  UnicodeCommentzWalterTrie_free(self->trie);
+  // ノードと子ノードの表はすべてアリーナにあるので、トライを辿らずにまとめて解放できる
+  NodeArena_free(self->arena);
   g_free(self->wordbuf);
   g_free(self);
 }
@@ -189,7 +183,7 @@ UnicodeCommentzWalterMatcher_addKeywordAsUTF8(UnicodeCommentzWalterMatcher *self
     return FALSE;
   }
   g_assert(0L < length_as_u16);
-  UnicodeCommentzWalterTrie_addKeyword(self->trie, keyword_as_u16, length_as_u16, keyword, self->wordbuf);
+  UnicodeCommentzWalterTrie_addKeyword(self->trie, self->arena, keyword_as_u16, length_as_u16, keyword, self->wordbuf);
   g_free(keyword_as_u16);
   self->compiled = FALSE;
   if (self->wmin > length_as_u16) {
@@ -201,7 +195,7 @@ UnicodeCommentzWalterMatcher_addKeywordAsUTF8(UnicodeCommentzWalterMatcher *self
 void
 UnicodeCommentzWalterMatcher_addKeywordAsUTF16(UnicodeCommentzWalterMatcher *self, const gunichar2 *keyword, gsize length)
 {
-  UnicodeCommentzWalterTrie_addKeyword(self->trie, keyword, length, keyword, self->wordbuf);
+  UnicodeCommentzWalterTrie_addKeyword(self->trie, self->arena, keyword, length, keyword, self->wordbuf);
   self->compiled = FALSE;
   if (self->wmin > length) {
     self->wmin = length;
@@ -225,17 +219,26 @@ UnicodeCommentzWalterMatcher_compile(UnicodeCommentzWalterMatcher *self)
 
 gboolean
 UnicodeCommentzWalterMatcher_scanUTF8String(UnicodeCommentzWalterMatcher *self, const gchar *document, glong length, gconstpointer *output, GError **error)
+{
+  UTF16Buffer buffer = UTF16BUFFER_INIT;
+  gboolean status = UnicodeCommentzWalterMatcher_scanUTF8StringWithBuffer(self, document, length, &buffer, output, error);
+  UTF16Buffer_clear(&buffer);
+  return status;
+}
+
+/**
+ * UTF-16 への変換結果を buffer に書き込んで検査する
+ * 同じ buffer を使い回せば、検査のたびに変換用の領域を確保しなくて済む
+ */
+gboolean
+UnicodeCommentzWalterMatcher_scanUTF8StringWithBuffer(UnicodeCommentzWalterMatcher *self, const gchar *document, glong length, UTF16Buffer *buffer, gconstpointer *output, GError **error)
 {
   glong length_as_u16 = 0L;
-  GError *conv_error = NULL;
-  gunichar2 *document_as_u16 = g_utf8_to_utf16(document, length, NULL, &length_as_u16, &conv_error);
-  if (NULL == document_as_u16) {
-    g_propagate_error(error, conv_error);
+  if (!UTF8Transcoder_toUTF16(document, length, buffer, &length_as_u16, error)) {
     return FALSE;
   }
   g_assert(0L < length_as_u16);
-  UnicodeCommentzWalterMatcher_scanUTF16String(self, document_as_u16, length_as_u16, output);
-  g_free(document_as_u16);
+  UnicodeCommentzWalterMatcher_scanUTF16String(self, buffer->data, length_as_u16, output);
   return TRUE;
 }
 
@@ -244,6 +247,8 @@ UnicodeCommentzWalterMatcher_scanUTF16String(UnicodeCommentzWalterMatcher *self,
 {
   UnicodeCommentzWalterMatcher_compile(self);
 
+  SCANSTATS_COUNT(&self->stats, n_scans, 1);
+  SCANSTATS_COUNT(&self->stats, n_units, length);
   const gunichar2 *document_start_iter = document + self->wmin - 1;
   const gunichar2 *const document_end = document + length;
   g_assert(NULL != output);
@@ -251,9 +256,11 @@ UnicodeCommentzWalterMatcher_scanUTF16String(UnicodeCommentzWalterMatcher *self,
     const UnicodeCommentzWalterTrie *current_node = self->trie;
     const gunichar2 *document_iter = document_start_iter;
     gunichar2 label = 0;
+    SCANSTATS_COUNT(&self->stats, n_alignments, 1);
     while (TRUE) {
       label = *document_iter;
-      gpointer next_node = g_hash_table_lookup(current_node->childs, GINT_TO_POINTER(label));
+      SCANSTATS_COUNT(&self->stats, n_compares, 1);
+      gpointer next_node = NodeArenaEdges_lookup(&current_node->childs, label);
       if (NULL == next_node) {
         break;
       }
@@ -268,8 +275,12 @@ UnicodeCommentzWalterMatcher_scanUTF16String(UnicodeCommentzWalterMatcher *self,
       }
       --document_iter;
     }
-    gint shift = MAX(current_node->shift1, self->chars[label] - (document_start_iter - document_iter) - 1);
-    document_start_iter += MIN(shift, current_node->shift2);
+    glong chars_shift = self->chars[label] - (document_start_iter - document_iter) - 1;
+    gint shift = MIN(MAX(current_node->shift1, chars_shift), current_node->shift2);
+    SCANSTATS_SHIFT(&self->stats,
+                    ScanStats_selectCommentzWalterRule(current_node->shift1, current_node->shift2, chars_shift),
+                    shift, document_start_iter - document_iter + 1);
+    document_start_iter += shift;
     if (document_end <= document_start_iter) {
       *output = NULL;
       return;
@@ -277,6 +288,93 @@ UnicodeCommentzWalterMatcher_scanUTF16String(UnicodeCommentzWalterMatcher *self,
   }
 }
 
+/**
+ * 文書に現れるすべてのキーワードを func に通知する
+ * end_offset は UTF-16 単位のオフセットで、func が FALSE を返すと走査を打ち切る
+ */
+void
+UnicodeCommentzWalterMatcher_scanAllUTF16String(UnicodeCommentzWalterMatcher *self, const gunichar2 *document, gsize length,
+                                                UnicodeCommentzWalterMatchFunc func, gpointer user_data)
+{
+  UnicodeCommentzWalterMatcher_compile(self);
+
+  SCANSTATS_COUNT(&self->stats, n_scans, 1);
+  SCANSTATS_COUNT(&self->stats, n_units, length);
+  if (length < self->wmin) {
+    return;
+  }
+  const gunichar2 *document_start_iter = document + self->wmin - 1;
+  const gunichar2 *const document_end = document + length;
+  while (TRUE) {
+    const UnicodeCommentzWalterTrie *current_node = self->trie;
+    const gunichar2 *document_iter = document_start_iter;
+    gunichar2 label = 0;
+    SCANSTATS_COUNT(&self->stats, n_alignments, 1);
+    while (TRUE) {
+      label = *document_iter;
+      SCANSTATS_COUNT(&self->stats, n_compares, 1);
+      gpointer next_node = NodeArenaEdges_lookup(&current_node->childs, label);
+      if (NULL == next_node) {
+        break;
+      }
+      current_node = (const UnicodeCommentzWalterTrie *) next_node;
+      if (NULL != current_node->output &&
+          !func(current_node->output, document_start_iter - document + 1, user_data)) {
+        return;
+      }
+      if (document == document_iter) {
+        break;
+      }
+      --document_iter;
+    }
+    glong chars_shift = self->chars[label] - (document_start_iter - document_iter) - 1;
+    gint shift = MIN(MAX(current_node->shift1, chars_shift), current_node->shift2);
+    SCANSTATS_SHIFT(&self->stats,
+                    ScanStats_selectCommentzWalterRule(current_node->shift1, current_node->shift2, chars_shift),
+                    shift, document_start_iter - document_iter + 1);
+    document_start_iter += shift;
+    if (document_end <= document_start_iter) {
+      return;
+    }
+  }
+}
+
+/**
+ * 走査の統計を返す。STRING_MATCHING_STATS を定義せずにビルドしていれば NULL を返す
+ */
+const ScanStats *
+UnicodeCommentzWalterMatcher_getStats(const UnicodeCommentzWalterMatcher *self)
+{
+#ifdef STRING_MATCHING_STATS
+  return &self->stats;
+#else
+  return NULL;
+#endif
+}
+
+void
+UnicodeCommentzWalterMatcher_resetStats(UnicodeCommentzWalterMatcher *self)
+{
+#ifdef STRING_MATCHING_STATS
+  ScanStats_reset(&self->stats);
+#endif
+}
+
+/**
+ * 確保している領域のバイト数を用途ごとに usage に足し込む
+ * chars は UTF-16 のコード単位ごとの表なので、キーワードに関係なく 256KB を占める
+ */
+void
+UnicodeCommentzWalterMatcher_memoryUsage(const UnicodeCommentzWalterMatcher *self, MemoryUsage *usage)
+{
+  MemoryUsage trie_usage = MEMORYUSAGE_INIT;
+  UnicodeCommentzWalterTrie_memoryUsage(self->trie, &trie_usage);
+  NodeArena_addMemoryUsage(self->arena, &trie_usage, usage);
+  usage->shift_tables += sizeof(self->chars);
+  usage->buffers += sizeof(gunichar2) * self->max_keyword_length;
+  usage->overhead += sizeof(UnicodeCommentzWalterMatcher) - sizeof(self->chars);
+}
+
 #ifdef DEBUG
 
 void
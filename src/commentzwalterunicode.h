@@ -7,9 +7,19 @@
 #include <stdio.h>
 #include <glib.h>
 
+#include "memoryusage.h"
+#include "scanstats.h"
+#include "utf8transcoder.h"
+
 struct UnicodeCommentzWalterMatcher;
 typedef struct UnicodeCommentzWalterMatcher UnicodeCommentzWalterMatcher;
 
+/**
+ * キーワードを見つけるたびに呼ばれる関数
+ * end_offset はキーワード末尾の直後を指す UTF-16 単位のオフセットで、FALSE を返すと走査を打ち切る
+ */
+typedef gboolean (*UnicodeCommentzWalterMatchFunc)(gconstpointer output, gsize end_offset, gpointer user_data);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -20,7 +30,12 @@ extern void UnicodeCommentzWalterMatcher_compile(UnicodeCommentzWalterMatcher *s
 extern gboolean UnicodeCommentzWalterMatcher_addKeywordAsUTF8(UnicodeCommentzWalterMatcher *self, const gchar *keyword, glong length, GError **error);
 extern void UnicodeCommentzWalterMatcher_addKeywordAsUTF16(UnicodeCommentzWalterMatcher* self, const gunichar2 *keyword, gsize length);
 extern gboolean UnicodeCommentzWalterMatcher_scanUTF8String(UnicodeCommentzWalterMatcher *self, const gchar *document, glong length, gconstpointer *output, GError **error);
+extern gboolean UnicodeCommentzWalterMatcher_scanUTF8StringWithBuffer(UnicodeCommentzWalterMatcher *self, const gchar *document, glong length, UTF16Buffer *buffer, gconstpointer *output, GError **error);
 extern void UnicodeCommentzWalterMatcher_scanUTF16String(UnicodeCommentzWalterMatcher *self, const gunichar2 *document, gsize length, gconstpointer *output);
+extern void UnicodeCommentzWalterMatcher_scanAllUTF16String(UnicodeCommentzWalterMatcher *self, const gunichar2 *document, gsize length, UnicodeCommentzWalterMatchFunc func, gpointer user_data);
+extern const ScanStats *UnicodeCommentzWalterMatcher_getStats(const UnicodeCommentzWalterMatcher *self);
+extern void UnicodeCommentzWalterMatcher_resetStats(UnicodeCommentzWalterMatcher *self);
+extern void UnicodeCommentzWalterMatcher_memoryUsage(const UnicodeCommentzWalterMatcher *self, MemoryUsage *usage);
 #ifdef DEBUG
 extern void UnicodeCommentzWalterMatcher_pprintTrie(UnicodeCommentzWalterMatcher *self, FILE *ostream);
 #endif
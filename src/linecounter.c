@@ -0,0 +1,175 @@
+#include <string.h>
+#include <glib.h>
+
+#include "linecounter.h"
+#include "simddispatch.h"
+
+/**
+ * 各カーネルは text[offset, textlen) に含まれる '\n' の数を返す
+ * ベクトル幅に満たない末尾は、より狭いカーネルに引き継ぐ
+ */
+typedef gsize (*LineCounter_countKernel)(const guchar *text, gsize offset, gsize textlen);
+
+static gsize
+LineCounter_countScalar(const guchar *text, gsize offset, gsize textlen)
+{
+    gsize n_newlines = 0;
+    for (; offset < textlen; ++offset) {
+        n_newlines += ('\n' == text[offset]);
+    }
+    return n_newlines;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+/* 比較結果 (一致で -1) を8ビットの計数に溜めるので、桁あふれする前に合計する */
+#define LINECOUNTER_MAX_BLOCKS 255
+
+__attribute__((target("sse2")))
+static gsize
+LineCounter_countSSE2(const guchar *text, gsize offset, gsize textlen)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    gsize n_newlines = 0;
+    while (offset + 16 <= textlen) {
+        __m128i counts = _mm_setzero_si128();
+        for (gsize i = 0; i < LINECOUNTER_MAX_BLOCKS && offset + 16 <= textlen; ++i, offset += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i *) (text + offset));
+            counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(block, newline));
+        }
+        __m128i sums = _mm_sad_epu8(counts, zero);
+        n_newlines += (gsize) _mm_cvtsi128_si32(sums) + (gsize) _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+    }
+    return n_newlines + LineCounter_countScalar(text, offset, textlen);
+}
+
+__attribute__((target("avx2")))
+static gsize
+LineCounter_countAVX2(const guchar *text, gsize offset, gsize textlen)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    gsize n_newlines = 0;
+    while (offset + 32 <= textlen) {
+        __m256i counts = _mm256_setzero_si256();
+        for (gsize i = 0; i < LINECOUNTER_MAX_BLOCKS && offset + 32 <= textlen; ++i, offset += 32) {
+            __m256i block = _mm256_loadu_si256((const __m256i *) (text + offset));
+            counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(block, newline));
+        }
+        __m256i sums = _mm256_sad_epu8(counts, zero);
+        __m128i sums128 = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        n_newlines += (gsize) _mm_cvtsi128_si32(sums128) + (gsize) _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums128, sums128));
+    }
+    return n_newlines + LineCounter_countSSE2(text, offset, textlen);
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+static gsize
+LineCounter_countAVX512(const guchar *text, gsize offset, gsize textlen)
+{
+    const __m512i newline = _mm512_set1_epi8('\n');
+    gsize n_newlines = 0;
+    for (; offset + 64 <= textlen; offset += 64) {
+        __m512i block = _mm512_loadu_si512((const void *) (text + offset));
+        n_newlines += (gsize) __builtin_popcountll(_mm512_cmpeq_epi8_mask(block, newline));
+    }
+    return n_newlines + LineCounter_countAVX2(text, offset, textlen);
+}
+
+#endif // defined(__x86_64__) || defined(__i386__)
+
+/**
+ * 実行時の CPU で使える最も広いカーネルを返す
+ */
+static LineCounter_countKernel
+LineCounter_getCountKernel(void)
+{
+    static gsize kernel_once = 0;
+    static LineCounter_countKernel kernel = NULL;
+    if (g_once_init_enter(&kernel_once)) {
+        switch (SIMDDispatch_getLevel()) {
+#if defined(__x86_64__) || defined(__i386__)
+        case SIMD_LEVEL_AVX512:
+            kernel = LineCounter_countAVX512;
+            break;
+        case SIMD_LEVEL_AVX2:
+            kernel = LineCounter_countAVX2;
+            break;
+        case SIMD_LEVEL_SSE2:
+            kernel = LineCounter_countSSE2;
+            break;
+#endif
+        default:
+            kernel = LineCounter_countScalar;
+            break;
+        }
+        g_once_init_leave(&kernel_once, 1);
+    }
+    return kernel;
+}
+
+/**
+ * text に含まれる '\n' の数を返す
+ */
+gsize
+LineCounter_countNewlines(const gchar *text, gsize textlen)
+{
+    return LineCounter_getCountKernel()((const guchar *) text, 0, textlen);
+}
+
+/**
+ * offset を含む行の先頭を返す。limit より前には改行がないことが分かっていれば、limit で探すのをやめる
+ */
+static gsize
+LineCounter_findLineStart(const gchar *text, gsize offset, gsize limit)
+{
+    while (limit < offset && '\n' != text[offset - 1]) {
+        --offset;
+    }
+    return offset;
+}
+
+void
+LineCounter_init(LineCounter *self, const gchar *text, gsize textlen)
+{
+    self->text = text;
+    self->textlen = textlen;
+    self->position = 0;
+    self->number = 1;
+    self->line_start = 0;
+}
+
+/**
+ * offset (textlen 以下) に移動して、その位置を含む行を求める
+ * 前に進むときは前回の位置からの改行を数えるだけなので、報告の順に移動すればテキスト全体を1回数えることになる
+ * 後ろにも移動できるが、戻った分の改行を数え直す
+ */
+void
+LineCounter_seek(LineCounter *self, gsize offset)
+{
+    g_assert(offset <= self->textlen);
+    if (self->position <= offset) {
+        gsize n_newlines = LineCounter_countNewlines(self->text + self->position, offset - self->position);
+        if (0 < n_newlines) {
+            self->number += n_newlines;
+            self->line_start = LineCounter_findLineStart(self->text, offset, self->position);
+        }
+    } else if (offset < self->line_start) {
+        self->number -= LineCounter_countNewlines(self->text + offset, self->line_start - offset);
+        self->line_start = LineCounter_findLineStart(self->text, offset, 0);
+    }
+    self->position = offset;
+}
+
+/**
+ * 現在の行の末尾 (改行の位置、最後の行ならテキストの末尾) のバイトオフセットを返す
+ */
+gsize
+LineCounter_getLineEnd(const LineCounter *self)
+{
+    const gchar *newline = (const gchar *) memchr(self->text + self->position, '\n', self->textlen - self->position);
+    return (NULL == newline) ? self->textlen : (gsize) (newline - self->text);
+}
@@ -0,0 +1,36 @@
+// 改行で区切られたテキストで、バイトオフセットを行番号と行の範囲に対応付ける
+// 前回の位置から新しい位置までの改行を SIMD でまとめて数えるので、キーワードの報告の間を1バイトずつ調べない
+// 改行は '\n' だけを数え、"\r\n" の '\r' は行の内容に含める
+
+#ifndef __LINECOUNTER_H__
+#define __LINECOUNTER_H__
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * テキスト上の現在の位置と、その位置を含む行
+ * LineCounter_init で初期化する。領域を確保しないので解放は要らない
+ */
+typedef struct LineCounter {
+    const gchar *text;
+    gsize textlen;
+    gsize position;   /* 最後に移動した位置 */
+    gsize number;     /* position を含む行の番号。1 から数える */
+    gsize line_start; /* position を含む行の先頭のバイトオフセット */
+} LineCounter;
+
+extern gsize LineCounter_countNewlines(const gchar *text, gsize textlen);
+
+extern void LineCounter_init(LineCounter *self, const gchar *text, gsize textlen);
+extern void LineCounter_seek(LineCounter *self, gsize offset);
+extern gsize LineCounter_getLineEnd(const LineCounter *self);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LINECOUNTER_H__
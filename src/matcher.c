@@ -0,0 +1,1423 @@
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "ahocorasickunicode.h"
+#include "boyermooreunicode.h"
+#include "commentzwalter.h"
+#include "commentzwalterunicode.h"
+#include "linecounter.h"
+#include "matcher.h"
+#include "matchercostprofile.h"
+#include "memoryusage.h"
+#include "naiveunicode.h"
+#include "scanstats.h"
+#include "sunday.h"
+#include "utf8transcoder.h"
+
+/* キーワードが1本でこのバイト数未満なら、スキップの利きが小さいので SIMD の総当たりを選ぶ */
+#define MATCHER_PLAN_MAX_NAIVE_LENGTH 8
+/* バイト単位の Commentz-Walter はノードごとに 0x100 要素の表を持つので、キーワードの総バイト数で制限する */
+#define MATCHER_PLAN_MAX_BYTE_TRIE_SIZE 8192
+/* UTF-16 版の Commentz-Walter はシフト量が最短キーワード長で頭打ちになるので、これより短ければ Aho-Corasick を選ぶ */
+#define MATCHER_PLAN_MIN_SKIP_LENGTH 4
+/* キーワードがこれより多いと、Commentz-Walter はトライを遡る照合が長くなりやすい */
+#define MATCHER_PLAN_MAX_CW_KEYWORDS 1000
+/* コストを予測するときに、指定がなければ走査すると見込むテキストのバイト数 */
+#define MATCHER_DEFAULT_EXPECTED_SCAN_BYTES (1024 * 1024)
+/* 1行に1つだけ報告するときに、1回の走査に渡すテキストの大きさの下限と上限 */
+#define MATCHER_LINES_MIN_WINDOW 64
+#define MATCHER_LINES_MAX_WINDOW (1024 * 1024)
+
+/**
+ * 登録されたキーワード
+ * 各エンジンの output には text を渡しておき、見つかったキーワードを MatcherKeyword_fromOutput で取り戻す
+ */
+typedef struct MatcherKeyword {
+    gsize length;    /* text のバイト数 */
+    gsize u16length; /* UTF-16 に変換したときのコード単位数 */
+    gchar text[];    /* NUL 終端 */
+} MatcherKeyword;
+
+#define MatcherKeyword_fromOutput(output) \
+    ((const MatcherKeyword *) ((const gchar *) (output) - G_STRUCT_OFFSET(MatcherKeyword, text)))
+
+/**
+ * エンジンごとの実装を束ねる表
+ * 単一パターンのエンジンは compileOne, findOne, freeOne を実装し、キーワードごとに前処理と走査を繰り返す
+ * compile, scan, scanAll, free にはそれらを束ねる共通の実装を使う
+ * 複数パターンのエンジンは scanAll を実装し、scan は最初の報告で打ち切る共通の実装にする
+ * scanAll の buffer は UTF-16 への変換に使う領域で、NULL なら呼び出しごとに確保する
+ * getStats と resetStats はエンジンの前処理結果 (単一パターンのエンジンではキーワードごと) の統計を扱い、
+ * 統計を数えないエンジンでは NULL にする
+ */
+typedef struct MatcherClass {
+    MatcherEngine engine;
+    const gchar *name;
+    gboolean (*compile)(Matcher *self, GError **error);
+    gboolean (*scan)(Matcher *self, const gchar *text, gsize textlen,
+                     const MatcherKeyword **keyword, gsize *offset, GError **error);
+    gboolean (*scanAll)(Matcher *self, const gchar *text, gsize textlen, UTF16Buffer *buffer,
+                        MatcherFunc func, gpointer user_data, GError **error);
+    void (*free)(Matcher *self);
+    gboolean (*compileOne)(const MatcherKeyword *keyword, gpointer *impl, GError **error);
+    const gchar *(*findOne)(gpointer impl, const MatcherKeyword *keyword, const gchar *text, gsize textlen);
+    GDestroyNotify freeOne;
+    const ScanStats *(*getStats)(gconstpointer impl);
+    void (*resetStats)(gpointer impl);
+    void (*memoryUsage)(gconstpointer impl, MemoryUsage *usage);
+} MatcherClass;
+
+struct Matcher {
+    GPtrArray *keywords;     /* 要素は MatcherKeyword */
+    GHashTable *keyword_set; /* 重複したキーワードを除くため、MatcherKeyword の text を登録する */
+    gsize min_length;
+    gsize max_length;
+    gsize total_length;
+    gsize min_u16length;
+    gsize max_u16length;
+    gboolean ascii;
+    gboolean newline;        /* 改行を含むキーワードがある */
+    const MatcherCostProfile *cost_profile; /* NULL なら環境変数で指定されたプロファイルを使う */
+    gsize expected_scan_bytes;
+    const MatcherClass *klass; /* コンパイル前は NULL */
+    gpointer impl;
+};
+
+/**
+ * 複数パターンのエンジンの報告を MatcherFunc に中継するための状態
+ * UTF-16 のエンジンは末尾位置を UTF-16 単位で報告するので、UTF-8 のバイトオフセットに直す
+ */
+typedef struct MatcherScanContext {
+    const gchar *text;
+    const guchar *cursor; /* cursor_u16 に対応する text 上の位置 */
+    gsize cursor_u16;
+    MatcherFunc func;
+    gpointer user_data;
+} MatcherScanContext;
+
+/**
+ * Matcher_scan で、テキストの中で最も手前で始まる出現を探すための状態
+ * 同じ位置で始まる出現が複数あれば短いキーワードを選ぶ
+ */
+typedef struct MatcherFirstMatch {
+    gsize max_length;
+    const MatcherKeyword *keyword; /* まだ見つかっていなければ NULL */
+    gsize offset;
+} MatcherFirstMatch;
+
+/**
+ * Matcher_scanLines で、すべての出現を行とともに報告するための状態
+ * 同じ行の出現が続くときに行末を探し直さないよう、最後に求めた行末を覚えておく
+ */
+typedef struct MatcherLineContext {
+    LineCounter lines;
+    gsize line_end;
+    gsize line_end_start; /* line_end を求めた行の先頭。まだ求めていなければ G_MAXSIZE */
+    MatcherLineFunc func;
+    gpointer user_data;
+} MatcherLineContext;
+
+/**
+ * Matcher_scanLines で1行に1つだけ報告するときに、テキストの中で最も手前の出現を探すための状態
+ * 同じ位置で始まる出現が複数あれば短いキーワードを選ぶ
+ */
+typedef struct MatcherLineSearch {
+    const gchar *text;
+    gsize textlen;
+    gsize max_length;
+    const MatcherKeyword *keyword; /* まだ見つかっていなければ NULL */
+    gsize offset;
+    gsize line_end;                /* offset を含む行の末尾 */
+} MatcherLineSearch;
+
+/**
+ * 単一パターンのエンジンで Matcher_scanLines に集めた出現
+ */
+typedef struct MatcherLineMatch {
+    gsize offset;
+    gsize keywordlen; /* 並べ替えで keyword を辿らずに済むよう写しておく */
+    const MatcherKeyword *keyword;
+} MatcherLineMatch;
+
+/**
+ * 連結したテキスト上の1つの文字列の開始位置と、渡された配列での添字
+ */
+typedef struct MatcherBatchSegment {
+    gsize start;
+    gsize index;
+} MatcherBatchSegment;
+
+/**
+ * 連結したテキスト上で報告された出現と、それを含む文字列の添字
+ */
+typedef struct MatcherBatchFound {
+    gsize index;
+    MatcherBatchMatch match;
+} MatcherBatchFound;
+
+/**
+ * 短い文字列のまとまりを1回の走査で検査するための作業領域と結果
+ * 文字列を NUL で区切って1つのテキストに連結し、エンジンを1回だけ呼び出す
+ * キーワードは NUL を含まないので、区切りをまたぐ出現は報告されない
+ * 領域は縮めずに使い回すので、同じ大きさのまとまりを繰り返し走査するときは確保しない
+ */
+struct MatcherBatch {
+    GString *text;
+    GArray *segments;   /* 要素は MatcherBatchSegment。start の昇順 */
+    gsize cursor;       /* 直前の出現を含んでいた segments の添字 */
+    guint8 *status;     /* 文字列ごとの MatcherBatchStatus */
+    gsize *first_match; /* i 番目の文字列の出現は matches の [first_match[i], first_match[i + 1]) */
+    gsize n_strings;
+    gsize capacity;     /* status の要素数。first_match は1つ多い */
+    gboolean collect;
+    GArray *found;      /* 要素は MatcherBatchFound。報告された順 */
+    GArray *matches;    /* 要素は MatcherBatchMatch。文字列の順に並べ直したもの */
+    UTF16Buffer buffer;
+};
+
+static inline const MatcherKeyword *
+Matcher_getKeyword(Matcher *self, guint index)
+{
+    return (const MatcherKeyword *) g_ptr_array_index(self->keywords, index);
+}
+
+/**
+ * u16offset を UTF-8 のバイトオフセットに変換する
+ * Commentz-Walter も Aho-Corasick も末尾位置の昇順で報告するので、前回の位置から読み進めればよい
+ */
+static gsize
+MatcherScanContext_toByteOffset(MatcherScanContext *self, gsize u16offset)
+{
+    const guchar *cursor = self->cursor;
+    gsize cursor_u16 = self->cursor_u16;
+    g_assert(cursor_u16 <= u16offset);
+    while (cursor_u16 < u16offset) {
+        guchar lead = *cursor;
+        if (lead < 0x80) {
+            cursor += 1;
+        } else if (lead < 0xE0) {
+            cursor += 2;
+        } else if (lead < 0xF0) {
+            cursor += 3;
+        } else {
+            /* サロゲートペアになる */
+            cursor += 4;
+            ++cursor_u16;
+        }
+        ++cursor_u16;
+    }
+    self->cursor = cursor;
+    self->cursor_u16 = cursor_u16;
+    return (const gchar *) cursor - self->text;
+}
+
+static gboolean
+Matcher_reportByteMatch(gconstpointer output, gsize end_offset, gpointer user_data)
+{
+    MatcherScanContext *context = (MatcherScanContext *) user_data;
+    const MatcherKeyword *keyword = MatcherKeyword_fromOutput(output);
+    return context->func(keyword->text, keyword->length, end_offset - keyword->length, context->user_data);
+}
+
+static gboolean
+Matcher_reportUTF16Match(gconstpointer output, gsize end_offset, gpointer user_data)
+{
+    MatcherScanContext *context = (MatcherScanContext *) user_data;
+    const MatcherKeyword *keyword = MatcherKeyword_fromOutput(output);
+    gsize end = MatcherScanContext_toByteOffset(context, end_offset);
+    return context->func(keyword->text, keyword->length, end - keyword->length, context->user_data);
+}
+
+/**
+ * 複数パターンのエンジンは末尾の位置の順に報告するので、最初に報告された出現は最も手前で始まるとは限らない
+ * 末尾が見つかった出現の開始位置から最長のキーワードの長さより先にあれば、それ以降の出現はすべて後ろで始まる
+ */
+static gboolean
+Matcher_findFirstMatch(const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    MatcherFirstMatch *first = (MatcherFirstMatch *) user_data;
+    if (NULL != first->keyword) {
+        if (first->offset + first->max_length < offset + keywordlen) {
+            return FALSE;
+        }
+        if (first->offset < offset || (first->offset == offset && first->keyword->length <= keywordlen)) {
+            return TRUE;
+        }
+    }
+    first->keyword = MatcherKeyword_fromOutput(keyword);
+    first->offset = offset;
+    return TRUE;
+}
+
+static void
+MatcherLineSearch_update(MatcherLineSearch *self, const MatcherKeyword *keyword, gsize offset)
+{
+    if (NULL != self->keyword &&
+        (self->offset < offset || (self->offset == offset && self->keyword->length <= keyword->length))) {
+        return;
+    }
+    self->keyword = keyword;
+    self->offset = offset;
+    const gchar *newline = (const gchar *) memchr(self->text + offset, '\n', self->textlen - offset);
+    self->line_end = (NULL == newline) ? self->textlen : (gsize) (newline - self->text);
+}
+
+/**
+ * 複数パターンのエンジンは末尾の位置の順に報告するので、末尾が見つかった行の末尾から最長のキーワードの長さより先にあれば、
+ * それ以降の出現はすべて後ろの行で始まる
+ */
+static gboolean
+MatcherLineSearch_report(const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    MatcherLineSearch *self = (MatcherLineSearch *) user_data;
+    if (NULL != self->keyword && self->line_end + self->max_length < offset + keywordlen) {
+        return FALSE;
+    }
+    MatcherLineSearch_update(self, MatcherKeyword_fromOutput(keyword), offset);
+    return TRUE;
+}
+
+static gboolean
+Matcher_reportLine(const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    MatcherLineContext *context = (MatcherLineContext *) user_data;
+    LineCounter_seek(&context->lines, offset);
+    if (context->line_end_start != context->lines.line_start) {
+        context->line_end = LineCounter_getLineEnd(&context->lines);
+        context->line_end_start = context->lines.line_start;
+    }
+    MatcherLine line = {context->lines.number, context->lines.line_start, context->line_end - context->lines.line_start};
+    return context->func(&line, keyword, keywordlen, offset, context->user_data);
+}
+
+/* 単一パターンのエンジンに共通の実装で、impl はキーワードごとの前処理結果の配列になる */
+
+static gboolean
+Matcher_compileSingle(Matcher *self, GError **error)
+{
+    guint n_keywords = self->keywords->len;
+    gpointer *impls = g_new0(gpointer, n_keywords);
+    for (guint i = 0; i < n_keywords; ++i) {
+        if (!self->klass->compileOne(Matcher_getKeyword(self, i), &impls[i], error)) {
+            for (guint j = 0; j < i; ++j) {
+                if (NULL != self->klass->freeOne) {
+                    self->klass->freeOne(impls[j]);
+                }
+            }
+            g_free(impls);
+            return FALSE;
+        }
+    }
+    self->impl = impls;
+    return TRUE;
+}
+
+static void
+Matcher_freeSingle(Matcher *self)
+{
+    gpointer *impls = (gpointer *) self->impl;
+    if (NULL != self->klass->freeOne) {
+        for (guint i = 0; i < self->keywords->len; ++i) {
+            self->klass->freeOne(impls[i]);
+        }
+    }
+    g_free(impls);
+}
+
+/**
+ * キーワードごとの最初の出現のうち、最も手前で始まるものを返す
+ * 同じ位置で始まる出現が複数あれば短いキーワードを選び、複数パターンのエンジンと同じ結果にする
+ */
+static gboolean
+Matcher_scanSingle(Matcher *self, const gchar *text, gsize textlen,
+                   const MatcherKeyword **keyword, gsize *offset, GError **error)
+{
+    gpointer *impls = (gpointer *) self->impl;
+    const MatcherKeyword *best = NULL;
+    gsize best_offset = 0;
+    for (guint i = 0; i < self->keywords->len; ++i) {
+        const MatcherKeyword *current = Matcher_getKeyword(self, i);
+        /* 見つかった出現より後ろで始まる出現は選ばれないので、その手前までを探す */
+        gsize limit = (NULL == best) ? textlen : MIN(textlen, best_offset + current->length);
+        const gchar *found = self->klass->findOne(impls[i], current, text, limit);
+        if (NULL == found) {
+            continue;
+        }
+        gsize found_offset = found - text;
+        if (NULL == best || found_offset < best_offset ||
+            (found_offset == best_offset && current->length < best->length)) {
+            best = current;
+            best_offset = found_offset;
+        }
+    }
+    if (NULL != best) {
+        *keyword = best;
+        *offset = best_offset;
+    }
+    return TRUE;
+}
+
+static gboolean
+Matcher_scanAllSingle(Matcher *self, const gchar *text, gsize textlen, UTF16Buffer *buffer,
+                      MatcherFunc func, gpointer user_data, GError **error)
+{
+    gpointer *impls = (gpointer *) self->impl;
+    const gchar *const text_end = text + textlen;
+    for (guint i = 0; i < self->keywords->len; ++i) {
+        const MatcherKeyword *keyword = Matcher_getKeyword(self, i);
+        const gchar *text_iter = text;
+        const gchar *found = NULL;
+        /* 重なり合う出現も報告するので、見つかった位置の次から探し直す */
+        while (NULL != (found = self->klass->findOne(impls[i], keyword, text_iter, text_end - text_iter))) {
+            if (!func(keyword->text, keyword->length, found - text, user_data)) {
+                return TRUE;
+            }
+            text_iter = found + 1;
+        }
+    }
+    return TRUE;
+}
+
+/* 複数パターンのエンジンに共通の実装 */
+
+static gboolean
+Matcher_scanMultiple(Matcher *self, const gchar *text, gsize textlen,
+                     const MatcherKeyword **keyword, gsize *offset, GError **error)
+{
+    MatcherFirstMatch first = {self->max_length, NULL, 0};
+    if (!self->klass->scanAll(self, text, textlen, NULL, Matcher_findFirstMatch, &first, error)) {
+        return FALSE;
+    }
+    if (NULL != first.keyword) {
+        *keyword = first.keyword;
+        *offset = first.offset;
+    }
+    return TRUE;
+}
+
+#ifdef __SSE2__
+
+static gboolean
+Matcher_compileNaive(const MatcherKeyword *keyword, gpointer *impl, GError **error)
+{
+    /* キーワードを直接使うので、前処理はない */
+    *impl = NULL;
+    return TRUE;
+}
+
+static const gchar *
+Matcher_findNaive(gpointer impl, const MatcherKeyword *keyword, const gchar *text, gsize textlen)
+{
+    return UnicodeNaiveMatcher_findWithSIMD(keyword->text, keyword->length, text, textlen);
+}
+
+#endif // __SSE2__
+
+static gboolean
+Matcher_compileSunday(const MatcherKeyword *keyword, gpointer *impl, GError **error)
+{
+    *impl = SundayMatcher_new(keyword->text, keyword->length);
+    return TRUE;
+}
+
+static const gchar *
+Matcher_findSunday(gpointer impl, const MatcherKeyword *keyword, const gchar *text, gsize textlen)
+{
+#ifdef __SSE2__
+    return SundayMatcher_findWithSIMD((SundayMatcher *) impl, text, textlen);
+#else
+    return SundayMatcher_find((SundayMatcher *) impl, text, textlen);
+#endif
+}
+
+static gboolean
+Matcher_compileBoyerMoore(const MatcherKeyword *keyword, gpointer *impl, GError **error)
+{
+    if (G_MAXUINT16 < keyword->u16length) {
+        g_set_error(error, MATCHER_ERROR, MATCHER_ERROR_UNSUPPORTED_ENGINE,
+                    "keyword is too long for boyer-moore: len=%ld, max=%ld",
+                    (glong) keyword->u16length, (glong) G_MAXUINT16);
+        return FALSE;
+    }
+    glong u16length = 0L;
+    gunichar2 *u16keyword = g_utf8_to_utf16(keyword->text, keyword->length, NULL, &u16length, error);
+    if (NULL == u16keyword) {
+        return FALSE;
+    }
+    *impl = UnicodeBoyerMooreMatcher_new(u16keyword, u16length);
+    g_free(u16keyword);
+    return TRUE;
+}
+
+static const gchar *
+Matcher_findBoyerMoore(gpointer impl, const MatcherKeyword *keyword, const gchar *text, gsize textlen)
+{
+    return UnicodeBoyerMooreMatcher_findUTF8String((UnicodeBoyerMooreMatcher *) impl, text, textlen);
+}
+
+static gboolean
+Matcher_compileCommentzWalter(Matcher *self, GError **error)
+{
+    CommentzWalterMatcher *impl = CommentzWalterMatcher_new(self->max_length);
+    for (guint i = 0; i < self->keywords->len; ++i) {
+        const MatcherKeyword *keyword = Matcher_getKeyword(self, i);
+        CommentzWalterMatcher_addKeyword(impl, keyword->text, keyword->length);
+    }
+    CommentzWalterMatcher_compile(impl);
+    self->impl = impl;
+    return TRUE;
+}
+
+static void
+Matcher_freeCommentzWalter(Matcher *self)
+{
+    CommentzWalterMatcher_free((CommentzWalterMatcher *) self->impl);
+}
+
+static gboolean
+Matcher_scanAllCommentzWalter(Matcher *self, const gchar *text, gsize textlen, UTF16Buffer *buffer,
+                              MatcherFunc func, gpointer user_data, GError **error)
+{
+    MatcherScanContext context = {text, (const guchar *) text, 0, func, user_data};
+    CommentzWalterMatcher_scanAll((CommentzWalterMatcher *) self->impl, text, textlen,
+                                  Matcher_reportByteMatch, &context);
+    return TRUE;
+}
+
+static gboolean
+Matcher_compileUnicodeCommentzWalter(Matcher *self, GError **error)
+{
+    UnicodeCommentzWalterMatcher *impl = UnicodeCommentzWalterMatcher_new(self->max_u16length);
+    for (guint i = 0; i < self->keywords->len; ++i) {
+        const MatcherKeyword *keyword = Matcher_getKeyword(self, i);
+        if (!UnicodeCommentzWalterMatcher_addKeywordAsUTF8(impl, keyword->text, keyword->length, error)) {
+            UnicodeCommentzWalterMatcher_free(impl);
+            return FALSE;
+        }
+    }
+    UnicodeCommentzWalterMatcher_compile(impl);
+    self->impl = impl;
+    return TRUE;
+}
+
+static void
+Matcher_freeUnicodeCommentzWalter(Matcher *self)
+{
+    UnicodeCommentzWalterMatcher_free((UnicodeCommentzWalterMatcher *) self->impl);
+}
+
+static gboolean
+Matcher_scanAllUnicodeCommentzWalter(Matcher *self, const gchar *text, gsize textlen, UTF16Buffer *buffer,
+                                     MatcherFunc func, gpointer user_data, GError **error)
+{
+    /* 変換用の領域は呼び出し側か呼び出しごとに持ち、同じ Matcher を複数のスレッドから使えるようにする */
+    UTF16Buffer local_buffer = UTF16BUFFER_INIT;
+    UTF16Buffer *u16buffer = (NULL != buffer) ? buffer : &local_buffer;
+    glong u16textlen = 0L;
+    gboolean scanned = UTF8Transcoder_toUTF16(text, textlen, u16buffer, &u16textlen, error);
+    if (scanned) {
+        MatcherScanContext context = {text, (const guchar *) text, 0, func, user_data};
+        UnicodeCommentzWalterMatcher_scanAllUTF16String((UnicodeCommentzWalterMatcher *) self->impl,
+                                                        u16buffer->data, u16textlen, Matcher_reportUTF16Match, &context);
+    }
+    UTF16Buffer_clear(&local_buffer);
+    return scanned;
+}
+
+static gboolean
+Matcher_compileAhoCorasick(Matcher *self, GError **error)
+{
+    UnicodeAhoCorasickMatcher *impl = UnicodeAhoCorasickMatcher_new(self->max_u16length);
+    for (guint i = 0; i < self->keywords->len; ++i) {
+        const MatcherKeyword *keyword = Matcher_getKeyword(self, i);
+        if (!UnicodeAhoCorasickMatcher_addKeywordAsUTF8(impl, keyword->text, keyword->length, error)) {
+            UnicodeAhoCorasickMatcher_free(impl);
+            return FALSE;
+        }
+    }
+    /* 走査が失敗遷移を書き換えないように、ここで求めておく */
+    UnicodeAhoCorasickMatcher_compile(impl);
+    self->impl = impl;
+    return TRUE;
+}
+
+static void
+Matcher_freeAhoCorasick(Matcher *self)
+{
+    UnicodeAhoCorasickMatcher_free((UnicodeAhoCorasickMatcher *) self->impl);
+}
+
+static gboolean
+Matcher_scanAllAhoCorasick(Matcher *self, const gchar *text, gsize textlen, UTF16Buffer *buffer,
+                           MatcherFunc func, gpointer user_data, GError **error)
+{
+    UTF16Buffer local_buffer = UTF16BUFFER_INIT;
+    UTF16Buffer *u16buffer = (NULL != buffer) ? buffer : &local_buffer;
+    glong u16textlen = 0L;
+    gboolean scanned = UTF8Transcoder_toUTF16(text, textlen, u16buffer, &u16textlen, error);
+    if (scanned) {
+        MatcherScanContext context = {text, (const guchar *) text, 0, func, user_data};
+        UnicodeAhoCorasickMatcher_scanAllUTF16String((UnicodeAhoCorasickMatcher *) self->impl,
+                                                     u16buffer->data, u16textlen, Matcher_reportUTF16Match, &context);
+    }
+    UTF16Buffer_clear(&local_buffer);
+    return scanned;
+}
+
+static const MatcherClass matcher_classes[] = {
+#ifdef __SSE2__
+    {
+        MATCHER_ENGINE_NAIVE_SIMD, "naive-SIMD",
+        Matcher_compileSingle, Matcher_scanSingle, Matcher_scanAllSingle, Matcher_freeSingle,
+        Matcher_compileNaive, Matcher_findNaive, NULL, NULL, NULL, NULL,
+    },
+#endif // __SSE2__
+    {
+        MATCHER_ENGINE_SUNDAY, "Sunday",
+        Matcher_compileSingle, Matcher_scanSingle, Matcher_scanAllSingle, Matcher_freeSingle,
+        Matcher_compileSunday, Matcher_findSunday, (GDestroyNotify) SundayMatcher_free,
+        (const ScanStats *(*)(gconstpointer)) SundayMatcher_getStats, (void (*)(gpointer)) SundayMatcher_resetStats,
+        (void (*)(gconstpointer, MemoryUsage *)) SundayMatcher_memoryUsage,
+    },
+    {
+        MATCHER_ENGINE_BOYER_MOORE, "Boyer-Moore",
+        Matcher_compileSingle, Matcher_scanSingle, Matcher_scanAllSingle, Matcher_freeSingle,
+        Matcher_compileBoyerMoore, Matcher_findBoyerMoore, (GDestroyNotify) UnicodeBoyerMooreMatcher_free,
+        (const ScanStats *(*)(gconstpointer)) UnicodeBoyerMooreMatcher_getStats,
+        (void (*)(gpointer)) UnicodeBoyerMooreMatcher_resetStats,
+        (void (*)(gconstpointer, MemoryUsage *)) UnicodeBoyerMooreMatcher_memoryUsage,
+    },
+    {
+        MATCHER_ENGINE_COMMENTZ_WALTER, "Commentz-Walter",
+        Matcher_compileCommentzWalter, Matcher_scanMultiple, Matcher_scanAllCommentzWalter, Matcher_freeCommentzWalter,
+        NULL, NULL, NULL,
+        (const ScanStats *(*)(gconstpointer)) CommentzWalterMatcher_getStats,
+        (void (*)(gpointer)) CommentzWalterMatcher_resetStats,
+        (void (*)(gconstpointer, MemoryUsage *)) CommentzWalterMatcher_memoryUsage,
+    },
+    {
+        MATCHER_ENGINE_UNICODE_COMMENTZ_WALTER, "Commentz-Walter-Unicode",
+        Matcher_compileUnicodeCommentzWalter, Matcher_scanMultiple, Matcher_scanAllUnicodeCommentzWalter,
+        Matcher_freeUnicodeCommentzWalter, NULL, NULL, NULL,
+        (const ScanStats *(*)(gconstpointer)) UnicodeCommentzWalterMatcher_getStats,
+        (void (*)(gpointer)) UnicodeCommentzWalterMatcher_resetStats,
+        (void (*)(gconstpointer, MemoryUsage *)) UnicodeCommentzWalterMatcher_memoryUsage,
+    },
+    {
+        MATCHER_ENGINE_AHO_CORASICK, "Aho-Corasick",
+        Matcher_compileAhoCorasick, Matcher_scanMultiple, Matcher_scanAllAhoCorasick, Matcher_freeAhoCorasick,
+        NULL, NULL, NULL,
+        (const ScanStats *(*)(gconstpointer)) UnicodeAhoCorasickMatcher_getStats,
+        (void (*)(gpointer)) UnicodeAhoCorasickMatcher_resetStats,
+        (void (*)(gconstpointer, MemoryUsage *)) UnicodeAhoCorasickMatcher_memoryUsage,
+    },
+};
+
+static const MatcherClass *
+MatcherClass_lookup(MatcherEngine engine)
+{
+    for (gsize i = 0; i < G_N_ELEMENTS(matcher_classes); ++i) {
+        if (engine == matcher_classes[i].engine) {
+            return &matcher_classes[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * エンジンの名前を返す
+ * この環境で使えないエンジンには NULL を返す
+ */
+const gchar *
+MatcherEngine_getName(MatcherEngine engine)
+{
+    const MatcherClass *klass = MatcherClass_lookup(engine);
+    return (NULL == klass) ? NULL : klass->name;
+}
+
+/**
+ * コンパイル済みのエンジンを破棄する
+ * キーワードが追加されたら、次の検査のときにエンジンを選び直す
+ */
+static void
+Matcher_reset(Matcher *self)
+{
+    if (NULL != self->klass) {
+        self->klass->free(self);
+    }
+    self->klass = NULL;
+    self->impl = NULL;
+}
+
+Matcher *
+Matcher_new(void)
+{
+    Matcher *self = (Matcher *) g_malloc0(sizeof(Matcher));
+    self->keywords = g_ptr_array_new_with_free_func(g_free);
+    self->keyword_set = g_hash_table_new(g_str_hash, g_str_equal);
+    self->min_length = G_MAXSIZE;
+    self->min_u16length = G_MAXSIZE;
+    self->ascii = TRUE;
+    self->expected_scan_bytes = MATCHER_DEFAULT_EXPECTED_SCAN_BYTES;
+    return self;
+}
+
+void
+Matcher_free(Matcher *self)
+{
+    if (NULL == self) {
+        return;
+    }
+    Matcher_reset(self);
+    g_hash_table_destroy(self->keyword_set);
+    g_ptr_array_free(self->keywords, TRUE);
+    g_free(self);
+}
+
+/**
+ * キーワードを登録する
+ * キーワードは複製して保持するので、呼び出し後に解放してよい
+ * 空のキーワードと UTF-8 として不正なキーワード (NUL を含むものを含む) は受け付けない
+ */
+gboolean
+Matcher_addKeyword(Matcher *self, const gchar *keyword, glong length, GError **error)
+{
+    if (0L > length) {
+        length = strlen(keyword);
+    }
+    if (0L == length) {
+        g_set_error_literal(error, MATCHER_ERROR, MATCHER_ERROR_INVALID_KEYWORD, "keyword is empty");
+        return FALSE;
+    }
+    if (!g_utf8_validate(keyword, length, NULL)) {
+        g_set_error_literal(error, MATCHER_ERROR, MATCHER_ERROR_INVALID_KEYWORD, "keyword is not valid UTF-8");
+        return FALSE;
+    }
+    MatcherKeyword *new_keyword = (MatcherKeyword *) g_malloc(sizeof(MatcherKeyword) + length + 1);
+    new_keyword->length = length;
+    memcpy(new_keyword->text, keyword, length);
+    new_keyword->text[length] = '\0';
+    if (g_hash_table_contains(self->keyword_set, new_keyword->text)) {
+        g_free(new_keyword);
+        return TRUE;
+    }
+
+    gboolean ascii = TRUE;
+    gsize u16length = 0;
+    for (glong i = 0; i < length; ++i) {
+        guchar c = (guchar) keyword[i];
+        if (0x80 <= c) {
+            ascii = FALSE;
+        }
+        if (0x80 != (c & 0xC0)) {
+            /* 4バイト文字はサロゲートペアになる */
+            u16length += (0xF0 <= c) ? 2 : 1;
+        }
+    }
+    new_keyword->u16length = u16length;
+    /* 前処理結果はキーワードの本数に依存するので、追加する前に破棄する */
+    Matcher_reset(self);
+    g_ptr_array_add(self->keywords, new_keyword);
+    g_hash_table_add(self->keyword_set, new_keyword->text);
+
+    self->min_length = MIN(self->min_length, (gsize) length);
+    self->max_length = MAX(self->max_length, (gsize) length);
+    self->total_length += length;
+    self->min_u16length = MIN(self->min_u16length, u16length);
+    self->max_u16length = MAX(self->max_u16length, u16length);
+    self->ascii = self->ascii && ascii;
+    self->newline = self->newline || NULL != memchr(keyword, '\n', length);
+    return TRUE;
+}
+
+/**
+ * コストプロファイルがないときに、経験則でエンジンを選ぶ
+ *
+ * キーワードが1本の場合:
+ * - 短ければスキップがほとんど利かないので、先頭と末尾のバイトを SIMD で絞り込む総当たり
+ * - SIMD で候補を絞り込めるなら、文字種によらず Sunday 法
+ *   Boyer-Moore 法も UTF-8 のバイト列を Horspool 法の不一致文字規則だけでずらすので、
+ *   CJK のキーワードでも候補の絞り込みがある Sunday 法の方が速い
+ * - 絞り込みがなければ、ASCII のみなら Sunday 法、CJK などを含むなら Boyer-Moore 法
+ * キーワードが複数の場合:
+ * - ASCII のみでトライが小さければ、表引きで遷移できるバイト単位の Commentz-Walter 法
+ * - 最短キーワードが十分長ければ、スキップの利く UTF-16 版の Commentz-Walter 法
+ * - それ以外はキーワード数や長さに性能が左右されにくい Aho-Corasick 法
+ */
+static MatcherEngine
+Matcher_planEngineByRule(Matcher *self)
+{
+    guint n_keywords = self->keywords->len;
+    if (1 == n_keywords) {
+#ifdef __SSE2__
+        if (self->max_length < MATCHER_PLAN_MAX_NAIVE_LENGTH) {
+            return MATCHER_ENGINE_NAIVE_SIMD;
+        }
+        return MATCHER_ENGINE_SUNDAY;
+#else
+        if (self->ascii || G_MAXUINT16 < self->max_u16length) {
+            return MATCHER_ENGINE_SUNDAY;
+        }
+        return MATCHER_ENGINE_BOYER_MOORE;
+#endif // __SSE2__
+    }
+    if (self->ascii && self->total_length <= MATCHER_PLAN_MAX_BYTE_TRIE_SIZE) {
+        return MATCHER_ENGINE_COMMENTZ_WALTER;
+    }
+    if (MATCHER_PLAN_MIN_SKIP_LENGTH <= self->min_u16length && n_keywords <= MATCHER_PLAN_MAX_CW_KEYWORDS) {
+        return MATCHER_ENGINE_UNICODE_COMMENTZ_WALTER;
+    }
+    return MATCHER_ENGINE_AHO_CORASICK;
+}
+
+/**
+ * 予測コストが最小のエンジンを選ぶ
+ * 単一パターンのエンジンはキーワードごとに走査するコストとして計測されているので、そのまま比較できる
+ * どのエンジンの計測値も使えなければ MATCHER_ENGINE_AUTO を返す
+ */
+static MatcherEngine
+Matcher_planEngineByCost(Matcher *self, const MatcherCostProfile *profile)
+{
+    MatcherAlphabet alphabet = self->ascii ? MATCHER_ALPHABET_ASCII : MATCHER_ALPHABET_CJK;
+    MatcherEngine best_engine = MATCHER_ENGINE_AUTO;
+    gdouble best_cost = 0.0;
+    for (gsize i = 0; i < G_N_ELEMENTS(matcher_classes); ++i) {
+        MatcherEngine engine = matcher_classes[i].engine;
+        /* 計測値に関係なく、メモリや実装の制約を満たさないエンジンは選ばない */
+        if (MATCHER_ENGINE_COMMENTZ_WALTER == engine && MATCHER_PLAN_MAX_BYTE_TRIE_SIZE < self->total_length) {
+            continue;
+        }
+        if (MATCHER_ENGINE_BOYER_MOORE == engine && G_MAXUINT16 < self->max_u16length) {
+            continue;
+        }
+        gdouble cost = 0.0;
+        if (!MatcherCostProfile_predict(profile, engine, alphabet, self->keywords->len, self->min_u16length,
+                                        self->total_length, self->expected_scan_bytes, &cost)) {
+            continue;
+        }
+        if (MATCHER_ENGINE_AUTO == best_engine || cost < best_cost) {
+            best_engine = engine;
+            best_cost = cost;
+        }
+    }
+    return best_engine;
+}
+
+/**
+ * 登録済みのキーワードに最適なエンジンを選ぶ
+ * コストプロファイルがあれば予測コストで選び、なければ経験則で選ぶ
+ */
+MatcherEngine
+Matcher_planEngine(Matcher *self)
+{
+    const MatcherCostProfile *profile = self->cost_profile;
+    if (NULL == profile) {
+        profile = MatcherCostProfile_getDefault();
+    }
+    if (NULL != profile) {
+        MatcherEngine engine = Matcher_planEngineByCost(self, profile);
+        if (MATCHER_ENGINE_AUTO != engine) {
+            return engine;
+        }
+    }
+    return Matcher_planEngineByRule(self);
+}
+
+/**
+ * エンジンを選ぶときに使うコストプロファイルを指定する
+ * NULL を指定すると、環境変数 STRING_MATCHING_COST_PROFILE で指定されたプロファイルを使う
+ * プロファイルは Matcher より長く生存しなければならない
+ */
+void
+Matcher_setCostProfile(Matcher *self, const MatcherCostProfile *profile)
+{
+    self->cost_profile = profile;
+}
+
+/**
+ * Matcher を破棄するまでに走査すると見込むテキストの総バイト数を指定する
+ * 前処理のコストと走査のコストのどちらを重視するかが変わる
+ */
+void
+Matcher_setExpectedScanBytes(Matcher *self, gsize scan_bytes)
+{
+    self->expected_scan_bytes = scan_bytes;
+}
+
+/**
+ * エンジンを前処理する
+ * engine に MATCHER_ENGINE_AUTO を指定すると Matcher_planEngine の選んだエンジンを使う
+ */
+gboolean
+Matcher_compile(Matcher *self, MatcherEngine engine, GError **error)
+{
+    if (0 == self->keywords->len) {
+        g_set_error_literal(error, MATCHER_ERROR, MATCHER_ERROR_NO_KEYWORD, "no keyword is added");
+        return FALSE;
+    }
+    if (MATCHER_ENGINE_AUTO == engine) {
+        engine = Matcher_planEngine(self);
+    }
+    const MatcherClass *klass = MatcherClass_lookup(engine);
+    if (NULL == klass) {
+        g_set_error(error, MATCHER_ERROR, MATCHER_ERROR_UNSUPPORTED_ENGINE,
+                    "engine is not available: %d", (gint) engine);
+        return FALSE;
+    }
+    Matcher_reset(self);
+    self->klass = klass;
+    if (!klass->compile(self, error)) {
+        self->klass = NULL;
+        self->impl = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * 使用中のエンジンを返す
+ * まだコンパイルしていなければ MATCHER_ENGINE_AUTO を返す
+ */
+MatcherEngine
+Matcher_getEngine(Matcher *self)
+{
+    return (NULL == self->klass) ? MATCHER_ENGINE_AUTO : self->klass->engine;
+}
+
+const gchar *
+Matcher_getEngineName(Matcher *self)
+{
+    return (NULL == self->klass) ? "auto" : self->klass->name;
+}
+
+/**
+ * 重複を除いて登録したキーワードの本数を返す
+ */
+guint
+Matcher_getKeywordCount(Matcher *self)
+{
+    return self->keywords->len;
+}
+
+/**
+ * テキストにキーワードが含まれるかを検査する
+ * 最も手前で始まる出現のキーワードを keyword に、その開始位置のバイトオフセットを offset に代入する
+ * 同じ位置で始まる出現が複数あれば短いキーワードを選ぶので、結果はエンジンによらない
+ * 見つからなければ keyword に NULL を代入する
+ * コンパイルしていなければ、自動で選んだエンジンでコンパイルする
+ * UTF-16 に変換するエンジンは不正な UTF-8 をエラーにするが、バイト単位のエンジンは検証せずに照合する
+ */
+gboolean
+Matcher_scan(Matcher *self, const gchar *text, glong textlen,
+             const gchar **keyword, gsize *offset, GError **error)
+{
+    g_assert(NULL != keyword);
+    *keyword = NULL;
+    if (0L > textlen) {
+        textlen = strlen(text);
+    }
+    if (NULL == self->klass && !Matcher_compile(self, MATCHER_ENGINE_AUTO, error)) {
+        return FALSE;
+    }
+    if (0L == textlen) {
+        return TRUE;
+    }
+    const MatcherKeyword *found = NULL;
+    gsize found_offset = 0;
+    if (!self->klass->scan(self, text, textlen, &found, &found_offset, error)) {
+        return FALSE;
+    }
+    if (NULL != found) {
+        *keyword = found->text;
+        if (NULL != offset) {
+            *offset = found_offset;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * テキストに現れるすべてのキーワードを func に通知する
+ * 重なり合う出現もすべて報告する。報告の順序はエンジンによって異なる
+ */
+gboolean
+Matcher_scanAll(Matcher *self, const gchar *text, glong textlen,
+                MatcherFunc func, gpointer user_data, GError **error)
+{
+    return Matcher_scanAllWithBuffer(self, text, textlen, NULL, func, user_data, error);
+}
+
+/**
+ * Matcher_scanAll と同じだが、UTF-16 に変換するエンジンでは呼び出し側の buffer を変換先として使い回す
+ * buffer をスレッドごとに持てば、同じ Matcher を複数のスレッドから走査しても変換のたびに確保しない
+ * buffer が NULL なら Matcher_scanAll と同じく呼び出しごとに確保する
+ */
+gboolean
+Matcher_scanAllWithBuffer(Matcher *self, const gchar *text, glong textlen, UTF16Buffer *buffer,
+                          MatcherFunc func, gpointer user_data, GError **error)
+{
+    if (0L > textlen) {
+        textlen = strlen(text);
+    }
+    if (NULL == self->klass && !Matcher_compile(self, MATCHER_ENGINE_AUTO, error)) {
+        return FALSE;
+    }
+    if (0L == textlen) {
+        return TRUE;
+    }
+    return self->klass->scanAll(self, text, textlen, buffer, func, user_data, error);
+}
+
+static inline gboolean
+MatcherLineMatch_precedes(const MatcherLineMatch *x, const MatcherLineMatch *y)
+{
+    return x->offset < y->offset || (x->offset == y->offset && x->keywordlen < y->keywordlen);
+}
+
+/**
+ * キーワードごとに位置の順に並んだ n_runs 個の区間 matches[run_starts[i], run_starts[i + 1]) を、隣り合う区間ごとに
+ * 併合して1つの列にする。区間は走査したキーワードの数しかないので、比較で並べ替えるより速い
+ * run_starts は n_runs + 1 個の要素を持ち、併合の途中で書き換える
+ */
+static void
+MatcherLineMatch_mergeRuns(MatcherLineMatch *matches, gsize n_matches, gsize *run_starts, guint n_runs)
+{
+    if (1 >= n_runs) {
+        return;
+    }
+    MatcherLineMatch *work = g_new(MatcherLineMatch, n_matches);
+    MatcherLineMatch *src = matches;
+    MatcherLineMatch *dst = work;
+    while (1 < n_runs) {
+        guint n_merged = 0;
+        for (guint r = 0; r < n_runs; r += 2) {
+            gsize i = run_starts[r];
+            gsize middle = (r + 1 < n_runs) ? run_starts[r + 1] : run_starts[n_runs];
+            gsize j = middle;
+            gsize end = (r + 1 < n_runs) ? run_starts[r + 2] : run_starts[n_runs];
+            gsize k = i;
+            run_starts[n_merged++] = i;
+            while (i < middle && j < end) {
+                dst[k++] = MatcherLineMatch_precedes(&src[j], &src[i]) ? src[j++] : src[i++];
+            }
+            memcpy(dst + k, src + i, sizeof(MatcherLineMatch) * (middle - i));
+            k += middle - i;
+            memcpy(dst + k, src + j, sizeof(MatcherLineMatch) * (end - j));
+        }
+        run_starts[n_merged] = n_matches;
+        n_runs = n_merged;
+        MatcherLineMatch *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != matches) {
+        memcpy(matches, src, sizeof(MatcherLineMatch) * n_matches);
+    }
+    g_free(work);
+}
+
+/**
+ * 単一パターンのエンジンで Matcher_scanLines を実装する
+ * キーワードごとに探すと報告が位置の順にならないので、出現を集めてキーワードごとの列を併合してから行を求める
+ * first_match_only なら、キーワードごとに見つかった行の残りを飛ばして次の行から探す
+ */
+static gboolean
+Matcher_scanLinesSingle(Matcher *self, const gchar *text, gsize textlen, gboolean first_match_only,
+                        MatcherLineFunc func, gpointer user_data)
+{
+    gpointer *impls = (gpointer *) self->impl;
+    const gchar *const text_end = text + textlen;
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(MatcherLineMatch));
+    gsize *run_starts = g_new(gsize, self->keywords->len + 1);
+    guint n_runs = 0;
+    for (guint i = 0; i < self->keywords->len; ++i) {
+        const MatcherKeyword *keyword = Matcher_getKeyword(self, i);
+        run_starts[n_runs] = matches->len;
+        const gchar *text_iter = text;
+        const gchar *found = NULL;
+        while (NULL != (found = self->klass->findOne(impls[i], keyword, text_iter, text_end - text_iter))) {
+            MatcherLineMatch match = {found - text, keyword->length, keyword};
+            g_array_append_val(matches, match);
+            if (!first_match_only) {
+                text_iter = found + 1;
+                continue;
+            }
+            const gchar *newline = (const gchar *) memchr(found, '\n', text_end - found);
+            if (NULL == newline) {
+                break;
+            }
+            text_iter = newline + 1;
+        }
+        if (run_starts[n_runs] < matches->len) {
+            ++n_runs;
+        }
+    }
+    run_starts[n_runs] = matches->len;
+    MatcherLineMatch_mergeRuns((MatcherLineMatch *) matches->data, matches->len, run_starts, n_runs);
+    g_free(run_starts);
+    LineCounter lines;
+    LineCounter_init(&lines, text, textlen);
+    MatcherLine line = {0, 0, 0};
+    for (guint i = 0; i < matches->len; ++i) {
+        const MatcherLineMatch *match = &g_array_index(matches, MatcherLineMatch, i);
+        LineCounter_seek(&lines, match->offset);
+        if (line.number != lines.number) {
+            line.number = lines.number;
+            line.offset = lines.line_start;
+            line.length = LineCounter_getLineEnd(&lines) - lines.line_start;
+        } else if (first_match_only) {
+            continue;
+        }
+        if (!func(&line, match->keyword->text, match->keyword->length, match->offset, user_data)) {
+            break;
+        }
+    }
+    g_array_free(matches, TRUE);
+    return TRUE;
+}
+
+/**
+ * キーワードが見つかった行を func に通知する。行は '\n' で区切り、見つかった位置の改行は SIMD でまとめて数える
+ * first_match_only が FALSE なら、すべての出現をその開始位置を含む行とともに報告する
+ * 順序は複数パターンのエンジンでは Matcher_scanAll と同じで、単一パターンのエンジンでは開始位置の順になる
+ * first_match_only が TRUE なら、キーワードを含む行ごとに最も手前 (同じ位置なら最も短いキーワード) の出現を
+ * 1つだけ行の順に報告し、その行の残りは走査せずに次の行から走査を再開する
+ * 複数パターンのエンジンでは、再開のたびにテキストの末尾まで UTF-16 へ変換し直さないよう、
+ * テキストを行の境界で区切った窓ごとに走査し、見つからなかった窓が続けば窓を広げる。改行を含むキーワードがあれば窓に区切らない
+ */
+gboolean
+Matcher_scanLines(Matcher *self, const gchar *text, glong textlen, gboolean first_match_only,
+                  MatcherLineFunc func, gpointer user_data, GError **error)
+{
+    if (0L > textlen) {
+        textlen = strlen(text);
+    }
+    if (NULL == self->klass && !Matcher_compile(self, MATCHER_ENGINE_AUTO, error)) {
+        return FALSE;
+    }
+    if (0L == textlen) {
+        return TRUE;
+    }
+    if (NULL != self->klass->compileOne) {
+        return Matcher_scanLinesSingle(self, text, textlen, first_match_only, func, user_data);
+    }
+    if (!first_match_only) {
+        MatcherLineContext context;
+        LineCounter_init(&context.lines, text, textlen);
+        context.line_end = 0;
+        context.line_end_start = G_MAXSIZE;
+        context.func = func;
+        context.user_data = user_data;
+        return self->klass->scanAll(self, text, textlen, NULL, Matcher_reportLine, &context, error);
+    }
+    LineCounter lines;
+    LineCounter_init(&lines, text, textlen);
+    UTF16Buffer buffer = UTF16BUFFER_INIT;
+    gsize window = MATCHER_LINES_MIN_WINDOW;
+    gsize position = 0;
+    gboolean scanned = TRUE;
+    while (position < (gsize) textlen) {
+        gsize window_end = textlen;
+        if (!self->newline && window < textlen - position) {
+            const gchar *newline = (const gchar *) memchr(text + position + window, '\n', textlen - position - window);
+            window_end = (NULL == newline) ? (gsize) textlen : (gsize) (newline - text) + 1;
+        }
+        MatcherLineSearch search = {text + position, window_end - position, self->max_length, NULL, 0, 0};
+        if (!self->klass->scanAll(self, search.text, search.textlen, &buffer, MatcherLineSearch_report, &search,
+                                  error)) {
+            scanned = FALSE;
+            break;
+        }
+        if (NULL == search.keyword) {
+            position = window_end;
+            window = MIN(window * 2, MATCHER_LINES_MAX_WINDOW);
+            continue;
+        }
+        /* 行が続けて見つかるなら、次の行の先で打ち切れるよう窓を狭める */
+        window = MAX(window / 2, MATCHER_LINES_MIN_WINDOW);
+        gsize offset = position + search.offset;
+        LineCounter_seek(&lines, offset);
+        MatcherLine line = {lines.number, lines.line_start, position + search.line_end - lines.line_start};
+        if (!func(&line, search.keyword->text, search.keyword->length, offset, user_data)) {
+            break;
+        }
+        position = line.offset + line.length + 1;
+    }
+    UTF16Buffer_clear(&buffer);
+    return scanned;
+}
+
+MatcherBatch *
+MatcherBatch_new(void)
+{
+    MatcherBatch *self = (MatcherBatch *) g_malloc0(sizeof(MatcherBatch));
+    self->text = g_string_new(NULL);
+    self->segments = g_array_new(FALSE, FALSE, sizeof(MatcherBatchSegment));
+    self->found = g_array_new(FALSE, FALSE, sizeof(MatcherBatchFound));
+    self->matches = g_array_new(FALSE, FALSE, sizeof(MatcherBatchMatch));
+    self->buffer = (UTF16Buffer) UTF16BUFFER_INIT;
+    return self;
+}
+
+void
+MatcherBatch_free(MatcherBatch *self)
+{
+    if (NULL == self) {
+        return;
+    }
+    UTF16Buffer_clear(&self->buffer);
+    g_array_free(self->matches, TRUE);
+    g_array_free(self->found, TRUE);
+    g_free(self->first_match);
+    g_free(self->status);
+    g_array_free(self->segments, TRUE);
+    g_string_free(self->text, TRUE);
+    g_free(self);
+}
+
+/**
+ * 直前に走査した文字列の数を返す
+ */
+gsize
+MatcherBatch_getLength(const MatcherBatch *self)
+{
+    return self->n_strings;
+}
+
+MatcherBatchStatus
+MatcherBatch_getStatus(const MatcherBatch *self, gsize index)
+{
+    g_assert(index < self->n_strings);
+    return (MatcherBatchStatus) self->status[index];
+}
+
+/**
+ * index 番目の文字列で見つかったキーワードを開始位置の昇順で返す
+ * collect_matches を FALSE にして走査したときは常に空になる
+ */
+const MatcherBatchMatch *
+MatcherBatch_getMatches(const MatcherBatch *self, gsize index, gsize *n_matches)
+{
+    g_assert(index < self->n_strings);
+    if (!self->collect) {
+        *n_matches = 0;
+        return NULL;
+    }
+    *n_matches = self->first_match[index + 1] - self->first_match[index];
+    return &g_array_index(self->matches, MatcherBatchMatch, self->first_match[index]);
+}
+
+/**
+ * 連結したテキスト上の offset を含む文字列を探す
+ * 複数パターンのエンジンは末尾位置の昇順に報告するので、まず直前の文字列とその次を調べる
+ */
+static const MatcherBatchSegment *
+MatcherBatch_findSegment(MatcherBatch *self, gsize offset)
+{
+    const MatcherBatchSegment *segments = (const MatcherBatchSegment *) self->segments->data;
+    gsize n_segments = self->segments->len;
+    gsize cursor = self->cursor;
+    if (segments[cursor].start <= offset && (cursor + 1 == n_segments || offset < segments[cursor + 1].start)) {
+        return &segments[cursor];
+    }
+    gsize low = 0;
+    gsize high = n_segments;
+    /* start が offset 以下の最後の要素を二分探索で探す */
+    while (1 < high - low) {
+        gsize middle = low + (high - low) / 2;
+        if (segments[middle].start <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    self->cursor = low;
+    return &segments[low];
+}
+
+static gboolean
+MatcherBatch_report(const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    MatcherBatch *self = (MatcherBatch *) user_data;
+    const MatcherBatchSegment *segment = MatcherBatch_findSegment(self, offset);
+    self->status[segment->index] = MATCHER_BATCH_HIT;
+    if (self->collect) {
+        MatcherBatchFound found = {segment->index, {keyword, keywordlen, offset - segment->start}};
+        g_array_append_val(self->found, found);
+    }
+    return TRUE;
+}
+
+/* 開始位置の昇順、同じ位置なら短いキーワードを先に並べる */
+static int
+MatcherBatchMatch_compare(const void *a, const void *b)
+{
+    const MatcherBatchMatch *x = (const MatcherBatchMatch *) a;
+    const MatcherBatchMatch *y = (const MatcherBatchMatch *) b;
+    if (x->offset != y->offset) {
+        return (x->offset < y->offset) ? -1 : 1;
+    }
+    if (x->keywordlen != y->keywordlen) {
+        return (x->keywordlen < y->keywordlen) ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * 報告された出現を文字列ごとに開始位置の順に並べ、first_match を作る
+ */
+static void
+MatcherBatch_groupMatches(MatcherBatch *self)
+{
+    memset(self->first_match, 0, sizeof(gsize) * (self->n_strings + 1));
+    const MatcherBatchFound *found = (const MatcherBatchFound *) self->found->data;
+    for (guint i = 0; i < self->found->len; ++i) {
+        ++self->first_match[found[i].index + 1];
+    }
+    for (gsize i = 0; i < self->n_strings; ++i) {
+        self->first_match[i + 1] += self->first_match[i];
+    }
+    g_array_set_size(self->matches, self->found->len);
+    MatcherBatchMatch *matches = (MatcherBatchMatch *) self->matches->data;
+    /* first_match[i] を i 番目の文字列の次の書き込み位置として使い、書き終えたら1つずつずらして戻す */
+    for (guint i = 0; i < self->found->len; ++i) {
+        matches[self->first_match[found[i].index]++] = found[i].match;
+    }
+    for (gsize i = self->n_strings; 0 < i; --i) {
+        self->first_match[i] = self->first_match[i - 1];
+    }
+    self->first_match[0] = 0;
+    /* 報告の順序はエンジンによって異なるので、文字列の中で開始位置の順に並べ直す */
+    for (gsize i = 0; i < self->n_strings; ++i) {
+        gsize n_matches = self->first_match[i + 1] - self->first_match[i];
+        if (1 < n_matches) {
+            qsort(matches + self->first_match[i], n_matches, sizeof(MatcherBatchMatch), MatcherBatchMatch_compare);
+        }
+    }
+}
+
+/**
+ * n_strings 個の文字列をまとめて走査し、文字列ごとの結果を batch に書き込む
+ * 1行ずつ Matcher_scanAll を呼ぶと、呼び出しごとに UTF-16 への変換先や反復子を確保するが、
+ * まとめて走査すればエンジンの呼び出しは1回で済み、作業領域は batch の中で使い回す
+ * collect_matches が FALSE なら、見つかったかどうかだけを記録する
+ * UTF-8 として不正な文字列は走査せず、MATCHER_BATCH_INVALID にする
+ */
+gboolean
+Matcher_scanBatch(Matcher *self, const MatcherString *strings, gsize n_strings,
+                  gboolean collect_matches, MatcherBatch *batch, GError **error)
+{
+    if (NULL == self->klass && !Matcher_compile(self, MATCHER_ENGINE_AUTO, error)) {
+        return FALSE;
+    }
+    /* 空のバッチでも first_match[0] を書くので、まだ確保していなければ確保する */
+    if (batch->capacity < n_strings || NULL == batch->first_match) {
+        batch->capacity = MAX(n_strings, batch->capacity * 2);
+        batch->status = (guint8 *) g_realloc(batch->status, sizeof(guint8) * batch->capacity);
+        batch->first_match = (gsize *) g_realloc(batch->first_match, sizeof(gsize) * (batch->capacity + 1));
+    }
+    batch->n_strings = n_strings;
+    batch->collect = collect_matches;
+    batch->cursor = 0;
+    g_string_truncate(batch->text, 0);
+    g_array_set_size(batch->segments, 0);
+    g_array_set_size(batch->found, 0);
+    for (gsize i = 0; i < n_strings; ++i) {
+        if (!UTF8Transcoder_validate(strings[i].text, strings[i].length, NULL)) {
+            batch->status[i] = MATCHER_BATCH_INVALID;
+            continue;
+        }
+        batch->status[i] = MATCHER_BATCH_MISS;
+        if (0 == strings[i].length) {
+            continue;
+        }
+        MatcherBatchSegment segment = {batch->text->len, i};
+        g_array_append_val(batch->segments, segment);
+        g_string_append_len(batch->text, strings[i].text, strings[i].length);
+        g_string_append_c(batch->text, '\0');
+    }
+    if (0 < batch->text->len &&
+        !self->klass->scanAll(self, batch->text->str, batch->text->len, &batch->buffer,
+                              MatcherBatch_report, batch, error)) {
+        return FALSE;
+    }
+    if (collect_matches) {
+        MatcherBatch_groupMatches(batch);
+    }
+    return TRUE;
+}
+
+/**
+ * 使用中のエンジンの走査の統計を stats に書き込む
+ * 単一パターンのエンジンではキーワードごとの統計を合計する
+ * コンパイルしていない、統計を数えないエンジンを使っている、
+ * または STRING_MATCHING_STATS を定義せずにビルドしていれば FALSE を返す
+ */
+gboolean
+Matcher_getStats(Matcher *self, ScanStats *stats)
+{
+    ScanStats_reset(stats);
+    if (NULL == self->klass || NULL == self->klass->getStats) {
+        return FALSE;
+    }
+    if (NULL == self->klass->compileOne) {
+        const ScanStats *impl_stats = self->klass->getStats(self->impl);
+        if (NULL == impl_stats) {
+            return FALSE;
+        }
+        ScanStats_add(stats, impl_stats);
+        return TRUE;
+    }
+    gpointer *impls = (gpointer *) self->impl;
+    for (guint i = 0; i < self->keywords->len; ++i) {
+        const ScanStats *impl_stats = self->klass->getStats(impls[i]);
+        if (NULL == impl_stats) {
+            return FALSE;
+        }
+        ScanStats_add(stats, impl_stats);
+    }
+    return TRUE;
+}
+
+/**
+ * キーワードの複製とコンパイル済みのエンジンが確保している領域のバイト数を用途ごとに usage に足し込む
+ * コンパイルしていなければキーワードの分だけを数える。GPtrArray と GHashTable の内部は要素数から見積もる
+ */
+void
+Matcher_memoryUsage(Matcher *self, MemoryUsage *usage)
+{
+    for (guint i = 0; i < self->keywords->len; ++i) {
+        usage->patterns += sizeof(MatcherKeyword) + Matcher_getKeyword(self, i)->length + 1;
+    }
+    usage->overhead += sizeof(Matcher) + sizeof(gpointer) * self->keywords->len +
+                       (sizeof(gpointer) * 2 + sizeof(guint)) * g_hash_table_size(self->keyword_set);
+    if (NULL == self->klass || NULL == self->klass->memoryUsage) {
+        return;
+    }
+    if (NULL == self->klass->compileOne) {
+        self->klass->memoryUsage(self->impl, usage);
+        return;
+    }
+    gpointer *impls = (gpointer *) self->impl;
+    usage->overhead += sizeof(gpointer) * self->keywords->len;
+    for (guint i = 0; i < self->keywords->len; ++i) {
+        self->klass->memoryUsage(impls[i], usage);
+    }
+}
+
+void
+Matcher_resetStats(Matcher *self)
+{
+    if (NULL == self->klass || NULL == self->klass->resetStats) {
+        return;
+    }
+    if (NULL == self->klass->compileOne) {
+        self->klass->resetStats(self->impl);
+        return;
+    }
+    gpointer *impls = (gpointer *) self->impl;
+    for (guint i = 0; i < self->keywords->len; ++i) {
+        self->klass->resetStats(impls[i]);
+    }
+}
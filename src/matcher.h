@@ -0,0 +1,125 @@
+// 各エンジンを共通の API で扱うための窓口
+// キーワードの本数、長さ、文字種から最も速そうなエンジンを選んで使う
+
+#ifndef __MATCHER_H__
+#define __MATCHER_H__
+
+#include <glib.h>
+
+#include "memoryusage.h"
+#include "scanstats.h"
+#include "utf8transcoder.h"
+
+struct Matcher;
+typedef struct Matcher Matcher;
+struct MatcherCostProfile;
+typedef struct MatcherCostProfile MatcherCostProfile;
+struct MatcherBatch;
+typedef struct MatcherBatch MatcherBatch;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MATCHER_ERROR (g_quark_from_static_string("matcher-error-quark"))
+
+typedef enum {
+    MATCHER_ERROR_INVALID_KEYWORD,
+    MATCHER_ERROR_NO_KEYWORD,
+    MATCHER_ERROR_UNSUPPORTED_ENGINE,
+} MatcherError;
+
+typedef enum {
+    MATCHER_ENGINE_AUTO,
+    MATCHER_ENGINE_NAIVE_SIMD,
+    MATCHER_ENGINE_SUNDAY,
+    MATCHER_ENGINE_BOYER_MOORE,
+    MATCHER_ENGINE_COMMENTZ_WALTER,
+    MATCHER_ENGINE_UNICODE_COMMENTZ_WALTER,
+    MATCHER_ENGINE_AHO_CORASICK,
+    MATCHER_N_ENGINES,
+} MatcherEngine;
+
+/**
+ * キーワードを見つけるたびに呼ばれる関数
+ * offset はキーワードの開始位置を指すバイトオフセットで、FALSE を返すと走査を打ち切る
+ */
+typedef gboolean (*MatcherFunc)(const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data);
+
+/**
+ * Matcher_scanLines でキーワードが見つかった行
+ */
+typedef struct MatcherLine {
+    gsize number; /* 1 から数える行番号 */
+    gsize offset; /* 行の先頭のバイトオフセット */
+    gsize length; /* 改行を含まない行のバイト数 */
+} MatcherLine;
+
+/**
+ * Matcher_scanLines でキーワードを見つけるたびに呼ばれる関数
+ * offset はキーワードの開始位置を指すテキスト先頭からのバイトオフセットで、line はその位置を含む行
+ * FALSE を返すと走査を打ち切る
+ */
+typedef gboolean (*MatcherLineFunc)(const MatcherLine *line, const gchar *keyword, gsize keywordlen, gsize offset,
+                                    gpointer user_data);
+
+/**
+ * Matcher_scanBatch で走査する文字列
+ */
+typedef struct MatcherString {
+    const gchar *text;
+    gsize length;
+} MatcherString;
+
+/**
+ * Matcher_scanBatch で見つかったキーワード。offset は文字列の先頭からのバイトオフセット
+ */
+typedef struct MatcherBatchMatch {
+    const gchar *keyword;
+    gsize keywordlen;
+    gsize offset;
+} MatcherBatchMatch;
+
+typedef enum {
+    MATCHER_BATCH_MISS,
+    MATCHER_BATCH_HIT,
+    MATCHER_BATCH_INVALID, /* UTF-8 として不正なので走査しなかった */
+} MatcherBatchStatus;
+
+extern const gchar *MatcherEngine_getName(MatcherEngine engine);
+
+extern Matcher *Matcher_new(void);
+extern void Matcher_free(Matcher *self);
+extern gboolean Matcher_addKeyword(Matcher *self, const gchar *keyword, glong length, GError **error);
+extern void Matcher_setCostProfile(Matcher *self, const MatcherCostProfile *profile);
+extern void Matcher_setExpectedScanBytes(Matcher *self, gsize scan_bytes);
+extern MatcherEngine Matcher_planEngine(Matcher *self);
+extern gboolean Matcher_compile(Matcher *self, MatcherEngine engine, GError **error);
+extern MatcherEngine Matcher_getEngine(Matcher *self);
+extern const gchar *Matcher_getEngineName(Matcher *self);
+extern guint Matcher_getKeywordCount(Matcher *self);
+extern gboolean Matcher_scan(Matcher *self, const gchar *text, glong textlen,
+                             const gchar **keyword, gsize *offset, GError **error);
+extern gboolean Matcher_scanAll(Matcher *self, const gchar *text, glong textlen,
+                                MatcherFunc func, gpointer user_data, GError **error);
+extern gboolean Matcher_scanAllWithBuffer(Matcher *self, const gchar *text, glong textlen, UTF16Buffer *buffer,
+                                          MatcherFunc func, gpointer user_data, GError **error);
+extern gboolean Matcher_scanLines(Matcher *self, const gchar *text, glong textlen, gboolean first_match_only,
+                                  MatcherLineFunc func, gpointer user_data, GError **error);
+extern gboolean Matcher_scanBatch(Matcher *self, const MatcherString *strings, gsize n_strings,
+                                  gboolean collect_matches, MatcherBatch *batch, GError **error);
+extern gboolean Matcher_getStats(Matcher *self, ScanStats *stats);
+extern void Matcher_resetStats(Matcher *self);
+extern void Matcher_memoryUsage(Matcher *self, MemoryUsage *usage);
+
+extern MatcherBatch *MatcherBatch_new(void);
+extern void MatcherBatch_free(MatcherBatch *self);
+extern gsize MatcherBatch_getLength(const MatcherBatch *self);
+extern MatcherBatchStatus MatcherBatch_getStatus(const MatcherBatch *self, gsize index);
+extern const MatcherBatchMatch *MatcherBatch_getMatches(const MatcherBatch *self, gsize index, gsize *n_matches);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MATCHER_H__
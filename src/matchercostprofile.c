@@ -0,0 +1,367 @@
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+
+#include "matcher.h"
+#include "matchercostprofile.h"
+#include "simddispatch.h"
+
+#define PROFILE_GROUP "profile"
+
+static const gchar *alphabet_names[] = {"ascii", "cjk"};
+
+/**
+ * 計測した格子点ごとのコスト
+ * build_costs, scan_costs は [engine][alphabet][count][length] の順に並べた配列で、負値は未計測を表す
+ */
+struct MatcherCostProfile {
+    guint *keyword_counts;   /* 昇順 */
+    gsize n_counts;
+    guint *keyword_lengths;  /* 昇順、文字数 */
+    gsize n_lengths;
+    gchar *simd_level;       /* 計測時の SIMD レベル (記録のみで、予測には使わない) */
+    gdouble *build_costs;    /* キーワード1バイトあたりの前処理時間 (ns) */
+    gdouble *scan_costs;     /* テキスト1バイトあたりの走査時間 (ns) */
+};
+
+static inline gsize
+MatcherCostProfile_getGridSize(const MatcherCostProfile *self)
+{
+    return self->n_counts * self->n_lengths;
+}
+
+static inline gsize
+MatcherCostProfile_getGridOffset(const MatcherCostProfile *self, MatcherEngine engine, MatcherAlphabet alphabet)
+{
+    return ((gsize) engine * MATCHER_N_ALPHABETS + alphabet) * MatcherCostProfile_getGridSize(self);
+}
+
+MatcherCostProfile *
+MatcherCostProfile_new(const guint *keyword_counts, gsize n_counts, const guint *keyword_lengths, gsize n_lengths)
+{
+    g_assert(0 < n_counts && 0 < n_lengths);
+    MatcherCostProfile *self = (MatcherCostProfile *) g_malloc0(sizeof(MatcherCostProfile));
+    self->keyword_counts = g_new(guint, n_counts);
+    memcpy(self->keyword_counts, keyword_counts, sizeof(guint) * n_counts);
+    self->n_counts = n_counts;
+    self->keyword_lengths = g_new(guint, n_lengths);
+    memcpy(self->keyword_lengths, keyword_lengths, sizeof(guint) * n_lengths);
+    self->n_lengths = n_lengths;
+    self->simd_level = g_strdup(SIMDDispatch_getLevelName(SIMDDispatch_getLevel()));
+    gsize n_costs = MatcherCostProfile_getGridOffset(self, MATCHER_N_ENGINES, 0);
+    self->build_costs = g_new(gdouble, n_costs);
+    self->scan_costs = g_new(gdouble, n_costs);
+    for (gsize i = 0; i < n_costs; ++i) {
+        self->build_costs[i] = -1.0;
+        self->scan_costs[i] = -1.0;
+    }
+    return self;
+}
+
+void
+MatcherCostProfile_free(MatcherCostProfile *self)
+{
+    if (NULL == self) {
+        return;
+    }
+    g_free(self->keyword_counts);
+    g_free(self->keyword_lengths);
+    g_free(self->simd_level);
+    g_free(self->build_costs);
+    g_free(self->scan_costs);
+    g_free(self);
+}
+
+const gchar *
+MatcherCostProfile_getAlphabetName(MatcherAlphabet alphabet)
+{
+    g_assert((guint) alphabet < G_N_ELEMENTS(alphabet_names));
+    return alphabet_names[alphabet];
+}
+
+void
+MatcherCostProfile_setCost(MatcherCostProfile *self, MatcherEngine engine, MatcherAlphabet alphabet,
+                           gsize count_index, gsize length_index,
+                           gdouble build_ns_per_byte, gdouble scan_ns_per_byte)
+{
+    g_assert((guint) engine < MATCHER_N_ENGINES && (guint) alphabet < MATCHER_N_ALPHABETS);
+    g_assert(count_index < self->n_counts && length_index < self->n_lengths);
+    gsize offset = MatcherCostProfile_getGridOffset(self, engine, alphabet) + count_index * self->n_lengths + length_index;
+    self->build_costs[offset] = build_ns_per_byte;
+    self->scan_costs[offset] = scan_ns_per_byte;
+}
+
+static gboolean
+MatcherCostProfile_readAxis(GKeyFile *key_file, const gchar *key, guint **axis, gsize *n_axis, GError **error)
+{
+    gsize n_values = 0;
+    gint *values = g_key_file_get_integer_list(key_file, PROFILE_GROUP, key, &n_values, error);
+    if (NULL == values) {
+        return FALSE;
+    }
+    for (gsize i = 0; i < n_values; ++i) {
+        if (values[i] <= 0 || (0 < i && values[i] <= values[i - 1])) {
+            g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                        "%s must be positive and increasing", key);
+            g_free(values);
+            return FALSE;
+        }
+    }
+    if (0 == n_values) {
+        g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE, "%s is empty", key);
+        g_free(values);
+        return FALSE;
+    }
+    *axis = (guint *) g_malloc_n(n_values, sizeof(guint));
+    for (gsize i = 0; i < n_values; ++i) {
+        (*axis)[i] = values[i];
+    }
+    *n_axis = n_values;
+    g_free(values);
+    return TRUE;
+}
+
+/**
+ * engine と alphabet の格子を読み込む
+ * キーがなければ未計測のままにする
+ */
+static gboolean
+MatcherCostProfile_readGrid(MatcherCostProfile *self, GKeyFile *key_file, const gchar *group, const gchar *key,
+                            gdouble *grid, GError **error)
+{
+    GError *read_error = NULL;
+    gsize n_values = 0;
+    gdouble *values = g_key_file_get_double_list(key_file, group, key, &n_values, &read_error);
+    if (NULL == values) {
+        if (g_error_matches(read_error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+            g_error_free(read_error);
+            return TRUE;
+        }
+        g_propagate_error(error, read_error);
+        return FALSE;
+    }
+    if (MatcherCostProfile_getGridSize(self) != n_values) {
+        g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                    "[%s] %s must have %ld values: actual=%ld",
+                    group, key, (glong) MatcherCostProfile_getGridSize(self), (glong) n_values);
+        g_free(values);
+        return FALSE;
+    }
+    memcpy(grid, values, sizeof(gdouble) * n_values);
+    g_free(values);
+    return TRUE;
+}
+
+/**
+ * bench --calibrate で作成したプロファイルを読み込む
+ */
+MatcherCostProfile *
+MatcherCostProfile_load(const gchar *filename, GError **error)
+{
+    MatcherCostProfile *self = NULL;
+    guint *keyword_counts = NULL;
+    guint *keyword_lengths = NULL;
+    gsize n_counts = 0;
+    gsize n_lengths = 0;
+    GError *read_error = NULL;
+    GKeyFile *key_file = g_key_file_new();
+    if (!g_key_file_load_from_file(key_file, filename, G_KEY_FILE_NONE, error)) {
+        goto escape;
+    }
+    gint version = g_key_file_get_integer(key_file, PROFILE_GROUP, "version", &read_error);
+    if (NULL != read_error) {
+        g_propagate_error(error, read_error);
+        goto escape;
+    }
+    if (MATCHER_COST_PROFILE_VERSION != version) {
+        g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                    "unsupported cost profile version: %d", version);
+        goto escape;
+    }
+    if (!MatcherCostProfile_readAxis(key_file, "keyword_counts", &keyword_counts, &n_counts, error) ||
+        !MatcherCostProfile_readAxis(key_file, "keyword_lengths", &keyword_lengths, &n_lengths, error)) {
+        goto escape;
+    }
+    self = MatcherCostProfile_new(keyword_counts, n_counts, keyword_lengths, n_lengths);
+    gchar *simd_level = g_key_file_get_string(key_file, PROFILE_GROUP, "simd_level", NULL);
+    if (NULL != simd_level) {
+        g_free(self->simd_level);
+        self->simd_level = simd_level;
+    }
+    for (guint engine = 0; engine < MATCHER_N_ENGINES; ++engine) {
+        const gchar *group = MatcherEngine_getName((MatcherEngine) engine);
+        if (NULL == group || !g_key_file_has_group(key_file, group)) {
+            continue;
+        }
+        for (guint alphabet = 0; alphabet < MATCHER_N_ALPHABETS; ++alphabet) {
+            gsize offset = MatcherCostProfile_getGridOffset(self, (MatcherEngine) engine, (MatcherAlphabet) alphabet);
+            gchar *build_key = g_strdup_printf("build_ns_per_byte_%s", alphabet_names[alphabet]);
+            gchar *scan_key = g_strdup_printf("scan_ns_per_byte_%s", alphabet_names[alphabet]);
+            gboolean succeeded =
+                MatcherCostProfile_readGrid(self, key_file, group, build_key, self->build_costs + offset, error) &&
+                MatcherCostProfile_readGrid(self, key_file, group, scan_key, self->scan_costs + offset, error);
+            g_free(build_key);
+            g_free(scan_key);
+            if (!succeeded) {
+                MatcherCostProfile_free(self);
+                self = NULL;
+                goto escape;
+            }
+        }
+    }
+
+ escape:
+    g_free(keyword_counts);
+    g_free(keyword_lengths);
+    g_key_file_free(key_file);
+    return self;
+}
+
+gboolean
+MatcherCostProfile_save(MatcherCostProfile *self, const gchar *filename, GError **error)
+{
+    GKeyFile *key_file = g_key_file_new();
+    g_key_file_set_integer(key_file, PROFILE_GROUP, "version", MATCHER_COST_PROFILE_VERSION);
+    g_key_file_set_string(key_file, PROFILE_GROUP, "simd_level", self->simd_level);
+    gint *axis = g_new(gint, MAX(self->n_counts, self->n_lengths));
+    for (gsize i = 0; i < self->n_counts; ++i) {
+        axis[i] = self->keyword_counts[i];
+    }
+    g_key_file_set_integer_list(key_file, PROFILE_GROUP, "keyword_counts", axis, self->n_counts);
+    for (gsize i = 0; i < self->n_lengths; ++i) {
+        axis[i] = self->keyword_lengths[i];
+    }
+    g_key_file_set_integer_list(key_file, PROFILE_GROUP, "keyword_lengths", axis, self->n_lengths);
+    g_free(axis);
+
+    for (guint engine = 0; engine < MATCHER_N_ENGINES; ++engine) {
+        const gchar *group = MatcherEngine_getName((MatcherEngine) engine);
+        if (NULL == group) {
+            continue;
+        }
+        for (guint alphabet = 0; alphabet < MATCHER_N_ALPHABETS; ++alphabet) {
+            gsize offset = MatcherCostProfile_getGridOffset(self, (MatcherEngine) engine, (MatcherAlphabet) alphabet);
+            gboolean measured = FALSE;
+            for (gsize i = 0; i < MatcherCostProfile_getGridSize(self); ++i) {
+                measured = measured || 0.0 <= self->scan_costs[offset + i];
+            }
+            if (!measured) {
+                continue;
+            }
+            gchar *build_key = g_strdup_printf("build_ns_per_byte_%s", alphabet_names[alphabet]);
+            gchar *scan_key = g_strdup_printf("scan_ns_per_byte_%s", alphabet_names[alphabet]);
+            g_key_file_set_double_list(key_file, group, build_key, self->build_costs + offset,
+                                       MatcherCostProfile_getGridSize(self));
+            g_key_file_set_double_list(key_file, group, scan_key, self->scan_costs + offset,
+                                       MatcherCostProfile_getGridSize(self));
+            g_free(build_key);
+            g_free(scan_key);
+        }
+    }
+    gboolean succeeded = g_key_file_save_to_file(key_file, filename, error);
+    g_key_file_free(key_file);
+    return succeeded;
+}
+
+/**
+ * 環境変数 STRING_MATCHING_COST_PROFILE で指定されたプロファイルを返す
+ * 初回呼び出し時に読み込み、指定がないか読み込めなければ NULL を返す
+ */
+const MatcherCostProfile *
+MatcherCostProfile_getDefault(void)
+{
+    static gsize profile_once = 0;
+    static MatcherCostProfile *profile = NULL;
+    if (g_once_init_enter(&profile_once)) {
+        const gchar *filename = g_getenv(MATCHER_COST_PROFILE_ENV_NAME);
+        if (NULL != filename && '\0' != *filename) {
+            GError *error = NULL;
+            profile = MatcherCostProfile_load(filename, &error);
+            if (NULL == profile) {
+                g_warning("failed to load cost profile %s: %s", filename, error->message);
+                g_error_free(error);
+            }
+        }
+        g_once_init_leave(&profile_once, 1);
+    }
+    return profile;
+}
+
+/**
+ * axis 上で x を挟む区間の先頭 index と、区間内の位置 t を対数軸で求める
+ * extrapolate が FALSE なら t を [0, 1] に切り詰め、TRUE なら最大値を超えた分を最後の区間の傾きで外挿する
+ */
+static void
+MatcherCostProfile_locate(const guint *axis, gsize n_axis, gdouble x, gboolean extrapolate, gsize *index, gdouble *t)
+{
+    if (1 == n_axis) {
+        *index = 0;
+        *t = 0.0;
+        return;
+    }
+    gsize i = 0;
+    while (i + 2 < n_axis && axis[i + 1] < x) {
+        ++i;
+    }
+    gdouble position = (log(x) - log(axis[i])) / (log(axis[i + 1]) - log(axis[i]));
+    *index = i;
+    *t = MAX(position, 0.0);
+    if (!extrapolate) {
+        *t = MIN(*t, 1.0);
+    }
+}
+
+/**
+ * 格子点の値を両対数軸上で双線形補間する
+ * 補間に使う格子点が未計測なら FALSE を返す
+ */
+static gboolean
+MatcherCostProfile_interpolate(const MatcherCostProfile *self, const gdouble *grid,
+                               gsize n_keywords, gsize keyword_length, gdouble *value)
+{
+    gsize count_index = 0;
+    gsize length_index = 0;
+    gdouble count_t = 0.0;
+    gdouble length_t = 0.0;
+    /* キーワード数は計測範囲を超えても増やした分だけコストが伸びるので外挿し、長さは端の値を使う */
+    MatcherCostProfile_locate(self->keyword_counts, self->n_counts, MAX(n_keywords, 1), TRUE, &count_index, &count_t);
+    MatcherCostProfile_locate(self->keyword_lengths, self->n_lengths, MAX(keyword_length, 1), FALSE, &length_index, &length_t);
+    gsize count_span = MIN(self->n_counts, 2);
+    gsize length_span = MIN(self->n_lengths, 2);
+    gdouble logs[2][2] = {{0.0, 0.0}, {0.0, 0.0}};
+    for (gsize i = 0; i < count_span; ++i) {
+        for (gsize j = 0; j < length_span; ++j) {
+            gdouble cost = grid[(count_index + i) * self->n_lengths + length_index + j];
+            if (cost <= 0.0) {
+                return FALSE;
+            }
+            logs[i][j] = log(cost);
+        }
+    }
+    gdouble lower = logs[0][0] + (logs[0][1] - logs[0][0]) * length_t;
+    gdouble upper = logs[1][0] + (logs[1][1] - logs[1][0]) * length_t;
+    *value = exp(lower + (upper - lower) * count_t);
+    return TRUE;
+}
+
+/**
+ * n_keywords 本、最短 keyword_length 文字、合計 total_keyword_bytes バイトのキーワードで前処理し、
+ * scan_bytes バイトのテキストを走査するときのコスト (ns) を予測する
+ * engine の計測値がなければ FALSE を返す
+ */
+gboolean
+MatcherCostProfile_predict(const MatcherCostProfile *self, MatcherEngine engine, MatcherAlphabet alphabet,
+                           gsize n_keywords, gsize keyword_length, gsize total_keyword_bytes,
+                           gsize scan_bytes, gdouble *cost_ns)
+{
+    g_assert((guint) engine < MATCHER_N_ENGINES && (guint) alphabet < MATCHER_N_ALPHABETS);
+    gsize offset = MatcherCostProfile_getGridOffset(self, engine, alphabet);
+    gdouble build_ns_per_byte = 0.0;
+    gdouble scan_ns_per_byte = 0.0;
+    if (!MatcherCostProfile_interpolate(self, self->build_costs + offset, n_keywords, keyword_length, &build_ns_per_byte) ||
+        !MatcherCostProfile_interpolate(self, self->scan_costs + offset, n_keywords, keyword_length, &scan_ns_per_byte)) {
+        return FALSE;
+    }
+    *cost_ns = build_ns_per_byte * total_keyword_bytes + scan_ns_per_byte * scan_bytes;
+    return TRUE;
+}
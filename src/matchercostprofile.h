@@ -0,0 +1,46 @@
+// 手元の計算機で計測したエンジンごとの前処理と走査のコストを保持し、
+// キーワード集合と走査するテキスト量からエンジンごとのコストを予測する
+// プロファイルは bench の --calibrate で作成し、環境変数 STRING_MATCHING_COST_PROFILE で指定できる
+
+#ifndef __MATCHERCOSTPROFILE_H__
+#define __MATCHERCOSTPROFILE_H__
+
+#include <glib.h>
+
+#include "matcher.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MATCHER_COST_PROFILE_ENV_NAME "STRING_MATCHING_COST_PROFILE"
+#define MATCHER_COST_PROFILE_VERSION 1
+
+/**
+ * キーワードとテキストの文字種
+ */
+typedef enum {
+    MATCHER_ALPHABET_ASCII,
+    MATCHER_ALPHABET_CJK,
+    MATCHER_N_ALPHABETS,
+} MatcherAlphabet;
+
+extern MatcherCostProfile *MatcherCostProfile_new(const guint *keyword_counts, gsize n_counts,
+                                                  const guint *keyword_lengths, gsize n_lengths);
+extern void MatcherCostProfile_free(MatcherCostProfile *self);
+extern MatcherCostProfile *MatcherCostProfile_load(const gchar *filename, GError **error);
+extern gboolean MatcherCostProfile_save(MatcherCostProfile *self, const gchar *filename, GError **error);
+extern const MatcherCostProfile *MatcherCostProfile_getDefault(void);
+extern const gchar *MatcherCostProfile_getAlphabetName(MatcherAlphabet alphabet);
+extern void MatcherCostProfile_setCost(MatcherCostProfile *self, MatcherEngine engine, MatcherAlphabet alphabet,
+                                       gsize count_index, gsize length_index,
+                                       gdouble build_ns_per_byte, gdouble scan_ns_per_byte);
+extern gboolean MatcherCostProfile_predict(const MatcherCostProfile *self, MatcherEngine engine, MatcherAlphabet alphabet,
+                                           gsize n_keywords, gsize keyword_length, gsize total_keyword_bytes,
+                                           gsize scan_bytes, gdouble *cost_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MATCHERCOSTPROFILE_H__
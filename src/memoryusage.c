@@ -0,0 +1,33 @@
+#include <stdio.h>
+#include <glib.h>
+
+#include "memoryusage.h"
+
+gsize
+MemoryUsage_getTotal(const MemoryUsage *self)
+{
+    return self->nodes + self->edges + self->shift_tables + self->buffers + self->patterns + self->overhead;
+}
+
+/**
+ * other の値を self に足し込む
+ */
+void
+MemoryUsage_add(MemoryUsage *self, const MemoryUsage *other)
+{
+    self->nodes += other->nodes;
+    self->edges += other->edges;
+    self->shift_tables += other->shift_tables;
+    self->buffers += other->buffers;
+    self->patterns += other->patterns;
+    self->overhead += other->overhead;
+}
+
+void
+MemoryUsage_pprint(const MemoryUsage *self, FILE *ostream)
+{
+    fprintf(ostream, "total=%lu, nodes=%lu, edges=%lu, shift tables=%lu, buffers=%lu, patterns=%lu, overhead=%lu\n",
+            (unsigned long) MemoryUsage_getTotal(self), (unsigned long) self->nodes, (unsigned long) self->edges,
+            (unsigned long) self->shift_tables, (unsigned long) self->buffers, (unsigned long) self->patterns,
+            (unsigned long) self->overhead);
+}
@@ -0,0 +1,37 @@
+// マッチャーのメモリ使用量
+// 各エンジンの *_memoryUsage が、確保している領域を用途ごとに MemoryUsage に足し込む
+// malloc の管理領域は含まないので、プロセスの使用量とは一致しない
+
+#ifndef __MEMORYUSAGE_H__
+#define __MEMORYUSAGE_H__
+
+#include <stdio.h>
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 用途ごとのバイト数
+ */
+typedef struct MemoryUsage {
+    gsize nodes;        /* トライやオートマトンのノード (子ノードの表を除く) */
+    gsize edges;        /* 子ノードの表 */
+    gsize shift_tables; /* シフト表 */
+    gsize buffers;      /* 前処理や走査に使う作業用の領域 */
+    gsize patterns;     /* パターンやキーワードの複製 */
+    gsize overhead;     /* 構造体そのもの、アリーナの未使用領域、ハッシュ表などの見積もり */
+} MemoryUsage;
+
+#define MEMORYUSAGE_INIT {0, 0, 0, 0, 0, 0}
+
+extern gsize MemoryUsage_getTotal(const MemoryUsage *self);
+extern void MemoryUsage_add(MemoryUsage *self, const MemoryUsage *other);
+extern void MemoryUsage_pprint(const MemoryUsage *self, FILE *ostream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MEMORYUSAGE_H__
@@ -36,57 +36,150 @@ UnicodeNaiveMatcher_scan(const gchar *keyword, const gchar *document)
 
 #ifdef __SSE2__
 
-#include <emmintrin.h>
-#include <sys/mman.h>
+#include <immintrin.h>
 
-typedef gchar vi128[16] __attribute__((aligned(16)));
-static vi128 s1v;
-static vi128 s2v;
-static vi128 result;
-static vi128 zero ={0};
+#include "simddispatch.h"
 
-gboolean
-UnicodeNaiveMatcher_scanWithSIMD(const gchar *keyword, const gchar *document)
+/**
+ * 以下のカーネルは、キーワードと文書を UTF-8 のバイト列のまま照合する
+ * キーワードの先頭バイトと末尾バイトを文書の連続する位置と同時に比較し、両方が一致した位置だけを memcmp で検証する
+ * ベクトル幅に満たない末尾は、より狭いカーネルに引き継ぐ
+ * キーワードが正しい UTF-8 であれば、先頭バイトは必ず文字の先頭なので、バイト列の一致はそのまま文字列の一致になる
+ * 状態はすべてスタック上に置くので、複数スレッドから同時に呼び出してよい
+ */
+
+static inline const gchar *
+UnicodeNaiveMatcher_verifyCandidates(guint64 mask, const gchar *candidates, const gchar *keyword, gsize keywordlen)
 {
-    const char *s1 = document;
-    const char *s1tbl[G_N_ELEMENTS(s1v)];
-    gchar s2u = (gchar) g_utf8_get_char(keyword);
-    for (int j=0; j<G_N_ELEMENTS(s2v); ++j) {
-        s2v[j] = s2u;
+    for (; 0 != mask; mask &= mask - 1) {
+        const gchar *candidate = candidates + __builtin_ctzll(mask);
+        if (keywordlen <= 2 || 0 == memcmp(candidate + 1, keyword + 1, keywordlen - 2)) {
+            return candidate;
+        }
     }
-    __m128i s2m = _mm_load_si128((__m128i *) s2v);
-    while (1) {
-        int j=0;
-        for (; j<G_N_ELEMENTS(s1v); ++j) {
-            if (*s1 == '\0') {
-                break;
-            }
-            s1tbl[j] = s1;
-            s1v[j] = (gchar) g_utf8_get_char(s1);
-            s1 = g_utf8_next_char(s1);
+    return NULL;
+}
+
+typedef const gchar *(*UnicodeNaiveMatcher_findBytesKernel)(const gchar *keyword, gsize keywordlen, const gchar *document, gsize offset, gsize documentlen);
+
+static const gchar *
+UnicodeNaiveMatcher_findBytesScalar(const gchar *keyword, gsize keywordlen, const gchar *document, gsize offset, gsize documentlen)
+{
+    for (; offset + keywordlen <= documentlen; ++offset) {
+        if (document[offset] == keyword[0] && 0 == memcmp(document + offset, keyword, keywordlen)) {
+            return document + offset;
         }
-        if (*s1 == '\0') {
-            for (int k=0; k<j; ++k) {
-                if (UnicodeNaiveMatcher_hasPrefix(s1tbl[k], keyword)) {
-                    return TRUE;
-                }
-            }
-            break;
+    }
+    return NULL;
+}
+
+__attribute__((target("sse2")))
+static const gchar *
+UnicodeNaiveMatcher_findBytesSSE2(const gchar *keyword, gsize keywordlen, const gchar *document, gsize offset, gsize documentlen)
+{
+    const __m128i first = _mm_set1_epi8(keyword[0]);
+    const __m128i last = _mm_set1_epi8(keyword[keywordlen - 1]);
+    for (; offset + keywordlen - 1 + 16 <= documentlen; offset += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i *) (document + offset));
+        __m128i block_last = _mm_loadu_si128((const __m128i *) (document + offset + keywordlen - 1));
+        guint64 mask = (guint32) _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+        const gchar *found = UnicodeNaiveMatcher_verifyCandidates(mask, document + offset, keyword, keywordlen);
+        if (NULL != found) {
+            return found;
         }
-        __m128i s1m = _mm_load_si128((__m128i *) s1v);
-        s1m = _mm_cmpeq_epi8(s1m, s2m);
-        _mm_store_si128((__m128i *) result, s1m);
-        if (0 != memcmp(result, zero, sizeof(zero))) {
-            for (int k=0; k<G_N_ELEMENTS(result); ++k) {
-                if (0 != result[k]) {
-                    if (UnicodeNaiveMatcher_hasPrefix(s1tbl[k], keyword)) {
-                        return TRUE;
-                    }
-                }
-            }
+    }
+    return UnicodeNaiveMatcher_findBytesScalar(keyword, keywordlen, document, offset, documentlen);
+}
+
+__attribute__((target("avx2")))
+static const gchar *
+UnicodeNaiveMatcher_findBytesAVX2(const gchar *keyword, gsize keywordlen, const gchar *document, gsize offset, gsize documentlen)
+{
+    const __m256i first = _mm256_set1_epi8(keyword[0]);
+    const __m256i last = _mm256_set1_epi8(keyword[keywordlen - 1]);
+    for (; offset + keywordlen - 1 + 32 <= documentlen; offset += 32) {
+        __m256i block_first = _mm256_loadu_si256((const __m256i *) (document + offset));
+        __m256i block_last = _mm256_loadu_si256((const __m256i *) (document + offset + keywordlen - 1));
+        guint64 mask = (guint32) _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+        const gchar *found = UnicodeNaiveMatcher_verifyCandidates(mask, document + offset, keyword, keywordlen);
+        if (NULL != found) {
+            return found;
         }
     }
-    return FALSE;
+    return UnicodeNaiveMatcher_findBytesSSE2(keyword, keywordlen, document, offset, documentlen);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static const gchar *
+UnicodeNaiveMatcher_findBytesAVX512(const gchar *keyword, gsize keywordlen, const gchar *document, gsize offset, gsize documentlen)
+{
+    const __m512i first = _mm512_set1_epi8(keyword[0]);
+    const __m512i last = _mm512_set1_epi8(keyword[keywordlen - 1]);
+    for (; offset + keywordlen - 1 + 64 <= documentlen; offset += 64) {
+        __m512i block_first = _mm512_loadu_si512((const void *) (document + offset));
+        __m512i block_last = _mm512_loadu_si512((const void *) (document + offset + keywordlen - 1));
+        guint64 mask = _mm512_cmpeq_epi8_mask(block_first, first) & _mm512_cmpeq_epi8_mask(block_last, last);
+        const gchar *found = UnicodeNaiveMatcher_verifyCandidates(mask, document + offset, keyword, keywordlen);
+        if (NULL != found) {
+            return found;
+        }
+    }
+    return UnicodeNaiveMatcher_findBytesAVX2(keyword, keywordlen, document, offset, documentlen);
+}
+
+/**
+ * 実行時の CPU で使える最も広いカーネルを返す
+ */
+static UnicodeNaiveMatcher_findBytesKernel
+UnicodeNaiveMatcher_getFindBytesKernel(void)
+{
+    static gsize kernel_once = 0;
+    static UnicodeNaiveMatcher_findBytesKernel kernel = NULL;
+    if (g_once_init_enter(&kernel_once)) {
+        switch (SIMDDispatch_getLevel()) {
+        case SIMD_LEVEL_AVX512:
+            kernel = UnicodeNaiveMatcher_findBytesAVX512;
+            break;
+        case SIMD_LEVEL_AVX2:
+            kernel = UnicodeNaiveMatcher_findBytesAVX2;
+            break;
+        case SIMD_LEVEL_SSE2:
+            kernel = UnicodeNaiveMatcher_findBytesSSE2;
+            break;
+        default:
+            kernel = UnicodeNaiveMatcher_findBytesScalar;
+            break;
+        }
+        g_once_init_leave(&kernel_once, 1);
+    }
+    return kernel;
+}
+
+/**
+ * キーワードが最初に現れる位置を返し、見つからなければ NULL を返す
+ * 長さを指定するので、キーワードと文書は NUL 終端でなくてよい
+ */
+const gchar *
+UnicodeNaiveMatcher_findWithSIMD(const gchar *keyword, gsize keywordlen, const gchar *document, gsize documentlen)
+{
+    if (0 == keywordlen) {
+        return document;
+    }
+    return UnicodeNaiveMatcher_getFindBytesKernel()(keyword, keywordlen, document, 0, documentlen);
+}
+
+gboolean
+UnicodeNaiveMatcher_scanWithSIMD(const gchar *keyword, const gchar *document)
+{
+    gsize keywordlen = strlen(keyword);
+    gsize documentlen = strlen(document);
+    if (0 == keywordlen) {
+        /* UnicodeNaiveMatcher_scan と同様に、空でない文書には空のキーワードが含まれるとみなす */
+        return 0 < documentlen;
+    }
+    return NULL != UnicodeNaiveMatcher_findWithSIMD(keyword, keywordlen, document, documentlen);
 }
 
 #endif // __SSE2__
@@ -6,6 +6,7 @@
 extern gboolean UnicodeNaiveMatcher_scan(const gchar *keyword, const gchar *document);
 #ifdef __SSE2__
 extern gboolean UnicodeNaiveMatcher_scanWithSIMD(const gchar *keyword, const gchar *document);
+extern const gchar *UnicodeNaiveMatcher_findWithSIMD(const gchar *keyword, gsize keywordlen, const gchar *document, gsize documentlen);
 #endif // __SSE2__
 
 #endif // __NAIVEUNICODE_H__
@@ -0,0 +1,191 @@
+#include <string.h>
+#include <glib.h>
+
+#include "nodearena.h"
+
+/* 切り出す領域の境界 */
+#define NODEARENA_ALIGNMENT 16
+/* 最初のチャンクの大きさ。以降は NODEARENA_MAX_CHUNK_SIZE まで倍々に大きくする */
+#define NODEARENA_MIN_CHUNK_SIZE (4 * 1024)
+#define NODEARENA_MAX_CHUNK_SIZE (1024 * 1024)
+/* 子ノードの表を最初に確保するときの要素数 */
+#define NODEARENA_MIN_EDGES_CAPACITY 4
+
+#define NODEARENA_ROUND_UP(n) (((n) + NODEARENA_ALIGNMENT - 1) & ~((gsize) NODEARENA_ALIGNMENT - 1))
+
+typedef struct NodeArenaChunk NodeArenaChunk;
+struct NodeArenaChunk {
+    NodeArenaChunk *next;
+};
+
+/* チャンクの先頭からデータ領域までのバイト数 */
+#define NODEARENA_CHUNK_HEADER_SIZE NODEARENA_ROUND_UP(sizeof(NodeArenaChunk))
+
+struct NodeArena {
+    NodeArenaChunk *chunks; // 最後に確保したチャンクから順に並ぶ
+    guint8 *cursor;
+    guint8 *end;
+    gsize next_chunk_size;
+    gsize allocated_bytes;
+};
+
+NodeArena *
+NodeArena_new(void)
+{
+    NodeArena *self = (NodeArena *) g_malloc0(sizeof(NodeArena));
+    self->next_chunk_size = NODEARENA_MIN_CHUNK_SIZE;
+    return self;
+}
+
+void
+NodeArena_free(NodeArena *self)
+{
+    if (NULL != self) {
+        NodeArenaChunk *chunk = self->chunks;
+        while (NULL != chunk) {
+            NodeArenaChunk *next = chunk->next;
+            g_free(chunk);
+            chunk = next;
+        }
+        g_free(self);
+    }
+}
+
+/**
+ * size バイト以上の領域を持つチャンクを確保し、以降の切り出し先にする
+ * チャンクは 0 で初期化されているので、切り出した領域を改めて 0 で埋める必要はない
+ */
+static void
+NodeArena_grow(NodeArena *self, gsize size)
+{
+    gsize chunk_size = MAX(self->next_chunk_size, NODEARENA_CHUNK_HEADER_SIZE + size);
+    NodeArenaChunk *chunk = (NodeArenaChunk *) g_malloc0(chunk_size);
+    chunk->next = self->chunks;
+    self->chunks = chunk;
+    self->cursor = (guint8 *) chunk + NODEARENA_CHUNK_HEADER_SIZE;
+    self->end = (guint8 *) chunk + chunk_size;
+    self->allocated_bytes += chunk_size;
+    self->next_chunk_size = MIN(self->next_chunk_size * 2, NODEARENA_MAX_CHUNK_SIZE);
+}
+
+/**
+ * 0 で初期化した size バイトの領域を切り出す
+ * 領域はアリーナを解放するまで有効で、個別には解放できない
+ */
+gpointer
+NodeArena_alloc0(NodeArena *self, gsize size)
+{
+    size = NODEARENA_ROUND_UP(MAX(size, 1));
+    if ((gsize) (self->end - self->cursor) < size) {
+        NodeArena_grow(self, size);
+    }
+    gpointer mem = self->cursor;
+    self->cursor += size;
+    return mem;
+}
+
+gpointer
+NodeArena_memdup(NodeArena *self, gconstpointer mem, gsize size)
+{
+    gpointer new_mem = NodeArena_alloc0(self, size);
+    memcpy(new_mem, mem, size);
+    return new_mem;
+}
+
+/**
+ * アリーナがこれまでに確保したチャンクの合計バイト数を返す
+ */
+gsize
+NodeArena_getAllocatedBytes(const NodeArena *self)
+{
+    return sizeof(NodeArena) + self->allocated_bytes;
+}
+
+/**
+ * アリーナに切り出した領域の用途ごとの使用量 contents を usage に足し込む
+ * チャンクの使い残し、境界合わせの詰め物、作り直して捨てた子ノードの表は overhead に数える
+ */
+void
+NodeArena_addMemoryUsage(const NodeArena *self, const MemoryUsage *contents, MemoryUsage *usage)
+{
+    gsize allocated_bytes = NodeArena_getAllocatedBytes(self);
+    gsize used_bytes = MemoryUsage_getTotal(contents);
+    MemoryUsage_add(usage, contents);
+    usage->overhead += allocated_bytes - MIN(allocated_bytes, used_bytes);
+}
+
+/**
+ * label 以上の最初のラベルの位置を返す
+ */
+static guint
+NodeArenaEdges_lowerBound(const NodeArenaEdges *self, gunichar2 label)
+{
+    guint low = 0;
+    guint high = self->size;
+    while (low < high) {
+        guint middle = low + (high - low) / 2;
+        if (self->labels[middle] < label) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * label の子ノードを返し、なければ NULL を返す
+ * 走査中に最も多く呼ばれるので、分岐予測の外れにくい条件付き移動だけで二分探索する
+ */
+gpointer
+NodeArenaEdges_lookup(const NodeArenaEdges *self, gunichar2 label)
+{
+    if (0 == self->size) {
+        return NULL;
+    }
+    const gunichar2 *base = self->labels;
+    guint n = self->size;
+    while (1 < n) {
+        guint half = n / 2;
+        base = (base[half] <= label) ? base + half : base;
+        n -= half;
+    }
+    return (label == *base) ? self->nodes[base - self->labels] : NULL;
+}
+
+/**
+ * label の子ノードとして node を登録する。label は未登録でなければならない
+ * 表が一杯になったら倍の大きさの表をアリーナから切り出して移す。古い表はアリーナごと解放される
+ */
+void
+NodeArenaEdges_insert(NodeArenaEdges *self, NodeArena *arena, gunichar2 label, gpointer node)
+{
+    guint index = NodeArenaEdges_lowerBound(self, label);
+    g_assert(index == self->size || label != self->labels[index]);
+    if (self->size == self->capacity) {
+        guint capacity = MAX(self->capacity * 2, NODEARENA_MIN_EDGES_CAPACITY);
+        gpointer *nodes = (gpointer *) NodeArena_alloc0(arena, sizeof(gpointer) * capacity);
+        gunichar2 *labels = (gunichar2 *) NodeArena_alloc0(arena, sizeof(gunichar2) * capacity);
+        if (0 < self->size) {
+            memcpy(nodes, self->nodes, sizeof(gpointer) * self->size);
+            memcpy(labels, self->labels, sizeof(gunichar2) * self->size);
+        }
+        self->nodes = nodes;
+        self->labels = labels;
+        self->capacity = capacity;
+    }
+    memmove(self->nodes + index + 1, self->nodes + index, sizeof(gpointer) * (self->size - index));
+    memmove(self->labels + index + 1, self->labels + index, sizeof(gunichar2) * (self->size - index));
+    self->nodes[index] = node;
+    self->labels[index] = label;
+    ++self->size;
+}
+
+/**
+ * 現在の表が使っているバイト数を返す。一杯になって捨てた古い表は含まない
+ */
+gsize
+NodeArenaEdges_getAllocatedBytes(const NodeArenaEdges *self)
+{
+    return (sizeof(gunichar2) + sizeof(gpointer)) * self->capacity;
+}
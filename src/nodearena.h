@@ -0,0 +1,45 @@
+// トライやオートマトンのノードをまとめて確保するためのアリーナ
+// 大きなチャンクから先頭詰めで切り出すだけなので確保が速く、同時期に作ったノードがメモリ上で近くに並ぶ
+// 個別には解放できず、NodeArena_free でチャンクごとまとめて解放する
+
+#ifndef __NODEARENA_H__
+#define __NODEARENA_H__
+
+#include <glib.h>
+
+#include "memoryusage.h"
+
+struct NodeArena;
+typedef struct NodeArena NodeArena;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * UTF-16 のコード単位をラベルとする子ノードの表
+ * ラベルの昇順に並べて二分探索する。0 で初期化すると空の表になり、領域は NodeArena から確保する
+ */
+typedef struct NodeArenaEdges {
+    gunichar2 *labels;
+    gpointer *nodes;
+    guint size;
+    guint capacity;
+} NodeArenaEdges;
+
+extern NodeArena *NodeArena_new(void);
+extern void NodeArena_free(NodeArena *self);
+extern gpointer NodeArena_alloc0(NodeArena *self, gsize size);
+extern gpointer NodeArena_memdup(NodeArena *self, gconstpointer mem, gsize size);
+extern gsize NodeArena_getAllocatedBytes(const NodeArena *self);
+extern void NodeArena_addMemoryUsage(const NodeArena *self, const MemoryUsage *contents, MemoryUsage *usage);
+
+extern gpointer NodeArenaEdges_lookup(const NodeArenaEdges *self, gunichar2 label);
+extern void NodeArenaEdges_insert(NodeArenaEdges *self, NodeArena *arena, gunichar2 label, gpointer node);
+extern gsize NodeArenaEdges_getAllocatedBytes(const NodeArenaEdges *self);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __NODEARENA_H__
@@ -0,0 +1,425 @@
+#include <string.h>
+#include <glib.h>
+
+#include "matcher.h"
+#include "patternmatcher.h"
+
+/* 隙間の文字数に上限がないことを表す */
+#define PATTERN_GAP_UNBOUNDED G_MAXSIZE
+/* .{m,n} に書ける文字数の上限 */
+#define PATTERN_MAX_GAP_COUNT G_MAXINT32
+/* 先頭から取り除いた要素がこれより多くなったら、待ち行列を詰める */
+#define PATTERN_CHAIN_QUEUE_COMPACT_THRESHOLD 64
+
+/**
+ * パターンの断片 (リテラル)
+ * 断片は登録した順に並べ、1つのパターンの断片は続けて置くので、直前の断片の番号は1つ小さい
+ */
+typedef struct PatternPiece {
+    guint pattern;   /* 断片を含むパターンの番号 */
+    guint index;     /* パターンの中で何番目の断片か */
+    gboolean last;   /* パターンの最後の断片 */
+    gsize n_chars;   /* 断片の文字数 */
+    gsize min_gap;   /* 直前の断片との隙間の文字数の下限。先頭の断片では使わない */
+    gsize max_gap;   /* 隙間の文字数の上限。上限がなければ PATTERN_GAP_UNBOUNDED */
+} PatternPiece;
+
+struct PatternMatcher {
+    Matcher *matcher;        /* すべての断片を登録する */
+    GArray *pieces;          /* 要素は PatternPiece */
+    GHashTable *piece_table; /* 断片の文字列から、その文字列を持つ断片の番号 (guint の GArray) への表 */
+    guint n_patterns;
+};
+
+/**
+ * パターンの先頭から、ある断片までの条件を満たした並び
+ */
+typedef struct PatternChain {
+    gsize end;   /* 断片の末尾の文字位置 */
+    gsize start; /* 先頭の断片の開始位置を指すバイトオフセット */
+} PatternChain;
+
+/**
+ * 断片ごとに、条件を満たした並びを末尾の位置の順に溜めておく待ち行列
+ * 次の断片は末尾の位置の順に報告されるので、隙間の上限より手前で終わる並びは先頭から捨ててよい
+ */
+typedef struct PatternChainQueue {
+    GArray *chains; /* 要素は PatternChain。まだ並びがなければ NULL */
+    guint head;     /* 取り除いていない最初の要素 */
+} PatternChainQueue;
+
+/**
+ * 1回の走査の状態。走査ごとに持つので、同じ PatternMatcher を複数のスレッドから使える
+ */
+typedef struct PatternMatcherScan {
+    const PatternMatcher *matcher;
+    const gchar *text;
+    gsize byte_position;       /* 文字を数え終えた位置のバイトオフセット */
+    gsize char_position;       /* byte_position の文字位置 */
+    PatternChainQueue *queues; /* 断片ごとの待ち行列 */
+    PatternMatcherFunc func;
+    gpointer user_data;
+} PatternMatcherScan;
+
+static gboolean
+PatternMatcher_isOrderedEngine(MatcherEngine engine)
+{
+    return MATCHER_ENGINE_COMMENTZ_WALTER == engine || MATCHER_ENGINE_UNICODE_COMMENTZ_WALTER == engine ||
+           MATCHER_ENGINE_AHO_CORASICK == engine;
+}
+
+/**
+ * UTF-8 の先頭バイトを数えて文字数を返す。続きのバイトだけを飛ばすので、不正なテキストでも止まらない
+ */
+static gsize
+PatternMatcher_countChars(const gchar *text, gsize length)
+{
+    gsize n_chars = 0;
+    for (gsize i = 0; i < length; ++i) {
+        n_chars += (0x80 != ((guchar) text[i] & 0xC0));
+    }
+    return n_chars;
+}
+
+PatternMatcher *
+PatternMatcher_new(void)
+{
+    PatternMatcher *self = g_new0(PatternMatcher, 1);
+    self->matcher = Matcher_new();
+    self->pieces = g_array_new(FALSE, FALSE, sizeof(PatternPiece));
+    self->piece_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_array_unref);
+    return self;
+}
+
+void
+PatternMatcher_free(PatternMatcher *self)
+{
+    if (NULL == self) {
+        return;
+    }
+    g_hash_table_destroy(self->piece_table);
+    g_array_free(self->pieces, TRUE);
+    Matcher_free(self->matcher);
+    g_free(self);
+}
+
+/**
+ * *iter から 10 進の数を読んで *count に入れ、*iter を数の後ろに進める
+ */
+static gboolean
+PatternMatcher_parseCount(const gchar **iter, const gchar *end, gsize *count)
+{
+    const gchar *digits = *iter;
+    gsize value = 0;
+    while (*iter < end && g_ascii_isdigit(**iter)) {
+        value = value * 10 + (**iter - '0');
+        if (PATTERN_MAX_GAP_COUNT < value) {
+            return FALSE;
+        }
+        ++*iter;
+    }
+    *count = value;
+    return digits < *iter;
+}
+
+/**
+ * *iter が '{' を指していれば {m}, {m,}, {m,n} を読み、隙間の文字数の範囲を返す。'{' がなければ1文字の隙間にする
+ */
+static gboolean
+PatternMatcher_parseGap(const gchar **iter, const gchar *end, gsize *min_gap, gsize *max_gap)
+{
+    if (*iter == end || '{' != **iter) {
+        *min_gap = *max_gap = 1;
+        return TRUE;
+    }
+    ++*iter;
+    if (!PatternMatcher_parseCount(iter, end, min_gap) || *iter == end) {
+        return FALSE;
+    }
+    *max_gap = *min_gap;
+    if (',' == **iter) {
+        ++*iter;
+        if (*iter < end && '}' == **iter) {
+            *max_gap = PATTERN_GAP_UNBOUNDED;
+        } else if (!PatternMatcher_parseCount(iter, end, max_gap) || *max_gap < *min_gap) {
+            return FALSE;
+        }
+    }
+    if (*iter == end || '}' != **iter) {
+        return FALSE;
+    }
+    ++*iter;
+    return TRUE;
+}
+
+/**
+ * パターンを断片と隙間に分けて pieces と texts (断片の文字列) に追加する
+ * 断片の pattern と last は呼び出し側で埋める
+ */
+static gboolean
+PatternMatcher_parse(const gchar *pattern, gsize length, GArray *pieces, GPtrArray *texts, GError **error)
+{
+    const gchar *iter = pattern;
+    const gchar *end = pattern + length;
+    GString *literal = g_string_new(NULL);
+    gsize min_gap = 0;
+    gsize max_gap = 0;
+    while (iter < end) {
+        gsize gap_min = 0;
+        gsize gap_max = 0;
+        if ('.' == *iter) {
+            ++iter;
+            if (!PatternMatcher_parseGap(&iter, end, &gap_min, &gap_max)) {
+                g_set_error(error, PATTERN_MATCHER_ERROR, PATTERN_MATCHER_ERROR_INVALID_PATTERN,
+                            "malformed gap at byte %ld", (glong) (iter - pattern));
+                g_string_free(literal, TRUE);
+                return FALSE;
+            }
+        } else if ('?' == *iter || '*' == *iter) {
+            gap_min = ('?' == *iter) ? 1 : 0;
+            gap_max = ('?' == *iter) ? 1 : PATTERN_GAP_UNBOUNDED;
+            ++iter;
+        } else {
+            if ('\\' == *iter) {
+                ++iter;
+                if (iter == end) {
+                    g_set_error_literal(error, PATTERN_MATCHER_ERROR, PATTERN_MATCHER_ERROR_INVALID_PATTERN,
+                                        "pattern ends with an escape");
+                    g_string_free(literal, TRUE);
+                    return FALSE;
+                }
+            }
+            const gchar *next = g_utf8_next_char(iter);
+            g_string_append_len(literal, iter, next - iter);
+            iter = next;
+            continue;
+        }
+        /* 隙間の前のリテラルを断片にする。リテラルがなければ続いた隙間なのでまとめる */
+        if (0 < literal->len) {
+            PatternPiece piece = {0, pieces->len, FALSE, g_utf8_strlen(literal->str, literal->len), min_gap, max_gap};
+            g_array_append_val(pieces, piece);
+            g_ptr_array_add(texts, g_strndup(literal->str, literal->len));
+            g_string_truncate(literal, 0);
+            min_gap = max_gap = 0;
+        } else if (0 == pieces->len) {
+            g_set_error_literal(error, PATTERN_MATCHER_ERROR, PATTERN_MATCHER_ERROR_INVALID_PATTERN,
+                                "pattern starts with a gap");
+            g_string_free(literal, TRUE);
+            return FALSE;
+        }
+        min_gap = MIN(min_gap + gap_min, (gsize) PATTERN_MAX_GAP_COUNT);
+        max_gap = (PATTERN_GAP_UNBOUNDED == max_gap || PATTERN_GAP_UNBOUNDED == gap_max)
+            ? PATTERN_GAP_UNBOUNDED : MIN(max_gap + gap_max, (gsize) PATTERN_MAX_GAP_COUNT);
+    }
+    if (0 == literal->len) {
+        g_set_error_literal(error, PATTERN_MATCHER_ERROR, PATTERN_MATCHER_ERROR_INVALID_PATTERN,
+                            (0 == pieces->len) ? "pattern is empty" : "pattern ends with a gap");
+        g_string_free(literal, TRUE);
+        return FALSE;
+    }
+    PatternPiece piece = {0, pieces->len, FALSE, g_utf8_strlen(literal->str, literal->len), min_gap, max_gap};
+    g_array_append_val(pieces, piece);
+    g_ptr_array_add(texts, g_string_free(literal, FALSE));
+    return TRUE;
+}
+
+/**
+ * パターンを登録する。パターンは PatternMatcher_addPattern を呼んだ順に 0 から番号を付ける
+ * UTF-8 として不正なパターンや、書き方の誤ったパターンは受け付けない
+ */
+gboolean
+PatternMatcher_addPattern(PatternMatcher *self, const gchar *pattern, glong length, GError **error)
+{
+    if (0L > length) {
+        length = strlen(pattern);
+    }
+    if (!g_utf8_validate(pattern, length, NULL)) {
+        g_set_error_literal(error, PATTERN_MATCHER_ERROR, PATTERN_MATCHER_ERROR_INVALID_PATTERN,
+                            "pattern is not valid UTF-8");
+        return FALSE;
+    }
+    GArray *pieces = g_array_new(FALSE, FALSE, sizeof(PatternPiece));
+    GPtrArray *texts = g_ptr_array_new_with_free_func(g_free);
+    gboolean parsed = PatternMatcher_parse(pattern, length, pieces, texts, error);
+    for (guint i = 0; parsed && i < texts->len; ++i) {
+        parsed = Matcher_addKeyword(self->matcher, (const gchar *) g_ptr_array_index(texts, i), -1L, error);
+    }
+    if (parsed) {
+        for (guint i = 0; i < pieces->len; ++i) {
+            PatternPiece *piece = &g_array_index(pieces, PatternPiece, i);
+            piece->pattern = self->n_patterns;
+            piece->last = (i + 1 == pieces->len);
+            guint piece_number = self->pieces->len;
+            g_array_append_val(self->pieces, *piece);
+            GArray *numbers = (GArray *) g_hash_table_lookup(self->piece_table, g_ptr_array_index(texts, i));
+            if (NULL == numbers) {
+                numbers = g_array_new(FALSE, FALSE, sizeof(guint));
+                g_hash_table_insert(self->piece_table, g_strdup((const gchar *) g_ptr_array_index(texts, i)), numbers);
+            }
+            g_array_append_val(numbers, piece_number);
+        }
+        ++self->n_patterns;
+    }
+    g_ptr_array_free(texts, TRUE);
+    g_array_free(pieces, TRUE);
+    return parsed;
+}
+
+guint
+PatternMatcher_getPatternCount(PatternMatcher *self)
+{
+    return self->n_patterns;
+}
+
+/**
+ * 断片を登録した Matcher を前処理する
+ * 断片が末尾の位置の順に報告されることを前提にするので、使えるのは複数パターンのエンジンだけで、
+ * MATCHER_ENGINE_AUTO で単一パターンのエンジンが選ばれたときは Aho-Corasick 法を使う
+ */
+gboolean
+PatternMatcher_compile(PatternMatcher *self, MatcherEngine engine, GError **error)
+{
+    if (0 == self->n_patterns) {
+        g_set_error_literal(error, PATTERN_MATCHER_ERROR, PATTERN_MATCHER_ERROR_NO_PATTERN, "no pattern is added");
+        return FALSE;
+    }
+    if (MATCHER_ENGINE_AUTO == engine) {
+        engine = Matcher_planEngine(self->matcher);
+        if (!PatternMatcher_isOrderedEngine(engine)) {
+            engine = MATCHER_ENGINE_AHO_CORASICK;
+        }
+    } else if (!PatternMatcher_isOrderedEngine(engine)) {
+        g_set_error(error, MATCHER_ERROR, MATCHER_ERROR_UNSUPPORTED_ENGINE,
+                    "engine does not report keywords in end order: %d", (gint) engine);
+        return FALSE;
+    }
+    return Matcher_compile(self->matcher, engine, error);
+}
+
+/**
+ * 使用中のエンジンの名前を返す。まだコンパイルしていなければ NULL を返す
+ */
+const gchar *
+PatternMatcher_getEngineName(PatternMatcher *self)
+{
+    return Matcher_getEngineName(self->matcher);
+}
+
+/**
+ * 次の断片 next がこれから文字位置 position より手前で始まることはないので、
+ * 隙間の上限より手前で終わる並びを捨て、上限がなければ条件を満たした並びを最も後ろで始まる並び1つにまとめる
+ * 条件を満たした並びは、上限がなければその後もずっと満たし続ける
+ */
+static void
+PatternChainQueue_advance(PatternChainQueue *self, const PatternPiece *next, gsize position)
+{
+    PatternChain *chains = (PatternChain *) self->chains->data;
+    guint n_chains = self->chains->len;
+    if (PATTERN_GAP_UNBOUNDED != next->max_gap) {
+        while (self->head < n_chains && chains[self->head].end + next->max_gap < position) {
+            ++self->head;
+        }
+    } else {
+        guint i = self->head;
+        gsize start = 0;
+        for (; i < n_chains && chains[i].end + next->min_gap <= position; ++i) {
+            start = MAX(start, chains[i].start);
+        }
+        if (self->head < i) {
+            self->head = i - 1;
+            chains[self->head].start = start;
+        }
+    }
+    if (PATTERN_CHAIN_QUEUE_COMPACT_THRESHOLD < self->head && n_chains < self->head * 2) {
+        g_array_remove_range(self->chains, 0, self->head);
+        self->head = 0;
+    }
+}
+
+/**
+ * 断片の末尾の文字位置 end までの並びを加える。next は次の断片
+ */
+static void
+PatternChainQueue_push(PatternChainQueue *self, const PatternPiece *next, gsize end, gsize start)
+{
+    if (NULL == self->chains) {
+        self->chains = g_array_new(FALSE, FALSE, sizeof(PatternChain));
+    }
+    PatternChain chain = {end, start};
+    g_array_append_val(self->chains, chain);
+    /* 次の断片が報告されないままでも、待ち行列が隙間の範囲を越えて伸びないようにする */
+    PatternChainQueue_advance(self, next, (next->n_chars < end) ? end - next->n_chars : 0);
+}
+
+/**
+ * 文字位置 position で始まる断片 piece の直前の断片までの並びのうち、隙間の条件を満たすものを探し、
+ * 最も後ろで始まる並び (一致する範囲が最も短くなる並び) の開始位置を *start に入れる
+ */
+static gboolean
+PatternChainQueue_findStart(PatternChainQueue *self, const PatternPiece *piece, gsize position, gsize *start)
+{
+    if (NULL == self->chains) {
+        return FALSE;
+    }
+    PatternChainQueue_advance(self, piece, position);
+    const PatternChain *chains = (const PatternChain *) self->chains->data;
+    gboolean found = FALSE;
+    for (guint i = self->head; i < self->chains->len && chains[i].end + piece->min_gap <= position; ++i) {
+        *start = found ? MAX(*start, chains[i].start) : chains[i].start;
+        found = TRUE;
+    }
+    return found;
+}
+
+static gboolean
+PatternMatcher_reportPiece(const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    PatternMatcherScan *scan = (PatternMatcherScan *) user_data;
+    const PatternMatcher *self = scan->matcher;
+    /* 複数パターンのエンジンは末尾の位置の順に報告するので、文字位置は前回の末尾から数え足せばよい */
+    gsize end = offset + keywordlen;
+    scan->char_position += PatternMatcher_countChars(scan->text + scan->byte_position, end - scan->byte_position);
+    scan->byte_position = end;
+    const GArray *numbers = (const GArray *) g_hash_table_lookup(self->piece_table, keyword);
+    /* 同じ文字列が1つのパターンに続けて現れても、この出現が自分自身の後に続かないよう後ろの断片から調べる */
+    for (guint i = numbers->len; 0 < i--; ) {
+        guint number = g_array_index(numbers, guint, i);
+        const PatternPiece *piece = &g_array_index(self->pieces, PatternPiece, number);
+        gsize start = offset;
+        if (0 < piece->index &&
+            !PatternChainQueue_findStart(&scan->queues[number - 1], piece, scan->char_position - piece->n_chars,
+                                         &start)) {
+            continue;
+        }
+        if (!piece->last) {
+            PatternChainQueue_push(&scan->queues[number], piece + 1, scan->char_position, start);
+        } else if (!scan->func(piece->pattern, start, end - start, scan->user_data)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * text を1回走査して、すべてのパターンの一致を報告する
+ * 一致はパターンごとに最後の断片の末尾の位置ごとに1つだけ、その位置で終わる最も短い範囲を、末尾の位置の順に報告する
+ * まだコンパイルしていなければ自動選択でコンパイルする
+ */
+gboolean
+PatternMatcher_scanAll(PatternMatcher *self, const gchar *text, glong textlen,
+                       PatternMatcherFunc func, gpointer user_data, GError **error)
+{
+    if (MATCHER_ENGINE_AUTO == Matcher_getEngine(self->matcher) &&
+        !PatternMatcher_compile(self, MATCHER_ENGINE_AUTO, error)) {
+        return FALSE;
+    }
+    PatternMatcherScan scan = {self, text, 0, 0, g_new0(PatternChainQueue, self->pieces->len), func, user_data};
+    gboolean scanned = Matcher_scanAll(self->matcher, text, textlen, PatternMatcher_reportPiece, &scan, error);
+    for (guint i = 0; i < self->pieces->len; ++i) {
+        if (NULL != scan.queues[i].chains) {
+            g_array_free(scan.queues[i].chains, TRUE);
+        }
+    }
+    g_free(scan.queues);
+    return scanned;
+}
@@ -0,0 +1,55 @@
+// 文字数の範囲を決めた隙間でリテラルを区切ったパターン (error.{0,20}timeout や user=*;token) を探す
+// すべてのパターンのリテラル (断片) を1つの Matcher の複数パターンのエンジンに登録して1回だけ走査し、
+// 断片が末尾の位置の順に報告されるたびに、パターンごとの小さな状態機械で隙間の条件を確かめる
+// テキストを後戻りして読み直さないので、断片ごとに走査して結果を突き合わせるより速い
+//
+// パターンの書き方:
+//   .       任意の1文字
+//   .{m,n}  m 文字以上 n 文字以下の任意の文字列。.{m} はちょうど m 文字、.{m,} は m 文字以上
+//   ?       . と同じ
+//   *       .{0,} と同じ
+//   \c      文字 c そのもの
+// 続いた隙間は1つにまとめる。隙間は改行を含めた任意の文字に一致し、パターンはリテラルで始まりリテラルで終わる
+
+#ifndef __PATTERNMATCHER_H__
+#define __PATTERNMATCHER_H__
+
+#include <glib.h>
+
+#include "matcher.h"
+
+struct PatternMatcher;
+typedef struct PatternMatcher PatternMatcher;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PATTERN_MATCHER_ERROR (g_quark_from_static_string("pattern-matcher-error-quark"))
+
+typedef enum {
+    PATTERN_MATCHER_ERROR_INVALID_PATTERN,
+    PATTERN_MATCHER_ERROR_NO_PATTERN,
+} PatternMatcherError;
+
+/**
+ * パターンが見つかるたびに呼ばれる関数
+ * pattern は PatternMatcher_addPattern で登録した順の番号、offset と length は一致した範囲のバイトオフセットとバイト数
+ * FALSE を返すと走査を打ち切る
+ */
+typedef gboolean (*PatternMatcherFunc)(guint pattern, gsize offset, gsize length, gpointer user_data);
+
+extern PatternMatcher *PatternMatcher_new(void);
+extern void PatternMatcher_free(PatternMatcher *self);
+extern gboolean PatternMatcher_addPattern(PatternMatcher *self, const gchar *pattern, glong length, GError **error);
+extern guint PatternMatcher_getPatternCount(PatternMatcher *self);
+extern gboolean PatternMatcher_compile(PatternMatcher *self, MatcherEngine engine, GError **error);
+extern const gchar *PatternMatcher_getEngineName(PatternMatcher *self);
+extern gboolean PatternMatcher_scanAll(PatternMatcher *self, const gchar *text, glong textlen,
+                                       PatternMatcherFunc func, gpointer user_data, GError **error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __PATTERNMATCHER_H__
@@ -0,0 +1,331 @@
+#include <glib.h>
+
+#include "matcher.h"
+#include "scanscheduler.h"
+#include "utf8transcoder.h"
+
+struct ScanSchedulerTaskBlock;
+
+/**
+ * 投入された1つの文書。text は func が呼ばれるまで呼び出し側が保持する
+ */
+typedef struct ScanSchedulerTask {
+    const gchar *text;
+    gsize textlen;
+    gpointer document;
+    struct ScanSchedulerTaskBlock *block; /* この文書を含む、1回の投入でまとめて確保した領域 */
+    GList link;                           /* キューの要素。data は自分を指し、キューに入れるときに確保しなくて済む */
+} ScanSchedulerTask;
+
+/**
+ * 1回の投入の文書をまとめて確保した領域。最後の文書を走査し終えたワーカーが解放する
+ */
+typedef struct ScanSchedulerTaskBlock {
+    gint n_pending; /* まだ func を呼び終えていない文書の数 */
+    ScanSchedulerTask tasks[];
+} ScanSchedulerTaskBlock;
+
+/**
+ * ワーカーごとの両端キューと、走査のたびに使い回す領域
+ * 持ち主は queue の先頭 (古いもの) から取り、盗む側は末尾から半分をまとめて取る
+ */
+typedef struct ScanSchedulerWorker {
+    ScanScheduler *scheduler;
+    GThread *thread;
+    guint index;
+    GMutex mutex;       /* queue を守る */
+    GQueue queue;       /* 要素は ScanSchedulerTask の link */
+    GArray *matches;    /* 要素は ScanSchedulerMatch */
+    UTF16Buffer buffer; /* UTF-16 に変換するエンジンの変換先 */
+    guint64 n_steals;
+} ScanSchedulerWorker;
+
+struct ScanScheduler {
+    Matcher *matcher;
+    ScanSchedulerFunc func;
+    gpointer user_data;
+    guint n_workers;
+    ScanSchedulerWorker *workers;
+    gint next_worker;   /* 次に投入された文書を入れるキュー */
+    gint n_queued;      /* いずれかのキューに入っている文書の数 */
+    gint n_outstanding; /* 投入されて、まだ func を呼び終えていない文書の数 */
+    gint n_idle;        /* idle_cond で待っているワーカーの数 */
+    gboolean quit;
+    GMutex mutex;       /* idle_cond, done_cond と quit を守る */
+    GCond idle_cond;
+    GCond done_cond;
+};
+
+static gboolean
+ScanScheduler_collect(const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    ScanSchedulerMatch match = {keyword, keywordlen, offset};
+    g_array_append_val((GArray *) user_data, match);
+    return TRUE;
+}
+
+/**
+ * 自分のキューの先頭から文書を取る
+ */
+static ScanSchedulerTask *
+ScanSchedulerWorker_pop(ScanSchedulerWorker *self)
+{
+    g_mutex_lock(&self->mutex);
+    GList *link = g_queue_pop_head_link(&self->queue);
+    g_mutex_unlock(&self->mutex);
+    return (NULL != link) ? (ScanSchedulerTask *) link->data : NULL;
+}
+
+/**
+ * 隣のワーカーから順にキューを調べ、最初に見つかったキューの末尾から半分 (端数は切り上げ) を盗む
+ * 盗んだうち最も古い文書を返し、残りは自分のキューに移す
+ */
+static ScanSchedulerTask *
+ScanSchedulerWorker_steal(ScanSchedulerWorker *self)
+{
+    ScanScheduler *scheduler = self->scheduler;
+    for (guint i = 1; i < scheduler->n_workers; ++i) {
+        ScanSchedulerWorker *victim = &scheduler->workers[(self->index + i) % scheduler->n_workers];
+        GQueue stolen = G_QUEUE_INIT;
+        g_mutex_lock(&victim->mutex);
+        guint n_steals = (victim->queue.length + 1) / 2;
+        for (guint j = 0; j < n_steals; ++j) {
+            g_queue_push_head_link(&stolen, g_queue_pop_tail_link(&victim->queue));
+        }
+        g_mutex_unlock(&victim->mutex);
+        if (0 == n_steals) {
+            continue;
+        }
+        ++self->n_steals;
+        ScanSchedulerTask *task = (ScanSchedulerTask *) g_queue_pop_head_link(&stolen)->data;
+        if (!g_queue_is_empty(&stolen)) {
+            g_mutex_lock(&self->mutex);
+            while (!g_queue_is_empty(&stolen)) {
+                g_queue_push_tail_link(&self->queue, g_queue_pop_head_link(&stolen));
+            }
+            g_mutex_unlock(&self->mutex);
+        }
+        return task;
+    }
+    return NULL;
+}
+
+/**
+ * 文書を走査して func に渡す
+ */
+static void
+ScanSchedulerWorker_run(ScanSchedulerWorker *self, ScanSchedulerTask *task)
+{
+    ScanScheduler *scheduler = self->scheduler;
+    GError *error = NULL;
+    g_array_set_size(self->matches, 0);
+    if (!Matcher_scanAllWithBuffer(scheduler->matcher, task->text, task->textlen, &self->buffer,
+                                   ScanScheduler_collect, self->matches, &error)) {
+        g_array_set_size(self->matches, 0);
+    }
+    scheduler->func(task->document, (const ScanSchedulerMatch *) self->matches->data, self->matches->len, error,
+                    scheduler->user_data);
+    g_clear_error(&error);
+    if (g_atomic_int_dec_and_test(&task->block->n_pending)) {
+        g_free(task->block);
+    }
+    if (g_atomic_int_dec_and_test(&scheduler->n_outstanding)) {
+        g_mutex_lock(&scheduler->mutex);
+        g_cond_broadcast(&scheduler->done_cond);
+        g_mutex_unlock(&scheduler->mutex);
+    }
+}
+
+static gpointer
+ScanSchedulerWorker_main(gpointer data)
+{
+    ScanSchedulerWorker *self = (ScanSchedulerWorker *) data;
+    ScanScheduler *scheduler = self->scheduler;
+    while (TRUE) {
+        ScanSchedulerTask *task = ScanSchedulerWorker_pop(self);
+        if (NULL == task) {
+            task = ScanSchedulerWorker_steal(self);
+        }
+        if (NULL != task) {
+            g_atomic_int_add(&scheduler->n_queued, -1);
+            ScanSchedulerWorker_run(self, task);
+            continue;
+        }
+        /* どのキューも空なら、文書が投入されるか終了を求められるまで眠る */
+        g_mutex_lock(&scheduler->mutex);
+        g_atomic_int_inc(&scheduler->n_idle);
+        while (0 == g_atomic_int_get(&scheduler->n_queued) && !scheduler->quit) {
+            g_cond_wait(&scheduler->idle_cond, &scheduler->mutex);
+        }
+        g_atomic_int_add(&scheduler->n_idle, -1);
+        gboolean quit = scheduler->quit;
+        g_mutex_unlock(&scheduler->mutex);
+        if (quit) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * 終了を知らせ、起動したワーカーの終了を待つ
+ */
+static void
+ScanScheduler_stopWorkers(ScanScheduler *self, guint n_started)
+{
+    g_mutex_lock(&self->mutex);
+    self->quit = TRUE;
+    g_cond_broadcast(&self->idle_cond);
+    g_mutex_unlock(&self->mutex);
+    for (guint i = 0; i < n_started; ++i) {
+        g_thread_join(self->workers[i].thread);
+    }
+    for (guint i = 0; i < self->n_workers; ++i) {
+        ScanSchedulerWorker *worker = &self->workers[i];
+        UTF16Buffer_clear(&worker->buffer);
+        g_array_free(worker->matches, TRUE);
+        g_queue_clear(&worker->queue);
+        g_mutex_clear(&worker->mutex);
+    }
+    g_cond_clear(&self->done_cond);
+    g_cond_clear(&self->idle_cond);
+    g_mutex_clear(&self->mutex);
+    g_free(self->workers);
+}
+
+/**
+ * matcher で文書を走査する n_workers 個のワーカーを起動する。n_workers が 0 なら CPU の数だけ起動する
+ * matcher はまだコンパイルしていなければ自動選択でコンパイルし、スケジューラを解放するまで変更してはならない
+ * func は文書ごとにワーカーのスレッドから呼ばれるので、複数のスレッドから同時に呼ばれてもよいように作る
+ */
+ScanScheduler *
+ScanScheduler_new(Matcher *matcher, guint n_workers, ScanSchedulerFunc func, gpointer user_data, GError **error)
+{
+    if (MATCHER_ENGINE_AUTO == Matcher_getEngine(matcher) && !Matcher_compile(matcher, MATCHER_ENGINE_AUTO, error)) {
+        return NULL;
+    }
+    ScanScheduler *self = (ScanScheduler *) g_malloc0(sizeof(ScanScheduler));
+    self->matcher = matcher;
+    self->func = func;
+    self->user_data = user_data;
+    self->n_workers = (0 < n_workers) ? n_workers : g_get_num_processors();
+    self->workers = g_new0(ScanSchedulerWorker, self->n_workers);
+    g_mutex_init(&self->mutex);
+    g_cond_init(&self->idle_cond);
+    g_cond_init(&self->done_cond);
+    for (guint i = 0; i < self->n_workers; ++i) {
+        ScanSchedulerWorker *worker = &self->workers[i];
+        worker->scheduler = self;
+        worker->index = i;
+        g_mutex_init(&worker->mutex);
+        g_queue_init(&worker->queue);
+        worker->matches = g_array_new(FALSE, FALSE, sizeof(ScanSchedulerMatch));
+        worker->buffer = (UTF16Buffer) UTF16BUFFER_INIT;
+    }
+    for (guint i = 0; i < self->n_workers; ++i) {
+        self->workers[i].thread = g_thread_try_new("scan-worker", ScanSchedulerWorker_main, &self->workers[i], error);
+        if (NULL == self->workers[i].thread) {
+            ScanScheduler_stopWorkers(self, i);
+            g_free(self);
+            return NULL;
+        }
+    }
+    return self;
+}
+
+/**
+ * 投入済みの文書をすべて走査し終えるのを待ってから、ワーカーを止めて解放する
+ */
+void
+ScanScheduler_free(ScanScheduler *self)
+{
+    if (NULL == self) {
+        return;
+    }
+    ScanScheduler_wait(self);
+    ScanScheduler_stopWorkers(self, self->n_workers);
+    g_free(self);
+}
+
+guint
+ScanScheduler_getWorkerCount(ScanScheduler *self)
+{
+    return self->n_workers;
+}
+
+/**
+ * 文書を投入する。文書はワーカーのキューに順番に振り分け、空いたワーカーが他のキューから盗んで偏りを均す
+ * text は document を渡して func が呼ばれるまで有効でなければならない
+ */
+void
+ScanScheduler_submit(ScanScheduler *self, const gchar *text, gsize textlen, gpointer document)
+{
+    ScanScheduler_submitMany(self, &text, &textlen, &document, 1);
+}
+
+/**
+ * n_documents 個の文書をまとめて投入する。文書ごとの領域は1回で確保する
+ */
+void
+ScanScheduler_submitMany(ScanScheduler *self, const gchar *const *texts, const gsize *textlens, gpointer const *documents,
+                         gsize n_documents)
+{
+    if (0 == n_documents) {
+        return;
+    }
+    ScanSchedulerTaskBlock *block = (ScanSchedulerTaskBlock *) g_malloc(sizeof(ScanSchedulerTaskBlock) +
+                                                                        sizeof(ScanSchedulerTask) * n_documents);
+    block->n_pending = (gint) n_documents;
+    g_atomic_int_add(&self->n_outstanding, (gint) n_documents);
+    /* 文書をキューに入れる前に数えておき、すぐに取り出したワーカーが n_queued を負にしないようにする */
+    g_atomic_int_add(&self->n_queued, (gint) n_documents);
+    for (gsize i = 0; i < n_documents; ++i) {
+        ScanSchedulerTask *task = &block->tasks[i];
+        task->text = texts[i];
+        task->textlen = textlens[i];
+        task->document = documents[i];
+        task->block = block;
+        task->link = (GList) {task, NULL, NULL};
+        guint index = (guint) g_atomic_int_add(&self->next_worker, 1) % self->n_workers;
+        ScanSchedulerWorker *worker = &self->workers[index];
+        g_mutex_lock(&worker->mutex);
+        g_queue_push_tail_link(&worker->queue, &task->link);
+        g_mutex_unlock(&worker->mutex);
+    }
+    /* 眠っているワーカーがいるときだけ起こす。ワーカーは n_idle を増やしてから n_queued を確かめる */
+    if (0 < g_atomic_int_get(&self->n_idle)) {
+        g_mutex_lock(&self->mutex);
+        if (1 == n_documents) {
+            g_cond_signal(&self->idle_cond);
+        } else {
+            g_cond_broadcast(&self->idle_cond);
+        }
+        g_mutex_unlock(&self->mutex);
+    }
+}
+
+/**
+ * 投入済みの文書をすべて走査し、func を呼び終えるまで待つ
+ */
+void
+ScanScheduler_wait(ScanScheduler *self)
+{
+    g_mutex_lock(&self->mutex);
+    while (0 < g_atomic_int_get(&self->n_outstanding)) {
+        g_cond_wait(&self->done_cond, &self->mutex);
+    }
+    g_mutex_unlock(&self->mutex);
+}
+
+/**
+ * 他のワーカーのキューから盗んだ回数の合計を返す。ScanScheduler_wait の後に呼ぶ
+ */
+guint64
+ScanScheduler_getStealCount(ScanScheduler *self)
+{
+    guint64 n_steals = 0;
+    for (guint i = 0; i < self->n_workers; ++i) {
+        n_steals += self->workers[i].n_steals;
+    }
+    return n_steals;
+}
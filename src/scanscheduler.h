@@ -0,0 +1,50 @@
+// 多数の文書を1つの Matcher で走査するためのスケジューラ
+// ワーカーごとに両端キューを持ち、自分のキューが空になったら他のワーカーのキューの先頭から盗む
+// 文書の大きさが大きく異なっても、手の空いたワーカーが残りを引き受けるので待ち時間の裾が伸びにくい
+
+#ifndef __SCANSCHEDULER_H__
+#define __SCANSCHEDULER_H__
+
+#include <glib.h>
+
+#include "matcher.h"
+
+struct ScanScheduler;
+typedef struct ScanScheduler ScanScheduler;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 文書の中で見つかったキーワード
+ */
+typedef struct ScanSchedulerMatch {
+    const gchar *keyword;
+    gsize keywordlen;
+    gsize offset; /* キーワードの開始位置を指すバイトオフセット */
+} ScanSchedulerMatch;
+
+/**
+ * 文書の走査が終わるたびに、走査したワーカーのスレッドから呼ばれる関数
+ * matches は見つかった順に並び、ワーカーが使い回す領域なので呼び出しの間だけ有効
+ * 走査に失敗したときは error に理由が入り、matches は空になる
+ */
+typedef void (*ScanSchedulerFunc)(gpointer document, const ScanSchedulerMatch *matches, gsize n_matches,
+                                  const GError *error, gpointer user_data);
+
+extern ScanScheduler *ScanScheduler_new(Matcher *matcher, guint n_workers, ScanSchedulerFunc func,
+                                        gpointer user_data, GError **error);
+extern void ScanScheduler_free(ScanScheduler *self);
+extern guint ScanScheduler_getWorkerCount(ScanScheduler *self);
+extern void ScanScheduler_submit(ScanScheduler *self, const gchar *text, gsize textlen, gpointer document);
+extern void ScanScheduler_submitMany(ScanScheduler *self, const gchar *const *texts, const gsize *textlens,
+                                     gpointer const *documents, gsize n_documents);
+extern void ScanScheduler_wait(ScanScheduler *self);
+extern guint64 ScanScheduler_getStealCount(ScanScheduler *self);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __SCANSCHEDULER_H__
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+
+#include "scanstats.h"
+
+static const gchar *const scanstats_rule_names[SCANSTATS_N_RULES] = {
+    "shift1",
+    "shift2",
+    "chars",
+    "bad-character",
+    "good-suffix",
+};
+
+const gchar *
+ScanStatsRule_getName(ScanStatsRule rule)
+{
+    return scanstats_rule_names[rule];
+}
+
+void
+ScanStats_reset(ScanStats *self)
+{
+    memset(self, 0, sizeof(ScanStats));
+}
+
+/**
+ * other の値を self に足し込む
+ */
+void
+ScanStats_add(ScanStats *self, const ScanStats *other)
+{
+    self->n_scans += other->n_scans;
+    self->n_units += other->n_units;
+    self->n_alignments += other->n_alignments;
+    self->n_compares += other->n_compares;
+    self->n_shifts += other->n_shifts;
+    self->total_shift += other->total_shift;
+    for (gsize i = 0; i < SCANSTATS_N_SHIFT_BUCKETS; ++i) {
+        self->shift_histogram[i] += other->shift_histogram[i];
+    }
+    for (gsize i = 0; i < SCANSTATS_N_RULES; ++i) {
+        self->n_rule_shifts[i] += other->n_rule_shifts[i];
+        self->rule_total_shift[i] += other->rule_total_shift[i];
+    }
+    self->n_fail_transitions += other->n_fail_transitions;
+    self->n_output_steps += other->n_output_steps;
+    self->n_skipped += other->n_skipped;
+}
+
+/**
+ * シフト量の平均を返す。シフトしていなければ 0 を返す
+ */
+gdouble
+ScanStats_getMeanShift(const ScanStats *self)
+{
+    return (0 < self->n_shifts) ? (gdouble) self->total_shift / self->n_shifts : 0.0;
+}
+
+gdouble
+ScanStats_getRuleMeanShift(const ScanStats *self, ScanStatsRule rule)
+{
+    return (0 < self->n_rule_shifts[rule]) ? (gdouble) self->rule_total_shift[rule] / self->n_rule_shifts[rule] : 0.0;
+}
+
+void
+ScanStats_pprint(const ScanStats *self, FILE *ostream)
+{
+    fprintf(ostream, "scans=%lu, units=%lu, alignments=%lu, compares=%lu, skipped=%lu\n",
+            (unsigned long) self->n_scans, (unsigned long) self->n_units, (unsigned long) self->n_alignments,
+            (unsigned long) self->n_compares, (unsigned long) self->n_skipped);
+    fprintf(ostream, "shifts=%lu, mean shift=%.2lf\n", (unsigned long) self->n_shifts, ScanStats_getMeanShift(self));
+    for (gsize i = 0; i < SCANSTATS_N_RULES; ++i) {
+        if (0 < self->n_rule_shifts[i]) {
+            fprintf(ostream, "  %s: shifts=%lu, mean shift=%.2lf\n", ScanStatsRule_getName((ScanStatsRule) i),
+                    (unsigned long) self->n_rule_shifts[i], ScanStats_getRuleMeanShift(self, (ScanStatsRule) i));
+        }
+    }
+    for (gsize i = 0; i < SCANSTATS_N_SHIFT_BUCKETS; ++i) {
+        if (0 < self->shift_histogram[i]) {
+            if (SCANSTATS_N_SHIFT_BUCKETS - 1 == i) {
+                fprintf(ostream, "  shift >= %lu: %lu\n", 1ul << i, (unsigned long) self->shift_histogram[i]);
+            } else {
+                fprintf(ostream, "  shift %lu-%lu: %lu\n", 1ul << i, (2ul << i) - 1,
+                        (unsigned long) self->shift_histogram[i]);
+            }
+        }
+    }
+    if (0 < self->n_fail_transitions || 0 < self->n_output_steps) {
+        fprintf(ostream, "fail transitions=%lu, output steps=%lu\n",
+                (unsigned long) self->n_fail_transitions, (unsigned long) self->n_output_steps);
+    }
+}
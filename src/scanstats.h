@@ -0,0 +1,99 @@
+// 走査の統計
+// STRING_MATCHING_STATS を定義してビルドしたときだけ、各エンジンが照合位置の数やシフト量の分布などを数える
+// 定義しなければ記録のマクロは何も生成せず、マッチャーも統計の領域を持たない
+// 統計はマッチャーごとに持つので、統計を有効にしたマッチャーを複数のスレッドで同時に走査してはならない
+
+#ifndef __SCANSTATS_H__
+#define __SCANSTATS_H__
+
+#include <stdio.h>
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * シフト量を決めた規則
+ */
+typedef enum {
+    SCANSTATS_RULE_SHIFT1,        /* Commentz-Walter の shift1 */
+    SCANSTATS_RULE_SHIFT2,        /* Commentz-Walter の shift2 */
+    SCANSTATS_RULE_CHARS,         /* Commentz-Walter の chars */
+    SCANSTATS_RULE_BAD_CHARACTER, /* Boyer-Moore の bctable、Sunday と Horspool のシフト表 */
+    SCANSTATS_RULE_GOOD_SUFFIX,   /* Boyer-Moore の gstable */
+    SCANSTATS_N_RULES,
+} ScanStatsRule;
+
+/* シフト量のヒストグラムの階級数。i 番目の階級は [2^i, 2^(i+1)) で、最後の階級はそれ以上をすべて含む */
+#define SCANSTATS_N_SHIFT_BUCKETS 16
+
+/**
+ * 走査の統計
+ * 長さの単位はバイト単位のエンジンではバイト、UTF-16 のエンジンでは UTF-16 のコード単位になる
+ */
+typedef struct ScanStats {
+    guint64 n_scans;                                    /* 走査の回数 */
+    guint64 n_units;                                    /* 走査したテキストの長さの合計 */
+    guint64 n_alignments;                               /* パターンをテキストに重ねて照合した位置の数 */
+    guint64 n_compares;                                 /* 比較したテキストの文字数 */
+    guint64 n_shifts;                                   /* シフトの回数 */
+    guint64 total_shift;                                /* シフト量の合計 */
+    guint64 shift_histogram[SCANSTATS_N_SHIFT_BUCKETS]; /* シフト量の分布 */
+    guint64 n_rule_shifts[SCANSTATS_N_RULES];           /* 規則ごとのシフトの回数 */
+    guint64 rule_total_shift[SCANSTATS_N_RULES];        /* 規則ごとのシフト量の合計 */
+    guint64 n_fail_transitions;                         /* Aho-Corasick の fail_state への遷移の回数 */
+    guint64 n_output_steps;                             /* Aho-Corasick で output を探して fail_state を辿った回数 */
+    guint64 n_skipped;                                  /* 比較せずに読み飛ばした長さ */
+} ScanStats;
+
+extern const gchar *ScanStatsRule_getName(ScanStatsRule rule);
+
+extern void ScanStats_reset(ScanStats *self);
+extern void ScanStats_add(ScanStats *self, const ScanStats *other);
+extern gdouble ScanStats_getMeanShift(const ScanStats *self);
+extern gdouble ScanStats_getRuleMeanShift(const ScanStats *self, ScanStatsRule rule);
+extern void ScanStats_pprint(const ScanStats *self, FILE *ostream);
+
+/**
+ * Commentz-Walter のシフト量 MIN(MAX(shift1, chars_shift), shift2) を決めた規則を返す
+ */
+static inline ScanStatsRule
+ScanStats_selectCommentzWalterRule(glong shift1, glong shift2, glong chars_shift)
+{
+    if (shift2 < MAX(shift1, chars_shift)) {
+        return SCANSTATS_RULE_SHIFT2;
+    }
+    return (shift1 >= chars_shift) ? SCANSTATS_RULE_SHIFT1 : SCANSTATS_RULE_CHARS;
+}
+
+/**
+ * 1回のシフトを記録する
+ * compared はその照合位置で比較した文字数で、シフト量がそれを超えた分を読み飛ばした長さとして数える
+ */
+static inline void
+ScanStats_recordShift(ScanStats *self, ScanStatsRule rule, glong shift, glong compared)
+{
+    ++self->n_shifts;
+    self->total_shift += shift;
+    ++self->shift_histogram[MIN(g_bit_storage((gulong) MAX(shift, 1)) - 1, SCANSTATS_N_SHIFT_BUCKETS - 1)];
+    ++self->n_rule_shifts[rule];
+    self->rule_total_shift[rule] += shift;
+    if (shift > compared) {
+        self->n_skipped += shift - compared;
+    }
+}
+
+#ifdef STRING_MATCHING_STATS
+#define SCANSTATS_COUNT(stats, field, n) ((stats)->field += (n))
+#define SCANSTATS_SHIFT(stats, rule, shift, compared) ScanStats_recordShift((stats), (rule), (shift), (compared))
+#else
+#define SCANSTATS_COUNT(stats, field, n) ((void) 0)
+#define SCANSTATS_SHIFT(stats, rule, shift, compared) ((void) 0)
+#endif // STRING_MATCHING_STATS
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __SCANSTATS_H__
@@ -0,0 +1,62 @@
+#include <string.h>
+#include <glib.h>
+
+#include "simddispatch.h"
+
+static const gchar *level_names[] = {
+    "scalar", "sse2", "avx2", "avx512",
+};
+
+/**
+ * CPU が対応している最も高い SIMD レベルを返す
+ */
+SIMDLevel
+SIMDDispatch_getSupportedLevel(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return SIMD_LEVEL_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_LEVEL_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SIMD_LEVEL_SSE2;
+    }
+#endif
+    return SIMD_LEVEL_SCALAR;
+}
+
+/**
+ * 各エンジンが使う SIMD レベルを返す
+ * 初回呼び出し時に CPU を検出し、環境変数による指定があればそれを反映した結果を以降も使う
+ * 指定されたレベルが CPU の対応範囲を超える場合は、対応している最も高いレベルに切り詰める
+ */
+SIMDLevel
+SIMDDispatch_getLevel(void)
+{
+    static gsize level_once = 0;
+    if (g_once_init_enter(&level_once)) {
+        SIMDLevel level = SIMDDispatch_getSupportedLevel();
+        const gchar *forced_name = g_getenv(SIMDDISPATCH_ENV_NAME);
+        if (NULL != forced_name) {
+            for (guint i = 0; i < G_N_ELEMENTS(level_names); ++i) {
+                if (0 == g_ascii_strcasecmp(forced_name, level_names[i])) {
+                    level = MIN(level, (SIMDLevel) i);
+                    break;
+                }
+            }
+        }
+        /* 0 は未初期化を表すので 1 を足して保存する */
+        g_once_init_leave(&level_once, level + 1);
+    }
+    return (SIMDLevel) (level_once - 1);
+}
+
+const gchar *
+SIMDDispatch_getLevelName(SIMDLevel level)
+{
+    g_assert((guint) level < G_N_ELEMENTS(level_names));
+    return level_names[level];
+}
@@ -0,0 +1,31 @@
+// SIMD 命令を使うカーネルを実行時の CPU に合わせて選ぶための共通処理
+// 環境変数 STRING_MATCHING_SIMD に scalar, sse2, avx2, avx512 のいずれかを指定すると、
+// CPU が対応している範囲でそのレベルに固定できる
+
+#ifndef __SIMDDISPATCH_H__
+#define __SIMDDISPATCH_H__
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIMDDISPATCH_ENV_NAME "STRING_MATCHING_SIMD"
+
+typedef enum {
+    SIMD_LEVEL_SCALAR,
+    SIMD_LEVEL_SSE2,
+    SIMD_LEVEL_AVX2,
+    SIMD_LEVEL_AVX512,
+} SIMDLevel;
+
+extern SIMDLevel SIMDDispatch_getLevel(void);
+extern SIMDLevel SIMDDispatch_getSupportedLevel(void);
+extern const gchar *SIMDDispatch_getLevelName(SIMDLevel level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __SIMDDISPATCH_H__
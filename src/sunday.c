@@ -2,12 +2,17 @@
 #include <string.h>
 #include <glib.h>
 
+#include "memoryusage.h"
+#include "scanstats.h"
 #include "sunday.h"
 
 struct SundayMatcher {
     gchar *pattern;
     gsize patternlen;
     gsize shifts[0x100];
+#ifdef STRING_MATCHING_STATS
+    ScanStats stats;
+#endif
 };
 
 SundayMatcher *
@@ -51,28 +56,203 @@ SundayMatcher_reinit(SundayMatcher *self, const gchar *pattern, glong patternlen
     }
 }
 
-gboolean
-SundayMatcher_scan(SundayMatcher *self, const gchar *text, gsize textlen)
+/**
+ * シフト表を使って照合する
+ * SIMD 版のカーネルもベクトル幅に満たない末尾の検査に使うので、走査の回数はここでは数えない
+ */
+static const gchar *
+SundayMatcher_findImpl(SundayMatcher *self, const gchar *text, gsize textlen)
 {
     const gchar *textend = text + textlen;
     const gchar *text_iter = text + self->patternlen - 1;
   continue_scanning:;
     if (textend <= text_iter) {
-        return FALSE;
+        return NULL;
     }
+    SCANSTATS_COUNT(&self->stats, n_alignments, 1);
     const gchar *subtext_iter = text_iter;
     const gchar *pattern_end = self->pattern - 1;
     const gchar *pattern_iter = pattern_end + self->patternlen;
     for (; pattern_end != pattern_iter; --subtext_iter, --pattern_iter) {
+        SCANSTATS_COUNT(&self->stats, n_compares, 1);
         if (*subtext_iter != *pattern_iter) {
             // 比較開始位置のひとつ後ろの文字を使ってシフト量を求める
             if (textend == subtext_iter + 1) {
-                return FALSE;
+                return NULL;
             }
             gchar subtext_char = *(subtext_iter + 1);
+            SCANSTATS_SHIFT(&self->stats, SCANSTATS_RULE_BAD_CHARACTER, self->shifts[(guchar) subtext_char],
+                            text_iter - subtext_iter + 1);
             text_iter += self->shifts[(guchar) subtext_char];
             goto continue_scanning;
         }
     }
-    return TRUE;
+    return subtext_iter + 1;
+}
+
+/**
+ * パターンが最初に現れる位置を返し、見つからなければ NULL を返す
+ */
+const gchar *
+SundayMatcher_find(SundayMatcher *self, const gchar *text, gsize textlen)
+{
+    SCANSTATS_COUNT(&self->stats, n_scans, 1);
+    SCANSTATS_COUNT(&self->stats, n_units, textlen);
+    return SundayMatcher_findImpl(self, text, textlen);
+}
+
+gboolean
+SundayMatcher_scan(SundayMatcher *self, const gchar *text, gsize textlen)
+{
+    return NULL != SundayMatcher_find(self, text, textlen);
+}
+
+/**
+ * 走査の統計を返す。STRING_MATCHING_STATS を定義せずにビルドしていれば NULL を返す
+ */
+const ScanStats *
+SundayMatcher_getStats(const SundayMatcher *self)
+{
+#ifdef STRING_MATCHING_STATS
+    return &self->stats;
+#else
+    return NULL;
+#endif
+}
+
+void
+SundayMatcher_resetStats(SundayMatcher *self)
+{
+#ifdef STRING_MATCHING_STATS
+    ScanStats_reset(&self->stats);
+#endif
+}
+
+/**
+ * 確保している領域のバイト数を用途ごとに usage に足し込む
+ */
+void
+SundayMatcher_memoryUsage(const SundayMatcher *self, MemoryUsage *usage)
+{
+    usage->patterns += sizeof(gchar) * (self->patternlen + 1);
+    usage->shift_tables += sizeof(self->shifts);
+    usage->overhead += sizeof(SundayMatcher) - sizeof(self->shifts);
 }
+
+#ifdef __SSE2__
+
+#include <immintrin.h>
+
+#include "simddispatch.h"
+
+/**
+ * パターンの先頭と末尾のバイトを複数のテキスト位置と同時に比較し、
+ * 両方が一致した位置だけを memcmp で検証する
+ * ベクトル幅に満たない末尾はシフト表を使ったスカラ版で検査する
+ */
+
+typedef const gchar *(*SundayMatcher_findKernel)(SundayMatcher *self, const gchar *text, gsize textlen);
+
+static inline const gchar *
+SundayMatcher_verifyCandidates(guint32 mask, const gchar *candidates, const gchar *pattern, gsize patternlen)
+{
+    for (; 0 != mask; mask &= mask - 1) {
+        const gchar *candidate = candidates + __builtin_ctz(mask);
+        if (patternlen <= 2 || 0 == memcmp(candidate + 1, pattern + 1, patternlen - 2)) {
+            return candidate;
+        }
+    }
+    return NULL;
+}
+
+__attribute__((target("sse2")))
+static const gchar *
+SundayMatcher_findSSE2(SundayMatcher *self, const gchar *text, gsize textlen)
+{
+    const gchar *pattern = self->pattern;
+    const gsize patternlen = self->patternlen;
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[patternlen - 1]);
+    gsize offset = 0;
+    for (; offset + patternlen - 1 + 16 <= textlen; offset += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i *) (text + offset));
+        __m128i block_last = _mm_loadu_si128((const __m128i *) (text + offset + patternlen - 1));
+        guint32 mask = (guint32) _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+        const gchar *found = SundayMatcher_verifyCandidates(mask, text + offset, pattern, patternlen);
+        if (NULL != found) {
+            return found;
+        }
+    }
+    return SundayMatcher_findImpl(self, text + offset, textlen - offset);
+}
+
+__attribute__((target("avx2")))
+static const gchar *
+SundayMatcher_findAVX2(SundayMatcher *self, const gchar *text, gsize textlen)
+{
+    const gchar *pattern = self->pattern;
+    const gsize patternlen = self->patternlen;
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[patternlen - 1]);
+    gsize offset = 0;
+    for (; offset + patternlen - 1 + 32 <= textlen; offset += 32) {
+        __m256i block_first = _mm256_loadu_si256((const __m256i *) (text + offset));
+        __m256i block_last = _mm256_loadu_si256((const __m256i *) (text + offset + patternlen - 1));
+        guint32 mask = (guint32) _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+        const gchar *found = SundayMatcher_verifyCandidates(mask, text + offset, pattern, patternlen);
+        if (NULL != found) {
+            return found;
+        }
+    }
+    return SundayMatcher_findSSE2(self, text + offset, textlen - offset);
+}
+
+/**
+ * 実行時の CPU で使える最も広いカーネルを返す
+ */
+static SundayMatcher_findKernel
+SundayMatcher_getFindKernel(void)
+{
+    static gsize kernel_once = 0;
+    static SundayMatcher_findKernel kernel = NULL;
+    if (g_once_init_enter(&kernel_once)) {
+        switch (SIMDDispatch_getLevel()) {
+        case SIMD_LEVEL_AVX512:
+        case SIMD_LEVEL_AVX2:
+            kernel = SundayMatcher_findAVX2;
+            break;
+        case SIMD_LEVEL_SSE2:
+            kernel = SundayMatcher_findSSE2;
+            break;
+        default:
+            kernel = SundayMatcher_findImpl;
+            break;
+        }
+        g_once_init_leave(&kernel_once, 1);
+    }
+    return kernel;
+}
+
+/**
+ * SIMD 版のカーネルはブロック単位で比較するので、走査の統計にはシフト表を使った末尾の検査だけが数えられる
+ */
+const gchar *
+SundayMatcher_findWithSIMD(SundayMatcher *self, const gchar *text, gsize textlen)
+{
+    if (0 == self->patternlen || textlen < self->patternlen) {
+        return SundayMatcher_find(self, text, textlen);
+    }
+    SCANSTATS_COUNT(&self->stats, n_scans, 1);
+    SCANSTATS_COUNT(&self->stats, n_units, textlen);
+    return SundayMatcher_getFindKernel()(self, text, textlen);
+}
+
+gboolean
+SundayMatcher_scanWithSIMD(SundayMatcher *self, const gchar *text, gsize textlen)
+{
+    return NULL != SundayMatcher_findWithSIMD(self, text, textlen);
+}
+
+#endif // __SSE2__
@@ -3,6 +3,9 @@
 
 #include <glib.h>
 
+#include "memoryusage.h"
+#include "scanstats.h"
+
 struct SundayMatcher;
 typedef struct SundayMatcher SundayMatcher;
 
@@ -10,5 +13,13 @@ extern SundayMatcher * SundayMatcher_new(const gchar *pattern, glong patternlen)
 extern void SundayMatcher_free(SundayMatcher *self);
 extern void SundayMatcher_reinit(SundayMatcher *self, const gchar *pattern, glong patternlen);
 extern gboolean SundayMatcher_scan(SundayMatcher *self, const gchar *text, gsize textlen);
+extern const gchar *SundayMatcher_find(SundayMatcher *self, const gchar *text, gsize textlen);
+extern const ScanStats *SundayMatcher_getStats(const SundayMatcher *self);
+extern void SundayMatcher_resetStats(SundayMatcher *self);
+extern void SundayMatcher_memoryUsage(const SundayMatcher *self, MemoryUsage *usage);
+#ifdef __SSE2__
+extern const gchar *SundayMatcher_findWithSIMD(SundayMatcher *self, const gchar *text, gsize textlen);
+extern gboolean SundayMatcher_scanWithSIMD(SundayMatcher *self, const gchar *text, gsize textlen);
+#endif // __SSE2__
 
 #endif // __SUNDAY_H__
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+
+#include "twoway.h"
+#include "memoryusage.h"
+
+struct TwoWayMatcher {
+    gchar *pattern;
+    gsize patternlen;
+    gssize critical_pos; /* critical factorization の位置 (左側の部分文字列の末尾) */
+    gsize period;        /* 右側の部分文字列の周期、またはパターンが周期的でない場合のシフト量 */
+    gboolean periodic;   /* パターン全体が period を周期に持つか */
+};
+
+/**
+ * パターンの最大接尾辞の開始位置の手前を返し、その周期を period に代入する
+ * reversed が真のときは逆順のアルファベット順序で最大接尾辞を求める
+ */
+static gssize
+TwoWayMatcher_maximalSuffix(const guchar *pattern, gsize patternlen, gboolean reversed, gsize *period)
+{
+    gssize suffix_pos = -1;
+    gsize j = 0;
+    gsize k = 1;
+    gsize p = 1;
+    while (j + k < patternlen) {
+        guchar a = pattern[j + k];
+        guchar b = pattern[suffix_pos + k];
+        if (reversed ? (a > b) : (a < b)) {
+            j += k;
+            k = 1;
+            p = j - suffix_pos;
+        } else if (a == b) {
+            if (k != p) {
+                ++k;
+            } else {
+                j += p;
+                k = 1;
+            }
+        } else {
+            suffix_pos = j;
+            j = suffix_pos + 1;
+            k = p = 1;
+        }
+    }
+    *period = p;
+    return suffix_pos;
+}
+
+TwoWayMatcher *
+TwoWayMatcher_new(const gchar *pattern, glong patternlen)
+{
+    TwoWayMatcher *self = (TwoWayMatcher *) g_malloc0(sizeof(TwoWayMatcher));
+    TwoWayMatcher_reinit(self, pattern, patternlen);
+    return self;
+}
+
+void
+TwoWayMatcher_free(TwoWayMatcher *self)
+{
+    g_free(self->pattern);
+    g_free(self);
+}
+
+void
+TwoWayMatcher_reinit(TwoWayMatcher *self, const gchar *pattern, glong patternlen)
+{
+    if (0L <= patternlen) {
+        self->patternlen = patternlen;
+    } else {
+        self->patternlen = strlen(pattern);
+    }
+    g_free(self->pattern);
+    self->pattern = g_strndup(pattern, self->patternlen);
+
+    // 2種類の順序で求めた最大接尾辞のうち、後ろにある方を critical factorization とする
+    const guchar *p = (const guchar *) self->pattern;
+    gsize period = 0;
+    gsize period_reversed = 0;
+    gssize pos = TwoWayMatcher_maximalSuffix(p, self->patternlen, FALSE, &period);
+    gssize pos_reversed = TwoWayMatcher_maximalSuffix(p, self->patternlen, TRUE, &period_reversed);
+    if (pos < pos_reversed) {
+        pos = pos_reversed;
+        period = period_reversed;
+    }
+    self->critical_pos = pos;
+
+    // 左側の部分文字列が右側の周期で繰り返されていれば、パターン全体が周期的である
+    if (period + pos + 1 <= self->patternlen && 0 == memcmp(p, p + period, pos + 1)) {
+        self->periodic = TRUE;
+        self->period = period;
+    } else {
+        self->periodic = FALSE;
+        self->period = MAX((gsize) (pos + 1), self->patternlen - pos - 1) + 1;
+    }
+}
+
+gboolean
+TwoWayMatcher_scan(TwoWayMatcher *self, const gchar *text, gsize textlen)
+{
+    const guchar *p = (const guchar *) self->pattern;
+    const guchar *t = (const guchar *) text;
+    const gssize m = self->patternlen;
+    const gssize ell = self->critical_pos;
+    if (0 == m) {
+        return TRUE;
+    }
+    if (textlen < (gsize) m) {
+        return FALSE;
+    }
+    const gsize tlast = textlen - m;
+    gsize j = 0;
+    if (self->periodic) {
+        // 周期的なパターンでは、一致済みの接頭辞 (memory) を次の位置で再比較しない
+        gssize memory = -1;
+        while (j <= tlast) {
+            // 右側の部分文字列を左から比較する
+            gssize i = MAX(ell, memory) + 1;
+            while (i < m && p[i] == t[i + j]) {
+                ++i;
+            }
+            if (i < m) {
+                j += i - ell;
+                memory = -1;
+                continue;
+            }
+            // 左側の部分文字列を右から比較する
+            i = ell;
+            while (i > memory && p[i] == t[i + j]) {
+                --i;
+            }
+            if (i <= memory) {
+                return TRUE;
+            }
+            j += self->period;
+            memory = m - self->period - 1;
+        }
+    } else {
+        while (j <= tlast) {
+            gssize i = ell + 1;
+            while (i < m && p[i] == t[i + j]) {
+                ++i;
+            }
+            if (i < m) {
+                j += i - ell;
+                continue;
+            }
+            i = ell;
+            while (i >= 0 && p[i] == t[i + j]) {
+                --i;
+            }
+            if (i < 0) {
+                return TRUE;
+            }
+            j += self->period;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * 確保している領域のバイト数を用途ごとに usage に足し込む
+ * シフト表を持たず、パターンの複製のほかは定数個の値だけを持つ
+ */
+void
+TwoWayMatcher_memoryUsage(const TwoWayMatcher *self, MemoryUsage *usage)
+{
+    usage->patterns += sizeof(gchar) * (self->patternlen + 1);
+    usage->overhead += sizeof(TwoWayMatcher);
+}
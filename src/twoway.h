@@ -0,0 +1,19 @@
+// 最悪計算量が線形で、パターン文字列のコピー以外に追加のメモリを必要としない
+
+#ifndef __TWOWAY_H__
+#define __TWOWAY_H__
+
+#include <glib.h>
+
+#include "memoryusage.h"
+
+struct TwoWayMatcher;
+typedef struct TwoWayMatcher TwoWayMatcher;
+
+extern TwoWayMatcher * TwoWayMatcher_new(const gchar *pattern, glong patternlen);
+extern void TwoWayMatcher_free(TwoWayMatcher *self);
+extern void TwoWayMatcher_reinit(TwoWayMatcher *self, const gchar *pattern, glong patternlen);
+extern gboolean TwoWayMatcher_scan(TwoWayMatcher *self, const gchar *text, gsize textlen);
+extern void TwoWayMatcher_memoryUsage(const TwoWayMatcher *self, MemoryUsage *usage);
+
+#endif // __TWOWAY_H__
@@ -0,0 +1,19 @@
+// TwoWayMatcher の UTF-16 版で、サロゲートペアもそのまま2つのコード単位として照合する
+
+#ifndef __TWOWAYUNICODE_H__
+#define __TWOWAYUNICODE_H__
+
+#include <glib.h>
+
+#include "memoryusage.h"
+
+struct UnicodeTwoWayMatcher;
+typedef struct UnicodeTwoWayMatcher UnicodeTwoWayMatcher;
+
+extern UnicodeTwoWayMatcher * UnicodeTwoWayMatcher_new(const gunichar2 *pattern, gsize patternlen);
+extern void UnicodeTwoWayMatcher_free(UnicodeTwoWayMatcher *self);
+extern void UnicodeTwoWayMatcher_reinit(UnicodeTwoWayMatcher *self, const gunichar2 *pattern, gsize patternlen);
+extern gboolean UnicodeTwoWayMatcher_scan(UnicodeTwoWayMatcher *self, const gunichar2 *text, gsize textlen);
+extern void UnicodeTwoWayMatcher_memoryUsage(const UnicodeTwoWayMatcher *self, MemoryUsage *usage);
+
+#endif // __TWOWAYUNICODE_H__
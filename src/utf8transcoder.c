@@ -0,0 +1,330 @@
+#include <string.h>
+#include <glib.h>
+
+#include "simddispatch.h"
+#include "utf8transcoder.h"
+
+/**
+ * 各カーネルは text から end までを検証しながら変換し、書き込んだコード単位数を返す
+ * 不正なバイト列か途中で途切れた文字に出会ったらそこで止まり、その位置を stop に代入する
+ * out が NULL の場合は検証だけを行う
+ * 埋め込まれた NUL は U+0000 として扱う
+ */
+typedef gsize (*UTF8Transcoder_kernel)(const guchar *text, const guchar *end, gunichar2 *out, const guchar **stop);
+
+/* UTF8Transcoder_decodeChar の返値で、途中で途切れた文字を表す */
+#define DECODE_PARTIAL (-1)
+/* UTF8Transcoder_decodeChar の返値で、不正なバイト列を表す */
+#define DECODE_INVALID (0)
+
+void
+UTF16Buffer_reserve(UTF16Buffer *self, gsize capacity)
+{
+    if (self->capacity < capacity) {
+        g_free(self->data);
+        self->data = (gunichar2 *) g_malloc_n(capacity, sizeof(gunichar2));
+        self->capacity = capacity;
+    }
+}
+
+void
+UTF16Buffer_clear(UTF16Buffer *self)
+{
+    g_free(self->data);
+    self->data = NULL;
+    self->capacity = 0;
+}
+
+/**
+ * p から1文字を復号して ch に代入し、消費したバイト数を返す
+ * 冗長な表現、サロゲート、U+10FFFF を超える値は不正とみなす
+ */
+static inline gint
+UTF8Transcoder_decodeChar(const guchar *p, const guchar *end, gunichar *ch)
+{
+    guchar lead = p[0];
+    if (lead < 0x80) {
+        *ch = lead;
+        return 1;
+    }
+    gint n;
+    gunichar value;
+    if (lead < 0xC2) {
+        return DECODE_INVALID;
+    } else if (lead < 0xE0) {
+        n = 2;
+        value = lead & 0x1F;
+    } else if (lead < 0xF0) {
+        n = 3;
+        value = lead & 0x0F;
+    } else if (lead < 0xF5) {
+        n = 4;
+        value = lead & 0x07;
+    } else {
+        return DECODE_INVALID;
+    }
+    for (gint i = 1; i < n; ++i) {
+        if (p + i >= end) {
+            return DECODE_PARTIAL;
+        }
+        if (0x80 != (p[i] & 0xC0)) {
+            return DECODE_INVALID;
+        }
+        value = (value << 6) | (p[i] & 0x3F);
+    }
+    if ((3 == n && value < 0x800) || (0xD800 <= value && value <= 0xDFFF) ||
+        (4 == n && (value < 0x10000 || 0x10FFFF < value))) {
+        return DECODE_INVALID;
+    }
+    *ch = value;
+    return n;
+}
+
+/**
+ * 1文字を復号して out に書き込み、書き込んだコード単位数を返す
+ * 復号できなかった場合は 0 を返して p を進めない
+ */
+static inline gsize
+UTF8Transcoder_transcodeChar(const guchar **p, const guchar *end, gunichar2 *out)
+{
+    gunichar ch = 0;
+    gint n = UTF8Transcoder_decodeChar(*p, end, &ch);
+    if (n <= 0) {
+        return 0;
+    }
+    *p += n;
+    if (ch < 0x10000) {
+        if (NULL != out) {
+            out[0] = ch;
+        }
+        return 1;
+    }
+    if (NULL != out) {
+        ch -= 0x10000;
+        out[0] = 0xD800 | (ch >> 10);
+        out[1] = 0xDC00 | (ch & 0x3FF);
+    }
+    return 2;
+}
+
+static gsize
+UTF8Transcoder_kernelScalar(const guchar *text, const guchar *end, gunichar2 *out, const guchar **stop)
+{
+    const guchar *p = text;
+    gsize n_units = 0;
+    while (p < end) {
+        gsize n = UTF8Transcoder_transcodeChar(&p, end, (NULL != out) ? out + n_units : NULL);
+        if (0 == n) {
+            break;
+        }
+        n_units += n;
+    }
+    *stop = p;
+    return n_units;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+__attribute__((target("sse2")))
+static gsize
+UTF8Transcoder_kernelSSE2(const guchar *text, const guchar *end, gunichar2 *out, const guchar **stop)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const guchar *p = text;
+    gsize n_units = 0;
+    while (p < end) {
+        /* 16バイトがすべて ASCII ならまとめて 16 ビットに拡張する */
+        gsize n_ascii = 0;
+        if (16 <= end - p) {
+            __m128i block = _mm_loadu_si128((const __m128i *) p);
+            guint32 mask = (guint32) _mm_movemask_epi8(block);
+            if (0 == mask) {
+                if (NULL != out) {
+                    _mm_storeu_si128((__m128i *) (out + n_units), _mm_unpacklo_epi8(block, zero));
+                    _mm_storeu_si128((__m128i *) (out + n_units + 8), _mm_unpackhi_epi8(block, zero));
+                }
+                p += 16;
+                n_units += 16;
+                continue;
+            }
+            n_ascii = __builtin_ctz(mask);
+        }
+        /* 最初の非 ASCII バイトまでは1バイトずつ拡張する */
+        for (gsize i = 0; i < n_ascii; ++i) {
+            if (NULL != out) {
+                out[n_units + i] = p[i];
+            }
+        }
+        p += n_ascii;
+        n_units += n_ascii;
+        gsize n = UTF8Transcoder_transcodeChar(&p, end, (NULL != out) ? out + n_units : NULL);
+        if (0 == n) {
+            break;
+        }
+        n_units += n;
+    }
+    *stop = p;
+    return n_units;
+}
+
+/**
+ * p からの12バイトが E1-EC, EE-EF で始まる3バイト文字4つであれば、復号して out に書き込む
+ * これらの先頭バイトでは冗長な表現やサロゲートが生じないので、継続バイトの形だけを確かめればよい
+ * E0, ED で始まる文字はスカラ版に任せる
+ */
+__attribute__((target("avx2")))
+static inline gboolean
+UTF8Transcoder_transcode3ByteBlock(const guchar *p, gunichar2 *out)
+{
+    const __m128i block = _mm_loadu_si128((const __m128i *) p);
+    const __m128i lead = _mm_shuffle_epi8(block, _mm_setr_epi8(0, -1, 3, -1, 6, -1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    const __m128i cont1 = _mm_shuffle_epi8(block, _mm_setr_epi8(1, -1, 4, -1, 7, -1, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    const __m128i cont2 = _mm_shuffle_epi8(block, _mm_setr_epi8(2, -1, 5, -1, 8, -1, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    const __m128i lead_low = _mm_and_si128(_mm_cmpgt_epi16(lead, _mm_set1_epi16(0xE0)), _mm_cmplt_epi16(lead, _mm_set1_epi16(0xED)));
+    const __m128i lead_high = _mm_and_si128(_mm_cmpgt_epi16(lead, _mm_set1_epi16(0xED)), _mm_cmplt_epi16(lead, _mm_set1_epi16(0xF0)));
+    const __m128i cont_mask = _mm_set1_epi16(0xC0);
+    const __m128i cont_bits = _mm_set1_epi16(0x80);
+    const __m128i valid = _mm_and_si128(_mm_or_si128(lead_low, lead_high),
+                                        _mm_and_si128(_mm_cmpeq_epi16(_mm_and_si128(cont1, cont_mask), cont_bits),
+                                                      _mm_cmpeq_epi16(_mm_and_si128(cont2, cont_mask), cont_bits)));
+    if (0xFF != (_mm_movemask_epi8(valid) & 0xFF)) {
+        return FALSE;
+    }
+    if (NULL != out) {
+        const __m128i payload = _mm_set1_epi16(0x3F);
+        __m128i units = _mm_slli_epi16(_mm_and_si128(lead, _mm_set1_epi16(0x0F)), 12);
+        units = _mm_or_si128(units, _mm_slli_epi16(_mm_and_si128(cont1, payload), 6));
+        units = _mm_or_si128(units, _mm_and_si128(cont2, payload));
+        _mm_storel_epi64((__m128i *) out, units);
+    }
+    return TRUE;
+}
+
+__attribute__((target("avx2")))
+static gsize
+UTF8Transcoder_kernelAVX2(const guchar *text, const guchar *end, gunichar2 *out, const guchar **stop)
+{
+    const guchar *p = text;
+    gsize n_units = 0;
+    while (p < end) {
+        /* 32バイトがすべて ASCII ならまとめて 16 ビットに拡張する */
+        gsize n_ascii = 0;
+        if (32 <= end - p) {
+            __m256i block = _mm256_loadu_si256((const __m256i *) p);
+            guint32 mask = (guint32) _mm256_movemask_epi8(block);
+            if (0 == mask) {
+                if (NULL != out) {
+                    _mm256_storeu_si256((__m256i *) (out + n_units), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(block)));
+                    _mm256_storeu_si256((__m256i *) (out + n_units + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(block, 1)));
+                }
+                p += 32;
+                n_units += 32;
+                continue;
+            }
+            n_ascii = __builtin_ctz(mask);
+        }
+        for (gsize i = 0; i < n_ascii; ++i) {
+            if (NULL != out) {
+                out[n_units + i] = p[i];
+            }
+        }
+        p += n_ascii;
+        n_units += n_ascii;
+        /* 3バイト文字が続く間は4文字ずつまとめて復号する */
+        while (16 <= end - p && UTF8Transcoder_transcode3ByteBlock(p, (NULL != out) ? out + n_units : NULL)) {
+            p += 12;
+            n_units += 4;
+        }
+        if (p == end) {
+            break;
+        }
+        gsize n = UTF8Transcoder_transcodeChar(&p, end, (NULL != out) ? out + n_units : NULL);
+        if (0 == n) {
+            break;
+        }
+        n_units += n;
+    }
+    *stop = p;
+    return n_units;
+}
+
+#endif // defined(__x86_64__) || defined(__i386__)
+
+/**
+ * 実行時の CPU で使える最も広いカーネルを返す
+ */
+static UTF8Transcoder_kernel
+UTF8Transcoder_getKernel(void)
+{
+    static gsize kernel_once = 0;
+    static UTF8Transcoder_kernel kernel = NULL;
+    if (g_once_init_enter(&kernel_once)) {
+        switch (SIMDDispatch_getLevel()) {
+#if defined(__x86_64__) || defined(__i386__)
+        case SIMD_LEVEL_AVX512:
+        case SIMD_LEVEL_AVX2:
+            kernel = UTF8Transcoder_kernelAVX2;
+            break;
+        case SIMD_LEVEL_SSE2:
+            kernel = UTF8Transcoder_kernelSSE2;
+            break;
+#endif
+        default:
+            kernel = UTF8Transcoder_kernelScalar;
+            break;
+        }
+        g_once_init_leave(&kernel_once, 1);
+    }
+    return kernel;
+}
+
+/**
+ * text が UTF-8 として正しいかを検査する
+ * end には、最初の不正なバイトか途中で途切れた文字の位置、すべて正しければ末尾を代入する
+ */
+gboolean
+UTF8Transcoder_validate(const gchar *text, gsize textlen, const gchar **end)
+{
+    const guchar *text_end = (const guchar *) text + textlen;
+    const guchar *stop = NULL;
+    (void) UTF8Transcoder_getKernel()((const guchar *) text, text_end, NULL, &stop);
+    if (NULL != end) {
+        *end = (const gchar *) stop;
+    }
+    return text_end == stop;
+}
+
+/**
+ * UTF-8 テキストを UTF-16 に変換して buffer に書き込み、コード単位数を u16len に代入する
+ * textlen が負の場合は NUL 終端とみなす
+ * buffer は必要に応じて拡張されるので、同じバッファを使い回せば変換のたびに確保しなくて済む
+ */
+gboolean
+UTF8Transcoder_toUTF16(const gchar *text, glong textlen, UTF16Buffer *buffer, glong *u16len, GError **error)
+{
+    if (0L > textlen) {
+        textlen = strlen(text);
+    }
+    /* UTF-16 のコード単位数は UTF-8 のバイト数を超えない */
+    UTF16Buffer_reserve(buffer, MAX(textlen, 1));
+    const guchar *text_end = (const guchar *) text + textlen;
+    const guchar *stop = NULL;
+    gsize n_units = UTF8Transcoder_getKernel()((const guchar *) text, text_end, buffer->data, &stop);
+    if (text_end != stop) {
+        gunichar ch = 0;
+        if (DECODE_PARTIAL == UTF8Transcoder_decodeChar(stop, text_end, &ch)) {
+            g_set_error_literal(error, G_CONVERT_ERROR, G_CONVERT_ERROR_PARTIAL_INPUT,
+                                "Partial character sequence at end of input");
+        } else {
+            g_set_error_literal(error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE,
+                                "Invalid byte sequence in conversion input");
+        }
+        return FALSE;
+    }
+    if (NULL != u16len) {
+        *u16len = n_units;
+    }
+    return TRUE;
+}
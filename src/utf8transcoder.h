@@ -0,0 +1,34 @@
+// Unicode 版の各エンジンが共通で使う UTF-8 の検証と UTF-16 への変換
+// ASCII の連続や3バイト文字 (CJK) の連続は SIMD でまとめて処理する
+
+#ifndef __UTF8TRANSCODER_H__
+#define __UTF8TRANSCODER_H__
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 変換結果を書き込むための再利用可能なバッファ
+ * UTF16BUFFER_INIT で初期化し、不要になったら UTF16Buffer_clear で解放する
+ */
+typedef struct UTF16Buffer {
+    gunichar2 *data;
+    gsize capacity; /* data に格納できるコード単位数 */
+} UTF16Buffer;
+
+#define UTF16BUFFER_INIT {NULL, 0}
+
+extern void UTF16Buffer_reserve(UTF16Buffer *self, gsize capacity);
+extern void UTF16Buffer_clear(UTF16Buffer *self);
+
+extern gboolean UTF8Transcoder_validate(const gchar *text, gsize textlen, const gchar **end);
+extern gboolean UTF8Transcoder_toUTF16(const gchar *text, glong textlen, UTF16Buffer *buffer, glong *u16len, GError **error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __UTF8TRANSCODER_H__
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../src/ahocorasickunicode.h"
@@ -58,9 +59,180 @@ void test1() {
   UnicodeAhoCorasickMatcher_free(matcher);
 }
 
+typedef struct Report {
+  guint stream;
+  gconstpointer output;
+  gsize end_offset;
+} Report;
+
+static gboolean collectReport(guint stream, gconstpointer output, gsize end_offset, gpointer user_data) {
+  Report report = {stream, output, end_offset};
+  g_array_append_val((GArray *) user_data, report);
+  return TRUE;
+}
+
+static gboolean stopAtFirstReport(guint stream, gconstpointer output, gsize end_offset, gpointer user_data) {
+  ++(*(int *) user_data);
+  return FALSE;
+}
+
+static int compareReports(gconstpointer a, gconstpointer b) {
+  const Report *lhs = (const Report *) a;
+  const Report *rhs = (const Report *) b;
+  if (lhs->end_offset != rhs->end_offset) {
+    return (lhs->end_offset < rhs->end_offset) ? -1 : 1;
+  }
+  return strcmp((const char *) lhs->output, (const char *) rhs->output);
+}
+
+static UnicodeAhoCorasickMatcher *newRandomMatcher(void) {
+  static const char *patterns[] = {"abcd", "abc", "bcd", "ab", "bc", "a", "cab", "dddd", "あい", "いあい", "𠮷あ", NULL};
+  UnicodeAhoCorasickMatcher *matcher = UnicodeAhoCorasickMatcher_new(16);
+  for (const char **patterns_iter = patterns; NULL != *patterns_iter; ++patterns_iter) {
+    assert(UnicodeAhoCorasickMatcher_addKeywordAsUTF8(matcher, *patterns_iter, -1L, NULL));
+  }
+  return matcher;
+}
+
+static gunichar2 *newRandomText(gsize n_pieces, glong *textlen) {
+  static const char *pieces[] = {"a", "b", "c", "d", "あ", "い", "𠮷"};
+  GString *text = g_string_new(NULL);
+  for (gsize i = 0; i < n_pieces; ++i) {
+    g_string_append(text, pieces[rand() % G_N_ELEMENTS(pieces)]);
+  }
+  gunichar2 *u16text = g_utf8_to_utf16(text->str, text->len, NULL, textlen, NULL);
+  g_string_free(text, TRUE);
+  return u16text;
+}
+
+/* 逐次のイテレータで見つけたキーワードを stream の報告として reports に追加する */
+static void scanSequentially(UnicodeAhoCorasickMatcher *matcher, const gunichar2 *text, gsize textlen, guint stream, GArray *reports) {
+  UnicodeAhoCorasickPatternsIter *iter = NULL;
+  UnicodeAhoCorasickMatcher_scanUTF16String(matcher, text, textlen, &iter);
+  gconstpointer output = NULL;
+  while (NULL != (output = UnicodeAhoCorasickPatternsIter_next(iter))) {
+    Report report = {stream, output, UnicodeAhoCorasickPatternsIter_getOffset(iter)};
+    g_array_append_val(reports, report);
+  }
+  UnicodeAhoCorasickPatternsIter_free(iter);
+}
+
+/* 交互に走査しても、各テキストの報告は逐次のイテレータと同じ順序で同じものになる */
+void test2() {
+  UnicodeAhoCorasickMatcher *matcher = newRandomMatcher();
+  enum { N_TEXTS = AHOCORASICKUNICODE_MAX_STREAMS * 2 + 3 };
+  gunichar2 *texts[N_TEXTS];
+  gsize textlens[N_TEXTS];
+  GArray *expected[N_TEXTS];
+  for (guint i = 0; i < N_TEXTS; ++i) {
+    glong textlen = 0;
+    texts[i] = newRandomText((0 == i % 7) ? 0 : (gsize) (rand() % 300), &textlen);
+    textlens[i] = textlen;
+    expected[i] = g_array_new(FALSE, FALSE, sizeof(Report));
+    scanSequentially(matcher, texts[i], textlens[i], i, expected[i]);
+  }
+  GArray *reports = g_array_new(FALSE, FALSE, sizeof(Report));
+  assert(UnicodeAhoCorasickMatcher_scanUTF16Interleaved(matcher, (const gunichar2 *const *) texts, textlens, N_TEXTS, collectReport, reports));
+  gsize n_reports = 0;
+  for (guint i = 0; i < N_TEXTS; ++i) {
+    guint k = 0;
+    for (guint j = 0; j < reports->len; ++j) {
+      const Report *report = &g_array_index(reports, Report, j);
+      if (i != report->stream) {
+        continue;
+      }
+      assert(k < expected[i]->len);
+      const Report *expected_report = &g_array_index(expected[i], Report, k++);
+      assert(expected_report->output == report->output);
+      assert(expected_report->end_offset == report->end_offset);
+    }
+    assert(k == expected[i]->len);
+    n_reports += k;
+  }
+  assert(n_reports == reports->len);
+  int n_calls = 0;
+  assert(!UnicodeAhoCorasickMatcher_scanUTF16Interleaved(matcher, (const gunichar2 *const *) texts, textlens, N_TEXTS, stopAtFirstReport, &n_calls));
+  assert(1 == n_calls);
+  g_array_free(reports, TRUE);
+  for (guint i = 0; i < N_TEXTS; ++i) {
+    g_array_free(expected[i], TRUE);
+    g_free(texts[i]);
+  }
+  UnicodeAhoCorasickMatcher_free(matcher);
+}
+
+/* テキストを分割して走査しても、境界をまたぐものを含めてすべての出現をちょうど1回ずつ報告する */
+void test3() {
+  UnicodeAhoCorasickMatcher *matcher = newRandomMatcher();
+  static const gsize n_pieces[] = {0, 1, 5, 40, 1000};
+  for (gsize t = 0; t < G_N_ELEMENTS(n_pieces); ++t) {
+    glong textlen = 0;
+    gunichar2 *text = newRandomText(n_pieces[t], &textlen);
+    GArray *expected = g_array_new(FALSE, FALSE, sizeof(Report));
+    scanSequentially(matcher, text, textlen, 0, expected);
+    g_array_sort(expected, compareReports);
+    for (guint n_slices = 0; n_slices <= AHOCORASICKUNICODE_MAX_STREAMS + 1; ++n_slices) {
+      GArray *reports = g_array_new(FALSE, FALSE, sizeof(Report));
+      assert(UnicodeAhoCorasickMatcher_scanUTF16Sliced(matcher, text, textlen, n_slices, collectReport, reports));
+      g_array_sort(reports, compareReports);
+      assert(expected->len == reports->len);
+      for (guint i = 0; i < reports->len; ++i) {
+        const Report *report = &g_array_index(reports, Report, i);
+        const Report *expected_report = &g_array_index(expected, Report, i);
+        assert(expected_report->output == report->output);
+        assert(expected_report->end_offset == report->end_offset);
+        assert(report->stream < MAX(n_slices, 1));
+      }
+      g_array_free(reports, TRUE);
+    }
+    g_array_free(expected, TRUE);
+    g_free(text);
+  }
+  UnicodeAhoCorasickMatcher_free(matcher);
+}
+
+static gboolean collectMatch(gconstpointer output, gsize end_offset, gpointer user_data) {
+  return collectReport(0, output, end_offset, user_data);
+}
+
+static gboolean stopAtFirstMatch(gconstpointer output, gsize end_offset, gpointer user_data) {
+  return stopAtFirstReport(0, output, end_offset, user_data);
+}
+
+/* コールバックで走査しても、逐次のイテレータと同じ順序で同じものを報告する */
+void test4() {
+  UnicodeAhoCorasickMatcher *matcher = newRandomMatcher();
+  UnicodeAhoCorasickMatcher_compile(matcher);
+  static const gsize n_pieces[] = {0, 1, 5, 40, 1000};
+  for (gsize t = 0; t < G_N_ELEMENTS(n_pieces); ++t) {
+    glong textlen = 0;
+    gunichar2 *text = newRandomText(n_pieces[t], &textlen);
+    GArray *expected = g_array_new(FALSE, FALSE, sizeof(Report));
+    scanSequentially(matcher, text, textlen, 0, expected);
+    GArray *reports = g_array_new(FALSE, FALSE, sizeof(Report));
+    UnicodeAhoCorasickMatcher_scanAllUTF16String(matcher, text, textlen, collectMatch, reports);
+    assert(expected->len == reports->len);
+    for (guint i = 0; i < reports->len; ++i) {
+      assert(g_array_index(expected, Report, i).output == g_array_index(reports, Report, i).output);
+      assert(g_array_index(expected, Report, i).end_offset == g_array_index(reports, Report, i).end_offset);
+    }
+    int n_calls = 0;
+    UnicodeAhoCorasickMatcher_scanAllUTF16String(matcher, text, textlen, stopAtFirstMatch, &n_calls);
+    assert(MIN(expected->len, 1) == (guint) n_calls);
+    g_array_free(reports, TRUE);
+    g_array_free(expected, TRUE);
+    g_free(text);
+  }
+  UnicodeAhoCorasickMatcher_free(matcher);
+}
+
 int main(int argc, char *argv[]) {
+  srand(0);
   test0();
   test1();
+  test2();
+  test3();
+  test4();
   return 0;
 }
 
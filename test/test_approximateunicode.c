@@ -0,0 +1,250 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "approximateunicode.h"
+
+typedef struct Match {
+    gsize end_offset;
+    guint distance;
+} Match;
+
+static gboolean
+collectMatch(gsize end_offset, guint distance, gpointer user_data)
+{
+    Match match = {end_offset, distance};
+    g_array_append_val((GArray *) user_data, match);
+    return TRUE;
+}
+
+static gboolean
+stopAtFirstMatch(gsize end_offset, guint distance, gpointer user_data)
+{
+    collectMatch(end_offset, distance, user_data);
+    return FALSE;
+}
+
+/**
+ * 末尾の位置ごとの誤りの数の最小値を動的計画法で求め、max_distance 以下のものを集める
+ */
+static GArray *
+scanNaively(const gunichar2 *pattern, gsize patternlen, const gunichar2 *text, gsize textlen,
+            UnicodeApproximateMode mode, guint max_distance)
+{
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(Match));
+    if (UNICODE_APPROXIMATE_MISMATCHES == mode) {
+        for (gsize end = patternlen; end <= textlen; ++end) {
+            guint distance = 0;
+            for (gsize i = 0; i < patternlen; ++i) {
+                distance += (pattern[i] != text[end - patternlen + i]);
+            }
+            if (distance <= max_distance) {
+                Match match = {end, distance};
+                g_array_append_val(matches, match);
+            }
+        }
+        return matches;
+    }
+    /* column[i] はパターンの先頭 i コード単位と、現在の位置で終わるテキストの部分文字列との編集距離の最小値 */
+    guint *column = g_new(guint, patternlen + 1);
+    for (gsize i = 0; i <= patternlen; ++i) {
+        column[i] = i;
+    }
+    for (gsize end = 1; end <= textlen; ++end) {
+        guint diagonal = column[0];
+        column[0] = 0;
+        for (gsize i = 1; i <= patternlen; ++i) {
+            guint above = column[i];
+            guint best = diagonal + (pattern[i - 1] != text[end - 1]);
+            best = MIN(best, above + 1);
+            best = MIN(best, column[i - 1] + 1);
+            column[i] = best;
+            diagonal = above;
+        }
+        if (column[patternlen] <= max_distance) {
+            Match match = {end, column[patternlen]};
+            g_array_append_val(matches, match);
+        }
+    }
+    g_free(column);
+    return matches;
+}
+
+static void
+assertSameMatches(const GArray *expected, const GArray *actual)
+{
+    assert(expected->len == actual->len);
+    for (guint i = 0; i < expected->len; ++i) {
+        assert(g_array_index(expected, Match, i).end_offset == g_array_index(actual, Match, i).end_offset);
+        assert(g_array_index(expected, Match, i).distance == g_array_index(actual, Match, i).distance);
+    }
+}
+
+static GArray *
+scanUTF16(const UnicodeApproximateMatcher *matcher, const gunichar2 *text, gsize textlen)
+{
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(Match));
+    UnicodeApproximateMatcher_scanUTF16String(matcher, text, textlen, collectMatch, matches);
+    return matches;
+}
+
+/**
+ * 表記の揺れた製品名を、誤りの数え方ごとに決まった位置と距離で見つける
+ */
+static void
+testFixedCases()
+{
+    static const struct {
+        const gchar *pattern;
+        const gchar *text;
+        UnicodeApproximateMode mode;
+        guint max_distance;
+        gsize expected_end;      /* 最初に報告されるバイトオフセット */
+        guint expected_distance; /* 最初に報告される距離 */
+    } cases[] = {
+        {"スマートフォン", "新しいスマートフオンを買った", UNICODE_APPROXIMATE_MISMATCHES, 1, 30, 1},
+        {"スマートフォン", "新しいスマホンを買った", UNICODE_APPROXIMATE_MISMATCHES, 2, 0, 0},
+        {"スマートフォン", "新しいスマトフォンを買った", UNICODE_APPROXIMATE_EDIT_DISTANCE, 1, 27, 1},
+        {"スマートフォン", "新しいスマーートフォンを買った", UNICODE_APPROXIMATE_EDIT_DISTANCE, 1, 33, 1},
+        {"Wi-Fi", "wifi と Wi-Fi", UNICODE_APPROXIMATE_EDIT_DISTANCE, 0, 14, 0},
+        {"Wi-Fi", "wifi と WiFi", UNICODE_APPROXIMATE_EDIT_DISTANCE, 1, 13, 1},
+        {"𠮟る", "𠮟る", UNICODE_APPROXIMATE_MISMATCHES, 0, 7, 0},
+        {"𠮟る", "𠂉る", UNICODE_APPROXIMATE_MISMATCHES, 1, 0, 0},
+        {"𠮟る", "𠂉る", UNICODE_APPROXIMATE_MISMATCHES, 2, 7, 2},
+    };
+    for (gsize i = 0; i < G_N_ELEMENTS(cases); ++i) {
+        UnicodeApproximateMatcher *matcher = UnicodeApproximateMatcher_newFromUTF8(
+            cases[i].pattern, -1L, cases[i].mode, cases[i].max_distance, NULL);
+        assert(NULL != matcher);
+        GArray *matches = g_array_new(FALSE, FALSE, sizeof(Match));
+        assert(UnicodeApproximateMatcher_scanUTF8String(matcher, cases[i].text, -1L, stopAtFirstMatch, matches, NULL));
+        if (0 == cases[i].expected_end) {
+            assert(0 == matches->len);
+        } else {
+            assert(1 == matches->len);
+            assert(cases[i].expected_end == g_array_index(matches, Match, 0).end_offset);
+            assert(cases[i].expected_distance == g_array_index(matches, Match, 0).distance);
+        }
+        g_array_free(matches, TRUE);
+        UnicodeApproximateMatcher_free(matcher);
+    }
+}
+
+/**
+ * 1ワードに収まる長さと複数のワードにまたがる長さのパターンで、動的計画法の結果と一致する
+ */
+static void
+testRandomCases()
+{
+    static const gunichar2 alphabet[] = {'a', 'b', 'c', 0x30A2, 0x30A4, 0xD842, 0xDFB7};
+    static const gsize patternlens[] = {1, 2, 5, 31, 63, 64, 65, 100, 128, 129, 200};
+    for (gsize n = 0; n < G_N_ELEMENTS(patternlens) * 20; ++n) {
+        gsize patternlen = patternlens[n % G_N_ELEMENTS(patternlens)];
+        /* 文字の種類を減らして、誤りの少ない一致が起こりやすくする */
+        gsize n_letters = 2 + rand() % (G_N_ELEMENTS(alphabet) - 1);
+        gunichar2 *pattern = g_new(gunichar2, patternlen);
+        for (gsize i = 0; i < patternlen; ++i) {
+            pattern[i] = alphabet[rand() % n_letters];
+        }
+        gsize textlen = rand() % 600;
+        gunichar2 *text = g_new(gunichar2, textlen + 1);
+        for (gsize i = 0; i < textlen; ++i) {
+            /* パターンの一部を写して、ところどころ書き換える */
+            text[i] = (0 == rand() % 8) ? alphabet[rand() % n_letters] : pattern[i % patternlen];
+        }
+        guint max_distance = rand() % MIN(patternlen, 4 + patternlen / 4);
+        for (int mode = UNICODE_APPROXIMATE_MISMATCHES; mode <= UNICODE_APPROXIMATE_EDIT_DISTANCE; ++mode) {
+            UnicodeApproximateMatcher *matcher = UnicodeApproximateMatcher_new(pattern, patternlen,
+                                                                               (UnicodeApproximateMode) mode, max_distance);
+            assert(patternlen == UnicodeApproximateMatcher_getPatternLength(matcher));
+            GArray *expected = scanNaively(pattern, patternlen, text, textlen, (UnicodeApproximateMode) mode, max_distance);
+            GArray *actual = scanUTF16(matcher, text, textlen);
+            assertSameMatches(expected, actual);
+            g_array_free(actual, TRUE);
+            g_array_free(expected, TRUE);
+            UnicodeApproximateMatcher_free(matcher);
+        }
+        g_free(text);
+        g_free(pattern);
+    }
+}
+
+/**
+ * UTF-8 の走査はバイトオフセットで報告し、サロゲートペアの間で終わる範囲は報告しない
+ */
+static void
+testUTF8Offsets()
+{
+    static const gchar *texts[] = {"aあ𠮟b", "𠮟𠮟あa", "abc"};
+    static const gchar *patterns[] = {"あ𠮟", "a𠮟", "𠮟b"};
+    for (gsize i = 0; i < G_N_ELEMENTS(patterns); ++i) {
+        glong patternlen = 0L;
+        gunichar2 *pattern = g_utf8_to_utf16(patterns[i], -1L, NULL, &patternlen, NULL);
+        for (guint max_distance = 0; max_distance < (guint) patternlen; ++max_distance) {
+            UnicodeApproximateMatcher *matcher = UnicodeApproximateMatcher_new(pattern, patternlen,
+                                                                               UNICODE_APPROXIMATE_EDIT_DISTANCE, max_distance);
+            for (gsize j = 0; j < G_N_ELEMENTS(texts); ++j) {
+                glong textlen = 0L;
+                gunichar2 *text = g_utf8_to_utf16(texts[j], -1L, NULL, &textlen, NULL);
+                GArray *expected = g_array_new(FALSE, FALSE, sizeof(Match));
+                GArray *u16matches = scanUTF16(matcher, text, textlen);
+                for (guint k = 0; k < u16matches->len; ++k) {
+                    Match match = g_array_index(u16matches, Match, k);
+                    if (0xD800 <= text[match.end_offset - 1] && 0xDBFF >= text[match.end_offset - 1]) {
+                        continue;
+                    }
+                    glong n_bytes = 0L;
+                    g_free(g_utf16_to_utf8(text, match.end_offset, NULL, &n_bytes, NULL));
+                    match.end_offset = n_bytes;
+                    g_array_append_val(expected, match);
+                }
+                GArray *actual = g_array_new(FALSE, FALSE, sizeof(Match));
+                assert(UnicodeApproximateMatcher_scanUTF8String(matcher, texts[j], -1L, collectMatch, actual, NULL));
+                assertSameMatches(expected, actual);
+                g_array_free(actual, TRUE);
+                g_array_free(u16matches, TRUE);
+                g_array_free(expected, TRUE);
+                g_free(text);
+            }
+            UnicodeApproximateMatcher_free(matcher);
+        }
+        g_free(pattern);
+    }
+}
+
+/**
+ * 空のパターン、パターンより長い距離、不正な UTF-8 をエラーにする
+ */
+static void
+testErrors()
+{
+    GError *error = NULL;
+    assert(NULL == UnicodeApproximateMatcher_newFromUTF8("", -1L, UNICODE_APPROXIMATE_MISMATCHES, 0, &error));
+    assert(g_error_matches(error, UNICODE_APPROXIMATE_ERROR, UNICODE_APPROXIMATE_ERROR_EMPTY_PATTERN));
+    g_clear_error(&error);
+    assert(NULL == UnicodeApproximateMatcher_newFromUTF8("あい", -1L, UNICODE_APPROXIMATE_EDIT_DISTANCE, 2, &error));
+    assert(g_error_matches(error, UNICODE_APPROXIMATE_ERROR, UNICODE_APPROXIMATE_ERROR_INVALID_DISTANCE));
+    g_clear_error(&error);
+    assert(NULL == UnicodeApproximateMatcher_newFromUTF8("\xE3\x81", -1L, UNICODE_APPROXIMATE_EDIT_DISTANCE, 0, &error));
+    assert(NULL != error);
+    g_clear_error(&error);
+
+    UnicodeApproximateMatcher *matcher = UnicodeApproximateMatcher_newFromUTF8("あい", -1L, UNICODE_APPROXIMATE_EDIT_DISTANCE, 1, NULL);
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(Match));
+    assert(!UnicodeApproximateMatcher_scanUTF8String(matcher, "あい\xFF", -1L, collectMatch, matches, &error));
+    assert(g_error_matches(error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE));
+    g_clear_error(&error);
+    g_array_free(matches, TRUE);
+    UnicodeApproximateMatcher_free(matcher);
+}
+
+int
+main(int argc, char **argv)
+{
+    srand(0);
+    testFixedCases();
+    testRandomCases();
+    testUTF8Offsets();
+    testErrors();
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "boyermooreunicode.h"
+
+static UnicodeBoyerMooreMatcher *
+newMatcherFromUTF8(const gchar *pattern)
+{
+    glong patternlen = 0L;
+    gunichar2 *pattern_as_u16 = g_utf8_to_utf16(pattern, -1L, NULL, &patternlen, NULL);
+    assert(NULL != pattern_as_u16);
+    UnicodeBoyerMooreMatcher *matcher = UnicodeBoyerMooreMatcher_new(pattern_as_u16, patternlen);
+    g_free(pattern_as_u16);
+    return matcher;
+}
+
+static void
+assertScanResults(UnicodeBoyerMooreMatcher *matcher, const gchar **text_tbl, const gboolean *expected_tbl)
+{
+    const gchar **texts_iter = text_tbl;
+    const gboolean *expecteds_iter = expected_tbl;
+    for (; NULL != *texts_iter; ++texts_iter, ++expecteds_iter) {
+        gboolean match = !*expecteds_iter;
+        assert(UnicodeBoyerMooreMatcher_scanUTF8String(matcher, *texts_iter, -1L, &match, NULL));
+        assert(*expecteds_iter == match);
+
+        glong textlen = 0L;
+        gunichar2 *text_as_u16 = g_utf8_to_utf16(*texts_iter, -1L, NULL, &textlen, NULL);
+        assert(NULL != text_as_u16);
+        match = !*expecteds_iter;
+        UnicodeBoyerMooreMatcher_scanUTF16String(matcher, text_as_u16, textlen, &match);
+        assert(*expecteds_iter == match);
+        g_free(text_as_u16);
+    }
+}
+
+/**
+ * アルファベット文字列の検索をテストする
+ */
+static void
+testAlphabetTextScan()
+{
+    static const gchar *text_tbl[] = {
+        "abcde", "bcde", "abcd", "abde", "_bcde", "abcd_", "ab_de",
+        "xyzabcdefgh", "xyzbcdefgh", "xyzabcdfgh", "xyzabdefgh",
+        "abbacbcdabcdeacbd", "abbacbcdabcdabbde",
+        NULL,
+    };
+    static const gboolean expected_tbl[] = {
+        TRUE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE,
+        TRUE, FALSE, FALSE, FALSE,
+        TRUE, FALSE,
+    };
+    UnicodeBoyerMooreMatcher *matcher = newMatcherFromUTF8("abcde");
+    assertScanResults(matcher, text_tbl, expected_tbl);
+    UnicodeBoyerMooreMatcher_free(matcher);
+}
+
+/**
+ * 日本語文字列の検索をテストする
+ */
+static void
+testJapaneseTextScan()
+{
+    static const gchar *text_tbl[] = {
+        "インターネット",
+        "ンターネット", "インターネッ", "インタネット", "インタアネット",
+        "株式会社インターネットイニシアティブ",
+        "株式会社ンターネットイニシアティブ", "株式会社インターネッイニシアティブ",
+        "株式会社インタネットイニシアティブ", "株式会社インタアネットイニシアティブ",
+        "イターネットインーネットインターネットインターットインターネト",
+        "イターネットインーネットインタアネットインターットインターネト",
+        NULL,
+    };
+    static const gboolean expected_tbl[] = {
+        TRUE,
+        FALSE, FALSE, FALSE, FALSE,
+        TRUE,
+        FALSE, FALSE,
+        FALSE, FALSE,
+        TRUE,
+        FALSE
+    };
+    UnicodeBoyerMooreMatcher *matcher = newMatcherFromUTF8("インターネット");
+    assertScanResults(matcher, text_tbl, expected_tbl);
+    UnicodeBoyerMooreMatcher_free(matcher);
+}
+
+/**
+ * 検索文字列およびテキストに非BMP文字が含まれる場合の検索をテストする
+ */
+static void
+testNotBMPTextScan()
+{
+    static const gchar *text_tbl[] = {
+        "𠮟・𠂉・𥻘・𨨩",
+        "・𠂉・𥻘・𨨩", "𠮟・𠂉・𥻘・", "𠮟・𠂉𥻘・𨨩", "𠮟・𠂉鎼𥻘・𨨩",
+        "驑・䮶・髝・𠮟・𠂉・𥻘・𨨩・䲂・䱿・鰸",
+        "驑・䮶・髝・・𠂉・𥻘・𨨩・䲂・䱿・鰸", "驑・䮶・髝・・𠂉・𥻘・・䲂・䱿・鰸",
+        "驑・䮶・髝・𠮟・𠂉𥻘・𨨩・䲂・䱿・鰸", "驑・䮶・髝・𠮟・𠂉鎼𥻘・𨨩・䲂・䱿・鰸",
+        "𠮟𠂉・𥻘・𨨩𠮟・・𥻘・𨨩𠮟・𠂉・𥻘・𨨩𠮟・𠂉・・𨨩𠮟・𠂉・𥻘𨨩",
+        "𠮟𠂉・𥻘・𨨩𠮟・・𥻘・𨨩𠮟・𠂉鎼𥻘・𨨩𠮟・𠂉・・𨨩𠮟・𠂉・𥻘𨨩",
+        NULL,
+    };
+    static const gboolean expected_tbl[] = {
+        TRUE,
+        FALSE, FALSE, FALSE, FALSE,
+        TRUE,
+        FALSE, FALSE,
+        FALSE, FALSE,
+        TRUE,
+        FALSE
+    };
+    UnicodeBoyerMooreMatcher *matcher = newMatcherFromUTF8("𠮟・𠂉・𥻘・𨨩");
+    assertScanResults(matcher, text_tbl, expected_tbl);
+    UnicodeBoyerMooreMatcher_free(matcher);
+}
+
+static gboolean
+scanChannelFromData(UnicodeBoyerMooreMatcher *matcher, const gchar *data, gsize datalen, gboolean as_utf16)
+{
+    gchar *filename = NULL;
+    gint fd = g_file_open_tmp("test_boyermooreunicode-XXXXXX", &filename, NULL);
+    assert(0 <= fd);
+    close(fd);
+    assert(g_file_set_contents(filename, data, datalen, NULL));
+    GIOChannel *channel = g_io_channel_new_file(filename, "r", NULL);
+    assert(NULL != channel);
+    assert(G_IO_STATUS_NORMAL == g_io_channel_set_encoding(channel, NULL, NULL));
+    gboolean match = FALSE;
+    if (as_utf16) {
+        assert(UnicodeBoyerMooreMatcher_scanUTF16Channel(matcher, channel, &match, NULL));
+    } else {
+        assert(UnicodeBoyerMooreMatcher_scanUTF8Channel(matcher, channel, &match, NULL));
+        gboolean file_match = !match;
+        assert(UnicodeBoyerMooreMatcher_scanUTF8File(matcher, filename, &file_match, NULL));
+        assert(match == file_match);
+    }
+    g_io_channel_unref(channel);
+    g_unlink(filename);
+    g_free(filename);
+    return match;
+}
+
+/**
+ * チャネルの読み出し範囲をまたぐ位置にパターンがある場合の検索をテストする
+ */
+static void
+testChannelScanAcrossBuffers()
+{
+    UnicodeBoyerMooreMatcher *matcher = newMatcherFromUTF8("インターネット");
+    /* 読み出し範囲の境界が様々な位置に来るように、最小のバッファで検査する */
+    UnicodeBoyerMooreMatcher_setChannelBufferSize(matcher, 0);
+    static const gchar *suffix_tbl[] = {
+        "インターネットイニシアティブ", "インタアネットイニシアティブ",
+        NULL,
+    };
+    static const gboolean expected_tbl[] = {
+        TRUE, FALSE,
+    };
+    for (int padding = 0; padding < 64; ++padding) {
+        const gchar **suffixes_iter = suffix_tbl;
+        const gboolean *expecteds_iter = expected_tbl;
+        for (; NULL != *suffixes_iter; ++suffixes_iter, ++expecteds_iter) {
+            GString *text = g_string_new(NULL);
+            for (int i = 0; i < padding; ++i) {
+                g_string_append(text, (i % 3) ? "x" : "株");
+            }
+            g_string_append(text, *suffixes_iter);
+            assert(*expecteds_iter == scanChannelFromData(matcher, text->str, text->len, FALSE));
+
+            glong textlen = 0L;
+            gunichar2 *text_as_u16 = g_utf8_to_utf16(text->str, text->len, NULL, &textlen, NULL);
+            assert(NULL != text_as_u16);
+            assert(*expecteds_iter == scanChannelFromData(matcher, (const gchar *) text_as_u16,
+                                                          sizeof(gunichar2) * textlen, TRUE));
+            g_free(text_as_u16);
+            g_string_free(text, TRUE);
+        }
+    }
+    UnicodeBoyerMooreMatcher_free(matcher);
+}
+
+/**
+ * 対になっていないサロゲートを含むパターンも作れる
+ * UTF-16 のテキストではそのまま照合し、正しい UTF-8 のテキストには現れないので常に不一致になる
+ */
+static void
+testUnpairedSurrogatePattern()
+{
+    static const gunichar2 pattern[] = {0xD842, 'a'};
+    UnicodeBoyerMooreMatcher *matcher = UnicodeBoyerMooreMatcher_new(pattern, G_N_ELEMENTS(pattern));
+    assert(NULL != matcher);
+    assert(G_N_ELEMENTS(pattern) == UnicodeBoyerMooreMatcher_getPatternLength(matcher));
+
+    static const gunichar2 text_as_u16[] = {'x', 0xD842, 'a', 'y'};
+    gboolean match = FALSE;
+    UnicodeBoyerMooreMatcher_scanUTF16String(matcher, text_as_u16, G_N_ELEMENTS(text_as_u16), &match);
+    assert(match);
+
+    /* 𠮷 (U+20BB7) の上位サロゲートは 0xD842 だが、UTF-8 では文字として比べるので一致しない */
+    static const gchar *texts[] = {"xay", "𠮷a", "", NULL};
+    for (const gchar **texts_iter = texts; NULL != *texts_iter; ++texts_iter) {
+        match = TRUE;
+        assert(UnicodeBoyerMooreMatcher_scanUTF8String(matcher, *texts_iter, -1L, &match, NULL));
+        assert(!match);
+        assert(NULL == UnicodeBoyerMooreMatcher_findUTF8String(matcher, *texts_iter, -1L));
+        assert(!scanChannelFromData(matcher, *texts_iter, strlen(*texts_iter), FALSE));
+    }
+    UnicodeBoyerMooreMatcher_free(matcher);
+
+    /* UTF-8 に変換できなくても、UTF-16 のチャネルの走査はパターンを持ち越せる大きさのバッファを使う */
+    static const gunichar2 long_pattern[] = {0xD842, 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k'};
+    static const gsize bufsizes[] = {0, 1, 4, 16, 64};
+    for (gsize i = 0; i < G_N_ELEMENTS(bufsizes); ++i) {
+        matcher = UnicodeBoyerMooreMatcher_new(long_pattern, G_N_ELEMENTS(long_pattern));
+        UnicodeBoyerMooreMatcher_setChannelBufferSize(matcher, bufsizes[i]);
+        for (gsize padding = 0; padding < 40; ++padding) {
+            gsize textlen = padding + G_N_ELEMENTS(long_pattern) + 1;
+            gunichar2 *text = g_new(gunichar2, textlen);
+            for (gsize j = 0; j < padding; ++j) {
+                text[j] = 'x';
+            }
+            memcpy(text + padding, long_pattern, sizeof(long_pattern));
+            text[textlen - 1] = 'y';
+            assert(scanChannelFromData(matcher, (const gchar *) text, sizeof(gunichar2) * textlen, TRUE));
+            g_free(text);
+        }
+        UnicodeBoyerMooreMatcher_free(matcher);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    testAlphabetTextScan();
+    testJapaneseTextScan();
+    testNotBMPTextScan();
+    testChannelScanAcrossBuffers();
+    testUnpairedSurrogatePattern();
+    return 0;
+}
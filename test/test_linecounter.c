@@ -0,0 +1,82 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "linecounter.h"
+
+static gsize
+countNewlinesNaively(const gchar *text, gsize textlen)
+{
+    gsize n_newlines = 0;
+    for (gsize i = 0; i < textlen; ++i) {
+        n_newlines += ('\n' == text[i]);
+    }
+    return n_newlines;
+}
+
+/**
+ * ベクトル幅の境界や 8 ビットの計数があふれる長さをまたいでも、1バイトずつ数えた結果と一致する
+ */
+static void
+testCountNewlines()
+{
+    static const gsize lengths[] = {0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 255 * 16 + 1, 255 * 32 + 7, 100000};
+    for (gsize i = 0; i < G_N_ELEMENTS(lengths); ++i) {
+        gchar *text = g_new(gchar, lengths[i] + 1);
+        for (gsize j = 0; j < lengths[i]; ++j) {
+            text[j] = (0 == rand() % 3) ? '\n' : 'a';
+        }
+        for (gsize offset = 0; offset < 3 && offset <= lengths[i]; ++offset) {
+            assert(countNewlinesNaively(text + offset, lengths[i] - offset) ==
+                   LineCounter_countNewlines(text + offset, lengths[i] - offset));
+        }
+        memset(text, '\n', lengths[i]);
+        assert(lengths[i] == LineCounter_countNewlines(text, lengths[i]));
+        g_free(text);
+    }
+}
+
+/**
+ * 前後のどちらに移動しても、行番号と行の範囲を先頭から数えた結果と一致する
+ */
+static void
+testSeek()
+{
+    static const gchar *pieces[] = {"a", "bc", "あ", "\n", "\n\n", "\r\n"};
+    GString *text = g_string_new(NULL);
+    for (gsize i = 0; i < 2000; ++i) {
+        g_string_append(text, pieces[rand() % G_N_ELEMENTS(pieces)]);
+    }
+    LineCounter lines;
+    LineCounter_init(&lines, text->str, text->len);
+    assert(1 == lines.number && 0 == lines.line_start);
+    for (gsize i = 0; i < 3000; ++i) {
+        gsize step = (gsize) rand() % 40;
+        gsize offset = (0 == i % 2) ? (gsize) rand() % (text->len + 1) : MIN(text->len, lines.position + step);
+        LineCounter_seek(&lines, offset);
+        gsize expected_number = 1 + countNewlinesNaively(text->str, offset);
+        gsize expected_start = offset;
+        while (0 < expected_start && '\n' != text->str[expected_start - 1]) {
+            --expected_start;
+        }
+        gsize expected_end = offset;
+        while (expected_end < text->len && '\n' != text->str[expected_end]) {
+            ++expected_end;
+        }
+        assert(expected_number == lines.number);
+        assert(expected_start == lines.line_start);
+        assert(expected_end == LineCounter_getLineEnd(&lines));
+    }
+    LineCounter_seek(&lines, text->len);
+    assert(1 + countNewlinesNaively(text->str, text->len) == lines.number);
+    g_string_free(text, TRUE);
+}
+
+int
+main(int argc, char **argv)
+{
+    srand(0);
+    testCountNewlines();
+    testSeek();
+    return 0;
+}
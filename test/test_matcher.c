@@ -0,0 +1,593 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "matcher.h"
+
+typedef struct Occurrence {
+    gsize offset;
+    gsize keywordlen;
+    const gchar *keyword;
+} Occurrence;
+
+typedef struct Occurrences {
+    Occurrence *items;
+    gsize len;
+    gsize capacity;
+} Occurrences;
+
+static void
+Occurrences_add(Occurrences *self, const gchar *keyword, gsize keywordlen, gsize offset)
+{
+    if (self->len == self->capacity) {
+        self->capacity = (0 == self->capacity) ? 16 : self->capacity * 2;
+        self->items = (Occurrence *) g_realloc(self->items, sizeof(Occurrence) * self->capacity);
+    }
+    Occurrence *item = &self->items[self->len++];
+    item->offset = offset;
+    item->keywordlen = keywordlen;
+    item->keyword = keyword;
+}
+
+static int
+Occurrence_compare(const void *a, const void *b)
+{
+    const Occurrence *x = (const Occurrence *) a;
+    const Occurrence *y = (const Occurrence *) b;
+    if (x->offset != y->offset) {
+        return (x->offset < y->offset) ? -1 : 1;
+    }
+    if (x->keywordlen != y->keywordlen) {
+        return (x->keywordlen < y->keywordlen) ? -1 : 1;
+    }
+    return memcmp(x->keyword, y->keyword, x->keywordlen);
+}
+
+static gboolean
+collectOccurrence(const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    Occurrences_add((Occurrences *) user_data, keyword, keywordlen, offset);
+    return TRUE;
+}
+
+/**
+ * 重なりを含むすべての出現を総当たりで数える
+ */
+static void
+findAllByBruteForce(const gchar **keywords, gsize n_keywords, const gchar *text, Occurrences *result)
+{
+    gsize textlen = strlen(text);
+    for (gsize i = 0; i < n_keywords; ++i) {
+        // Matcher は重複したキーワードを1本として扱う
+        gboolean duplicated = FALSE;
+        for (gsize j = 0; j < i; ++j) {
+            duplicated = duplicated || 0 == strcmp(keywords[i], keywords[j]);
+        }
+        if (duplicated) {
+            continue;
+        }
+        gsize keywordlen = strlen(keywords[i]);
+        for (gsize offset = 0; offset + keywordlen <= textlen; ++offset) {
+            if (0 == memcmp(text + offset, keywords[i], keywordlen)) {
+                Occurrences_add(result, keywords[i], keywordlen, offset);
+            }
+        }
+    }
+    qsort(result->items, result->len, sizeof(Occurrence), Occurrence_compare);
+}
+
+static void
+assertSameOccurrences(const Occurrences *expected, Occurrences *actual)
+{
+    qsort(actual->items, actual->len, sizeof(Occurrence), Occurrence_compare);
+    assert(expected->len == actual->len);
+    for (gsize i = 0; i < expected->len; ++i) {
+        assert(0 == Occurrence_compare(&expected->items[i], &actual->items[i]));
+    }
+}
+
+static Matcher *
+newMatcher(const gchar **keywords, gsize n_keywords)
+{
+    Matcher *matcher = Matcher_new();
+    for (gsize i = 0; i < n_keywords; ++i) {
+        assert(Matcher_addKeyword(matcher, keywords[i], -1L, NULL));
+    }
+    return matcher;
+}
+
+/**
+ * engine で text を検査した結果が総当たりと一致することを確かめる
+ */
+static void
+assertScanResults(const gchar **keywords, gsize n_keywords, MatcherEngine engine, const gchar *text)
+{
+    Occurrences expected = {NULL, 0, 0};
+    findAllByBruteForce(keywords, n_keywords, text, &expected);
+
+    Matcher *matcher = newMatcher(keywords, n_keywords);
+    assert(Matcher_compile(matcher, engine, NULL));
+    assert(MATCHER_ENGINE_AUTO != Matcher_getEngine(matcher));
+
+    Occurrences actual = {NULL, 0, 0};
+    assert(Matcher_scanAll(matcher, text, -1L, collectOccurrence, &actual, NULL));
+    assertSameOccurrences(&expected, &actual);
+
+    // 変換先を使い回しても結果は変わらない
+    UTF16Buffer buffer = UTF16BUFFER_INIT;
+    for (int i = 0; i < 2; ++i) {
+        Occurrences reused = {NULL, 0, 0};
+        assert(Matcher_scanAllWithBuffer(matcher, text, -1L, &buffer, collectOccurrence, &reused, NULL));
+        assertSameOccurrences(&expected, &reused);
+        g_free(reused.items);
+    }
+    UTF16Buffer_clear(&buffer);
+
+    const gchar *keyword = NULL;
+    gsize offset = 0;
+    assert(Matcher_scan(matcher, text, -1L, &keyword, &offset, NULL));
+    if (0 == expected.len) {
+        assert(NULL == keyword);
+    } else {
+        // 総当たりの結果を並べた先頭、つまり最も手前で始まる最も短い出現がどのエンジンでも返る
+        assert(NULL != keyword);
+        assert(expected.items[0].offset == offset);
+        assert(expected.items[0].keywordlen == strlen(keyword));
+        assert(0 == strncmp(text + offset, keyword, strlen(keyword)));
+    }
+
+    Matcher_free(matcher);
+    g_free(actual.items);
+    g_free(expected.items);
+}
+
+static const MatcherEngine engines[] = {
+#ifdef __SSE2__
+    MATCHER_ENGINE_NAIVE_SIMD,
+#endif // __SSE2__
+    MATCHER_ENGINE_SUNDAY,
+    MATCHER_ENGINE_BOYER_MOORE,
+    MATCHER_ENGINE_COMMENTZ_WALTER,
+    MATCHER_ENGINE_UNICODE_COMMENTZ_WALTER,
+    MATCHER_ENGINE_AHO_CORASICK,
+    MATCHER_ENGINE_AUTO,
+};
+
+/**
+ * キーワードの本数や文字種に応じたエンジンが選ばれることをテストする
+ */
+static void
+testPlanEngine()
+{
+    static const gchar *short_keyword[] = {"abc"};
+    static const gchar *ascii_keyword[] = {"internet initiative"};
+    static const gchar *japanese_keyword[] = {"インターネット"};
+    static const gchar *ascii_keywords[] = {"abc", "internet", "initiative"};
+    static const gchar *japanese_keywords[] = {"インターネット", "イニシアティブ", "株式会社"};
+    static const gchar *short_japanese_keywords[] = {"株式", "インターネット"};
+    struct {
+        const gchar **keywords;
+        gsize n_keywords;
+        MatcherEngine expected;
+    } cases[] = {
+#ifdef __SSE2__
+        {short_keyword, G_N_ELEMENTS(short_keyword), MATCHER_ENGINE_NAIVE_SIMD},
+#else
+        {short_keyword, G_N_ELEMENTS(short_keyword), MATCHER_ENGINE_SUNDAY},
+#endif // __SSE2__
+        {ascii_keyword, G_N_ELEMENTS(ascii_keyword), MATCHER_ENGINE_SUNDAY},
+#ifdef __SSE2__
+        {japanese_keyword, G_N_ELEMENTS(japanese_keyword), MATCHER_ENGINE_SUNDAY},
+#else
+        {japanese_keyword, G_N_ELEMENTS(japanese_keyword), MATCHER_ENGINE_BOYER_MOORE},
+#endif // __SSE2__
+        {ascii_keywords, G_N_ELEMENTS(ascii_keywords), MATCHER_ENGINE_COMMENTZ_WALTER},
+        {japanese_keywords, G_N_ELEMENTS(japanese_keywords), MATCHER_ENGINE_UNICODE_COMMENTZ_WALTER},
+        {short_japanese_keywords, G_N_ELEMENTS(short_japanese_keywords), MATCHER_ENGINE_AHO_CORASICK},
+    };
+    for (gsize i = 0; i < G_N_ELEMENTS(cases); ++i) {
+        Matcher *matcher = newMatcher(cases[i].keywords, cases[i].n_keywords);
+        assert(cases[i].expected == Matcher_planEngine(matcher));
+        assert(MATCHER_ENGINE_AUTO == Matcher_getEngine(matcher));
+        assert(0 == strcmp("auto", Matcher_getEngineName(matcher)));
+        // 検査の前に自動でコンパイルされる
+        const gchar *keyword = NULL;
+        assert(Matcher_scan(matcher, "株式会社インターネットイニシアティブ", -1L, &keyword, NULL, NULL));
+        assert(cases[i].expected == Matcher_getEngine(matcher));
+        Matcher_free(matcher);
+    }
+}
+
+/**
+ * 決まった入力に対して、全エンジンの結果が総当たりと一致することをテストする
+ */
+static void
+testFixedTextScan()
+{
+    static const gchar *texts[] = {
+        "", "a", "abc", "abcabcabc", "aaaaaaaa", "xyzabcdefgh",
+        "インターネット", "株式会社インターネットイニシアティブ", "株式株式会社社",
+        "ab\xf0\x9f\x98\x80" "abc\xf0\x9f\x98\x80" "インターネット",
+    };
+    static const gchar *single_keywords[][1] = {
+        {"abc"}, {"aa"}, {"インターネット"}, {"\xf0\x9f\x98\x80" "abc"}, {"株式会社インターネットイニシアティブ"},
+    };
+    static const gchar *multiple_keywords[][4] = {
+        {"abc", "bca", "cab", "a"},
+        {"インターネット", "ネット", "株式", "株式会社"},
+        {"aa", "aaa", "aaaa", "b"},
+        {"\xf0\x9f\x98\x80", "abc", "ターネ", "社"},
+    };
+    for (gsize t = 0; t < G_N_ELEMENTS(texts); ++t) {
+        for (gsize k = 0; k < G_N_ELEMENTS(single_keywords); ++k) {
+            for (gsize e = 0; e < G_N_ELEMENTS(engines); ++e) {
+                assertScanResults(single_keywords[k], 1, engines[e], texts[t]);
+            }
+        }
+        for (gsize k = 0; k < G_N_ELEMENTS(multiple_keywords); ++k) {
+            // 単一パターンのエンジンはキーワードごとに走査する
+            for (gsize e = 0; e < G_N_ELEMENTS(engines); ++e) {
+                assertScanResults(multiple_keywords[k], 4, engines[e], texts[t]);
+            }
+        }
+    }
+}
+
+/**
+ * 後から登録したキーワードが先に現れても、全エンジンがテキストの最も手前で始まる出現を返す
+ * 同じ位置で始まる出現があれば短いキーワードを返し、先に終わる出現を含むキーワードも手前で始まれば選ぶ
+ */
+static void
+testScanFirstOccurrence()
+{
+    static const struct {
+        const gchar *keywords[3];
+        const gchar *text;
+        const gchar *expected_keyword;
+        gsize expected_offset;
+    } cases[] = {
+        {{"おはよう", "こんにちは", NULL}, "こんにちは、おはよう", "こんにちは", 0},
+        {{"ネット", "インター", NULL}, "株式会社インターネット", "インター", 12},
+        {{"xyz", "abcd", "ab"}, "__abcdxyz", "ab", 2},
+        {{"abcd", "bc", NULL}, "xabcdx", "abcd", 1},
+        {{"zz", "abc", "b"}, "abczz", "abc", 0},
+        {{"ネット", "ターネ", "インターネット"}, "株式会社インターネット", "インターネット", 12},
+    };
+    for (gsize i = 0; i < G_N_ELEMENTS(cases); ++i) {
+        gsize n_keywords = (NULL == cases[i].keywords[2]) ? 2 : 3;
+        for (gsize e = 0; e < G_N_ELEMENTS(engines); ++e) {
+            Matcher *matcher = newMatcher((const gchar **) cases[i].keywords, n_keywords);
+            assert(Matcher_compile(matcher, engines[e], NULL));
+            const gchar *keyword = NULL;
+            gsize offset = 0;
+            assert(Matcher_scan(matcher, cases[i].text, -1L, &keyword, &offset, NULL));
+            assert(NULL != keyword);
+            assert(0 == strcmp(cases[i].expected_keyword, keyword));
+            assert(cases[i].expected_offset == offset);
+            Matcher_free(matcher);
+        }
+    }
+}
+
+/**
+ * ASCII と CJK を混ぜた小さなアルファベットで作ったランダムな入力について、
+ * 全エンジンの結果が総当たりと一致することをテストする
+ */
+static void
+testRandomTextScan()
+{
+    static const gchar *alphabet[] = {"a", "b", "あ", "い", "\xf0\x9f\x98\x80"};
+    GRand *rand = g_rand_new_with_seed(34);
+    gchar keyword_bufs[4][32];
+    const gchar *keywords[4];
+    gchar text[256];
+    for (gint round = 0; round < 300; ++round) {
+        gsize n_keywords = g_rand_int_range(rand, 1, 5);
+        for (gsize i = 0; i < n_keywords; ++i) {
+            keyword_bufs[i][0] = '\0';
+            gint keywordlen = g_rand_int_range(rand, 1, 6);
+            for (gint j = 0; j < keywordlen; ++j) {
+                strcat(keyword_bufs[i], alphabet[g_rand_int_range(rand, 0, G_N_ELEMENTS(alphabet))]);
+            }
+            keywords[i] = keyword_bufs[i];
+        }
+        text[0] = '\0';
+        gint textlen = g_rand_int_range(rand, 0, 50);
+        for (gint j = 0; j < textlen; ++j) {
+            strcat(text, alphabet[g_rand_int_range(rand, 0, G_N_ELEMENTS(alphabet))]);
+        }
+        for (gsize e = 0; e < G_N_ELEMENTS(engines); ++e) {
+            assertScanResults(keywords, n_keywords, engines[e], text);
+        }
+    }
+    g_rand_free(rand);
+}
+
+/**
+ * まとめて走査した結果が、文字列ごとの総当たりと一致することをテストする
+ * 区切りをまたぐ出現は報告せず、不正な文字列だけを MATCHER_BATCH_INVALID にする
+ */
+static void
+testBatchScan()
+{
+    static const gchar *alphabet[] = {"a", "b", "あ", "い", "\xf0\x9f\x98\x80"};
+    static const gchar *keywords[] = {"ab", "ba", "あい", "b\xf0\x9f\x98\x80" "a", "aaa"};
+    GRand *rand = g_rand_new_with_seed(46);
+    gchar texts[64][128];
+    MatcherString strings[G_N_ELEMENTS(texts)];
+    MatcherBatch *batch = MatcherBatch_new();
+    for (gsize e = 0; e < G_N_ELEMENTS(engines); ++e) {
+        Matcher *matcher = newMatcher(keywords, G_N_ELEMENTS(keywords));
+        assert(Matcher_compile(matcher, engines[e], NULL));
+        for (gint round = 0; round < 20; ++round) {
+            gsize n_strings = g_rand_int_range(rand, 0, G_N_ELEMENTS(texts));
+            for (gsize i = 0; i < n_strings; ++i) {
+                texts[i][0] = '\0';
+                gint textlen = g_rand_int_range(rand, 0, 12);
+                for (gint j = 0; j < textlen; ++j) {
+                    strcat(texts[i], alphabet[g_rand_int_range(rand, 0, G_N_ELEMENTS(alphabet))]);
+                }
+                if (0 == g_rand_int_range(rand, 0, 10)) {
+                    strcat(texts[i], "\xff");
+                }
+                strings[i].text = texts[i];
+                strings[i].length = strlen(texts[i]);
+            }
+            gboolean collect = (0 == round % 2);
+            assert(Matcher_scanBatch(matcher, strings, n_strings, collect, batch, NULL));
+            assert(n_strings == MatcherBatch_getLength(batch));
+            for (gsize i = 0; i < n_strings; ++i) {
+                MatcherBatchStatus status = MatcherBatch_getStatus(batch, i);
+                if (!g_utf8_validate(texts[i], -1, NULL)) {
+                    assert(MATCHER_BATCH_INVALID == status);
+                    continue;
+                }
+                Occurrences expected = {NULL, 0, 0};
+                findAllByBruteForce(keywords, G_N_ELEMENTS(keywords), texts[i], &expected);
+                assert((0 < expected.len) == (MATCHER_BATCH_HIT == status));
+                gsize n_matches = 0;
+                const MatcherBatchMatch *matches = MatcherBatch_getMatches(batch, i, &n_matches);
+                if (!collect) {
+                    assert(0 == n_matches);
+                } else {
+                    assert(expected.len == n_matches);
+                    for (gsize j = 0; j < n_matches; ++j) {
+                        // 開始位置の昇順に並ぶ
+                        assert(0 == j || matches[j - 1].offset <= matches[j].offset);
+                        assert(0 == memcmp(texts[i] + matches[j].offset, matches[j].keyword, matches[j].keywordlen));
+                    }
+                }
+                g_free(expected.items);
+            }
+        }
+        Matcher_free(matcher);
+    }
+    MatcherBatch_free(batch);
+    g_rand_free(rand);
+}
+
+/**
+ * 新しいバッチで空の文字列の並びを走査しても、どちらの collect_matches でも成功する
+ */
+static void
+testEmptyBatchScan()
+{
+    static const gchar *keywords[] = {"ab", "あい"};
+    for (gsize e = 0; e < G_N_ELEMENTS(engines); ++e) {
+        for (gint collect = 0; collect < 2; ++collect) {
+            Matcher *matcher = newMatcher(keywords, G_N_ELEMENTS(keywords));
+            assert(Matcher_compile(matcher, engines[e], NULL));
+            MatcherBatch *batch = MatcherBatch_new();
+            assert(Matcher_scanBatch(matcher, NULL, 0, collect, batch, NULL));
+            assert(0 == MatcherBatch_getLength(batch));
+            MatcherBatch_free(batch);
+            Matcher_free(matcher);
+        }
+    }
+}
+
+typedef struct LineOccurrence {
+    Occurrence occurrence;
+    MatcherLine line;
+} LineOccurrence;
+
+typedef struct LineOccurrences {
+    GArray *items; /* 要素は LineOccurrence */
+    gsize limit;   /* この件数を受け取ったら走査を打ち切る */
+} LineOccurrences;
+
+static gboolean
+collectLineOccurrence(const MatcherLine *line, const gchar *keyword, gsize keywordlen, gsize offset,
+                      gpointer user_data)
+{
+    LineOccurrences *occurrences = (LineOccurrences *) user_data;
+    LineOccurrence item = {{offset, keywordlen, keyword}, *line};
+    g_array_append_val(occurrences->items, item);
+    return occurrences->items->len < occurrences->limit;
+}
+
+static int
+LineOccurrence_compare(const void *a, const void *b)
+{
+    return Occurrence_compare(&((const LineOccurrence *) a)->occurrence, &((const LineOccurrence *) b)->occurrence);
+}
+
+/**
+ * offset を含む行を先頭から数えて求める
+ */
+static MatcherLine
+findLineNaively(const gchar *text, gsize textlen, gsize offset)
+{
+    MatcherLine line = {1, 0, 0};
+    for (gsize i = 0; i < offset; ++i) {
+        if ('\n' == text[i]) {
+            ++line.number;
+            line.offset = i + 1;
+        }
+    }
+    gsize end = offset;
+    while (end < textlen && '\n' != text[end]) {
+        ++end;
+    }
+    line.length = end - line.offset;
+    return line;
+}
+
+static void
+assertSameLine(const MatcherLine *expected, const MatcherLine *actual)
+{
+    assert(expected->number == actual->number);
+    assert(expected->offset == actual->offset);
+    assert(expected->length == actual->length);
+}
+
+/**
+ * すべての出現を報告するときは総当たりの出現とその行に一致し、
+ * 1行に1つだけ報告するときはキーワードを含む行ごとに最も手前 (同じ位置なら最も短い) の出現が行の順に報告される
+ */
+static void
+assertScanLinesResults(Matcher *matcher, const gchar **keywords, gsize n_keywords, const gchar *text)
+{
+    gsize textlen = strlen(text);
+    Occurrences expected = {NULL, 0, 0};
+    findAllByBruteForce(keywords, n_keywords, text, &expected);
+    LineOccurrences actual = {g_array_new(FALSE, FALSE, sizeof(LineOccurrence)), G_MAXSIZE};
+
+    assert(Matcher_scanLines(matcher, text, textlen, FALSE, collectLineOccurrence, &actual, NULL));
+    g_array_sort(actual.items, LineOccurrence_compare);
+    assert(expected.len == actual.items->len);
+    for (gsize i = 0; i < expected.len; ++i) {
+        const LineOccurrence *item = &g_array_index(actual.items, LineOccurrence, i);
+        assert(0 == Occurrence_compare(&expected.items[i], &item->occurrence));
+        MatcherLine line = findLineNaively(text, textlen, item->occurrence.offset);
+        assertSameLine(&line, &item->line);
+    }
+
+    g_array_set_size(actual.items, 0);
+    assert(Matcher_scanLines(matcher, text, textlen, TRUE, collectLineOccurrence, &actual, NULL));
+    gsize n_lines = 0;
+    for (gsize i = 0; i < expected.len; ++i) {
+        MatcherLine line = findLineNaively(text, textlen, expected.items[i].offset);
+        if (0 < n_lines &&
+            line.offset == g_array_index(actual.items, LineOccurrence, n_lines - 1).line.offset) {
+            continue;
+        }
+        assert(n_lines < actual.items->len);
+        const LineOccurrence *item = &g_array_index(actual.items, LineOccurrence, n_lines);
+        assert(0 == Occurrence_compare(&expected.items[i], &item->occurrence));
+        assertSameLine(&line, &item->line);
+        ++n_lines;
+    }
+    assert(n_lines == actual.items->len);
+
+    // 最初の報告で打ち切れる
+    for (gint first_match_only = 0; first_match_only < 2; ++first_match_only) {
+        g_array_set_size(actual.items, 0);
+        actual.limit = 1;
+        assert(Matcher_scanLines(matcher, text, textlen, first_match_only, collectLineOccurrence, &actual, NULL));
+        assert(MIN(expected.len, 1) == actual.items->len);
+        actual.limit = G_MAXSIZE;
+    }
+
+    g_array_free(actual.items, TRUE);
+    g_free(expected.items);
+}
+
+/**
+ * 行ごとの報告を、改行を含むキーワードや、見つからない区間が続いて走査の窓が広がる長いテキストでテストする
+ */
+static void
+testScanLines()
+{
+    static const gchar *alphabet[] = {"a", "b", "あ", "い", "\n", "\n\n", "\r\n"};
+    static const gchar *keywords[] = {"ab", "ba", "あい", "aaa", "b"};
+    static const gchar *newline_keywords[] = {"ab", "b\na", "あ\n", "\nい"};
+    static const gchar *fillers[] = {"x", "yz", "\n", "う"};
+    GRand *rand = g_rand_new_with_seed(48);
+    for (gsize e = 0; e < G_N_ELEMENTS(engines); ++e) {
+        for (gint set = 0; set < 2; ++set) {
+            const gchar **words = (0 == set) ? keywords : newline_keywords;
+            gsize n_words = (0 == set) ? G_N_ELEMENTS(keywords) : G_N_ELEMENTS(newline_keywords);
+            Matcher *matcher = newMatcher(words, n_words);
+            assert(Matcher_compile(matcher, engines[e], NULL));
+            GString *text = g_string_new(NULL);
+            for (gint round = 0; round < 30; ++round) {
+                g_string_truncate(text, 0);
+                gint n_pieces = g_rand_int_range(rand, 0, 60);
+                for (gint i = 0; i < n_pieces; ++i) {
+                    g_string_append(text, alphabet[g_rand_int_range(rand, 0, G_N_ELEMENTS(alphabet))]);
+                }
+                assertScanLinesResults(matcher, words, n_words, text->str);
+            }
+            // 出現がまばらな長いテキスト
+            g_string_truncate(text, 0);
+            for (gint i = 0; i < 200000; ++i) {
+                if (0 == g_rand_int_range(rand, 0, 20000)) {
+                    g_string_append(text, words[g_rand_int_range(rand, 0, n_words)]);
+                }
+                g_string_append(text, fillers[g_rand_int_range(rand, 0, G_N_ELEMENTS(fillers))]);
+            }
+            assertScanLinesResults(matcher, words, n_words, text->str);
+            g_string_free(text, TRUE);
+            Matcher_free(matcher);
+        }
+    }
+    g_rand_free(rand);
+}
+
+/**
+ * 不正なキーワードやテキスト、エンジンの指定がエラーになることをテストする
+ */
+static void
+testErrors()
+{
+    GError *error = NULL;
+    Matcher *matcher = Matcher_new();
+    assert(!Matcher_addKeyword(matcher, "", -1L, &error));
+    assert(g_error_matches(error, MATCHER_ERROR, MATCHER_ERROR_INVALID_KEYWORD));
+    g_clear_error(&error);
+    assert(!Matcher_addKeyword(matcher, "\xff\xfe", -1L, &error));
+    assert(g_error_matches(error, MATCHER_ERROR, MATCHER_ERROR_INVALID_KEYWORD));
+    g_clear_error(&error);
+    assert(!Matcher_compile(matcher, MATCHER_ENGINE_AUTO, &error));
+    assert(g_error_matches(error, MATCHER_ERROR, MATCHER_ERROR_NO_KEYWORD));
+    g_clear_error(&error);
+
+    assert(Matcher_addKeyword(matcher, "abc", -1L, NULL));
+    assert(Matcher_addKeyword(matcher, "def", -1L, NULL));
+    assert(!Matcher_compile(matcher, (MatcherEngine) -1, &error));
+    assert(g_error_matches(error, MATCHER_ERROR, MATCHER_ERROR_UNSUPPORTED_ENGINE));
+    g_clear_error(&error);
+
+    // UTF-16 に変換するエンジンは不正なテキストをエラーにする
+    static const MatcherEngine utf16_engines[] = {
+        MATCHER_ENGINE_UNICODE_COMMENTZ_WALTER, MATCHER_ENGINE_AHO_CORASICK,
+    };
+    for (gsize e = 0; e < G_N_ELEMENTS(utf16_engines); ++e) {
+        const gchar *keyword = NULL;
+        assert(Matcher_compile(matcher, utf16_engines[e], NULL));
+        assert(!Matcher_scan(matcher, "abc\xff", -1L, &keyword, NULL, &error));
+        assert(g_error_matches(error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE));
+        g_clear_error(&error);
+    }
+    // バイト単位のエンジンは検証せずに照合する
+    const gchar *keyword = NULL;
+    assert(Matcher_compile(matcher, MATCHER_ENGINE_COMMENTZ_WALTER, NULL));
+    assert(Matcher_scan(matcher, "abc\xff", -1L, &keyword, NULL, NULL));
+    assert(0 == strcmp("abc", keyword));
+    Matcher_free(matcher);
+}
+
+int
+main(int argc, char **argv)
+{
+    testPlanEngine();
+    testFixedTextScan();
+    testScanFirstOccurrence();
+    testRandomTextScan();
+    testBatchScan();
+    testEmptyBatchScan();
+    testScanLines();
+    testErrors();
+    return 0;
+}
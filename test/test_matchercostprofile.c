@@ -0,0 +1,152 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "matcher.h"
+#include "matchercostprofile.h"
+
+static const guint keyword_counts[] = {1, 4, 16};
+static const guint keyword_lengths[] = {2, 8};
+
+static gboolean
+nearlyEquals(gdouble expected, gdouble actual)
+{
+    return fabs(expected - actual) <= fabs(expected) * 1e-9;
+}
+
+/**
+ * Sunday はキーワード数に比例して走査が遅くなり、Aho-Corasick はキーワード数によらないプロファイルを作る
+ */
+static MatcherCostProfile *
+newProfile()
+{
+    MatcherCostProfile *profile = MatcherCostProfile_new(keyword_counts, G_N_ELEMENTS(keyword_counts),
+                                                         keyword_lengths, G_N_ELEMENTS(keyword_lengths));
+    for (gsize ci = 0; ci < G_N_ELEMENTS(keyword_counts); ++ci) {
+        for (gsize li = 0; li < G_N_ELEMENTS(keyword_lengths); ++li) {
+            MatcherCostProfile_setCost(profile, MATCHER_ENGINE_SUNDAY, MATCHER_ALPHABET_ASCII, ci, li,
+                                       1.0, 0.5 * keyword_counts[ci]);
+            MatcherCostProfile_setCost(profile, MATCHER_ENGINE_AHO_CORASICK, MATCHER_ALPHABET_ASCII, ci, li,
+                                       100.0, 3.0);
+        }
+    }
+    return profile;
+}
+
+/**
+ * 格子点での値と、格子点の間や外側での補間をテストする
+ */
+static void
+testPredict()
+{
+    MatcherCostProfile *profile = newProfile();
+    gdouble cost = 0.0;
+    // 格子点ではそのままの値を使う
+    assert(MatcherCostProfile_predict(profile, MATCHER_ENGINE_SUNDAY, MATCHER_ALPHABET_ASCII, 4, 8, 32, 1000, &cost));
+    assert(nearlyEquals(1.0 * 32 + 2.0 * 1000, cost));
+    // 両対数軸での補間なので、比例関係は格子点の間でも保たれる
+    assert(MatcherCostProfile_predict(profile, MATCHER_ENGINE_SUNDAY, MATCHER_ALPHABET_ASCII, 8, 4, 32, 1000, &cost));
+    assert(nearlyEquals(1.0 * 32 + 4.0 * 1000, cost));
+    // キーワード数は計測範囲の外へ外挿する
+    assert(MatcherCostProfile_predict(profile, MATCHER_ENGINE_SUNDAY, MATCHER_ALPHABET_ASCII, 64, 8, 0, 1000, &cost));
+    assert(nearlyEquals(32.0 * 1000, cost));
+    // 長さは端の値を使う
+    assert(MatcherCostProfile_predict(profile, MATCHER_ENGINE_SUNDAY, MATCHER_ALPHABET_ASCII, 1, 100, 0, 1000, &cost));
+    assert(nearlyEquals(0.5 * 1000, cost));
+    assert(MatcherCostProfile_predict(profile, MATCHER_ENGINE_SUNDAY, MATCHER_ALPHABET_ASCII, 1, 1, 0, 1000, &cost));
+    assert(nearlyEquals(0.5 * 1000, cost));
+    // 計測していないエンジンや文字種は予測できない
+    assert(!MatcherCostProfile_predict(profile, MATCHER_ENGINE_COMMENTZ_WALTER, MATCHER_ALPHABET_ASCII, 4, 8, 32, 1000, &cost));
+    assert(!MatcherCostProfile_predict(profile, MATCHER_ENGINE_SUNDAY, MATCHER_ALPHABET_CJK, 4, 8, 32, 1000, &cost));
+    MatcherCostProfile_free(profile);
+}
+
+/**
+ * 保存したプロファイルを読み込むと同じ予測になることをテストする
+ */
+static void
+testSaveAndLoad()
+{
+    gchar *filename = NULL;
+    gint fd = g_file_open_tmp("test_matchercostprofile-XXXXXX", &filename, NULL);
+    assert(0 <= fd);
+    close(fd);
+
+    MatcherCostProfile *profile = newProfile();
+    assert(MatcherCostProfile_save(profile, filename, NULL));
+    MatcherCostProfile *loaded = MatcherCostProfile_load(filename, NULL);
+    assert(NULL != loaded);
+    static const MatcherEngine engines[] = {MATCHER_ENGINE_SUNDAY, MATCHER_ENGINE_AHO_CORASICK};
+    for (gsize e = 0; e < G_N_ELEMENTS(engines); ++e) {
+        for (gsize n_keywords = 1; n_keywords < 40; n_keywords += 3) {
+            gdouble expected = 0.0;
+            gdouble actual = 0.0;
+            assert(MatcherCostProfile_predict(profile, engines[e], MATCHER_ALPHABET_ASCII, n_keywords, 5, 100, 5000, &expected));
+            assert(MatcherCostProfile_predict(loaded, engines[e], MATCHER_ALPHABET_ASCII, n_keywords, 5, 100, 5000, &actual));
+            assert(nearlyEquals(expected, actual));
+        }
+    }
+    gdouble cost = 0.0;
+    assert(!MatcherCostProfile_predict(loaded, MATCHER_ENGINE_BOYER_MOORE, MATCHER_ALPHABET_ASCII, 1, 2, 2, 10, &cost));
+    MatcherCostProfile_free(loaded);
+    MatcherCostProfile_free(profile);
+
+    // 存在しないファイルや壊れたファイルはエラーになる
+    GError *error = NULL;
+    assert(g_file_set_contents(filename, "[profile]\nversion=0\n", -1, NULL));
+    assert(NULL == MatcherCostProfile_load(filename, &error));
+    assert(g_error_matches(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE));
+    g_clear_error(&error);
+    g_unlink(filename);
+    assert(NULL == MatcherCostProfile_load(filename, &error));
+    assert(NULL != error);
+    g_clear_error(&error);
+    g_free(filename);
+}
+
+/**
+ * Matcher が予測コストの小さいエンジンを選ぶことをテストする
+ */
+static void
+testPlanEngineByCost()
+{
+    MatcherCostProfile *profile = newProfile();
+    Matcher *matcher = Matcher_new();
+    Matcher_setCostProfile(matcher, profile);
+    assert(Matcher_addKeyword(matcher, "internet", -1L, NULL));
+    // キーワードが少なければ、キーワードごとに走査しても Sunday のほうが速い
+    assert(MATCHER_ENGINE_SUNDAY == Matcher_planEngine(matcher));
+    for (gsize i = 0; i < 7; ++i) {
+        gchar keyword[] = {'a' + i, 'b' + i, 'c' + i, '\0'};
+        assert(Matcher_addKeyword(matcher, keyword, -1L, NULL));
+    }
+    // 8本になると、Sunday の走査コストが Aho-Corasick を上回る
+    assert(MATCHER_ENGINE_AHO_CORASICK == Matcher_planEngine(matcher));
+    // 走査するテキストが少なければ、前処理の軽い Sunday を選ぶ
+    Matcher_setExpectedScanBytes(matcher, 10);
+    assert(MATCHER_ENGINE_SUNDAY == Matcher_planEngine(matcher));
+    Matcher_free(matcher);
+
+    // 計測値のない文字種では経験則で選ぶ
+    matcher = Matcher_new();
+    Matcher_setCostProfile(matcher, profile);
+    assert(Matcher_addKeyword(matcher, "インターネット", -1L, NULL));
+#ifdef __SSE2__
+    assert(MATCHER_ENGINE_SUNDAY == Matcher_planEngine(matcher));
+#else
+    assert(MATCHER_ENGINE_BOYER_MOORE == Matcher_planEngine(matcher));
+#endif // __SSE2__
+    Matcher_free(matcher);
+    MatcherCostProfile_free(profile);
+}
+
+int
+main(int argc, char **argv)
+{
+    testPredict();
+    testSaveAndLoad();
+    testPlanEngineByCost();
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include <assert.h>
+#include <string.h>
+#include <glib.h>
+#include "ahocorasickunicode.h"
+#include "boyermoore.h"
+#include "boyermooreunicode.h"
+#include "commentzwalter.h"
+#include "commentzwalterunicode.h"
+#include "matcher.h"
+#include "memoryusage.h"
+#include "sunday.h"
+#include "twoway.h"
+#include "twowayunicode.h"
+
+static void
+testTotal()
+{
+    MemoryUsage usage = {1, 2, 3, 4, 5, 6};
+    assert(21 == MemoryUsage_getTotal(&usage));
+    MemoryUsage sum = MEMORYUSAGE_INIT;
+    MemoryUsage_add(&sum, &usage);
+    MemoryUsage_add(&sum, &usage);
+    assert(42 == MemoryUsage_getTotal(&sum));
+    assert(6 == sum.shift_tables);
+}
+
+/**
+ * バイト単位の Commentz-Walter 法では、ノードごとに 256 要素の子ノードの表を持つ
+ */
+static void
+testCommentzWalter()
+{
+    CommentzWalterMatcher *matcher = CommentzWalterMatcher_new(16);
+    CommentzWalterMatcher_addKeyword(matcher, "abc", -1L);
+    CommentzWalterMatcher_compile(matcher);
+    MemoryUsage usage = MEMORYUSAGE_INIT;
+    CommentzWalterMatcher_memoryUsage(matcher, &usage);
+    // 根と "c", "bc", "abc" の4ノード
+    assert(4 * 0x100 * sizeof(gpointer) == usage.edges);
+    assert(1 + 2 + 3 == usage.patterns);
+    assert(0x100 * sizeof(guint) == usage.shift_tables);
+    assert(16 == usage.buffers);
+    // 接尾辞を共有するキーワードは新しいノードを1つだけ増やす
+    CommentzWalterMatcher_addKeyword(matcher, "xabc", -1L);
+    MemoryUsage grown = MEMORYUSAGE_INIT;
+    CommentzWalterMatcher_memoryUsage(matcher, &grown);
+    assert(usage.edges + 0x100 * sizeof(gpointer) == grown.edges);
+    assert(usage.patterns + 4 == grown.patterns);
+    assert(MemoryUsage_getTotal(&usage) <= MemoryUsage_getTotal(&grown));
+    CommentzWalterMatcher_free(matcher);
+}
+
+static void
+testUnicodeCommentzWalter()
+{
+    UnicodeCommentzWalterMatcher *matcher = UnicodeCommentzWalterMatcher_new(16);
+    assert(UnicodeCommentzWalterMatcher_addKeywordAsUTF8(matcher, "いろは", -1L, NULL));
+    UnicodeCommentzWalterMatcher_compile(matcher);
+    MemoryUsage usage = MEMORYUSAGE_INIT;
+    UnicodeCommentzWalterMatcher_memoryUsage(matcher, &usage);
+    // chars は UTF-16 のコード単位ごとの表
+    assert(0x10000 * sizeof(guint) == usage.shift_tables);
+    assert(sizeof(gunichar2) * (1 + 2 + 3) == usage.patterns);
+    assert(sizeof(gunichar2) * 16 == usage.buffers);
+    assert(0 < usage.nodes);
+    assert(0 < usage.edges);
+    UnicodeCommentzWalterMatcher_free(matcher);
+}
+
+static void
+testAhoCorasick()
+{
+    UnicodeAhoCorasickMatcher *matcher = UnicodeAhoCorasickMatcher_new(16);
+    MemoryUsage empty = MEMORYUSAGE_INIT;
+    UnicodeAhoCorasickMatcher_memoryUsage(matcher, &empty);
+    assert(0 == empty.edges);
+    static const gchar *keywords[] = {"he", "she", "his", "hers", NULL};
+    for (const gchar **keyword = keywords; NULL != *keyword; ++keyword) {
+        assert(UnicodeAhoCorasickMatcher_addKeywordAsUTF8(matcher, *keyword, -1L, NULL));
+    }
+    MemoryUsage usage = MEMORYUSAGE_INIT;
+    UnicodeAhoCorasickMatcher_memoryUsage(matcher, &usage);
+    // 根と h, he, her, hers, hi, his, s, sh, she の10ステート
+    assert(empty.nodes * 10 == usage.nodes);
+    assert(0 < usage.edges);
+    assert(0 == usage.patterns);
+    assert(0 == usage.shift_tables);
+    assert(sizeof(gunichar2) * 16 == usage.buffers);
+    UnicodeAhoCorasickMatcher_free(matcher);
+}
+
+static void
+testSinglePattern()
+{
+    MemoryUsage usage = MEMORYUSAGE_INIT;
+    SundayMatcher *sunday = SundayMatcher_new("needle", -1L);
+    SundayMatcher_memoryUsage(sunday, &usage);
+    assert(7 == usage.patterns);
+    assert(0x100 * sizeof(gsize) == usage.shift_tables);
+    assert(0 == usage.nodes + usage.edges + usage.buffers);
+    SundayMatcher_free(sunday);
+
+    usage = (MemoryUsage) MEMORYUSAGE_INIT;
+    BoyerMooreMatcher *bm = BoyerMooreMatcher_new("needle");
+    BoyerMooreMatcher_memoryUsage(bm, &usage);
+    assert(0 == usage.patterns);
+    assert(0 < usage.shift_tables);
+    BoyerMooreMatcher_free(bm);
+
+    usage = (MemoryUsage) MEMORYUSAGE_INIT;
+    glong patternlen = 0;
+    gunichar2 *pattern = g_utf8_to_utf16("いろは", -1L, NULL, &patternlen, NULL);
+    UnicodeBoyerMooreMatcher *ubm = UnicodeBoyerMooreMatcher_new(pattern, patternlen);
+    UnicodeBoyerMooreMatcher_memoryUsage(ubm, &usage);
+    // UTF-16 のパターンと、NUL 終端した UTF-8 のパターン
+    assert(sizeof(gunichar2) * 3 + 10 == usage.patterns);
+    assert(0 == usage.buffers);
+    UnicodeBoyerMooreMatcher_free(ubm);
+
+    usage = (MemoryUsage) MEMORYUSAGE_INIT;
+    UnicodeTwoWayMatcher *utw = UnicodeTwoWayMatcher_new(pattern, patternlen);
+    UnicodeTwoWayMatcher_memoryUsage(utw, &usage);
+    assert(sizeof(gunichar2) * 3 == usage.patterns);
+    assert(0 == usage.shift_tables);
+    UnicodeTwoWayMatcher_free(utw);
+    g_free(pattern);
+
+    usage = (MemoryUsage) MEMORYUSAGE_INIT;
+    TwoWayMatcher *tw = TwoWayMatcher_new("needle", -1L);
+    TwoWayMatcher_memoryUsage(tw, &usage);
+    assert(7 == usage.patterns);
+    TwoWayMatcher_free(tw);
+}
+
+/**
+ * Matcher はキーワードの複製に、コンパイルしたエンジンの使用量を加える
+ */
+static void
+testMatcher()
+{
+    Matcher *matcher = Matcher_new();
+    assert(Matcher_addKeyword(matcher, "abc", -1L, NULL));
+    assert(Matcher_addKeyword(matcher, "bcd", -1L, NULL));
+    assert(Matcher_addKeyword(matcher, "abc", -1L, NULL));
+    assert(2 == Matcher_getKeywordCount(matcher));
+    MemoryUsage keywords_only = MEMORYUSAGE_INIT;
+    Matcher_memoryUsage(matcher, &keywords_only);
+    assert(0 < keywords_only.patterns);
+    assert(0 == keywords_only.shift_tables);
+
+    // 単一パターンのエンジンはキーワードごとのシフト表を持つ
+    assert(Matcher_compile(matcher, MATCHER_ENGINE_SUNDAY, NULL));
+    MemoryUsage sunday = MEMORYUSAGE_INIT;
+    Matcher_memoryUsage(matcher, &sunday);
+    assert(2 * 0x100 * sizeof(gsize) == sunday.shift_tables);
+    assert(keywords_only.patterns + 2 * 4 == sunday.patterns);
+
+    assert(Matcher_compile(matcher, MATCHER_ENGINE_UNICODE_COMMENTZ_WALTER, NULL));
+    MemoryUsage cw = MEMORYUSAGE_INIT;
+    Matcher_memoryUsage(matcher, &cw);
+    assert(0x10000 * sizeof(guint) == cw.shift_tables);
+    assert(0 < cw.nodes);
+
+    assert(Matcher_compile(matcher, MATCHER_ENGINE_AHO_CORASICK, NULL));
+    MemoryUsage ac = MEMORYUSAGE_INIT;
+    Matcher_memoryUsage(matcher, &ac);
+    assert(0 == ac.shift_tables);
+    assert(keywords_only.patterns == ac.patterns);
+    assert(MemoryUsage_getTotal(&ac) < MemoryUsage_getTotal(&cw));
+    Matcher_free(matcher);
+}
+
+int
+main(int argc, char **argv)
+{
+    testTotal();
+    testCommentzWalter();
+    testUnicodeCommentzWalter();
+    testAhoCorasick();
+    testSinglePattern();
+    testMatcher();
+    return 0;
+}
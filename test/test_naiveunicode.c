@@ -0,0 +1,71 @@
+#include <assert.h>
+#include <string.h>
+#include <glib.h>
+#include "naiveunicode.h"
+
+/**
+ * 日本語文字列の検索をテストする
+ */
+static void
+testJapaneseTextScan()
+{
+    static const gchar *text_tbl[] = {
+        "インターネット",
+        "ンターネット", "インターネッ", "インタネット", "インタアネット",
+        "株式会社インターネットイニシアティブ",
+        "株式会社ンターネットイニシアティブ", "株式会社インターネッイニシアティブ",
+        "株式会社インタネットイニシアティブ", "株式会社インタアネットイニシアティブ",
+        "イターネットインーネットインターネットインターットインターネト",
+        "イターネットインーネットインタアネットインターットインターネト",
+        NULL,
+    };
+    static const gboolean expected_tbl[] = {
+        TRUE,
+        FALSE, FALSE, FALSE, FALSE,
+        TRUE,
+        FALSE, FALSE,
+        FALSE, FALSE,
+        TRUE,
+        FALSE
+    };
+    const gchar **texts_iter = text_tbl;
+    const gboolean *expecteds_iter = expected_tbl;
+    for (; NULL != *texts_iter; ++texts_iter, ++expecteds_iter) {
+        assert(*expecteds_iter == UnicodeNaiveMatcher_scan("インターネット", *texts_iter));
+#ifdef __SSE2__
+        assert(*expecteds_iter == UnicodeNaiveMatcher_scanWithSIMD("インターネット", *texts_iter));
+#endif // __SSE2__
+    }
+}
+
+/**
+ * 文書中の全ての位置にキーワードを置いた場合の検索をテストする
+ * 下位バイトだけが一致する文字 (U+3042 と U+3142) で文書を埋めて、誤検出がないことも確かめる
+ */
+static void
+testEveryPositionScan()
+{
+    for (gsize n_chars = 1; n_chars < 100; ++n_chars) {
+        for (gsize position = 0; position < n_chars; ++position) {
+            GString *document = g_string_new(NULL);
+            for (gsize i = 0; i < n_chars; ++i) {
+                g_string_append(document, (i == position) ? "あ" : "ㅂ");
+            }
+            assert(UnicodeNaiveMatcher_scan("あ", document->str));
+#ifdef __SSE2__
+            assert(UnicodeNaiveMatcher_scanWithSIMD("あ", document->str));
+            document->str[document->len - 3 * (n_chars - position)] = '\0';
+            assert(!UnicodeNaiveMatcher_scanWithSIMD("あ", document->str));
+#endif // __SSE2__
+            g_string_free(document, TRUE);
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    testJapaneseTextScan();
+    testEveryPositionScan();
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <assert.h>
+#include <string.h>
+#include <glib.h>
+#include "nodearena.h"
+
+/**
+ * 切り出した領域が 0 で初期化され、境界が揃い、互いに重ならないことをテストする
+ */
+static void
+testAlloc()
+{
+    NodeArena *arena = NodeArena_new();
+    gsize initial_bytes = NodeArena_getAllocatedBytes(arena);
+    GPtrArray *blocks = g_ptr_array_new();
+    for (gsize i = 0; i < 2000; ++i) {
+        // チャンクより大きな領域も混ぜる
+        gsize size = (0 == i % 500) ? 3 * 1024 * 1024 : 1 + i % 300;
+        guint8 *block = (guint8 *) NodeArena_alloc0(arena, size);
+        assert(0 == (GPOINTER_TO_SIZE(block) % 16));
+        for (gsize j = 0; j < size; ++j) {
+            assert(0 == block[j]);
+        }
+        memset(block, (guint8) i, size);
+        g_ptr_array_add(blocks, block);
+    }
+    for (gsize i = 0; i < blocks->len; ++i) {
+        gsize size = (0 == i % 500) ? 3 * 1024 * 1024 : 1 + i % 300;
+        const guint8 *block = (const guint8 *) g_ptr_array_index(blocks, i);
+        for (gsize j = 0; j < size; ++j) {
+            assert((guint8) i == block[j]);
+        }
+    }
+    assert(initial_bytes + 4 * 3 * 1024 * 1024 < NodeArena_getAllocatedBytes(arena));
+
+    const gchar word[] = "internet";
+    gchar *copied = (gchar *) NodeArena_memdup(arena, word, sizeof(word));
+    assert(word != copied);
+    assert(0 == strcmp(word, copied));
+
+    g_ptr_array_free(blocks, TRUE);
+    NodeArena_free(arena);
+    NodeArena_free(NULL);
+}
+
+/**
+ * 子ノードの表を GHashTable と比較する
+ */
+static void
+testEdges()
+{
+    NodeArena *arena = NodeArena_new();
+    NodeArenaEdges edges;
+    memset(&edges, 0, sizeof(edges));
+    assert(NULL == NodeArenaEdges_lookup(&edges, 0));
+
+    GHashTable *expected = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GRand *rand = g_rand_new_with_seed(36);
+    for (gsize i = 0; i < 5000; ++i) {
+        gunichar2 label = (gunichar2) g_rand_int_range(rand, 0, 0x10000);
+        if (NULL != g_hash_table_lookup(expected, GINT_TO_POINTER(label))) {
+            continue;
+        }
+        gpointer node = NodeArena_alloc0(arena, 1);
+        NodeArenaEdges_insert(&edges, arena, label, node);
+        g_hash_table_insert(expected, GINT_TO_POINTER(label), node);
+    }
+    assert(g_hash_table_size(expected) == edges.size);
+    for (guint i = 1; i < edges.size; ++i) {
+        assert(edges.labels[i - 1] < edges.labels[i]);
+    }
+    for (guint label = 0; label < 0x10000; ++label) {
+        assert(g_hash_table_lookup(expected, GINT_TO_POINTER(label)) == NodeArenaEdges_lookup(&edges, (gunichar2) label));
+    }
+    g_rand_free(rand);
+    g_hash_table_destroy(expected);
+    NodeArena_free(arena);
+}
+
+int
+main(int argc, char **argv)
+{
+    testAlloc();
+    testEdges();
+    return 0;
+}
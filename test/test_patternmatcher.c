@@ -0,0 +1,338 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "patternmatcher.h"
+
+#define UNBOUNDED G_MAXSIZE
+#define MAX_PIECES 4
+
+/**
+ * 総当たりで照合するために、パターンを組み立てた断片と隙間
+ */
+typedef struct Pattern {
+    const gchar *pieces[MAX_PIECES];
+    gsize min_gaps[MAX_PIECES]; /* min_gaps[i] は pieces[i - 1] と pieces[i] の間の隙間 */
+    gsize max_gaps[MAX_PIECES];
+    gsize n_pieces;
+} Pattern;
+
+typedef struct Found {
+    guint pattern;
+    gsize offset;
+    gsize length;
+} Found;
+
+typedef struct Collector {
+    GArray *found;   /* 要素は Found */
+    gsize limit;     /* この件数を受け取ったら走査を打ち切る */
+} Collector;
+
+static gboolean
+collectFound(guint pattern, gsize offset, gsize length, gpointer user_data)
+{
+    Collector *collector = (Collector *) user_data;
+    Found found = {pattern, offset, length};
+    g_array_append_val(collector->found, found);
+    return collector->found->len < collector->limit;
+}
+
+static int
+Found_compare(const void *a, const void *b)
+{
+    const Found *x = (const Found *) a;
+    const Found *y = (const Found *) b;
+    if (x->offset + x->length != y->offset + y->length) {
+        return (x->offset + x->length < y->offset + y->length) ? -1 : 1;
+    }
+    if (x->pattern != y->pattern) {
+        return (x->pattern < y->pattern) ? -1 : 1;
+    }
+    return (x->offset < y->offset) ? -1 : (x->offset > y->offset);
+}
+
+/**
+ * パターンを書き方に沿った文字列にする
+ */
+static gchar *
+Pattern_format(const Pattern *self)
+{
+    GString *pattern = g_string_new(self->pieces[0]);
+    for (gsize i = 1; i < self->n_pieces; ++i) {
+        if (UNBOUNDED == self->max_gaps[i]) {
+            g_string_append_printf(pattern, (0 == self->min_gaps[i]) ? "*" : ".{%lu,}",
+                                   (unsigned long) self->min_gaps[i]);
+        } else if (1 == self->min_gaps[i] && 1 == self->max_gaps[i]) {
+            g_string_append(pattern, "?");
+        } else {
+            g_string_append_printf(pattern, ".{%lu,%lu}", (unsigned long) self->min_gaps[i],
+                                   (unsigned long) self->max_gaps[i]);
+        }
+        g_string_append(pattern, self->pieces[i]);
+    }
+    return g_string_free(pattern, FALSE);
+}
+
+/**
+ * 文字位置 position で pieces[index] が始まるとき、先頭の断片まで条件を満たして遡れる最も後ろの開始位置を返す
+ * 遡れなければ -1 を返す。memo は断片と文字位置ごとの結果で、まだ求めていなければ -2
+ */
+static glong
+Pattern_findStart(const Pattern *self, const gchar **chars, gsize n_chars, gsize index, gsize position, glong *memo)
+{
+    glong *result = &memo[index * (n_chars + 1) + position];
+    if (-2 != *result) {
+        return *result;
+    }
+    *result = -1;
+    if (0 == index) {
+        *result = position;
+        return *result;
+    }
+    gsize prev_chars = g_utf8_strlen(self->pieces[index - 1], -1);
+    gsize prev_len = strlen(self->pieces[index - 1]);
+    for (gsize end = 0; end <= position; ++end) {
+        gsize gap = position - end;
+        if (end < prev_chars || gap < self->min_gaps[index] || self->max_gaps[index] < gap) {
+            continue;
+        }
+        gsize start = end - prev_chars;
+        if (chars[start] + prev_len <= chars[n_chars] &&
+            0 == memcmp(chars[start], self->pieces[index - 1], prev_len)) {
+            *result = MAX(*result, Pattern_findStart(self, chars, n_chars, index - 1, start, memo));
+        }
+    }
+    return *result;
+}
+
+/**
+ * 最後の断片の出現ごとに、条件を満たす最も短い一致を総当たりで求める
+ */
+static void
+findByBruteForce(const Pattern *patterns, gsize n_patterns, const gchar *text, GArray *result)
+{
+    GPtrArray *positions = g_ptr_array_new();
+    for (const gchar *iter = text; ; iter = g_utf8_next_char(iter)) {
+        g_ptr_array_add(positions, (gpointer) iter);
+        if ('\0' == *iter) {
+            break;
+        }
+    }
+    const gchar **chars = (const gchar **) positions->pdata;
+    gsize n_chars = positions->len - 1;
+    glong *memo = g_new(glong, MAX_PIECES * (n_chars + 1));
+    for (gsize p = 0; p < n_patterns; ++p) {
+        const Pattern *pattern = &patterns[p];
+        for (gsize i = 0; i < MAX_PIECES * (n_chars + 1); ++i) {
+            memo[i] = -2;
+        }
+        const gchar *last = pattern->pieces[pattern->n_pieces - 1];
+        gsize last_len = strlen(last);
+        for (gsize position = 0; position < n_chars; ++position) {
+            if (chars[position] + last_len > chars[n_chars] || 0 != memcmp(chars[position], last, last_len)) {
+                continue;
+            }
+            glong start = Pattern_findStart(pattern, chars, n_chars, pattern->n_pieces - 1, position, memo);
+            if (0 <= start) {
+                Found found = {p, chars[start] - text, chars[position] + last_len - chars[start]};
+                g_array_append_val(result, found);
+            }
+        }
+    }
+    g_free(memo);
+    g_ptr_array_free(positions, TRUE);
+    qsort(result->data, result->len, sizeof(Found), Found_compare);
+}
+
+static PatternMatcher *
+newPatternMatcher(const gchar **patterns, gsize n_patterns, MatcherEngine engine)
+{
+    PatternMatcher *matcher = PatternMatcher_new();
+    for (gsize i = 0; i < n_patterns; ++i) {
+        assert(PatternMatcher_addPattern(matcher, patterns[i], -1L, NULL));
+    }
+    assert(PatternMatcher_compile(matcher, engine, NULL));
+    return matcher;
+}
+
+static const MatcherEngine engines[] = {
+    MATCHER_ENGINE_COMMENTZ_WALTER,
+    MATCHER_ENGINE_UNICODE_COMMENTZ_WALTER,
+    MATCHER_ENGINE_AHO_CORASICK,
+    MATCHER_ENGINE_AUTO,
+};
+
+/**
+ * 書き方の例どおりの範囲が報告される
+ */
+static void
+testFixedPatterns()
+{
+    static const gchar *patterns[] = {"error.{0,20}timeout", "user=*;token", "エラー.{1,3}切れ", "a\\.b\\*", "x?y"};
+    static const gchar *text = "error: read timeout\n"
+                               "error: the connection was closed before timeout\n"
+                               "user=alice; id=1;token=xyz\n"
+                               "エラー:時間切れ エラー切れ\n"
+                               "a.b* axb* xzy xy";
+    static const Found expected[] = {
+        {0, 0, 19},   /* error: read timeout */
+        {1, 68, 22},  /* user=alice; id=1;token */
+        {2, 95, 22},  /* エラー:時間切れ */
+        {3, 134, 4},  /* a.b* */
+        {4, 144, 3},  /* xzy */
+    };
+    for (gsize e = 0; e < G_N_ELEMENTS(engines); ++e) {
+        PatternMatcher *matcher = newPatternMatcher(patterns, G_N_ELEMENTS(patterns), engines[e]);
+        assert(G_N_ELEMENTS(patterns) == PatternMatcher_getPatternCount(matcher));
+        assert(NULL != PatternMatcher_getEngineName(matcher));
+        Collector collector = {g_array_new(FALSE, FALSE, sizeof(Found)), G_MAXSIZE};
+        assert(PatternMatcher_scanAll(matcher, text, -1L, collectFound, &collector, NULL));
+        assert(G_N_ELEMENTS(expected) == collector.found->len);
+        for (gsize i = 0; i < G_N_ELEMENTS(expected); ++i) {
+            const Found *found = &g_array_index(collector.found, Found, i);
+            assert(0 == Found_compare(&expected[i], found));
+        }
+        g_array_free(collector.found, TRUE);
+        PatternMatcher_free(matcher);
+    }
+}
+
+/**
+ * ランダムなパターンとテキストで、総当たりと同じ一致が末尾の位置の順に報告される
+ * 同じ断片が複数のパターンや1つのパターンの中に何度も現れてもよい
+ */
+static void
+testRandomPatterns()
+{
+    static const gchar *alphabet[] = {"a", "b", "あ"};
+    static const gchar *pieces[] = {"a", "b", "ab", "ba", "あ", "aあ", "bb"};
+    GRand *rand = g_rand_new_with_seed(49);
+    for (gsize e = 0; e < G_N_ELEMENTS(engines); ++e) {
+        for (gint round = 0; round < 200; ++round) {
+            Pattern patterns[4];
+            gchar *formatted[G_N_ELEMENTS(patterns)];
+            gsize n_patterns = g_rand_int_range(rand, 1, G_N_ELEMENTS(patterns) + 1);
+            for (gsize p = 0; p < n_patterns; ++p) {
+                Pattern *pattern = &patterns[p];
+                pattern->n_pieces = g_rand_int_range(rand, 1, MAX_PIECES + 1);
+                for (gsize i = 0; i < pattern->n_pieces; ++i) {
+                    pattern->pieces[i] = pieces[g_rand_int_range(rand, 0, G_N_ELEMENTS(pieces))];
+                    pattern->min_gaps[i] = g_rand_int_range(rand, 0, 3);
+                    pattern->max_gaps[i] = (0 == g_rand_int_range(rand, 0, 4))
+                        ? UNBOUNDED : pattern->min_gaps[i] + g_rand_int_range(rand, 0, 4);
+                }
+                formatted[p] = Pattern_format(pattern);
+            }
+            GString *text = g_string_new(NULL);
+            gint textlen = g_rand_int_range(rand, 0, 40);
+            for (gint i = 0; i < textlen; ++i) {
+                g_string_append(text, alphabet[g_rand_int_range(rand, 0, G_N_ELEMENTS(alphabet))]);
+            }
+
+            GArray *expected = g_array_new(FALSE, FALSE, sizeof(Found));
+            findByBruteForce(patterns, n_patterns, text->str, expected);
+            PatternMatcher *matcher = newPatternMatcher((const gchar **) formatted, n_patterns, engines[e]);
+            Collector collector = {g_array_new(FALSE, FALSE, sizeof(Found)), G_MAXSIZE};
+            assert(PatternMatcher_scanAll(matcher, text->str, text->len, collectFound, &collector, NULL));
+            for (guint i = 1; i < collector.found->len; ++i) {
+                const Found *prev = &g_array_index(collector.found, Found, i - 1);
+                const Found *found = &g_array_index(collector.found, Found, i);
+                assert(prev->offset + prev->length <= found->offset + found->length);
+            }
+            qsort(collector.found->data, collector.found->len, sizeof(Found), Found_compare);
+            assert(expected->len == collector.found->len);
+            for (guint i = 0; i < expected->len; ++i) {
+                assert(0 == Found_compare(&g_array_index(expected, Found, i),
+                                          &g_array_index(collector.found, Found, i)));
+            }
+
+            // 最初の報告で打ち切れる
+            g_array_set_size(collector.found, 0);
+            collector.limit = 1;
+            assert(PatternMatcher_scanAll(matcher, text->str, text->len, collectFound, &collector, NULL));
+            assert(MIN(expected->len, 1) == collector.found->len);
+
+            g_array_free(collector.found, TRUE);
+            PatternMatcher_free(matcher);
+            g_array_free(expected, TRUE);
+            g_string_free(text, TRUE);
+            for (gsize p = 0; p < n_patterns; ++p) {
+                g_free(formatted[p]);
+            }
+        }
+    }
+    g_rand_free(rand);
+}
+
+/**
+ * 次の断片が現れない長いテキストでも、隙間の範囲を越えて並びを溜めずに走査し終える
+ */
+static void
+testLongText()
+{
+    static const gchar *patterns[] = {"a.{0,3}b", "a*c", "ab.{2}ab"};
+    GString *text = g_string_new(NULL);
+    for (gint i = 0; i < 200000; ++i) {
+        g_string_append(text, (0 == i % 1000) ? "b" : "a");
+    }
+    g_string_append(text, "c");
+    PatternMatcher *matcher = newPatternMatcher(patterns, G_N_ELEMENTS(patterns), MATCHER_ENGINE_AUTO);
+    Collector collector = {g_array_new(FALSE, FALSE, sizeof(Found)), G_MAXSIZE};
+    assert(PatternMatcher_scanAll(matcher, text->str, text->len, collectFound, &collector, NULL));
+    // "a.{0,3}b" は b の手前の4文字から、"a*c" は最後の c までの最も短い範囲
+    assert(199 + 1 == collector.found->len);
+    const Found *last = &g_array_index(collector.found, Found, collector.found->len - 1);
+    assert(1 == last->pattern && text->len - 2 == last->offset && 2 == last->length);
+    g_array_free(collector.found, TRUE);
+    PatternMatcher_free(matcher);
+    g_string_free(text, TRUE);
+}
+
+/**
+ * 書き方の誤ったパターンや、末尾の位置の順に報告しないエンジンの指定がエラーになる
+ */
+static void
+testErrors()
+{
+    static const gchar *invalid[] = {
+        "", ".abc", "*abc", "abc?", "abc.{1,2}", "a.{3,2}b", "a.{x}b", "a.{1,2b", "a.{,2}b", "a\\", "a\xff",
+        "a.{99999999999}b",
+    };
+    GError *error = NULL;
+    PatternMatcher *matcher = PatternMatcher_new();
+    for (gsize i = 0; i < G_N_ELEMENTS(invalid); ++i) {
+        assert(!PatternMatcher_addPattern(matcher, invalid[i], -1L, &error));
+        assert(g_error_matches(error, PATTERN_MATCHER_ERROR, PATTERN_MATCHER_ERROR_INVALID_PATTERN));
+        g_clear_error(&error);
+    }
+    assert(0 == PatternMatcher_getPatternCount(matcher));
+    assert(!PatternMatcher_compile(matcher, MATCHER_ENGINE_AUTO, &error));
+    assert(g_error_matches(error, PATTERN_MATCHER_ERROR, PATTERN_MATCHER_ERROR_NO_PATTERN));
+    g_clear_error(&error);
+
+    assert(PatternMatcher_addPattern(matcher, "a.{2}b", -1L, NULL));
+    assert(!PatternMatcher_compile(matcher, MATCHER_ENGINE_SUNDAY, &error));
+    assert(g_error_matches(error, MATCHER_ERROR, MATCHER_ERROR_UNSUPPORTED_ENGINE));
+    g_clear_error(&error);
+    PatternMatcher_free(matcher);
+
+    // 断片が1つだけなら Matcher は単一パターンのエンジンを選ぶが、自動選択では複数パターンのエンジンにする
+    matcher = PatternMatcher_new();
+    assert(PatternMatcher_addPattern(matcher, "abc", -1L, NULL));
+    Collector collector = {g_array_new(FALSE, FALSE, sizeof(Found)), G_MAXSIZE};
+    assert(PatternMatcher_scanAll(matcher, "abc xabc", -1L, collectFound, &collector, NULL));
+    assert(0 == strcmp(MatcherEngine_getName(MATCHER_ENGINE_AHO_CORASICK), PatternMatcher_getEngineName(matcher)));
+    assert(2 == collector.found->len);
+    g_array_free(collector.found, TRUE);
+    PatternMatcher_free(matcher);
+}
+
+int
+main(int argc, char **argv)
+{
+    testFixedPatterns();
+    testRandomPatterns();
+    testLongText();
+    testErrors();
+    return 0;
+}
@@ -0,0 +1,281 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "matcher.h"
+#include "scanscheduler.h"
+
+#define N_DOCUMENTS 500
+
+static const gchar *keywords[] = {"abc", "bca", "インター", "ネット"};
+
+typedef struct Document {
+    gchar *text;
+    gsize textlen;
+    gsize expected;  /* Matcher_scanAll で数えた件数 */
+    gint n_calls;    /* func が呼ばれた回数 */
+    gsize n_matches; /* func に渡された件数 */
+    gboolean failed;
+} Document;
+
+/**
+ * 先頭の文書を走査したワーカーを、残りの文書がすべて終わるまで止めておくための状態
+ */
+typedef struct Blocker {
+    GMutex mutex;
+    GCond cond;
+    Document *blocked;
+    gint n_done;
+    gint n_total;
+} Blocker;
+
+static gboolean
+countMatch(const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    ++(*(gsize *) user_data);
+    return TRUE;
+}
+
+static void
+onScanned(gpointer document, const ScanSchedulerMatch *matches, gsize n_matches, const GError *error, gpointer user_data)
+{
+    Document *doc = (Document *) document;
+    for (gsize i = 0; i < n_matches; ++i) {
+        assert(0 == memcmp(doc->text + matches[i].offset, matches[i].keyword, matches[i].keywordlen));
+    }
+    doc->n_matches = n_matches;
+    doc->failed = (NULL != error);
+    g_atomic_int_inc(&doc->n_calls);
+
+    Blocker *blocker = (Blocker *) user_data;
+    if (NULL == blocker) {
+        return;
+    }
+    g_mutex_lock(&blocker->mutex);
+    if (doc == blocker->blocked) {
+        while (blocker->n_done < blocker->n_total - 1) {
+            g_cond_wait(&blocker->cond, &blocker->mutex);
+        }
+    } else {
+        ++blocker->n_done;
+        g_cond_broadcast(&blocker->cond);
+    }
+    g_mutex_unlock(&blocker->mutex);
+}
+
+static Matcher *
+newMatcher(MatcherEngine engine)
+{
+    Matcher *matcher = Matcher_new();
+    for (gsize i = 0; i < G_N_ELEMENTS(keywords); ++i) {
+        assert(Matcher_addKeyword(matcher, keywords[i], -1L, NULL));
+    }
+    assert(Matcher_compile(matcher, engine, NULL));
+    return matcher;
+}
+
+/**
+ * 大きさが 1 バイトから数万バイトまでばらつく文書を作る
+ */
+static void
+makeDocuments(Matcher *matcher, Document *documents, gsize n_documents)
+{
+    static const gchar *pieces[] = {"a", "b", "c", "abc", "インター", "ネット", " "};
+    for (gsize i = 0; i < n_documents; ++i) {
+        GString *text = g_string_new(NULL);
+        gsize n_pieces = (0 == i % 50) ? 20000 : (gsize) (rand() % 40);
+        for (gsize j = 0; j < n_pieces; ++j) {
+            g_string_append(text, pieces[rand() % G_N_ELEMENTS(pieces)]);
+        }
+        documents[i].textlen = text->len;
+        documents[i].text = g_string_free(text, FALSE);
+        documents[i].expected = 0;
+        documents[i].n_calls = 0;
+        documents[i].n_matches = 0;
+        documents[i].failed = FALSE;
+        assert(Matcher_scanAll(matcher, documents[i].text, documents[i].textlen, countMatch,
+                               &documents[i].expected, NULL));
+    }
+}
+
+static void
+freeDocuments(Document *documents, gsize n_documents)
+{
+    for (gsize i = 0; i < n_documents; ++i) {
+        g_free(documents[i].text);
+    }
+}
+
+/**
+ * どのエンジンでも、すべての文書がちょうど1回ずつ走査され、Matcher_scanAll と同じ件数が報告される
+ * 待ち合わせた後も続けて投入できる
+ */
+static void
+testScanDocuments()
+{
+    static const MatcherEngine engines[] = {
+        MATCHER_ENGINE_SUNDAY,
+        MATCHER_ENGINE_BOYER_MOORE,
+        MATCHER_ENGINE_UNICODE_COMMENTZ_WALTER,
+        MATCHER_ENGINE_AHO_CORASICK,
+    };
+    for (gsize e = 0; e < G_N_ELEMENTS(engines); ++e) {
+        Matcher *matcher = newMatcher(engines[e]);
+        Document documents[N_DOCUMENTS];
+        makeDocuments(matcher, documents, N_DOCUMENTS);
+        ScanScheduler *scheduler = ScanScheduler_new(matcher, 4, onScanned, NULL, NULL);
+        assert(NULL != scheduler);
+        assert(4 == ScanScheduler_getWorkerCount(scheduler));
+        for (gsize round = 0; round < 2; ++round) {
+            for (gsize i = 0; i < N_DOCUMENTS; ++i) {
+                ScanScheduler_submit(scheduler, documents[i].text, documents[i].textlen, &documents[i]);
+            }
+            ScanScheduler_wait(scheduler);
+            for (gsize i = 0; i < N_DOCUMENTS; ++i) {
+                assert(round + 1 == (gsize) documents[i].n_calls);
+                assert(!documents[i].failed);
+                assert(documents[i].expected == documents[i].n_matches);
+            }
+        }
+        ScanScheduler_free(scheduler);
+        freeDocuments(documents, N_DOCUMENTS);
+        Matcher_free(matcher);
+    }
+}
+
+/**
+ * 1つのワーカーが止まっていても、そのキューに残った文書は他のワーカーが盗んで走査する
+ */
+static void
+testStealFromBlockedWorker()
+{
+    Matcher *matcher = newMatcher(MATCHER_ENGINE_AHO_CORASICK);
+    Document documents[N_DOCUMENTS];
+    makeDocuments(matcher, documents, N_DOCUMENTS);
+    Blocker blocker;
+    g_mutex_init(&blocker.mutex);
+    g_cond_init(&blocker.cond);
+    blocker.blocked = &documents[0];
+    blocker.n_done = 0;
+    blocker.n_total = N_DOCUMENTS;
+    ScanScheduler *scheduler = ScanScheduler_new(matcher, 2, onScanned, &blocker, NULL);
+    assert(NULL != scheduler);
+    for (gsize i = 0; i < N_DOCUMENTS; ++i) {
+        ScanScheduler_submit(scheduler, documents[i].text, documents[i].textlen, &documents[i]);
+    }
+    ScanScheduler_wait(scheduler);
+    assert(N_DOCUMENTS - 1 == blocker.n_done);
+    assert(0 < ScanScheduler_getStealCount(scheduler));
+    for (gsize i = 0; i < N_DOCUMENTS; ++i) {
+        assert(1 == documents[i].n_calls);
+        assert(documents[i].expected == documents[i].n_matches);
+    }
+    ScanScheduler_free(scheduler);
+    g_cond_clear(&blocker.cond);
+    g_mutex_clear(&blocker.mutex);
+    freeDocuments(documents, N_DOCUMENTS);
+    Matcher_free(matcher);
+}
+
+/**
+ * コンパイルしたばかりで一度も走査していない Aho-Corasick のマッチャーを複数のワーカーで同時に走査しても、
+ * 別のマッチャーで数えた件数と一致する。失敗遷移はコンパイルのときに求めるので、走査はオートマトンを読むだけになる
+ */
+static void
+testFreshAhoCorasick()
+{
+    static const gchar *letters[] = {"a", "b", "c", "イ", "ン"};
+    GPtrArray *fresh_keywords = g_ptr_array_new_with_free_func(g_free);
+    for (gsize length = 4; length <= 5; ++length) {
+        gsize n_keywords = 1;
+        for (gsize i = 0; i < length; ++i) {
+            n_keywords *= G_N_ELEMENTS(letters);
+        }
+        for (gsize n = 0; n < n_keywords; ++n) {
+            GString *keyword = g_string_new(NULL);
+            for (gsize i = 0, rest = n; i < length; ++i, rest /= G_N_ELEMENTS(letters)) {
+                g_string_append(keyword, letters[rest % G_N_ELEMENTS(letters)]);
+            }
+            g_ptr_array_add(fresh_keywords, g_string_free(keyword, FALSE));
+        }
+    }
+    Matcher *reference = Matcher_new();
+    for (guint i = 0; i < fresh_keywords->len; ++i) {
+        assert(Matcher_addKeyword(reference, (const gchar *) g_ptr_array_index(fresh_keywords, i), -1L, NULL));
+    }
+    assert(Matcher_compile(reference, MATCHER_ENGINE_UNICODE_COMMENTZ_WALTER, NULL));
+    Document documents[64];
+    makeDocuments(reference, documents, G_N_ELEMENTS(documents));
+    for (gsize round = 0; round < 30; ++round) {
+        Matcher *matcher = Matcher_new();
+        for (guint i = 0; i < fresh_keywords->len; ++i) {
+            assert(Matcher_addKeyword(matcher, (const gchar *) g_ptr_array_index(fresh_keywords, i), -1L, NULL));
+        }
+        assert(Matcher_compile(matcher, MATCHER_ENGINE_AHO_CORASICK, NULL));
+        ScanScheduler *scheduler = ScanScheduler_new(matcher, 8, onScanned, NULL, NULL);
+        assert(NULL != scheduler);
+        const gchar *texts[G_N_ELEMENTS(documents)];
+        gsize textlens[G_N_ELEMENTS(documents)];
+        gpointer pointers[G_N_ELEMENTS(documents)];
+        for (gsize i = 0; i < G_N_ELEMENTS(documents); ++i) {
+            documents[i].n_calls = 0;
+            texts[i] = documents[i].text;
+            textlens[i] = documents[i].textlen;
+            pointers[i] = &documents[i];
+        }
+        ScanScheduler_submitMany(scheduler, texts, textlens, pointers, G_N_ELEMENTS(documents));
+        ScanScheduler_wait(scheduler);
+        for (gsize i = 0; i < G_N_ELEMENTS(documents); ++i) {
+            assert(1 == documents[i].n_calls);
+            assert(!documents[i].failed);
+            assert(documents[i].expected == documents[i].n_matches);
+        }
+        ScanScheduler_free(scheduler);
+        Matcher_free(matcher);
+    }
+    freeDocuments(documents, G_N_ELEMENTS(documents));
+    Matcher_free(reference);
+    g_ptr_array_free(fresh_keywords, TRUE);
+}
+
+/**
+ * 走査に失敗した文書はエラーとともに報告され、他の文書の走査は続く
+ * コンパイルしていない Matcher は自動選択でコンパイルする
+ */
+static void
+testErrors()
+{
+    Matcher *matcher = Matcher_new();
+    assert(Matcher_addKeyword(matcher, "abc", -1L, NULL));
+    assert(Matcher_addKeyword(matcher, "インター", -1L, NULL));
+    ScanScheduler *scheduler = ScanScheduler_new(matcher, 0, onScanned, NULL, NULL);
+    assert(NULL != scheduler);
+    assert(0 < ScanScheduler_getWorkerCount(scheduler));
+    assert(MATCHER_ENGINE_AUTO != Matcher_getEngine(matcher));
+    ScanScheduler_free(scheduler);
+
+    assert(Matcher_compile(matcher, MATCHER_ENGINE_AHO_CORASICK, NULL));
+    scheduler = ScanScheduler_new(matcher, 2, onScanned, NULL, NULL);
+    Document invalid = {g_strdup("abc\xff"), 4, 0, 0, 0, FALSE};
+    Document valid = {g_strdup("abcabc"), 6, 2, 0, 0, FALSE};
+    ScanScheduler_submit(scheduler, invalid.text, invalid.textlen, &invalid);
+    ScanScheduler_submit(scheduler, valid.text, valid.textlen, &valid);
+    ScanScheduler_wait(scheduler);
+    assert(1 == invalid.n_calls && invalid.failed && 0 == invalid.n_matches);
+    assert(1 == valid.n_calls && !valid.failed && 2 == valid.n_matches);
+    ScanScheduler_free(scheduler);
+    g_free(valid.text);
+    g_free(invalid.text);
+    Matcher_free(matcher);
+}
+
+int
+main(int argc, char **argv)
+{
+    srand(0);
+    testScanDocuments();
+    testStealFromBlockedWorker();
+    testFreshAhoCorasick();
+    testErrors();
+    return 0;
+}
@@ -0,0 +1,262 @@
+#include <assert.h>
+#include <string.h>
+#include <glib.h>
+#include "ahocorasickunicode.h"
+#include "boyermoore.h"
+#include "boyermooreunicode.h"
+#include "commentzwalter.h"
+#include "commentzwalterunicode.h"
+#include "matcher.h"
+#include "scanstats.h"
+#include "sunday.h"
+
+// STRING_MATCHING_STATS を定義してビルドする
+
+/**
+ * パターンに含まれない文字だけのテキスト
+ * どのエンジンも各照合位置で末尾の1文字だけを比較し、パターン長 (Sunday は +1) ずつシフトする
+ */
+#define MISS_TEXT "xxxxxxxxx"
+
+/**
+ * ヒストグラムと規則ごとの回数の合計がシフトの回数と一致することを確かめる
+ */
+static void
+assertConsistent(const ScanStats *stats)
+{
+    guint64 n_histogram = 0;
+    for (gsize i = 0; i < SCANSTATS_N_SHIFT_BUCKETS; ++i) {
+        n_histogram += stats->shift_histogram[i];
+    }
+    guint64 n_rules = 0;
+    guint64 rule_total = 0;
+    for (gsize i = 0; i < SCANSTATS_N_RULES; ++i) {
+        n_rules += stats->n_rule_shifts[i];
+        rule_total += stats->rule_total_shift[i];
+    }
+    assert(stats->n_shifts == n_histogram);
+    assert(stats->n_shifts == n_rules);
+    assert(stats->total_shift == rule_total);
+    assert(stats->n_alignments <= stats->n_compares);
+}
+
+static void
+assertReset(const ScanStats *stats)
+{
+    static const ScanStats zero;
+    assert(0 == memcmp(&zero, stats, sizeof(ScanStats)));
+}
+
+static void
+testSunday()
+{
+    SundayMatcher *matcher = SundayMatcher_new("abc", -1L);
+    const ScanStats *stats = SundayMatcher_getStats(matcher);
+    assert(NULL != stats);
+    assert(!SundayMatcher_scan(matcher, MISS_TEXT, strlen(MISS_TEXT)));
+    assert(1 == stats->n_scans);
+    assert(9 == stats->n_units);
+    assert(2 == stats->n_alignments);
+    assert(2 == stats->n_compares);
+    assert(2 == stats->n_shifts);
+    assert(8 == stats->total_shift);
+    assert(2 == stats->shift_histogram[2]);
+    assert(2 == stats->n_rule_shifts[SCANSTATS_RULE_BAD_CHARACTER]);
+    assert(6 == stats->n_skipped);
+    assert(4.0 == ScanStats_getMeanShift(stats));
+    assertConsistent(stats);
+    SundayMatcher_resetStats(matcher);
+    assertReset(stats);
+    SundayMatcher_free(matcher);
+}
+
+static void
+testBoyerMoore()
+{
+    BoyerMooreMatcher *matcher = BoyerMooreMatcher_new("abc");
+    const ScanStats *stats = BoyerMooreMatcher_getStats(matcher);
+    assert(NULL != stats);
+    assert(!BoyerMooreMatcher_scan(matcher, MISS_TEXT, FALSE));
+    assert(1 == stats->n_scans);
+    assert(3 == stats->n_alignments);
+    assert(3 == stats->n_compares);
+    assert(9 == stats->total_shift);
+    assert(3 == stats->n_rule_shifts[SCANSTATS_RULE_BAD_CHARACTER]);
+    assert(6 == stats->n_skipped);
+    assertConsistent(stats);
+    // パターンが周期的だと good suffix rule が効く
+    BoyerMooreMatcher_resetStats(matcher);
+    BoyerMooreMatcher_updatePattern(matcher, "abab");
+    assert(BoyerMooreMatcher_scan(matcher, "bbabxabab", FALSE));
+    assert(0 < stats->n_rule_shifts[SCANSTATS_RULE_GOOD_SUFFIX]);
+    assertConsistent(stats);
+    BoyerMooreMatcher_free(matcher);
+}
+
+static void
+testUnicodeBoyerMoore()
+{
+    glong patternlen = 0;
+    gunichar2 *pattern = g_utf8_to_utf16("abc", -1L, NULL, &patternlen, NULL);
+    glong textlen = 0;
+    gunichar2 *text = g_utf8_to_utf16(MISS_TEXT, -1L, NULL, &textlen, NULL);
+    UnicodeBoyerMooreMatcher *matcher = UnicodeBoyerMooreMatcher_new(pattern, patternlen);
+    const ScanStats *stats = UnicodeBoyerMooreMatcher_getStats(matcher);
+    assert(NULL != stats);
+    gboolean match = TRUE;
+    UnicodeBoyerMooreMatcher_scanUTF16String(matcher, text, textlen, &match);
+    assert(!match);
+    assert(3 == stats->n_alignments);
+    assert(3 == stats->n_compares);
+    assert(9 == stats->total_shift);
+    assert(6 == stats->n_skipped);
+    assertConsistent(stats);
+    // UTF-8 テキストはバイト単位の Horspool 法で数える
+    UnicodeBoyerMooreMatcher_resetStats(matcher);
+    assert(UnicodeBoyerMooreMatcher_scanUTF8String(matcher, MISS_TEXT, -1L, &match, NULL));
+    assert(!match);
+    assert(1 == stats->n_scans);
+    assert(9 == stats->n_units);
+    assert(3 == stats->n_alignments);
+    assert(3 == stats->n_rule_shifts[SCANSTATS_RULE_BAD_CHARACTER]);
+    assertConsistent(stats);
+    UnicodeBoyerMooreMatcher_free(matcher);
+    g_free(text);
+    g_free(pattern);
+}
+
+static gboolean
+countMatch(gconstpointer output, gsize end_offset, gpointer user_data)
+{
+    ++(*(gint *) user_data);
+    return TRUE;
+}
+
+static void
+testCommentzWalter()
+{
+    CommentzWalterMatcher *matcher = CommentzWalterMatcher_new(64);
+    CommentzWalterMatcher_addKeyword(matcher, "abc", -1L);
+    CommentzWalterMatcher_addKeyword(matcher, "bcd", -1L);
+    const ScanStats *stats = CommentzWalterMatcher_getStats(matcher);
+    assert(NULL != stats);
+    gconstpointer output = NULL;
+    CommentzWalterMatcher_scan(matcher, MISS_TEXT, -1L, &output);
+    assert(NULL == output);
+    // 根でつまずくので chars によるシフトになる
+    assert(3 == stats->n_alignments);
+    assert(3 == stats->n_compares);
+    assert(3 == stats->n_rule_shifts[SCANSTATS_RULE_CHARS]);
+    assert(3.0 == ScanStats_getRuleMeanShift(stats, SCANSTATS_RULE_CHARS));
+    assertConsistent(stats);
+    // キーワードの途中まで一致すると shift1 や shift2 でシフトする
+    CommentzWalterMatcher_resetStats(matcher);
+    gint n_matches = 0;
+    CommentzWalterMatcher_scanAll(matcher, "xbcxabcdxbc", -1L, countMatch, &n_matches);
+    assert(2 == n_matches);
+    assert(1 == stats->n_scans);
+    assert(11 == stats->n_units);
+    assert(0 < stats->n_rule_shifts[SCANSTATS_RULE_SHIFT1] + stats->n_rule_shifts[SCANSTATS_RULE_SHIFT2]);
+    assertConsistent(stats);
+    CommentzWalterMatcher_free(matcher);
+}
+
+static void
+testUnicodeCommentzWalter()
+{
+    UnicodeCommentzWalterMatcher *matcher = UnicodeCommentzWalterMatcher_new(64);
+    assert(UnicodeCommentzWalterMatcher_addKeywordAsUTF8(matcher, "abc", -1L, NULL));
+    assert(UnicodeCommentzWalterMatcher_addKeywordAsUTF8(matcher, "bcd", -1L, NULL));
+    const ScanStats *stats = UnicodeCommentzWalterMatcher_getStats(matcher);
+    assert(NULL != stats);
+    gconstpointer output = NULL;
+    assert(UnicodeCommentzWalterMatcher_scanUTF8String(matcher, MISS_TEXT, -1L, &output, NULL));
+    assert(NULL == output);
+    assert(1 == stats->n_scans);
+    assert(9 == stats->n_units);
+    assert(3 == stats->n_alignments);
+    assert(3 == stats->n_rule_shifts[SCANSTATS_RULE_CHARS]);
+    assert(6 == stats->n_skipped);
+    assertConsistent(stats);
+    UnicodeCommentzWalterMatcher_free(matcher);
+}
+
+static void
+testAhoCorasick()
+{
+    UnicodeAhoCorasickMatcher *matcher = UnicodeAhoCorasickMatcher_new(64);
+    static const gchar *keywords[] = {"he", "she", "his", "hers", NULL};
+    for (const gchar **keyword = keywords; NULL != *keyword; ++keyword) {
+        assert(UnicodeAhoCorasickMatcher_addKeywordAsUTF8(matcher, *keyword, -1L, NULL));
+    }
+    const ScanStats *stats = UnicodeAhoCorasickMatcher_getStats(matcher);
+    assert(NULL != stats);
+    UnicodeAhoCorasickPatternsIter *iter = NULL;
+    assert(UnicodeAhoCorasickMatcher_scanUTF8String(matcher, "ushers", -1L, &iter, NULL));
+    gint n_matches = 0;
+    while (NULL != UnicodeAhoCorasickPatternsIter_next(iter)) {
+        ++n_matches;
+    }
+    UnicodeAhoCorasickPatternsIter_free(iter);
+    assert(3 == n_matches);
+    assert(1 == stats->n_scans);
+    assert(6 == stats->n_units);
+    // "she" の後の 'r' で "he" に戻る
+    assert(1 == stats->n_fail_transitions);
+    assert(0 < stats->n_output_steps);
+    assert(0 == stats->n_alignments);
+    assert(0 == stats->n_shifts);
+    UnicodeAhoCorasickMatcher_resetStats(matcher);
+    assertReset(stats);
+    UnicodeAhoCorasickMatcher_free(matcher);
+}
+
+static gboolean
+countMatcherMatch(const gchar *keyword, gsize keywordlen, gsize offset, gpointer user_data)
+{
+    ++(*(gint *) user_data);
+    return TRUE;
+}
+
+/**
+ * 単一パターンのエンジンではキーワードごとの統計が合計されることをテストする
+ */
+static void
+testMatcher()
+{
+    Matcher *matcher = Matcher_new();
+    ScanStats stats;
+    assert(!Matcher_getStats(matcher, &stats));
+    assert(Matcher_addKeyword(matcher, "abc", -1L, NULL));
+    assert(Matcher_addKeyword(matcher, "bcd", -1L, NULL));
+    assert(Matcher_compile(matcher, MATCHER_ENGINE_SUNDAY, NULL));
+    gint n_matches = 0;
+    assert(Matcher_scanAll(matcher, MISS_TEXT, -1L, countMatcherMatch, &n_matches, NULL));
+    assert(0 == n_matches);
+    assert(Matcher_getStats(matcher, &stats));
+    assert(2 == stats.n_scans);
+    assert(18 == stats.n_units);
+    assertConsistent(&stats);
+    Matcher_resetStats(matcher);
+    assert(Matcher_getStats(matcher, &stats));
+    assertReset(&stats);
+    assert(Matcher_compile(matcher, MATCHER_ENGINE_UNICODE_COMMENTZ_WALTER, NULL));
+    assert(Matcher_scanAll(matcher, MISS_TEXT, -1L, countMatcherMatch, &n_matches, NULL));
+    assert(Matcher_getStats(matcher, &stats));
+    assert(1 == stats.n_scans);
+    assert(3 == stats.n_rule_shifts[SCANSTATS_RULE_CHARS]);
+    Matcher_free(matcher);
+}
+
+int
+main(int argc, char **argv)
+{
+    testSunday();
+    testBoyerMoore();
+    testUnicodeBoyerMoore();
+    testCommentzWalter();
+    testUnicodeCommentzWalter();
+    testAhoCorasick();
+    testMatcher();
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <assert.h>
+#include <string.h>
+#include <glib.h>
+#include "sunday.h"
+
+static void
+assertScanResults(SundayMatcher *matcher, const gchar **text_tbl, const gboolean *expected_tbl)
+{
+    const gchar **texts_iter = text_tbl;
+    const gboolean *expecteds_iter = expected_tbl;
+    for (; NULL != *texts_iter; ++texts_iter, ++expecteds_iter) {
+        gsize textlen = strlen(*texts_iter);
+        assert(*expecteds_iter == SundayMatcher_scan(matcher, *texts_iter, textlen));
+#ifdef __SSE2__
+        assert(*expecteds_iter == SundayMatcher_scanWithSIMD(matcher, *texts_iter, textlen));
+#endif // __SSE2__
+    }
+}
+
+/**
+ * アルファベット文字列の検索をテストする
+ */
+static void
+testAlphabetTextScan()
+{
+    static const gchar *text_tbl[] = {
+        "abcde", "bcde", "abcd", "abde", "_bcde", "abcd_", "ab_de",
+        "xyzabcdefgh", "xyzbcdefgh", "xyzabcdfgh", "xyzabdefgh",
+        "abbacbcdabcdeacbd", "abbacbcdabcdabbde",
+        "aeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeabcde",
+        "aeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeaeabxde",
+        NULL,
+    };
+    static const gboolean expected_tbl[] = {
+        TRUE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE,
+        TRUE, FALSE, FALSE, FALSE,
+        TRUE, FALSE,
+        TRUE,
+        FALSE,
+    };
+    SundayMatcher *matcher = SundayMatcher_new("abcde", -1L);
+    assertScanResults(matcher, text_tbl, expected_tbl);
+    SundayMatcher_free(matcher);
+}
+
+/**
+ * 日本語文字列の検索をテストする
+ */
+static void
+testJapaneseTextScan()
+{
+    static const gchar *text_tbl[] = {
+        "インターネット",
+        "ンターネット", "インターネッ", "インタネット", "インタアネット",
+        "株式会社インターネットイニシアティブ",
+        "株式会社ンターネットイニシアティブ", "株式会社インターネッイニシアティブ",
+        "株式会社インタネットイニシアティブ", "株式会社インタアネットイニシアティブ",
+        "イターネットインーネットインターネットインターットインターネト",
+        "イターネットインーネットインタアネットインターットインターネト",
+        NULL,
+    };
+    static const gboolean expected_tbl[] = {
+        TRUE,
+        FALSE, FALSE, FALSE, FALSE,
+        TRUE,
+        FALSE, FALSE,
+        FALSE, FALSE,
+        TRUE,
+        FALSE
+    };
+    SundayMatcher *matcher = SundayMatcher_new("インターネット", -1L);
+    assertScanResults(matcher, text_tbl, expected_tbl);
+    SundayMatcher_free(matcher);
+}
+
+/**
+ * テキスト中の全ての位置に1文字のパターンを置いた場合の検索をテストする
+ */
+static void
+testEveryPositionScan()
+{
+    gchar text[100];
+    SundayMatcher *matcher = SundayMatcher_new("z", -1L);
+    for (gsize textlen = 1; textlen < sizeof(text); ++textlen) {
+        for (gsize position = 0; position < textlen; ++position) {
+            memset(text, 'a', textlen);
+            text[position] = 'z';
+            assert(SundayMatcher_scan(matcher, text, textlen));
+#ifdef __SSE2__
+            assert(SundayMatcher_scanWithSIMD(matcher, text, textlen));
+            assert(!SundayMatcher_scanWithSIMD(matcher, text, position));
+#endif // __SSE2__
+        }
+    }
+    SundayMatcher_free(matcher);
+}
+
+int
+main(int argc, char *argv[])
+{
+    testAlphabetTextScan();
+    testJapaneseTextScan();
+    testEveryPositionScan();
+    return 0;
+}
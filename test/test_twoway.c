@@ -0,0 +1,71 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "twoway.h"
+
+/**
+ * アルファベット文字列の検索をテストする
+ */
+static void
+testAlphabetTextScan()
+{
+    static const gchar *text_tbl[] = {
+        "abcde", "bcde", "abcd", "abde", "_bcde", "abcd_", "ab_de",
+        "xyzabcdefgh", "xyzbcdefgh", "xyzabcdfgh", "xyzabdefgh",
+        "abbacbcdabcdeacbd", "abbacbcdabcdabbde",
+        NULL,
+    };
+    static const gboolean expected_tbl[] = {
+        TRUE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE,
+        TRUE, FALSE, FALSE, FALSE,
+        TRUE, FALSE,
+    };
+    TwoWayMatcher *matcher = TwoWayMatcher_new("abcde", -1L);
+    const gchar **texts_iter = text_tbl;
+    const gboolean *expecteds_iter = expected_tbl;
+    for (; NULL != *texts_iter; ++texts_iter, ++expecteds_iter) {
+        assert(*expecteds_iter == TwoWayMatcher_scan(matcher, *texts_iter, strlen(*texts_iter)));
+    }
+    TwoWayMatcher_free(matcher);
+}
+
+/**
+ * 周期的なパターンを含むランダムな文字列の検索を、素朴な検索の結果と比較してテストする
+ */
+static void
+testRandomTextScan()
+{
+    gchar pattern[8];
+    gchar text[32];
+    TwoWayMatcher *matcher = TwoWayMatcher_new("", 0L);
+    srand(0);
+    for (int n = 0; n < 100000; ++n) {
+        gsize patternlen = 1 + rand() % sizeof(pattern);
+        gsize textlen = rand() % sizeof(text);
+        for (gsize i = 0; i < patternlen; ++i) {
+            pattern[i] = 'a' + rand() % 2;
+        }
+        for (gsize i = 0; i < textlen; ++i) {
+            text[i] = 'a' + rand() % 2;
+        }
+        gboolean expected = FALSE;
+        for (gsize i = 0; i + patternlen <= textlen; ++i) {
+            if (0 == memcmp(text + i, pattern, patternlen)) {
+                expected = TRUE;
+                break;
+            }
+        }
+        TwoWayMatcher_reinit(matcher, pattern, patternlen);
+        assert(expected == TwoWayMatcher_scan(matcher, text, textlen));
+    }
+    TwoWayMatcher_free(matcher);
+}
+
+int
+main(int argc, char *argv[])
+{
+    testAlphabetTextScan();
+    testRandomTextScan();
+    return 0;
+}
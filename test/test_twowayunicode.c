@@ -0,0 +1,86 @@
+#include <assert.h>
+#include <string.h>
+#include <glib.h>
+#include "twowayunicode.h"
+
+/**
+ * 検索文字列およびテキストに非BMP文字が含まれる場合の検索をテストする
+ */
+static void
+testNotBMPTextScan()
+{
+    static const gchar *text_tbl[] = {
+        "𠮟・𠂉・𥻘・𨨩",
+        "・𠂉・𥻘・𨨩", "𠮟・𠂉・𥻘・", "𠮟・𠂉𥻘・𨨩", "𠮟・𠂉鎼𥻘・𨨩",
+        "驑・䮶・髝・𠮟・𠂉・𥻘・𨨩・䲂・䱿・鰸",
+        "驑・䮶・髝・・𠂉・𥻘・𨨩・䲂・䱿・鰸", "驑・䮶・髝・・𠂉・𥻘・・䲂・䱿・鰸",
+        "驑・䮶・髝・𠮟・𠂉𥻘・𨨩・䲂・䱿・鰸", "驑・䮶・髝・𠮟・𠂉鎼𥻘・𨨩・䲂・䱿・鰸",
+        "𠮟𠂉・𥻘・𨨩𠮟・・𥻘・𨨩𠮟・𠂉・𥻘・𨨩𠮟・𠂉・・𨨩𠮟・𠂉・𥻘𨨩",
+        "𠮟𠂉・𥻘・𨨩𠮟・・𥻘・𨨩𠮟・𠂉鎼𥻘・𨨩𠮟・𠂉・・𨨩𠮟・𠂉・𥻘𨨩",
+        NULL,
+    };
+    static const gboolean expected_tbl[] = {
+        TRUE,
+        FALSE, FALSE, FALSE, FALSE,
+        TRUE,
+        FALSE, FALSE,
+        FALSE, FALSE,
+        TRUE,
+        FALSE
+    };
+    glong patternlen = 0L;
+    gunichar2 *pattern = g_utf8_to_utf16("𠮟・𠂉・𥻘・𨨩", -1L, NULL, &patternlen, NULL);
+    assert(NULL != pattern);
+    UnicodeTwoWayMatcher *matcher = UnicodeTwoWayMatcher_new(pattern, patternlen);
+    g_free(pattern);
+    const gchar **texts_iter = text_tbl;
+    const gboolean *expecteds_iter = expected_tbl;
+    for (; NULL != *texts_iter; ++texts_iter, ++expecteds_iter) {
+        glong textlen = 0L;
+        gunichar2 *text = g_utf8_to_utf16(*texts_iter, -1L, NULL, &textlen, NULL);
+        assert(NULL != text);
+        assert(*expecteds_iter == UnicodeTwoWayMatcher_scan(matcher, text, textlen));
+        g_free(text);
+    }
+    UnicodeTwoWayMatcher_free(matcher);
+}
+
+/**
+ * 周期的なパターンの検索をテストする
+ */
+static void
+testPeriodicPatternScan()
+{
+    static const gchar *text_tbl[] = {
+        "ああいああいああいああい", "ああいああいあいああいあ", "あいああいああいあ",
+        "いああいああいああいああ", "ああいああいああいあい",
+        NULL,
+    };
+    static const gboolean expected_tbl[] = {
+        TRUE, FALSE, FALSE,
+        TRUE, FALSE,
+    };
+    glong patternlen = 0L;
+    gunichar2 *pattern = g_utf8_to_utf16("ああいああいああいああ", -1L, NULL, &patternlen, NULL);
+    assert(NULL != pattern);
+    UnicodeTwoWayMatcher *matcher = UnicodeTwoWayMatcher_new(pattern, patternlen);
+    g_free(pattern);
+    const gchar **texts_iter = text_tbl;
+    const gboolean *expecteds_iter = expected_tbl;
+    for (; NULL != *texts_iter; ++texts_iter, ++expecteds_iter) {
+        glong textlen = 0L;
+        gunichar2 *text = g_utf8_to_utf16(*texts_iter, -1L, NULL, &textlen, NULL);
+        assert(NULL != text);
+        assert(*expecteds_iter == UnicodeTwoWayMatcher_scan(matcher, text, textlen));
+        g_free(text);
+    }
+    UnicodeTwoWayMatcher_free(matcher);
+}
+
+int
+main(int argc, char *argv[])
+{
+    testNotBMPTextScan();
+    testPeriodicPatternScan();
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "utf8transcoder.h"
+
+/**
+ * GLib の変換結果と比較する
+ */
+static void
+assertSameAsGLib(const gchar *text, gsize textlen, UTF16Buffer *buffer)
+{
+    glong expected_len = 0L;
+    GError *expected_error = NULL;
+    gunichar2 *expected = g_utf8_to_utf16(text, textlen, NULL, &expected_len, &expected_error);
+
+    glong actual_len = 0L;
+    GError *actual_error = NULL;
+    gboolean status = UTF8Transcoder_toUTF16(text, textlen, buffer, &actual_len, &actual_error);
+    assert((NULL != expected) == status);
+    if (status) {
+        assert(expected_len == actual_len);
+        assert(0 == memcmp(expected, buffer->data, sizeof(gunichar2) * actual_len));
+    } else {
+        assert(expected_error->code == actual_error->code);
+        g_error_free(expected_error);
+        g_error_free(actual_error);
+    }
+    g_free(expected);
+
+    const gchar *expected_end = NULL;
+    const gchar *actual_end = NULL;
+    assert(g_utf8_validate(text, textlen, &expected_end) == UTF8Transcoder_validate(text, textlen, &actual_end));
+    assert(expected_end == actual_end);
+}
+
+/**
+ * 様々な長さの文字が混在するテキストの変換をテストする
+ */
+static void
+testMixedTextTranscode()
+{
+    static const gchar *text_tbl[] = {
+        "", "abcde", "インターネット", "株式会社インターネットイニシアティブ (IIJ)",
+        "𠮟・𠂉・𥻘・𨨩", "ÀÉÎÕÜ ÅÆÇ ñ", "\xe0\xa4\x85\xed\x9f\xbf\xef\xbf\xbd",
+        "0123456789abcdefあいうえおかきくけこさしすせそたちつてとabcdefghijklmnopqrstuvwxyz",
+        NULL,
+    };
+    UTF16Buffer buffer = UTF16BUFFER_INIT;
+    for (const gchar **texts_iter = text_tbl; NULL != *texts_iter; ++texts_iter) {
+        assertSameAsGLib(*texts_iter, strlen(*texts_iter), &buffer);
+    }
+    UTF16Buffer_clear(&buffer);
+}
+
+/**
+ * 不正なバイト列や途中で途切れた文字を含むテキストの変換を、ランダムに生成してテストする
+ */
+static void
+testRandomTextTranscode()
+{
+    static const gchar *piece_tbl[] = {
+        "a", "0123456789abcdef", "é", "あ", "インターネット", "\xe0\xa0\x80", "\xed\x9f\xbf", "𠮟",
+        "\x80", "\xc0\xaf", "\xe0\x80\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xff", "\xe3\x81",
+    };
+    UTF16Buffer buffer = UTF16BUFFER_INIT;
+    srand(0);
+    for (int n = 0; n < 20000; ++n) {
+        GString *text = g_string_new(NULL);
+        gsize n_pieces = rand() % 40;
+        for (gsize i = 0; i < n_pieces; ++i) {
+            /* 不正なバイト列は低い確率で混ぜる */
+            gsize index = rand() % G_N_ELEMENTS(piece_tbl);
+            if (8 <= index && 0 != rand() % 8) {
+                index = rand() % 8;
+            }
+            g_string_append(text, piece_tbl[index]);
+        }
+        assertSameAsGLib(text->str, text->len, &buffer);
+        g_string_free(text, TRUE);
+    }
+    UTF16Buffer_clear(&buffer);
+}
+
+int
+main(int argc, char *argv[])
+{
+    testMixedTextTranscode();
+    testRandomTextTranscode();
+    return 0;
+}